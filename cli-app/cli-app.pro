@@ -0,0 +1,91 @@
+TEMPLATE = app
+TARGET   = fccli
+
+# QtGui and QtWidgets aren't used here, but the core library links against them
+QT = core gui widgets
+
+win*{
+	QT += winextras
+}
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+mac* | linux*{
+	CONFIG(release, debug|release):CONFIG += Release
+	CONFIG(debug, debug|release):CONFIG += Debug
+}
+
+contains(QT_ARCH, x86_64) {
+	ARCHITECTURE = x64
+} else {
+	ARCHITECTURE = x86
+}
+
+android {
+	Release:OUTPUT_DIR=android/release
+	Debug:OUTPUT_DIR=android/debug
+
+} else:ios {
+	Release:OUTPUT_DIR=ios/release
+	Debug:OUTPUT_DIR=ios/debug
+
+} else {
+	Release:OUTPUT_DIR=release/$${ARCHITECTURE}
+	Debug:OUTPUT_DIR=debug/$${ARCHITECTURE}
+}
+
+DESTDIR  = ../bin/$${OUTPUT_DIR}
+OBJECTS_DIR = ../build/$${OUTPUT_DIR}/$${TARGET}
+MOC_DIR     = ../build/$${OUTPUT_DIR}/$${TARGET}
+UI_DIR      = ../build/$${OUTPUT_DIR}/$${TARGET}
+RCC_DIR     = ../build/$${OUTPUT_DIR}/$${TARGET}
+
+INCLUDEPATH += \
+	$$PWD/src/ \
+	../file-commander-core/src \
+	../file-commander-core/include \
+	../qtutils \
+	../cpputils
+
+SOURCES += \
+	src/main.cpp \
+	src/cjsonreporter.cpp \
+	src/cfileoperationrunner.cpp \
+	src/csearchrunner.cpp
+
+HEADERS += \
+	src/cjsonreporter.h \
+	src/cfileoperationrunner.h \
+	src/csearchrunner.h
+
+DEFINES += _SCL_SECURE_NO_WARNINGS
+
+LIBS += -L../bin/$${OUTPUT_DIR} -lcore -lqtutils -lcpputils
+
+win*{
+	LIBS += -lole32 -lShell32 -lUser32
+	QMAKE_CXXFLAGS += /MP /wd4251
+	QMAKE_CXXFLAGS_WARN_ON = /W4
+	DEFINES += WIN32_LEAN_AND_MEAN NOMINMAX
+
+	!*msvc2013*:QMAKE_LFLAGS += /DEBUG:FASTLINK
+
+	Debug:QMAKE_LFLAGS += /INCREMENTAL
+	Release:QMAKE_LFLAGS += /OPT:REF /OPT:ICF
+}
+
+linux*|mac*{
+	QMAKE_CXXFLAGS_WARN_ON = -Wall -Wno-c++11-extensions -Wno-local-type-template-args -Wno-deprecated-register
+
+	Release:DEFINES += NDEBUG=1
+	Debug:DEFINES += _DEBUG
+}
+
+win32*:!*msvc2012:*msvc* {
+	QMAKE_CXXFLAGS += /FS
+}
+
+mac*|linux*{
+	PRE_TARGETDEPS += $${DESTDIR}/libcore.a
+}
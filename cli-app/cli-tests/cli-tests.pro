@@ -0,0 +1,20 @@
+TEMPLATE = app
+TARGET   = fccli_test
+
+# Runs the fccli executable, which must be built into the same folder
+include(../../file-commander-core/config.pri)
+
+QT = core testlib
+
+DESTDIR  = ../../bin/$${OUTPUT_DIR}
+OBJECTS_DIR = ../../build/$${OUTPUT_DIR}/$${TARGET}
+MOC_DIR     = ../../build/$${OUTPUT_DIR}/$${TARGET}
+UI_DIR      = ../../build/$${OUTPUT_DIR}/$${TARGET}
+RCC_DIR     = ../../build/$${OUTPUT_DIR}/$${TARGET}
+
+INCLUDEPATH += \
+	$${PWD}/ \
+	../../cpputils
+
+SOURCES += \
+	clitest.cpp
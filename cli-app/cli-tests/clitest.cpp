@@ -0,0 +1,190 @@
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <vector>
+
+// Smoke test of fccli: the argument parsing, the exit codes and the events printed by each command
+class CliTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+
+	void usageErrors_data();
+	void usageErrors();
+
+	void size();
+	void search();
+	void copyAndDelete();
+
+private:
+	// Returns the exit code, or -1 if fccli didn't finish normally
+	int run(const QStringList& arguments, std::vector<QJsonObject>* events = nullptr) const;
+	static std::vector<QJsonObject> eventsOfType(const std::vector<QJsonObject>& events, const QString& type);
+
+private:
+	QTemporaryDir _tempDir;
+	QString _root;
+};
+
+// Same as in main.cpp
+enum ExitCode {
+	exitSuccess = 0,
+	exitUsageError = 1,
+	exitAborted = 2
+};
+
+void CliTest::initTestCase()
+{
+	QVERIFY(_tempDir.isValid());
+	_root = _tempDir.path() + "/root";
+	QVERIFY(QDir().mkpath(_root + "/sub"));
+
+	for (const QString& name: {QString("a.txt"), QString("b.log"), QString("sub/c.txt")})
+	{
+		QFile file(_root + '/' + name);
+		QVERIFY(file.open(QFile::WriteOnly));
+		QCOMPARE(file.write(QByteArray(100, name[0].toLatin1())), (qint64)100);
+	}
+}
+
+void CliTest::usageErrors_data()
+{
+	QTest::addColumn<QStringList>("arguments");
+
+	QTest::newRow("no command") << QStringList();
+	QTest::newRow("unknown command") << QStringList{"frobnicate"};
+	QTest::newRow("copy without destination") << QStringList{"copy", "a"};
+	QTest::newRow("move without destination") << QStringList{"move", "a"};
+	QTest::newRow("delete without items") << QStringList{"delete"};
+	QTest::newRow("search without folders") << QStringList{"search", "*.txt"};
+	QTest::newRow("search with an empty mask") << QStringList{"search", "", "."};
+	QTest::newRow("size without items") << QStringList{"size"};
+	QTest::newRow("missing item") << QStringList{"size", "/this/path/does/not/exist"};
+	QTest::newRow("invalid --on-exists") << QStringList{"--on-exists", "ignore", "delete", "a"};
+	QTest::newRow("overwrite is not an error policy") << QStringList{"--on-error", "overwrite", "delete", "a"};
+}
+
+void CliTest::usageErrors()
+{
+	QFETCH(QStringList, arguments);
+
+	std::vector<QJsonObject> events;
+	QCOMPARE(run(arguments, &events), (int)exitUsageError);
+	// Nothing is done
+	QVERIFY(events.empty());
+}
+
+void CliTest::size()
+{
+	std::vector<QJsonObject> events;
+	QCOMPARE(run({"size", _root}, &events), (int)exitSuccess);
+
+	const auto sizes = eventsOfType(events, "size");
+	QCOMPARE(sizes.size(), (size_t)1);
+	QCOMPARE(sizes.front()["path"].toString(), _root);
+	QCOMPARE(sizes.front()["files"].toInt(), 3);
+
+	QVERIFY(!events.empty());
+	QCOMPARE(events.back()["event"].toString(), QString("finished"));
+	QCOMPARE(events.back()["status"].toString(), QString("completed"));
+	QCOMPARE(events.back()["files"].toInt(), 3);
+	QVERIFY(events.back().contains("elapsed_ms"));
+}
+
+void CliTest::search()
+{
+	std::vector<QJsonObject> events;
+	QCOMPARE(run({"search", "*.txt", _root}, &events), (int)exitSuccess);
+
+	QStringList matches;
+	for (const QJsonObject& match: eventsOfType(events, "match"))
+		matches.push_back(QDir::fromNativeSeparators(match["path"].toString()));
+	matches.sort();
+	QCOMPARE(matches, (QStringList{_root + "/a.txt", _root + "/sub/c.txt"}));
+
+	QVERIFY(!events.empty());
+	QCOMPARE(events.back()["event"].toString(), QString("finished"));
+	QCOMPARE(events.back()["status"].toString(), QString("completed"));
+	QCOMPARE(events.back()["matches"].toInt(), 2);
+
+	// By contents
+	QCOMPARE(run({"search", "--contents", "bbb", "*", _root}, &events), (int)exitSuccess);
+	const auto contentsMatches = eventsOfType(events, "match");
+	QCOMPARE(contentsMatches.size(), (size_t)1);
+	QCOMPARE(QDir::fromNativeSeparators(contentsMatches.front()["path"].toString()), _root + "/b.log");
+}
+
+void CliTest::copyAndDelete()
+{
+	const QString destination = _tempDir.path() + "/copy";
+	QVERIFY(QDir().mkpath(destination));
+
+	std::vector<QJsonObject> events;
+	QCOMPARE(run({"copy", _root + "/a.txt", _root + "/sub", destination}, &events), (int)exitSuccess);
+	QVERIFY(QFile::exists(destination + "/a.txt"));
+	QVERIFY(QFile::exists(destination + "/sub/c.txt"));
+	QVERIFY(!events.empty());
+	QCOMPARE(events.back()["event"].toString(), QString("finished"));
+
+	// The destination file exists, and the default policy is to abort
+	QCOMPARE(run({"copy", _root + "/a.txt", destination}), (int)exitAborted);
+	QCOMPARE(run({"copy", "--on-exists", "skip", _root + "/a.txt", destination}), (int)exitSuccess);
+
+	QCOMPARE(run({"delete", destination}), (int)exitSuccess);
+	QVERIFY(!QFileInfo::exists(destination));
+}
+
+int CliTest::run(const QStringList& arguments, std::vector<QJsonObject>* events) const
+{
+	QProcess process;
+	process.start(QCoreApplication::applicationDirPath() + "/fccli", arguments);
+	if (!process.waitForFinished(60000) || process.exitStatus() != QProcess::NormalExit)
+	{
+		qWarning() << "fccli" << arguments << "failed:" << process.errorString();
+		process.kill();
+		return -1;
+	}
+
+	if (events)
+	{
+		events->clear();
+		// The help text that comes with some usage errors isn't JSON and is skipped
+		for (const QByteArray& line: process.readAllStandardOutput().split('\n'))
+		{
+			const QJsonDocument event = QJsonDocument::fromJson(line);
+			if (event.isObject())
+				events->push_back(event.object());
+		}
+	}
+
+	return process.exitCode();
+}
+
+std::vector<QJsonObject> CliTest::eventsOfType(const std::vector<QJsonObject>& events, const QString& type)
+{
+	std::vector<QJsonObject> result;
+	for (const QJsonObject& event: events)
+	{
+		if (event["event"].toString() == type)
+			result.push_back(event);
+	}
+
+	return result;
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_GUILESS_MAIN(CliTest)
+#include "clitest.moc"
+RESTORE_COMPILER_WARNINGS
@@ -0,0 +1,169 @@
+#include "cfileoperationrunner.h"
+#include "cjsonreporter.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCoreApplication>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+static QString haltReasonName(HaltReason reason)
+{
+	switch (reason)
+	{
+	case hrFileExists:
+		return QStringLiteral("file_exists");
+	case hrSourceFileIsReadOnly:
+		return QStringLiteral("source_read_only");
+	case hrDestFileIsReadOnly:
+		return QStringLiteral("dest_read_only");
+	case hrFailedToMakeItemWritable:
+		return QStringLiteral("failed_to_make_writable");
+	case hrFileDoesntExit:
+		return QStringLiteral("file_doesnt_exist");
+	case hrCreatingFolderFailed:
+		return QStringLiteral("creating_folder_failed");
+	case hrFailedToDelete:
+		return QStringLiteral("failed_to_delete");
+	default:
+		return QStringLiteral("unknown_error");
+	}
+}
+
+static QString responseName(UserResponse response)
+{
+	switch (response)
+	{
+	case urSkipThis:
+	case urSkipAll:
+		return QStringLiteral("skip");
+	case urProceedWithThis:
+	case urProceedWithAll:
+		return QStringLiteral("overwrite");
+	default:
+		return QStringLiteral("abort");
+	}
+}
+
+CFileOperationRunner::CFileOperationRunner(CJsonReporter& reporter, const Policies& policies) :
+	_reporter(reporter),
+	_policies(policies)
+{
+}
+
+bool CFileOperationRunner::run(Operation operation, const std::vector<CFileSystemObject>& source, const QString& destination, size_t numWorkers, size_t maxWorkersPerDevice)
+{
+	std::unique_ptr<COperationPerformer> performer(new COperationPerformer(operation, source, destination));
+	_performer = performer.get();
+	_performer->setWatcher(this);
+	if (operation != operationDelete)
+		_performer->setParallelCopying(numWorkers, maxWorkersPerDevice);
+
+	_performer->start();
+
+	// The callbacks are queued by the operation thread, same as for the progress dialogs, only drained by polling rather than by a timer
+	while (!_finished)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		QCoreApplication::processEvents();
+		processEvents();
+	}
+
+	_performer = nullptr;
+	performer.reset();
+
+	QJsonObject event {
+		{"event", "finished"},
+		{"status", _aborted ? "aborted" : "completed"},
+		{"files", (qint64)_numFilesProcessed},
+		{"total_files", (qint64)_totalNumFiles},
+		{"halts", (qint64)_numHalts},
+		{"speed", (qint64)_speed}
+	};
+	_reporter.report(event);
+
+	return !_aborted;
+}
+
+void CFileOperationRunner::onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed, uint32_t secondsRemaining, bool totalsEstimated)
+{
+	_numFilesProcessed = numFilesProcessed;
+	_totalNumFiles = totalNumFiles;
+	_speed = speed;
+
+	QJsonObject event {
+		{"event", "progress"},
+		{"percent", (double)totalPercentage},
+		{"files", (qint64)numFilesProcessed},
+		{"total_files", (qint64)totalNumFiles},
+		{"totals_estimated", totalsEstimated},
+		{"current_file", _currentFile},
+		{"file_percent", (double)filePercentage},
+		{"speed", (qint64)speed}
+	};
+
+	if (!totalsEstimated)
+		event.insert("eta_s", (qint64)secondsRemaining);
+
+	_reporter.reportProgress(event);
+}
+
+void CFileOperationRunner::onProcessHalted(HaltReason reason, CFileSystemObject source, CFileSystemObject dest, QString errorMessage)
+{
+	assert_and_return_r(_performer, );
+
+	UserResponse response = urAbort;
+	switch (reason)
+	{
+	case hrFileExists:
+		response = _policies.onFileExists;
+		break;
+	case hrSourceFileIsReadOnly:
+	case hrDestFileIsReadOnly:
+		response = _policies.onReadOnly;
+		break;
+	default:
+		response = _policies.onError;
+		break;
+	}
+
+	++_numHalts;
+	_reporter.report(QJsonObject {
+		{"event", "halted"},
+		{"reason", haltReasonName(reason)},
+		{"source", source.fullAbsolutePath()},
+		{"destination", dest.fullAbsolutePath()},
+		{"error", errorMessage},
+		{"action", responseName(response)}
+	});
+
+	if (response == urAbort)
+		_aborted = true;
+
+	_performer->userResponse(reason, response);
+}
+
+void CFileOperationRunner::onProcessFinished(QString /*message*/)
+{
+	_finished = true;
+}
+
+void CFileOperationRunner::onCurrentFileChanged(QString file)
+{
+	_currentFile = file;
+}
+
+void CFileOperationRunner::processEvents()
+{
+	std::vector<std::function<void ()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(_callbackMutex);
+		callbacks.swap(_callbacks);
+	}
+
+	// Not holding the lock: onProcessHalted() responds to the performer, which may be waiting to queue a callback
+	for (const auto& callback: callbacks)
+		callback();
+}
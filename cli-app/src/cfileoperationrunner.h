@@ -0,0 +1,41 @@
+#pragma once
+
+#include "fileoperations/coperationperformer.h"
+
+class CJsonReporter;
+
+// Runs a copy, move or delete operation to completion without any interaction: whenever the operation halts for a user decision,
+// the response is taken from the policies given on the command line
+class CFileOperationRunner : public CFileOperationObserver
+{
+public:
+	struct Policies {
+		UserResponse onFileExists = urAbort;
+		UserResponse onReadOnly = urAbort;
+		UserResponse onError = urAbort;
+	};
+
+	CFileOperationRunner(CJsonReporter& reporter, const Policies& policies);
+
+	// Blocks until the operation is finished. Returns false if it was aborted.
+	bool run(Operation operation, const std::vector<CFileSystemObject>& source, const QString& destination, size_t numWorkers, size_t maxWorkersPerDevice);
+
+private:
+	void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining, bool totalsEstimated) override;
+	void onProcessHalted(HaltReason reason, CFileSystemObject source, CFileSystemObject dest, QString errorMessage) override;
+	void onProcessFinished(QString message = QString()) override;
+	void onCurrentFileChanged(QString file) override;
+
+	void processEvents();
+
+private:
+	CJsonReporter& _reporter;
+	const Policies _policies;
+	COperationPerformer* _performer = nullptr;
+
+	QString _currentFile;
+	size_t _numFilesProcessed = 0, _totalNumFiles = 0, _numHalts = 0;
+	uint64_t _speed = 0;
+	bool _finished = false;
+	bool _aborted = false;
+};
@@ -0,0 +1,44 @@
+#include "cjsonreporter.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QJsonDocument>
+RESTORE_COMPILER_WARNINGS
+
+#include <stdio.h>
+
+CJsonReporter::CJsonReporter(int progressIntervalMs) :
+	_startTime(std::chrono::steady_clock::now()),
+	_progressInterval(progressIntervalMs)
+{
+}
+
+void CJsonReporter::report(QJsonObject event)
+{
+	event.insert(QStringLiteral("elapsed_ms"), elapsedMs());
+	const QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact) + '\n';
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	fwrite(line.constData(), 1, (size_t)line.size(), stdout);
+	// Whoever reads the output is probably waiting for it
+	fflush(stdout);
+}
+
+void CJsonReporter::reportProgress(QJsonObject event)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto now = std::chrono::steady_clock::now();
+		if (_progressReported && now - _lastProgressTime < _progressInterval)
+			return;
+
+		_progressReported = true;
+		_lastProgressTime = now;
+	}
+
+	report(std::move(event));
+}
+
+qint64 CJsonReporter::elapsedMs() const
+{
+	return (qint64)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime).count();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QJsonObject>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+#include <mutex>
+
+// Writes the events to stdout, one compact JSON object per line, for scripts to parse. The log goes to stderr.
+// Every event gets the "elapsed_ms" field: the time since the reporter was created.
+class CJsonReporter
+{
+public:
+	explicit CJsonReporter(int progressIntervalMs);
+
+	void report(QJsonObject event);
+	// The progress events are throttled: the ones that come sooner than the interval after the previous one are dropped
+	void reportProgress(QJsonObject event);
+
+	qint64 elapsedMs() const;
+
+private:
+	std::mutex _mutex;
+	const std::chrono::steady_clock::time_point _startTime;
+	std::chrono::steady_clock::time_point _lastProgressTime;
+	const std::chrono::milliseconds _progressInterval;
+	bool _progressReported = false;
+};
@@ -0,0 +1,68 @@
+#include "csearchrunner.h"
+#include "cjsonreporter.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCoreApplication>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+#include <thread>
+
+CSearchRunner::CSearchRunner(CFileSearchEngine& engine, CJsonReporter& reporter) :
+	_engine(engine),
+	_reporter(reporter)
+{
+	_engine.addListener(this);
+}
+
+CSearchRunner::~CSearchRunner()
+{
+	_engine.removeListener(this);
+}
+
+void CSearchRunner::run(const QString& what, bool subjectCaseSensitive, const QStringList& where, const QString& contentsToFind, bool contentsCaseSensitive)
+{
+	_engine.search(what, subjectCaseSensitive, where, contentsToFind, contentsCaseSensitive);
+
+	// The search engine delivers its notifications through its UI queue; this thread plays the part of the UI thread
+	while (!_finished)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		QCoreApplication::processEvents();
+		_engine.uiThreadTimerTick();
+	}
+}
+
+void CSearchRunner::itemScanned(const QString& currentItem)
+{
+	_reporter.reportProgress(QJsonObject {
+		{"event", "progress"},
+		{"current_item", currentItem},
+		{"matches", (qint64)_numMatches}
+	});
+}
+
+void CSearchRunner::matchesFound(const std::vector<QString>& paths)
+{
+	for (const QString& path: paths)
+	{
+		_reporter.report(QJsonObject {
+			{"event", "match"},
+			{"path", path}
+		});
+	}
+
+	_numMatches += paths.size();
+}
+
+void CSearchRunner::searchFinished(CFileSearchEngine::SearchStatus status, uint32_t itemsPerSecond)
+{
+	_reporter.report(QJsonObject {
+		{"event", "finished"},
+		{"status", status == CFileSearchEngine::SearchFinished ? "completed" : "aborted"},
+		{"matches", (qint64)_numMatches},
+		{"items_per_second", (qint64)itemsPerSecond}
+	});
+
+	_finished = true;
+}
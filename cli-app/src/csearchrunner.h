@@ -0,0 +1,28 @@
+#pragma once
+
+#include "filesearchengine/cfilesearchengine.h"
+
+class CJsonReporter;
+
+// Runs a file search through the core's search engine, reporting every match as soon as it's delivered
+class CSearchRunner : public CFileSearchEngine::FileSearchListener
+{
+public:
+	CSearchRunner(CFileSearchEngine& engine, CJsonReporter& reporter);
+	~CSearchRunner();
+
+	// Blocks until the search is finished
+	void run(const QString& what, bool subjectCaseSensitive, const QStringList& where, const QString& contentsToFind, bool contentsCaseSensitive);
+
+private:
+	void itemScanned(const QString& currentItem) override;
+	void matchesFound(const std::vector<QString>& paths) override;
+	void searchFinished(CFileSearchEngine::SearchStatus status, uint32_t itemsPerSecond) override;
+
+private:
+	CFileSearchEngine& _engine;
+	CJsonReporter& _reporter;
+
+	size_t _numMatches = 0;
+	bool _finished = false;
+};
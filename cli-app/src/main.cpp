@@ -0,0 +1,218 @@
+#include "cfileoperationrunner.h"
+#include "cjsonreporter.h"
+#include "csearchrunner.h"
+#include "cpanel.h"
+#include "settings.h"
+#include "settings/csettings.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFileInfo>
+#include <QLoggingCategory>
+RESTORE_COMPILER_WARNINGS
+
+#include <stdio.h>
+
+enum ExitCode {
+	exitSuccess = 0,
+	exitUsageError = 1,
+	exitAborted = 2
+};
+
+static int usageError(const QString& message)
+{
+	fprintf(stderr, "%s\n", qUtf8Printable(message));
+	return exitUsageError;
+}
+
+// "skip", "overwrite" (if allowed) or "abort"
+static bool parsePolicy(const QString& value, bool overwriteAllowed, UserResponse& response)
+{
+	if (value == QLatin1String("skip"))
+		response = urSkipAll;
+	else if (value == QLatin1String("overwrite") && overwriteAllowed)
+		response = urProceedWithAll;
+	else if (value == QLatin1String("abort"))
+		response = urAbort;
+	else
+		return false;
+
+	return true;
+}
+
+static bool existingItems(const QStringList& paths, std::vector<CFileSystemObject>& items, QString& error)
+{
+	for (const QString& path: paths)
+	{
+		CFileSystemObject item(QFileInfo(path).absoluteFilePath());
+		if (!item.exists())
+		{
+			error = QStringLiteral("No such file or folder: ") + path;
+			return false;
+		}
+
+		items.push_back(std::move(item));
+	}
+
+	return true;
+}
+
+static int sizeCommand(const std::vector<CFileSystemObject>& items, CJsonReporter& reporter)
+{
+	FilesystemObjectsStatistics total;
+	for (const CFileSystemObject& item: items)
+	{
+		const FilesystemObjectsStatistics stats = CPanel::calculateStatistics(std::vector<CFileSystemObject>(1, item), [&reporter](const QString& currentFolder) {
+			reporter.reportProgress(QJsonObject {
+				{"event", "progress"},
+				{"current_item", currentFolder}
+			});
+		});
+
+		reporter.report(QJsonObject {
+			{"event", "size"},
+			{"path", item.fullAbsolutePath()},
+			{"files", (qint64)stats.files},
+			{"folders", (qint64)stats.folders},
+			{"bytes", (qint64)stats.occupiedSpace}
+		});
+
+		total.files += stats.files;
+		total.folders += stats.folders;
+		total.occupiedSpace += stats.occupiedSpace;
+	}
+
+	reporter.report(QJsonObject {
+		{"event", "finished"},
+		{"status", "completed"},
+		{"files", (qint64)total.files},
+		{"folders", (qint64)total.folders},
+		{"bytes", (qint64)total.occupiedSpace}
+	});
+
+	return exitSuccess;
+}
+
+int main(int argc, char *argv[])
+{
+	AdvancedAssert::setLoggingFunc([](const char* message){
+		qInfo() << message;
+	});
+
+	QCoreApplication app(argc, argv);
+	// Same as the GUI, so that the same settings and caches are used
+	app.setOrganizationName("GitHubSoft");
+	app.setApplicationName("File Commander");
+
+	CSettings::setApplicationName(app.applicationName());
+	CSettings::setOrganizationName(app.organizationName());
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+		"Performs file operations without user interaction. Every event is printed to stdout as a single-line JSON object.\n\n"
+		"Commands:\n"
+		"  copy <source>... <destination>\n"
+		"  move <source>... <destination>\n"
+		"  delete <item>...\n"
+		"  search <name mask> <folder>...\n"
+		"  size <item>...\n\n"
+		"Exit code: 0 - success, 1 - invalid arguments, 2 - the operation was aborted.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("command", "copy, move, delete, search or size");
+	parser.addPositionalArgument("arguments", "The arguments of the command", "[arguments...]");
+
+	const QCommandLineOption onExistsOption("on-exists", "What to do when the destination file exists: skip, overwrite or abort (the default).", "policy", "abort");
+	const QCommandLineOption onReadOnlyOption("on-read-only", "What to do with the read-only files: skip, overwrite or abort (the default).", "policy", "abort");
+	const QCommandLineOption onErrorOption("on-error", "What to do when an item can't be processed: skip or abort (the default).", "policy", "abort");
+
+	CSettings s;
+	const QCommandLineOption workersOption("workers", "The number of threads copying small files.", "count", s.value(KEY_OPERATIONS_PARALLEL_COPY_WORKERS, 4).toString());
+	const QCommandLineOption workersPerDeviceOption("workers-per-device", "The maximum number of threads writing to one device.", "count", s.value(KEY_OPERATIONS_PARALLEL_COPY_WORKERS_PER_DEVICE, 4).toString());
+
+	const QCommandLineOption contentsOption("contents", "search: only find the files containing this text.", "text");
+	const QCommandLineOption caseSensitiveOption("case-sensitive", "search: match the name mask case-sensitively.");
+	const QCommandLineOption contentsCaseSensitiveOption("contents-case-sensitive", "search: match the contents case-sensitively.");
+
+	const QCommandLineOption progressIntervalOption("progress-interval", "The minimum time between two progress events, ms (500 by default).", "ms", "500");
+	const QCommandLineOption verboseOption("verbose", "Write the log to stderr.");
+
+	parser.addOptions({onExistsOption, onReadOnlyOption, onErrorOption, workersOption, workersPerDeviceOption,
+		contentsOption, caseSensitiveOption, contentsCaseSensitiveOption, progressIntervalOption, verboseOption});
+	parser.process(app);
+
+	if (!parser.isSet(verboseOption))
+		QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+	QStringList arguments = parser.positionalArguments();
+	if (arguments.empty())
+		parser.showHelp(exitUsageError);
+
+	const QString command = arguments.takeFirst();
+	CJsonReporter reporter(parser.value(progressIntervalOption).toInt());
+
+	if (command == QLatin1String("copy") || command == QLatin1String("move") || command == QLatin1String("delete"))
+	{
+		CFileOperationRunner::Policies policies;
+		if (!parsePolicy(parser.value(onExistsOption), true, policies.onFileExists))
+			return usageError("Invalid --on-exists value: " + parser.value(onExistsOption));
+		if (!parsePolicy(parser.value(onReadOnlyOption), true, policies.onReadOnly))
+			return usageError("Invalid --on-read-only value: " + parser.value(onReadOnlyOption));
+		if (!parsePolicy(parser.value(onErrorOption), false, policies.onError))
+			return usageError("Invalid --on-error value: " + parser.value(onErrorOption));
+
+		const Operation operation = command == QLatin1String("copy") ? operationCopy : (command == QLatin1String("move") ? operationMove : operationDelete);
+		QString destination;
+		if (operation != operationDelete)
+		{
+			if (arguments.size() < 2)
+				return usageError("Usage: " + command + " <source>... <destination>");
+
+			destination = QFileInfo(arguments.takeLast()).absoluteFilePath();
+		}
+		else if (arguments.empty())
+			return usageError("Usage: delete <item>...");
+
+		std::vector<CFileSystemObject> items;
+		QString error;
+		if (!existingItems(arguments, items, error))
+			return usageError(error);
+
+		CFileOperationRunner runner(reporter, policies);
+		const bool completed = runner.run(operation, items, destination, parser.value(workersOption).toUInt(), parser.value(workersPerDeviceOption).toUInt());
+		return completed ? exitSuccess : exitAborted;
+	}
+	else if (command == QLatin1String("search"))
+	{
+		if (arguments.size() < 2)
+			return usageError("Usage: search <name mask> <folder>...");
+
+		const QString what = arguments.takeFirst();
+		if (what.isEmpty())
+			return usageError("The name mask can't be empty");
+
+		for (QString& folder: arguments)
+			folder = QFileInfo(folder).absoluteFilePath();
+
+		// Only the search engine itself: no controller, panels, volume enumeration or indexes to set up
+		CFileSearchEngine engine;
+		CSearchRunner runner(engine, reporter);
+		runner.run(what, parser.isSet(caseSensitiveOption), arguments, parser.value(contentsOption), parser.isSet(contentsCaseSensitiveOption));
+		return exitSuccess;
+	}
+	else if (command == QLatin1String("size"))
+	{
+		if (arguments.empty())
+			return usageError("Usage: size <item>...");
+
+		std::vector<CFileSystemObject> items;
+		QString error;
+		if (!existingItems(arguments, items, error))
+			return usageError(error);
+
+		return sizeCommand(items, reporter);
+	}
+
+	return usageError("Unknown command: " + command);
+}
@@ -1,6 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS = operationperformer filesystemobject
+SUBDIRS = operationperformer filesystemobject directorylister directoryscanner dirsizecache filecontentsmatcher filecontentsindex filenameindex
 SUBDIRS += qtutils cpputils cpp-template-utils test-utils
 
 cpp-template-utils.subdir = ../../cpp-template-utils
@@ -13,3 +13,9 @@ test-utils.depends = qtutils
 
 operationperformer.depends = test-utils
 filesystemobject.depends = qtutils
+directorylister.depends = qtutils
+directoryscanner.depends = qtutils
+dirsizecache.depends = qtutils
+filecontentsmatcher.depends = qtutils
+filecontentsindex.depends = qtutils
+filenameindex.depends = qtutils
@@ -0,0 +1,40 @@
+TEMPLATE = app
+TARGET   = directorylister_benchmark
+
+include(../../config.pri)
+
+QT = core testlib
+QT += gui #QIcon, iconprovider
+
+DESTDIR  = ../../../bin/$${OUTPUT_DIR}
+OBJECTS_DIR = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+MOC_DIR     = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+UI_DIR      = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+RCC_DIR     = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+
+mac*|linux*{
+	PRE_TARGETDEPS += $${DESTDIR}/libqtutils.a $${DESTDIR}/libcpputils.a
+}
+
+for (included_item, INCLUDEPATH): INCLUDEPATH += ../../$${included_item}
+INCLUDEPATH += \
+	$${PWD}/ \
+	../../src/
+
+LIBS += -L$${DESTDIR} -lqtutils -lcpputils
+
+SOURCES += \
+	directorylisterbenchmark.cpp \
+	../../src/directorylister.cpp \
+	../../src/cfilesystemobject.cpp \
+	../../src/fileoperations/kernelassistedcopy.cpp \
+	../../src/fasthash.c \
+	../../src/iconprovider/ciconprovider.cpp
+
+HEADERS += \
+	../../src/directorylister.h \
+	../../src/cfilesystemobject.h \
+	../../src/fileoperations/kernelassistedcopy.h \
+	../../src/fasthash.h \
+	../../src/iconprovider/ciconprovider.h \
+	../../src/iconprovider/ciconproviderimpl.h
@@ -0,0 +1,157 @@
+#include "directorylister.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <map>
+
+// Compares the time it takes to populate a panel from a folder of 10k / 100k / 1M files the old way (QDir::entryInfoList + a CFileSystemObject per QFileInfo) and with listDirectoryNatively.
+// The 1M case takes a while to set up and is only run if FC_BENCHMARK_1M is set.
+class DirectoryListerBenchmark : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+	void nativeListingMatchesQDir();
+
+	void populateWithQDir_data();
+	void populateWithQDir();
+	void populateNatively_data();
+	void populateNatively();
+
+private:
+	static void addBenchmarkRows();
+	QString folderWithFiles(int numFiles);
+
+private:
+	QTemporaryDir _root;
+	std::map<int, QString> _folders;
+};
+
+void DirectoryListerBenchmark::initTestCase()
+{
+	QVERIFY(_root.isValid());
+}
+
+void DirectoryListerBenchmark::nativeListingMatchesQDir()
+{
+	const QString folder = _root.path() + "/mixed/";
+	QVERIFY(QDir().mkpath(folder + "subfolder.with.dots"));
+	QVERIFY(QDir().mkpath(folder + ".hidden_folder"));
+	for (const QString& fileName: QStringList{"file.txt", "archive.tar.gz", "no_extension", ".bashrc", "trailing_dot.", QString::fromUtf8("юникод.md")})
+	{
+		QFile file(folder + fileName);
+		QVERIFY(file.open(QFile::WriteOnly));
+		file.write(fileName.toUtf8());
+	}
+
+	std::vector<CFileSystemObject> nativeItems;
+	if (!listDirectoryNatively(folder, true, nativeItems))
+		QSKIP("The native listing is not available on this platform");
+
+	std::map<qulonglong, CFileSystemObject> qDirItems;
+	for (const auto& info: QDir(folder).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System))
+	{
+		const CFileSystemObject item(info);
+		qDirItems[item.hash()] = item;
+	}
+
+	QCOMPARE(nativeItems.size(), qDirItems.size());
+	for (const auto& nativeItem: nativeItems)
+	{
+		const auto qDirItem = qDirItems.find(nativeItem.hash());
+		QVERIFY2(qDirItem != qDirItems.end(), qPrintable(nativeItem.fullAbsolutePath()));
+		QCOMPARE(nativeItem.fullAbsolutePath(), qDirItem->second.fullAbsolutePath());
+		QCOMPARE(nativeItem.parentDirPath(), qDirItem->second.parentDirPath());
+		QCOMPARE(nativeItem.fullName(), qDirItem->second.fullName());
+		QCOMPARE(nativeItem.isCdUp(), qDirItem->second.isCdUp());
+		QCOMPARE(nativeItem.isHidden(), qDirItem->second.isHidden());
+		QCOMPARE(nativeItem.type(), qDirItem->second.type());
+		QCOMPARE(nativeItem.size(), qDirItem->second.size());
+		QCOMPARE(nativeItem.properties().modificationDate, qDirItem->second.properties().modificationDate);
+		if (nativeItem.isFile())
+		{
+			QCOMPARE(nativeItem.extension(), qDirItem->second.extension());
+			QCOMPARE(nativeItem.name(), qDirItem->second.name());
+		}
+	}
+}
+
+void DirectoryListerBenchmark::populateWithQDir_data()
+{
+	addBenchmarkRows();
+}
+
+void DirectoryListerBenchmark::populateWithQDir()
+{
+	QFETCH(int, numFiles);
+	const QString folder = folderWithFiles(numFiles);
+
+	QBENCHMARK_ONCE {
+		std::vector<CFileSystemObject> items;
+		const auto list = QDir(folder).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System);
+		items.reserve((size_t)list.size());
+		for (const auto& info: list)
+			items.emplace_back(info);
+
+		QVERIFY(items.size() >= (size_t)numFiles);
+	}
+}
+
+void DirectoryListerBenchmark::populateNatively_data()
+{
+	addBenchmarkRows();
+}
+
+void DirectoryListerBenchmark::populateNatively()
+{
+	QFETCH(int, numFiles);
+	const QString folder = folderWithFiles(numFiles);
+
+	QBENCHMARK_ONCE {
+		std::vector<CFileSystemObject> items;
+		if (!listDirectoryNatively(folder, true, items))
+			QSKIP("The native listing is not available on this platform");
+
+		QVERIFY(items.size() >= (size_t)numFiles);
+	}
+}
+
+void DirectoryListerBenchmark::addBenchmarkRows()
+{
+	QTest::addColumn<int>("numFiles");
+
+	QTest::newRow("10k") << 10000;
+	QTest::newRow("100k") << 100000;
+	if (qEnvironmentVariableIsSet("FC_BENCHMARK_1M"))
+		QTest::newRow("1M") << 1000000;
+}
+
+QString DirectoryListerBenchmark::folderWithFiles(int numFiles)
+{
+	auto& folder = _folders[numFiles];
+	if (!folder.isEmpty())
+		return folder;
+
+	folder = _root.path() + "/" + QString::number(numFiles) + "/";
+	if (!QDir().mkpath(folder))
+		return QString();
+
+	for (int i = 0; i < numFiles; ++i)
+	{
+		QFile file(folder + "file_" + QString::number(i) + ".dat");
+		if (!file.open(QFile::WriteOnly))
+			return QString();
+	}
+
+	return folder;
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_APPLESS_MAIN(DirectoryListerBenchmark)
+#include "directorylisterbenchmark.moc"
+RESTORE_COMPILER_WARNINGS
@@ -0,0 +1,245 @@
+#include "directoryscanner.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <vector>
+
+// Walks a generated tree of 85 folders and 6800 files with both orders and different numbers of threads.
+class DirectoryScannerTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+
+	void anyOrder_data();
+	void anyOrder();
+	void deterministicOrder_data();
+	void deterministicOrder();
+	void batches();
+	void cancellation_data();
+	void cancellation();
+
+private:
+	static void addThreadRows();
+	bool createTree(const QString& path, int depth);
+	// The order of a sequential depth-first walk, the root included
+	static void enumerateSequentially(const QString& path, QStringList& paths);
+	static QString parentPath(const QString& path);
+
+private:
+	QTemporaryDir _root;
+	QString _rootPath;
+	QStringList _expectedPaths; // In the deterministic order
+
+	static const int numSubfolders = 4;
+	static const int numFilesPerFolder = 80;
+	static const int treeDepth = 3;
+};
+
+void DirectoryScannerTest::initTestCase()
+{
+	QVERIFY(_root.isValid());
+	_rootPath = _root.path() + "/tree/";
+	QVERIFY(createTree(_rootPath, treeDepth));
+
+	enumerateSequentially(_rootPath, _expectedPaths);
+	QCOMPARE(_expectedPaths.size(), 1 + 84 + 85 * numFilesPerFolder);
+}
+
+void DirectoryScannerTest::anyOrder_data()
+{
+	addThreadRows();
+}
+
+void DirectoryScannerTest::anyOrder()
+{
+	QFETCH(int, numThreads);
+
+	QStringList paths;
+	scanDirectory(CFileSystemObject(_rootPath), [&paths](const std::vector<CFileSystemObject>& batch) {
+		for (const auto& item: batch)
+			paths.push_back(item.fullAbsolutePath());
+	}, std::atomic<bool>{false}, soAnyOrder, (size_t)numThreads);
+
+	QCOMPARE(paths.size(), _expectedPaths.size());
+	QCOMPARE(paths.front(), _expectedPaths.front());
+
+	// Every item exactly once, and every folder before anything inside it
+	std::set<QString> reported;
+	for (const QString& path: paths)
+	{
+		QVERIFY2(reported.insert(path).second, qPrintable(path));
+		if (path != _expectedPaths.front())
+			QVERIFY2(reported.count(parentPath(path)) != 0, qPrintable(path));
+	}
+
+	QVERIFY(reported == std::set<QString>(_expectedPaths.begin(), _expectedPaths.end()));
+}
+
+void DirectoryScannerTest::deterministicOrder_data()
+{
+	addThreadRows();
+}
+
+void DirectoryScannerTest::deterministicOrder()
+{
+	QFETCH(int, numThreads);
+
+	QStringList paths;
+	scanDirectory(CFileSystemObject(_rootPath), [&paths](const std::vector<CFileSystemObject>& batch) {
+		for (const auto& item: batch)
+			paths.push_back(item.fullAbsolutePath());
+	}, std::atomic<bool>{false}, soDeterministic, (size_t)numThreads);
+
+	QCOMPARE(paths, _expectedPaths);
+}
+
+void DirectoryScannerTest::batches()
+{
+	for (const ScanOrder order: {soAnyOrder, soDeterministic})
+	{
+		std::atomic<int> numObserversRunning {0};
+		bool concurrentCallDetected = false, emptyBatchDetected = false;
+		size_t numBatches = 0, maxBatchSize = 0, numItems = 0;
+		scanDirectory(CFileSystemObject(_rootPath), [&](const std::vector<CFileSystemObject>& batch) {
+			if (++numObserversRunning != 1)
+				concurrentCallDetected = true;
+
+			++numBatches;
+			numItems += batch.size();
+			maxBatchSize = std::max(maxBatchSize, batch.size());
+			emptyBatchDetected = emptyBatchDetected || batch.empty();
+
+			--numObserversRunning;
+		}, std::atomic<bool>{false}, order, 8);
+
+		QVERIFY(!concurrentCallDetected);
+		QVERIFY(!emptyBatchDetected);
+		QCOMPARE(numItems, (size_t)_expectedPaths.size());
+
+		if (order == soAnyOrder)
+			// The root, then at least one batch per folder
+			QVERIFY(numBatches >= 1 + 85);
+		else
+		{
+			// The root, then batches of up to 256 items
+			QVERIFY(maxBatchSize <= 256);
+			QVERIFY(numBatches >= 1 + ((size_t)_expectedPaths.size() - 1) / 256);
+		}
+	}
+}
+
+void DirectoryScannerTest::cancellation_data()
+{
+	QTest::addColumn<int>("order");
+
+	QTest::newRow("any order") << (int)soAnyOrder;
+	QTest::newRow("deterministic") << (int)soDeterministic;
+}
+
+void DirectoryScannerTest::cancellation()
+{
+	QFETCH(int, order);
+
+	std::atomic<bool> abort {false};
+	size_t numItems = 0, numItemsWhenAborted = 0, numBatchesAfterAbort = 0;
+	scanDirectory(CFileSystemObject(_rootPath), [&](const std::vector<CFileSystemObject>& batch) {
+		if (abort)
+			++numBatchesAfterAbort;
+
+		numItems += batch.size();
+		if (!abort && numItems >= 100)
+		{
+			numItemsWhenAborted = numItems;
+			abort = true;
+		}
+	}, abort, (ScanOrder)order, 8);
+
+	QVERIFY(abort);
+	QVERIFY(numItems < (size_t)_expectedPaths.size());
+	// The threads that were already reporting when the flag was set may still deliver their batches, but nothing more
+	QVERIFY(numBatchesAfterAbort <= 8);
+	QVERIFY(numItems - numItemsWhenAborted <= 8 * 256);
+
+	// Nothing is running in the background anymore: a new walk is complete
+	size_t numItemsOfNewWalk = 0;
+	scanDirectory(CFileSystemObject(_rootPath), [&numItemsOfNewWalk](const std::vector<CFileSystemObject>& batch) {
+		numItemsOfNewWalk += batch.size();
+	}, std::atomic<bool>{false}, (ScanOrder)order, 8);
+	QCOMPARE(numItemsOfNewWalk, (size_t)_expectedPaths.size());
+}
+
+void DirectoryScannerTest::addThreadRows()
+{
+	QTest::addColumn<int>("numThreads");
+
+	QTest::newRow("1 thread") << 1;
+	QTest::newRow("2 threads") << 2;
+	QTest::newRow("8 threads") << 8;
+	QTest::newRow("default") << 0;
+}
+
+bool DirectoryScannerTest::createTree(const QString& path, int depth)
+{
+	if (!QDir().mkpath(path))
+		return false;
+
+	// Mixed case, so that the deterministic order has to be case-insensitive to match
+	for (int i = 0; i < numFilesPerFolder; ++i)
+	{
+		QFile file(path + (i % 2 == 0 ? "file_" : "FILE_") + QString::number(i) + ".txt");
+		if (!file.open(QFile::WriteOnly) || file.write(path.toUtf8()) <= 0)
+			return false;
+	}
+
+	if (depth > 0)
+	{
+		for (int i = 0; i < numSubfolders; ++i)
+		{
+			if (!createTree(path + (i % 2 == 0 ? "Folder_" : "folder_") + QString::number(i) + "/", depth - 1))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void DirectoryScannerTest::enumerateSequentially(const QString& path, QStringList& paths)
+{
+	const CFileSystemObject folder(path);
+	paths.push_back(folder.fullAbsolutePath());
+
+	auto list = QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::System);
+	std::sort(list.begin(), list.end(), [](const QFileInfo& l, const QFileInfo& r) {
+		return l.fileName().compare(r.fileName(), Qt::CaseInsensitive) < 0;
+	});
+
+	for (const auto& info: list)
+	{
+		if (info.isDir())
+			enumerateSequentially(info.absoluteFilePath(), paths);
+		else
+			paths.push_back(CFileSystemObject(info).fullAbsolutePath());
+	}
+}
+
+QString DirectoryScannerTest::parentPath(const QString& path)
+{
+	// The folders' paths end with a slash
+	const QString trimmedPath = path.endsWith('/') ? path.left(path.length() - 1) : path;
+	return trimmedPath.left(trimmedPath.lastIndexOf('/') + 1);
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_APPLESS_MAIN(DirectoryScannerTest)
+#include "directoryscannertest.moc"
+RESTORE_COMPILER_WARNINGS
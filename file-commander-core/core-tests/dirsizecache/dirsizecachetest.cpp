@@ -0,0 +1,174 @@
+#include "dirsizecache/cdirectorysizecache.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// The tree:
+// root/a.txt (10 bytes), root/hardlink (100 bytes)
+// root/sub1/b.txt (20 bytes), root/sub1/hardlink - the same file as root/hardlink
+// root/sub1/sub2/c.txt (30 bytes)
+// The test cases depend on each other and run in order.
+class DirectorySizeCacheTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+
+	void hardLinksAreCountedOnce();
+	void unchangedFolderIsTakenFromTheCache();
+	void ctimeChangeInvalidatesTheEntry();
+	void mtimeChangeInvalidatesTheEntry();
+	void saving();
+
+private:
+	CDirectorySizeCache::Totals calculate(const QString& path, CDirectorySizeCache::CountedInodes& countedInodes);
+	CDirectorySizeCache::Totals calculate(const QString& path);
+	static bool writeFile(const QString& path, int size, QFile::OpenMode mode = QFile::WriteOnly);
+	static QString cacheFilePath();
+
+private:
+	QTemporaryDir _tempDir;
+	QString _root;
+};
+
+void DirectorySizeCacheTest::initTestCase()
+{
+#ifdef _WIN32
+	QSKIP("CDirectorySizeCache is not supported on Windows");
+#else
+	// Not touching the user's cache
+	QStandardPaths::setTestModeEnabled(true);
+	QFile::remove(cacheFilePath());
+
+	QVERIFY(_tempDir.isValid());
+	_root = _tempDir.path() + "/root";
+	QVERIFY(QDir().mkpath(_root + "/sub1/sub2"));
+	QVERIFY(writeFile(_root + "/a.txt", 10));
+	QVERIFY(writeFile(_root + "/hardlink", 100));
+	QVERIFY(writeFile(_root + "/sub1/b.txt", 20));
+	QVERIFY(writeFile(_root + "/sub1/sub2/c.txt", 30));
+	QVERIFY(::link(QFile::encodeName(_root + "/hardlink").constData(), QFile::encodeName(_root + "/sub1/hardlink").constData()) == 0);
+
+	// The folders modified within the last 2 seconds aren't cached
+	std::this_thread::sleep_for(std::chrono::milliseconds(3100));
+#endif
+}
+
+void DirectorySizeCacheTest::hardLinksAreCountedOnce()
+{
+	const auto totals = calculate(_root);
+	QCOMPARE(totals.files, (uint64_t)4);
+	QCOMPARE(totals.folders, (uint64_t)2);
+	QCOMPARE(totals.size, (uint64_t)160);
+
+	// The results of calculations that share the set of the counted inodes are added up without counting a file twice
+	CDirectorySizeCache::CountedInodes countedInodes;
+	const auto sub1Totals = calculate(_root + "/sub1", countedInodes);
+	QCOMPARE(sub1Totals.files, (uint64_t)3);
+	QCOMPARE(sub1Totals.size, (uint64_t)150);
+
+	const auto rootTotals = calculate(_root, countedInodes);
+	QCOMPARE(rootTotals.files, (uint64_t)3);
+	QCOMPARE(rootTotals.size, (uint64_t)60);
+
+	// The same from the cache, the subfolders included
+	const auto cachedTotals = calculate(_root);
+	QCOMPARE(cachedTotals.files, (uint64_t)4);
+	QCOMPARE(cachedTotals.folders, (uint64_t)2);
+	QCOMPARE(cachedTotals.size, (uint64_t)160);
+}
+
+void DirectorySizeCacheTest::unchangedFolderIsTakenFromTheCache()
+{
+	// Modifying a file in place touches neither the mtime nor the ctime of its folder, so the cached size is returned (which is the documented caveat)
+	QVERIFY(writeFile(_root + "/sub1/b.txt", 5, QFile::Append));
+
+	const auto totals = calculate(_root);
+	QCOMPARE(totals.files, (uint64_t)4);
+	QCOMPARE(totals.size, (uint64_t)160);
+}
+
+void DirectorySizeCacheTest::ctimeChangeInvalidatesTheEntry()
+{
+	// Only the ctime changes
+	QVERIFY(QFile::setPermissions(_root + "/sub1", QFile::permissions(_root + "/sub1") | QFile::ExeGroup));
+
+	const auto totals = calculate(_root);
+	QCOMPARE(totals.files, (uint64_t)4);
+	QCOMPARE(totals.size, (uint64_t)165);
+}
+
+void DirectorySizeCacheTest::mtimeChangeInvalidatesTheEntry()
+{
+	QVERIFY(writeFile(_root + "/sub1/sub2/c.txt", 5, QFile::Append));
+	auto totals = calculate(_root);
+	QCOMPARE(totals.size, (uint64_t)165);
+
+	// A new file changes the folder's mtime
+	QVERIFY(writeFile(_root + "/sub1/sub2/d.txt", 1));
+	totals = calculate(_root);
+	QCOMPARE(totals.files, (uint64_t)5);
+	QCOMPARE(totals.folders, (uint64_t)2);
+	QCOMPARE(totals.size, (uint64_t)171);
+}
+
+void DirectorySizeCacheTest::saving()
+{
+	CDirectorySizeCache::get().save();
+	const QString path = cacheFilePath();
+	QFile file(path);
+	QVERIFY(file.open(QFile::ReadOnly));
+	const QByteArray contents = file.readAll();
+	QVERIFY(contents.size() > 8);
+	file.close();
+
+	// Nothing new to save
+	calculate(_root);
+	CDirectorySizeCache::get().save();
+	QVERIFY(file.open(QFile::ReadOnly));
+	QCOMPARE(file.readAll(), contents);
+}
+
+CDirectorySizeCache::Totals DirectorySizeCacheTest::calculate(const QString& path, CDirectorySizeCache::CountedInodes& countedInodes)
+{
+	CDirectorySizeCache::Totals totals;
+	if (!CDirectorySizeCache::get().calculate(path, countedInodes, totals))
+		qWarning() << "Failed to calculate the size of" << path;
+
+	return totals;
+}
+
+CDirectorySizeCache::Totals DirectorySizeCacheTest::calculate(const QString& path)
+{
+	CDirectorySizeCache::CountedInodes countedInodes;
+	return calculate(path, countedInodes);
+}
+
+bool DirectorySizeCacheTest::writeFile(const QString& path, int size, QFile::OpenMode mode)
+{
+	QFile file(path);
+	return file.open(mode) && file.write(QByteArray(size, 'x')) == size;
+}
+
+QString DirectorySizeCacheTest::cacheFilePath()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/directorysizes.dat";
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_GUILESS_MAIN(DirectorySizeCacheTest)
+#include "dirsizecachetest.moc"
+RESTORE_COMPILER_WARNINGS
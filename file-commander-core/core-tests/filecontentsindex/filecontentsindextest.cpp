@@ -0,0 +1,155 @@
+#include "filesearchengine/cfilecontentsindex.h"
+#include "filesearchengine/cfilecontentsmatcher.h"
+#include "settings/csettings.h"
+#include "settings.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+
+// The test cases depend on each other and run in order
+class FileContentsIndexTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void trigramPrefilter();
+	void shortLiteralIsNotLookedUp();
+	void unindexedLocation();
+	void updateAfterModifications();
+	void modificationWithinTheSameSecond();
+
+private:
+	// Returns the relative paths of the candidates sorted, or "not indexed"
+	QStringList candidates(const QString& query, bool caseSensitive, const QString& location = QString()) const;
+	bool writeFile(const QString& relativePath, const QByteArray& contents) const;
+	void waitForCandidates(const QString& query, const QStringList& expectedCandidates) const;
+
+private:
+	QTemporaryDir _tempDir;
+	QString _root;
+};
+
+void FileContentsIndexTest::initTestCase()
+{
+	// Not touching the user's settings and cache
+	QStandardPaths::setTestModeEnabled(true);
+	CSettings::setOrganizationName("GitHubSoft");
+	CSettings::setApplicationName("File Commander contents index test");
+
+	QVERIFY(_tempDir.isValid());
+	_root = _tempDir.path() + "/root";
+	QVERIFY(QDir().mkpath(_root + "/sub"));
+
+	QVERIFY(writeFile("hello.txt", "Hello, world!\n"));
+	QVERIFY(writeFile("sub/bye.txt", "Goodbye, cruel world\n"));
+	QVERIFY(writeFile("sub/other.txt", "Nothing to see here\n"));
+	QVERIFY(writeFile("binary.dat", QByteArray("Hello, world!\0\0\0", 16)));
+
+	CSettings().setValue(KEY_OTHER_CONTENTS_INDEX_LOCATIONS, QStringList{_root});
+	CFileContentsIndex::get().settingsChanged();
+	// Building the index in the background
+	QTRY_VERIFY_WITH_TIMEOUT(candidates("world", true) != QStringList{"not indexed"}, 30000);
+}
+
+void FileContentsIndexTest::cleanupTestCase()
+{
+	CSettings().setValue(KEY_OTHER_CONTENTS_INDEX_LOCATIONS, QStringList());
+	CFileContentsIndex::get().settingsChanged();
+}
+
+void FileContentsIndexTest::trigramPrefilter()
+{
+	// A binary file never matches, so it isn't a candidate
+	QCOMPARE(candidates("world", true), (QStringList{"hello.txt", "sub/bye.txt"}));
+	QCOMPARE(candidates("cruel", true), QStringList{"sub/bye.txt"});
+	QCOMPARE(candidates("xyzzy", true), QStringList());
+
+	// The trigrams are folded to lower case, so either query finds the same candidates
+	QCOMPARE(candidates("HELLO", false), QStringList{"hello.txt"});
+	QCOMPARE(candidates("HELLO", true), QStringList{"hello.txt"});
+
+	// Only the literal part of a wildcard query is looked up
+	QCOMPARE(candidates("*to s?e*", true), QStringList{"sub/other.txt"});
+
+	// Only the files inside the searched location
+	QCOMPARE(candidates("world", true, _root + "/sub"), QStringList{"sub/bye.txt"});
+}
+
+void FileContentsIndexTest::shortLiteralIsNotLookedUp()
+{
+	QCOMPARE(candidates("wo", true), QStringList{"not indexed"});
+	QCOMPARE(candidates("w*d", true), QStringList{"not indexed"});
+}
+
+void FileContentsIndexTest::unindexedLocation()
+{
+	QCOMPARE(candidates("world", true, _tempDir.path()), QStringList{"not indexed"});
+}
+
+void FileContentsIndexTest::updateAfterModifications()
+{
+	QVERIFY(writeFile("sub/bye.txt", "Goodbye, everyone\n"));
+	QVERIFY(writeFile("sub/new.txt", "Brave new world\n"));
+	QVERIFY(QFile::remove(_root + "/hello.txt"));
+
+	CFileContentsIndex::get().updateAllIndexes();
+	waitForCandidates("world", {"sub/new.txt"});
+	QCOMPARE(candidates("everyone", true), QStringList{"sub/bye.txt"});
+	QCOMPARE(candidates("hello", true), QStringList());
+}
+
+void FileContentsIndexTest::modificationWithinTheSameSecond()
+{
+	// The size stays the same, and the modification time (which has a resolution of a second) is very likely the same, too
+	QVERIFY(writeFile("sub/other.txt", "Something here, see\n"));
+	CFileContentsIndex::get().updateAllIndexes();
+	waitForCandidates("something", {"sub/other.txt"});
+
+	QVERIFY(writeFile("sub/other.txt", "Anything here, seen\n"));
+	CFileContentsIndex::get().updateAllIndexes();
+	waitForCandidates("anything", {"sub/other.txt"});
+	QCOMPARE(candidates("something", true), QStringList());
+}
+
+QStringList FileContentsIndexTest::candidates(const QString& query, bool caseSensitive, const QString& location) const
+{
+	const CFileContentsMatcher matcher(query, caseSensitive);
+	const std::atomic<bool> abort {false};
+	QStringList paths;
+	const bool indexed = CFileContentsIndex::get().findCandidates(location.isEmpty() ? _root : location, matcher, [&](const QString& path) {
+		paths.push_back(path.mid(_root.size() + 1));
+	}, abort);
+
+	if (!indexed)
+		return QStringList{"not indexed"};
+
+	paths.sort();
+	return paths;
+}
+
+bool FileContentsIndexTest::writeFile(const QString& relativePath, const QByteArray& contents) const
+{
+	QFile file(_root + '/' + relativePath);
+	return file.open(QFile::WriteOnly) && file.write(contents) == contents.size();
+}
+
+void FileContentsIndexTest::waitForCandidates(const QString& query, const QStringList& expectedCandidates) const
+{
+	QTRY_COMPARE_WITH_TIMEOUT(candidates(query, true), expectedCandidates, 30000);
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_GUILESS_MAIN(FileContentsIndexTest)
+#include "filecontentsindextest.moc"
+RESTORE_COMPILER_WARNINGS
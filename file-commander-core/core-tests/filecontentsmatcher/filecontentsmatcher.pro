@@ -0,0 +1,30 @@
+TEMPLATE = app
+TARGET   = filecontentsmatcher_test
+
+include(../../config.pri)
+
+QT = core testlib
+
+DESTDIR  = ../../../bin/$${OUTPUT_DIR}
+OBJECTS_DIR = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+MOC_DIR     = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+UI_DIR      = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+RCC_DIR     = ../../../build/$${OUTPUT_DIR}/$${TARGET}
+
+mac*|linux*{
+	PRE_TARGETDEPS += $${DESTDIR}/libqtutils.a $${DESTDIR}/libcpputils.a
+}
+
+for (included_item, INCLUDEPATH): INCLUDEPATH += ../../$${included_item}
+INCLUDEPATH += \
+	$${PWD}/ \
+	../../src/
+
+LIBS += -L$${DESTDIR} -lqtutils -lcpputils
+
+SOURCES += \
+	filecontentsmatchertest.cpp \
+	../../src/filesearchengine/cfilecontentsmatcher.cpp
+
+HEADERS += \
+	../../src/filesearchengine/cfilecontentsmatcher.h
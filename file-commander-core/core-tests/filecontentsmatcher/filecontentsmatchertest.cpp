@@ -0,0 +1,158 @@
+#include "filesearchengine/cfilecontentsmatcher.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QTemporaryFile>
+#include <QTextCodec>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+class FileContentsMatcherTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void literalExtraction_data();
+	void literalExtraction();
+
+	void wildcardSets_data();
+	void wildcardSets();
+
+	void hitsAtEveryBlockOffset();
+	void caseInsensitiveFolding();
+
+	void localEncodingFallback();
+
+private:
+	static bool matches(const CFileContentsMatcher& matcher, const QByteArray& data);
+};
+
+void FileContentsMatcherTest::literalExtraction_data()
+{
+	QTest::addColumn<QString>("query");
+	QTest::addColumn<bool>("caseSensitive");
+	QTest::addColumn<QByteArray>("literal");
+
+	QTest::newRow("plain") << "needle" << true << QByteArray("needle");
+	QTest::newRow("case-insensitive") << "NeeDLe" << false << QByteArray("needle");
+	QTest::newRow("star") << "ab*cdef*g" << true << QByteArray("cdef");
+	QTest::newRow("question mark") << "abc?de" << true << QByteArray("abc");
+	QTest::newRow("set at the end") << "x*[abc]" << true << QByteArray("x");
+	QTest::newRow("set in the middle") << "foo[bar]bazz" << true << QByteArray("bazz");
+	QTest::newRow("negated set") << "ab[!cdefgh]xyz" << true << QByteArray("xyz");
+	QTest::newRow("bracket first in a set") << "ab[]cdefgh]xyz" << true << QByteArray("xyz");
+	QTest::newRow("unterminated set") << "abc*[defghij" << true << QByteArray("abc");
+	QTest::newRow("only wildcards") << "*?[abc]*" << true << QByteArray();
+	QTest::newRow("brackets without wildcards") << "[abc]" << true << QByteArray("[abc]");
+}
+
+void FileContentsMatcherTest::literalExtraction()
+{
+	QFETCH(QString, query);
+	QFETCH(bool, caseSensitive);
+	QFETCH(QByteArray, literal);
+
+	QCOMPARE(CFileContentsMatcher(query, caseSensitive).literal(), literal);
+}
+
+void FileContentsMatcherTest::wildcardSets_data()
+{
+	QTest::addColumn<QString>("query");
+	QTest::addColumn<QByteArray>("data");
+	QTest::addColumn<bool>("match");
+
+	QTest::newRow("set member") << "x*[abc]" << QByteArray("first line\nxyzb\nlast line\n") << true;
+	QTest::newRow("not a set member") << "x*[abc]" << QByteArray("first line\nxyzd\nlast line\n") << false;
+	QTest::newRow("set in the middle") << "foo[bar]bazz" << QByteArray("fooabazz") << true;
+	QTest::newRow("negated set") << "ab[!c]xyz" << QByteArray("abdxyz\n") << true;
+	QTest::newRow("negated set, no match") << "ab[!c]xyz" << QByteArray("abcxyz\n") << false;
+}
+
+void FileContentsMatcherTest::wildcardSets()
+{
+	QFETCH(QString, query);
+	QFETCH(QByteArray, data);
+	QFETCH(bool, match);
+
+	QCOMPARE(matches(CFileContentsMatcher(query, true), data), match);
+}
+
+// The literal is placed at every offset relative to the 16-byte blocks, including the ones where its first and last bytes are in different blocks
+void FileContentsMatcherTest::hitsAtEveryBlockOffset()
+{
+	const QByteArray alphabet = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+	for (int length = 1; length <= alphabet.size(); ++length)
+	{
+		const QByteArray literal = alphabet.left(length);
+		const CFileContentsMatcher matcher(QString::fromLatin1(literal), true);
+		QCOMPARE(matcher.literal(), literal);
+
+		QByteArray nearMiss = literal;
+		nearMiss[length - 1] = '_';
+
+		for (int offset = 0; offset < 48; ++offset)
+		{
+			for (const int tail: {0, 1, 15, 16, 17})
+			{
+				QByteArray data = QByteArray(offset, '.') + literal + QByteArray(tail, '.');
+				QVERIFY2(matches(matcher, data), qPrintable(QString("length %1, offset %2, tail %3").arg(length).arg(offset).arg(tail)));
+
+				data = QByteArray(offset, '.') + nearMiss + QByteArray(tail, '.');
+				QVERIFY2(!matches(matcher, data), qPrintable(QString("near miss: length %1, offset %2, tail %3").arg(length).arg(offset).arg(tail)));
+			}
+		}
+	}
+}
+
+void FileContentsMatcherTest::caseInsensitiveFolding()
+{
+	const CFileContentsMatcher matcher("a@B[z", false);
+	QCOMPARE(matcher.literal(), QByteArray("a@b[z"));
+
+	for (int offset = 0; offset < 40; ++offset)
+	{
+		const QByteArray padding(offset, '-');
+		QVERIFY(matches(matcher, padding + "A@b[Z" + padding));
+		// Setting bit 5 maps '@' to '`' and '[' to '{', which must not be taken for a match
+		QVERIFY(!matches(matcher, padding + "A`b[Z" + padding));
+		QVERIFY(!matches(matcher, padding + "a@b{z" + padding));
+	}
+}
+
+void FileContentsMatcherTest::localEncodingFallback()
+{
+	QTextCodec* cp1251 = QTextCodec::codecForName("Windows-1251");
+	if (!cp1251)
+		QSKIP("Windows-1251 is not available");
+
+	QTextCodec* const originalLocaleCodec = QTextCodec::codecForLocale();
+	QTextCodec::setCodecForLocale(cp1251);
+
+	const QString query = QString::fromUtf8("\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 world"); // "privet world" in Cyrillic and Latin
+	const CFileContentsMatcher matcher(query, true);
+	// Only the ASCII part can be looked for in the raw data
+	QCOMPARE(matcher.literal(), QByteArray(" world"));
+
+	QTemporaryFile file;
+	QVERIFY(file.open());
+	file.write("hello\n" + cp1251->fromUnicode(query) + "\n");
+	file.close();
+
+	const std::atomic<bool> abort {false};
+	QVERIFY(matcher.fileMatches(file.fileName(), abort));
+	// UTF-8 still works
+	QVERIFY(matches(matcher, "hello\n" + query.toUtf8() + "\n"));
+	QVERIFY(!matches(matcher, "hello\n world\n"));
+
+	QTextCodec::setCodecForLocale(originalLocaleCodec);
+}
+
+bool FileContentsMatcherTest::matches(const CFileContentsMatcher& matcher, const QByteArray& data)
+{
+	const std::atomic<bool> abort {false};
+	return matcher.dataMatches(data.constData(), (size_t)data.size(), abort);
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_APPLESS_MAIN(FileContentsMatcherTest)
+#include "filecontentsmatchertest.moc"
+RESTORE_COMPILER_WARNINGS
@@ -0,0 +1,203 @@
+#include "filesearchengine/cfilenameindex.h"
+#include "filesearchengine/cfilenamequery.h"
+#include "settings/csettings.h"
+#include "settings.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// The tree:
+// root/a.txt
+// root/sub/b.txt
+// root/sub/deeper/c.dat
+// The test cases depend on each other and run in order.
+class FileNameIndexTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void query();
+	void unindexedLocation();
+	void loadingTheSavedIndex();
+	void changesAreAppliedOnTop();
+	void truncatedFileIsRejected();
+	void corruptFileIsRejected();
+
+private:
+	// Returns the paths relative to the root sorted, folders with a trailing slash, or "not indexed"
+	QStringList items(const QString& query, bool caseSensitive = true, const QString& location = QString()) const;
+	void setIndexedLocations(const QStringList& locations) const;
+	// There's only one location indexed, so there's one file once the outdated ones are removed
+	static QStringList indexFiles();
+
+private:
+	QTemporaryDir _tempDir;
+	QString _root;
+	const QStringList _allItems {"a.txt", "sub/", "sub/b.txt", "sub/deeper/", "sub/deeper/c.dat"};
+};
+
+void FileNameIndexTest::initTestCase()
+{
+	// Not touching the user's settings and cache
+	QStandardPaths::setTestModeEnabled(true);
+	CSettings::setOrganizationName("GitHubSoft");
+	CSettings::setApplicationName("File Commander name index test");
+	QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/filenameindex").removeRecursively();
+
+	QVERIFY(_tempDir.isValid());
+	_root = _tempDir.path() + "/root";
+	QVERIFY(QDir().mkpath(_root + "/sub/deeper"));
+	for (const QString& path: {"a.txt", "sub/b.txt", "sub/deeper/c.dat"})
+	{
+		QFile file(_root + '/' + path);
+		QVERIFY(file.open(QFile::WriteOnly));
+	}
+
+	setIndexedLocations({_root});
+	// Building the index in the background
+	QTRY_VERIFY_WITH_TIMEOUT(items("*") != QStringList{"not indexed"}, 30000);
+	QCOMPARE(indexFiles().size(), 1);
+}
+
+void FileNameIndexTest::cleanupTestCase()
+{
+	setIndexedLocations({});
+}
+
+void FileNameIndexTest::query()
+{
+	QCOMPARE(items("*"), _allItems);
+	QCOMPARE(items("*.txt"), (QStringList{"a.txt", "sub/b.txt"}));
+	QCOMPARE(items("b.t"), QStringList{"sub/b.txt"});
+	QCOMPARE(items("xyzzy"), QStringList());
+
+	// A substring without a slash is matched against the folder path and the name separately
+	QCOMPARE(items("deeper"), (QStringList{"sub/deeper/", "sub/deeper/c.dat"}));
+	QCOMPARE(items("A.TXT", false), QStringList{"a.txt"});
+	QCOMPARE(items("A.TXT", true), QStringList());
+
+	// Only the items inside the searched location
+	QCOMPARE(items("*", true, _root + "/sub"), (QStringList{"sub/b.txt", "sub/deeper/", "sub/deeper/c.dat"}));
+}
+
+void FileNameIndexTest::unindexedLocation()
+{
+	QCOMPARE(items("*", true, _tempDir.path()), QStringList{"not indexed"});
+}
+
+void FileNameIndexTest::loadingTheSavedIndex()
+{
+	setIndexedLocations({});
+	QCOMPARE(items("*"), QStringList{"not indexed"});
+
+	// The file is less than a day old, so it's mapped right away instead of being rebuilt
+	setIndexedLocations({_root});
+	QCOMPARE(items("*"), _allItems);
+}
+
+void FileNameIndexTest::changesAreAppliedOnTop()
+{
+	QVERIFY(QDir().mkpath(_root + "/new/folder"));
+	QVERIFY(QFile::remove(_root + "/sub/b.txt"));
+
+	CFileNameIndex::get().itemsChanged(
+		transparent_set<QFileInfo>{QFileInfo(_root + "/new"), QFileInfo(_root + "/new/folder")},
+		transparent_set<QFileInfo>{QFileInfo(_root + "/sub/b.txt")}
+	);
+
+	QCOMPARE(items("*"), (QStringList{"a.txt", "new/", "new/folder/", "sub/", "sub/deeper/", "sub/deeper/c.dat"}));
+
+	// A removed folder hides everything inside it, including the items added after the index was built
+	QVERIFY(QDir(_root + "/new").removeRecursively());
+	QVERIFY(QDir(_root + "/sub").removeRecursively());
+	CFileNameIndex::get().itemsChanged({}, transparent_set<QFileInfo>{QFileInfo(_root + "/new"), QFileInfo(_root + "/sub")});
+	QCOMPARE(items("*"), QStringList{"a.txt"});
+}
+
+void FileNameIndexTest::truncatedFileIsRejected()
+{
+	setIndexedLocations({});
+
+	QFile file(indexFiles().value(0));
+	QVERIFY(file.size() > 32);
+	QVERIFY(file.resize(file.size() - 1));
+
+	// Rejected when it's loaded, and then rebuilt from the current contents of the folder
+	QTest::ignoreMessage(QtInfoMsg, QRegularExpression("is not a valid index file"));
+	setIndexedLocations({_root});
+	QTRY_COMPARE_WITH_TIMEOUT(items("*"), QStringList{"a.txt"}, 30000);
+	// The rejected file is removed after the new one is in use
+	QTRY_COMPARE_WITH_TIMEOUT(indexFiles().size(), 1, 30000);
+}
+
+void FileNameIndexTest::corruptFileIsRejected()
+{
+	setIndexedLocations({});
+
+	// The size is right, but the first entry refers to a folder that doesn't exist
+	QFile file(indexFiles().value(0));
+	QVERIFY(file.open(QFile::ReadWrite));
+	const QByteArray header = file.read(32);
+	QCOMPARE(header.size(), 32);
+	uint32_t numFolders = 0;
+	memcpy(&numFolders, header.constData() + 16, sizeof(numFolders));
+	const uint32_t invalidFolder = numFolders;
+	QVERIFY(file.seek(32 + (qint64)numFolders * 12));
+	QCOMPARE(file.write(reinterpret_cast<const char*>(&invalidFolder), sizeof(invalidFolder)), (qint64)sizeof(invalidFolder));
+	file.close();
+
+	QTest::ignoreMessage(QtInfoMsg, QRegularExpression("is corrupt or belongs to another location"));
+	setIndexedLocations({_root});
+	QTRY_COMPARE_WITH_TIMEOUT(items("*"), QStringList{"a.txt"}, 30000);
+}
+
+QStringList FileNameIndexTest::items(const QString& query, bool caseSensitive, const QString& location) const
+{
+	const CFileNameQuery nameQuery(query, caseSensitive);
+	const std::atomic<bool> abort {false};
+	QStringList paths;
+	const bool indexed = CFileNameIndex::get().findItems(location.isEmpty() ? _root : location, nameQuery, [&](const QString& path, bool /*isDir*/) {
+		paths.push_back(path.mid(_root.size() + 1));
+	}, abort);
+
+	if (!indexed)
+		return QStringList{"not indexed"};
+
+	paths.sort();
+	return paths;
+}
+
+void FileNameIndexTest::setIndexedLocations(const QStringList& locations) const
+{
+	CSettings().setValue(KEY_OTHER_FILE_NAME_INDEX_LOCATIONS, locations);
+	CFileNameIndex::get().settingsChanged();
+}
+
+QStringList FileNameIndexTest::indexFiles()
+{
+	QStringList files;
+	for (QDirIterator it(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/filenameindex", QStringList("*.idx"), QDir::Files, QDirIterator::Subdirectories); it.hasNext();)
+		files.push_back(it.next());
+
+	return files;
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_GUILESS_MAIN(FileNameIndexTest)
+#include "filenameindextest.moc"
+RESTORE_COMPILER_WARNINGS
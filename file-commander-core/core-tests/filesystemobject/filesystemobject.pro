@@ -25,11 +25,13 @@ LIBS += -L$${DESTDIR} -lqtutils -lcpputils
 SOURCES += \
 	fso_test.cpp \
 	../../src/cfilesystemobject.cpp \
+	../../src/fileoperations/kernelassistedcopy.cpp \
 	../../src/fasthash.c \
 	../../src/iconprovider/ciconprovider.cpp
 
 HEADERS += \
 	../../src/cfilesystemobject.h \
+	../../src/fileoperations/kernelassistedcopy.h \
 	../../src/fasthash.h \
 	../../src/iconprovider/ciconprovider.h \
 	../../src/iconprovider/ciconproviderimpl.h
@@ -26,17 +26,26 @@ for (included_item, INCLUDEPATH): INCLUDEPATH += ../../$${included_item}
 SOURCES += \
 	operationperformertest.cpp \
 	../../src/fileoperations/coperationperformer.cpp \
+	../../src/fileoperations/ccopyworkerpool.cpp \
+	../../src/fileoperations/cparalleldeleter.cpp \
 	../../src/cfilesystemobject.cpp \
+	../../src/fileoperations/kernelassistedcopy.cpp \
 	../../src/iconprovider/ciconprovider.cpp \
 	../../src/fasthash.c \
-	../../src/directoryscanner.cpp
+	../../src/directoryscanner.cpp \
+	../../src/directorylister.cpp
 
 HEADERS += \
 	../../src/fileoperations/cfileoperation.h \
 	../../src/fileoperations/coperationperformer.h \
+	../../src/fileoperations/ccopyworkerpool.h \
+	../../src/fileoperations/cparalleldeleter.h \
 	../../src/fileoperations/operationcodes.h \
+	../../src/fileoperations/kernelassistedcopy.h \
 	../../src/cfilesystemobject.h \
 	../../src/iconprovider/ciconprovider.h \
 	../../src/iconprovider/ciconproviderimpl.h \
 	../../src/fasthash.h \
-	../../src/directoryscanner.h
+	../../src/directoryscanner.h \
+	../../src/cparalleltreewalk.hpp \
+	../../src/directorylister.h
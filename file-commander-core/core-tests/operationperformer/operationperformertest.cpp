@@ -1,4 +1,5 @@
 #include "fileoperations/coperationperformer.h"
+#include "fileoperations/cparalleldeleter.h"
 #include "cfolderenumeratorrecursive.h"
 #include "container/set_operations.hpp"
 
@@ -7,7 +8,15 @@ DISABLE_COMPILER_WARNINGS
 #include <QtTest>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <map>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 class TestOperationPerformer : public QObject
 {
@@ -16,6 +25,8 @@ class TestOperationPerformer : public QObject
 private slots:
 	void fileSystemObjectTest();
 	void testCopy();
+	void testParallelCopy();
+	void testDelete();
 };
 
 inline bool compareFolderContents(const std::vector<CFileSystemObject>& source, const std::vector<CFileSystemObject>& dest)
@@ -70,6 +81,75 @@ inline QString dstTestDirPath()
 	return QApplication::applicationDirPath() + "/copy-move-test-folder/";
 }
 
+// TODO: extract this into init() / cleanup()
+inline void removeDstTestDir()
+{
+	const QString destDirPath = dstTestDirPath();
+#ifdef _WIN32
+	std::system((QString("rmdir /S /Q ") % '\"' % QString(destDirPath).replace('/', '\\') % '\"').toUtf8().data());
+#else
+	std::system((QString("rm -rf ") % '\"' % destDirPath % '\"').toUtf8().data());
+#endif
+}
+
+// Answers the halts the way the user would and counts them
+class CHaltResponder : public CFileOperationObserver
+{
+public:
+	// The halts not listed are skipped
+	explicit CHaltResponder(std::map<HaltReason, UserResponse> responses) : _responses(std::move(responses)) {}
+
+	// Blocks until the operation is done, processing the callbacks it queues meanwhile
+	void run(COperationPerformer& performer)
+	{
+		_performer = &performer;
+		performer.setWatcher(this);
+		performer.start();
+		while (!performer.done())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			processCallbacks();
+		}
+
+		processCallbacks();
+		_performer = nullptr;
+	}
+
+	size_t numHalts(HaltReason reason) const
+	{
+		return (size_t)std::count(_halts.begin(), _halts.end(), reason);
+	}
+
+private:
+	void processCallbacks()
+	{
+		std::vector<std::function<void ()>> callbacks;
+		{
+			std::lock_guard<std::mutex> lock(_callbackMutex);
+			callbacks.swap(_callbacks);
+		}
+
+		for (const auto& callback: callbacks)
+			callback();
+	}
+
+	void onProgressChanged(float /*totalPercentage*/, size_t /*numFilesProcessed*/, size_t /*totalNumFiles*/, float /*filePercentage*/, uint64_t /*speed*/, uint32_t /*secondsRemaining*/, bool /*totalsEstimated*/) override {}
+	void onProcessFinished(QString /*message*/) override {}
+	void onCurrentFileChanged(QString /*file*/) override {}
+
+	void onProcessHalted(HaltReason reason, CFileSystemObject /*source*/, CFileSystemObject /*dest*/, QString /*errorMessage*/) override
+	{
+		_halts.push_back(reason);
+		const auto response = _responses.find(reason);
+		_performer->userResponse(reason, response != _responses.end() ? response->second : urSkipThis);
+	}
+
+private:
+	const std::map<HaltReason, UserResponse> _responses;
+	COperationPerformer* _performer = nullptr;
+	std::vector<HaltReason> _halts;
+};
+
 void TestOperationPerformer::fileSystemObjectTest()
 {
 	CFileSystemObject o(srcTestDirPath());
@@ -85,12 +165,7 @@ void TestOperationPerformer::testCopy()
 	qDebug() << "Source:" << srcDirPath;
 	qDebug() << "Dest:" << destDirPath;
 
-	// TODO: extract this into init() / cleanup()
-#ifdef _WIN32
-	std::system((QString("rmdir /S /Q ") % '\"' % QString(destDirPath).replace('/', '\\') % '\"').toUtf8().data());
-#else
-#error cleanup script not defined
-#endif
+	removeDstTestDir();
 	COperationPerformer p(operationCopy, std::vector<CFileSystemObject> {CFileSystemObject(srcDirPath)}, destDirPath);
 	p.start();
 	while (!p.done());
@@ -102,6 +177,109 @@ void TestOperationPerformer::testCopy()
 	QVERIFY(compareFolderContents(sourceTree, destTree));
 }
 
+void TestOperationPerformer::testParallelCopy()
+{
+	const QString srcDirPath = srcTestDirPath();
+	const QString destDirPath = dstTestDirPath();
+
+	removeDstTestDir();
+	COperationPerformer p(operationCopy, std::vector<CFileSystemObject> {CFileSystemObject(srcDirPath)}, destDirPath);
+	p.setParallelCopying(4, 2);
+	p.start();
+	while (!p.done());
+
+	std::vector<CFileSystemObject> sourceTree, destTree;
+	CFolderEnumeratorRecursive::enumerateFolder(srcDirPath, sourceTree);
+	CFolderEnumeratorRecursive::enumerateFolder(destDirPath + CFileSystemObject(srcTestDirPath()).fullName(), destTree);
+
+	QVERIFY(compareFolderContents(sourceTree, destTree));
+}
+
+void TestOperationPerformer::testDelete()
+{
+	const QString srcDirPath = srcTestDirPath();
+	const QString destDirPath = dstTestDirPath();
+
+	removeDstTestDir();
+	COperationPerformer copy(operationCopy, std::vector<CFileSystemObject> {CFileSystemObject(srcDirPath)}, destDirPath);
+	copy.start();
+	while (!copy.done());
+
+	const QString copiedDirPath = destDirPath + CFileSystemObject(srcTestDirPath()).fullName();
+	QVERIFY(CFileSystemObject(copiedDirPath).exists());
+
+	// Nesting deeper than the fixture's
+	const QString nestedDirPath = copiedDirPath + "/nested/1/2/3/4/";
+	QVERIFY(QDir().mkpath(nestedDirPath));
+	for (const QString& dirPath: {copiedDirPath + "/nested/1/", nestedDirPath})
+	{
+		QFile file(dirPath + "file.txt");
+		QVERIFY(file.open(QFile::WriteOnly));
+		QVERIFY(file.write("data") == 4);
+	}
+
+	// unlink() only cares about the folder's permissions, but the user is asked about the read-only files all the same
+	const QStringList readOnlyFiles {copiedDirPath + "/a/read-only.txt", copiedDirPath + "/nested/1/2/read-only.txt", nestedDirPath + "read-only.txt"};
+	for (const QString& path: readOnlyFiles)
+	{
+		QFile file(path);
+		QVERIFY(file.open(QFile::WriteOnly));
+		QVERIFY(file.write("data") == 4);
+		file.close();
+		QVERIFY(file.setPermissions(QFile::ReadOwner | QFile::ReadGroup | QFile::ReadOther));
+	}
+
+#ifdef _WIN32
+	const bool readOnlyFilesAreProtected = true;
+#else
+	// Nothing is read-only for root
+	const bool readOnlyFilesAreProtected = ::geteuid() != 0;
+#endif
+
+	std::vector<CFileSystemObject> tree;
+	CFolderEnumeratorRecursive::enumerateFolder(copiedDirPath, tree);
+	QVERIFY(tree.size() > 10);
+
+	if (CParallelDeleter::supported())
+	{
+		// The count the progress is based on: every item, the root included
+		CParallelDeleter counter(4);
+		counter.startCounting({QFile::encodeName(copiedDirPath).constData()});
+		QVERIFY(counter.waitUntilFinished(std::chrono::milliseconds(10000)));
+		QCOMPARE(counter.numItemsProcessed(), (uint64_t)tree.size() + 1);
+		QVERIFY(counter.takeFailures().empty());
+	}
+
+	// The skipped files are kept, along with the folders they're in
+	{
+		CHaltResponder responder({{hrSourceFileIsReadOnly, urSkipThis}});
+		COperationPerformer p(operationDelete, std::vector<CFileSystemObject> {CFileSystemObject(copiedDirPath)});
+		responder.run(p);
+
+		QCOMPARE(responder.numHalts(hrSourceFileIsReadOnly), readOnlyFilesAreProtected ? (size_t)readOnlyFiles.size() : (size_t)0);
+		if (CParallelDeleter::supported())
+			QCOMPARE(responder.numHalts(hrFailedToDelete), (size_t)0);
+
+		QVERIFY(!QFileInfo::exists(nestedDirPath + "file.txt"));
+		for (const QString& path: readOnlyFiles)
+			QCOMPARE(QFileInfo::exists(path), readOnlyFilesAreProtected);
+	}
+
+	// The answer applies to the rest of the read-only files
+	if (readOnlyFilesAreProtected)
+	{
+		CHaltResponder responder({{hrSourceFileIsReadOnly, urProceedWithAll}});
+		COperationPerformer p(operationDelete, std::vector<CFileSystemObject> {CFileSystemObject(copiedDirPath)});
+		responder.run(p);
+
+		QCOMPARE(responder.numHalts(hrSourceFileIsReadOnly), (size_t)1);
+	}
+
+	QVERIFY(!CFileSystemObject(copiedDirPath).exists());
+	QVERIFY(!QFileInfo::exists(copiedDirPath));
+	QVERIFY(QDir(destDirPath).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot).isEmpty());
+}
+
 DISABLE_COMPILER_WARNINGS
 
 QTEST_MAIN(TestOperationPerformer)
@@ -24,6 +24,9 @@ HEADERS += \
 	src/fileoperations/operationcodes.h \
 	src/fileoperations/coperationperformer.h \
 	src/fileoperations/cfileoperation.h \
+	src/fileoperations/kernelassistedcopy.h \
+	src/fileoperations/ccopyworkerpool.h \
+	src/fileoperations/cparalleldeleter.h \
 	src/shell/cshell.h \
 	include/settings.h \
 	src/favoritelocationslist/cfavoritelocations.h \
@@ -31,10 +34,20 @@ HEADERS += \
 	src/iconprovider/ciconproviderimpl.h \
 	src/fasthash.h \
 	src/filesearchengine/cfilesearchengine.h \
+	src/filesearchengine/cfilecontentsindex.h \
+	src/filesearchengine/cfilecontentsmatcher.h \
+	src/filesearchengine/cfilenameindex.h \
+	src/filesearchengine/cfilenamequery.h \
 	src/directoryscanner.h \
+	src/cparalleltreewalk.hpp \
+	src/directorylister.h \
+	src/dirsizecache/cdirectorysizecache.h \
 	src/diskenumerator/volumeinfo.hpp \
 	src/diskenumerator/cvolumeenumerator.h \
+	src/diskenumerator/cvolumelookup.h \
 	src/filesystemwatcher/cfilesystemwatcher.h \
+	src/filesystemwatcher/cfilesystemwatcherinterface.h \
+	src/filesystemwatcher/cfilesystemwatchertimerbased.h \
     src/diskenumerator/volumeinfohelper.hpp
 
 SOURCES += \
@@ -43,13 +56,30 @@ SOURCES += \
 	src/cpanel.cpp \
 	src/iconprovider/ciconprovider.cpp \
 	src/fileoperations/coperationperformer.cpp \
+	src/fileoperations/kernelassistedcopy.cpp \
+	src/fileoperations/ccopyworkerpool.cpp \
+	src/fileoperations/cparalleldeleter.cpp \
 	src/shell/cshell.cpp \
 	src/favoritelocationslist/cfavoritelocations.cpp \
 	src/fasthash.c \
 	src/filesearchengine/cfilesearchengine.cpp \
+	src/filesearchengine/cfilecontentsindex.cpp \
+	src/filesearchengine/cfilecontentsmatcher.cpp \
+	src/filesearchengine/cfilenameindex.cpp \
+	src/filesearchengine/cfilenamequery.cpp \
 	src/directoryscanner.cpp \
+	src/directorylister.cpp \
+	src/dirsizecache/cdirectorysizecache.cpp \
 	src/diskenumerator/cvolumeenumerator.cpp \
-	src/filesystemwatcher/cfilesystemwatcher.cpp
+	src/diskenumerator/cvolumelookup.cpp \
+	src/filesystemwatcher/cfilesystemwatcher.cpp \
+	src/filesystemwatcher/cfilesystemwatcherinterface.cpp \
+	src/filesystemwatcher/cfilesystemwatchertimerbased.cpp
+
+linux*{
+	HEADERS += src/filesystemwatcher/cfilesystemwatcherinotify.h
+	SOURCES += src/filesystemwatcher/cfilesystemwatcherinotify.cpp
+}
 
 include(src/pluginengine/pluginengine.pri)
 include(src/plugininterface/plugininterface.pri)
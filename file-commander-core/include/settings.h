@@ -40,6 +40,8 @@
 
 // Operations
 #define KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION "Operations/CopyMove/AskForConfirmation"
+#define KEY_OPERATIONS_PARALLEL_COPY_WORKERS "Operations/CopyMove/ParallelCopyWorkers"
+#define KEY_OPERATIONS_PARALLEL_COPY_WORKERS_PER_DEVICE "Operations/CopyMove/ParallelCopyWorkersPerDevice"
 
 // Editing
 #define KEY_EDITOR_PATH "Edit/EditorProgramPath"
@@ -47,3 +49,5 @@
 // Other
 #define KEY_OTHER_SHELL_COMMAND_NAME "Other/Shell/ShellCommandName"
 #define KEY_OTHER_CHECK_FOR_UPDATES_AUTOMATICALLY "Other/UpdateChecking/CheckAutomatically"
+#define KEY_OTHER_FILE_NAME_INDEX_LOCATIONS "Other/Search/FileNameIndexLocations"
+#define KEY_OTHER_CONTENTS_INDEX_LOCATIONS "Other/Search/ContentsIndexLocations"
@@ -5,6 +5,8 @@
 #include "pluginengine/cpluginengine.h"
 #include "filesystemhelperfunctions.h"
 #include "iconprovider/ciconprovider.h"
+#include "filesearchengine/cfilecontentsindex.h"
+#include "filesearchengine/cfilenameindex.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QApplication>
@@ -19,7 +21,6 @@ RESTORE_COMPILER_WARNINGS
 CController* CController::_instance = nullptr;
 
 CController::CController() :
-	_fileSearchEngine(*this),
 	_leftPanel(LeftPanel),
 	_rightPanel(RightPanel),
 	_workerThreadPool(2, "CController thread pool")
@@ -37,6 +38,9 @@ CController::CController() :
 
 	_leftPanel.restoreFromSettings();
 	_rightPanel.restoreFromSettings();
+
+	CFileNameIndex::get().settingsChanged();
+	CFileContentsIndex::get().settingsChanged();
 }
 
 CController& CController::get()
@@ -68,6 +72,8 @@ void CController::uiThreadTimerTick()
 {
 	_leftPanel.uiThreadTimerTick();
 	_rightPanel.uiThreadTimerTick();
+	_fileSearchEngine.uiThreadTimerTick();
+	CIconProvider::uiThreadTimerTick();
 
 	_uiQueue.exec(CExecutionQueue::execAll);
 }
@@ -138,6 +144,8 @@ void CController::settingsChanged()
 	_leftPanel.settingsChanged();
 
 	CIconProvider::settingsChanged();
+	CFileNameIndex::get().settingsChanged();
+	CFileContentsIndex::get().settingsChanged();
 }
 
 void CController::activePanelChanged(Panel p)
@@ -415,14 +423,7 @@ QString CController::volumePath(size_t index) const
 
 size_t CController::currentVolumeIndex(Panel p) const
 {
-	const auto drives = _volumeEnumerator.drives();
-	for (size_t i = 0; i < drives.size(); ++i)
-	{
-		if (CFileSystemObject(panel(p).currentDirPathNative()).isChildOf(drives[i].rootObjectInfo))
-			return i;
-	}
-
-	return std::numeric_limits<int>::max();
+	return _volumeEnumerator.volumeIndexForPath(panel(p).currentDirPathPosix());
 }
 
 CFavoriteLocations& CController::favoriteLocations()
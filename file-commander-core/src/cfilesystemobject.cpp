@@ -58,6 +58,41 @@ inline QString parentForAbsolutePath(QString absolutePath)
 	return absolutePath;
 }
 
+CFileSystemObject::CFileSystemObject(const QString& parentFolder, const QString& fileName, FileSystemObjectType type, uint64_t size, time_t creationDate, time_t modificationDate)
+{
+	assert_r(parentFolder.endsWith('/') && !fileName.isEmpty());
+
+	// The same properties refreshInfo() would obtain from QFileInfo, which will only query the file system if any of the remaining methods needs it
+	_properties.exists = true;
+	_properties.type = type;
+	_properties.fullPath = parentFolder % fileName;
+	// No trailing slash for QFileInfo, or it won't know the file name
+	_fileInfo.setFile(_properties.fullPath);
+	if (type == Directory)
+		_properties.fullPath.append('/');
+
+	_properties.parentFolder = parentFolder;
+	_properties.hash = ::hash(_properties.fullPath.toUtf8());
+	_properties.fullName = fileName;
+
+	if (type == File)
+	{
+		const int suffixStart = fileName.lastIndexOf('.');
+		_properties.extension = suffixStart >= 0 ? fileName.mid(suffixStart + 1) : QString();
+		_properties.completeBaseName = suffixStart >= 0 ? fileName.left(suffixStart) : fileName;
+	}
+	else if (type == Directory)
+	{
+		_properties.completeBaseName = fileName;
+		_dir.setPath(_properties.fullPath);
+	}
+
+	_properties.isCdUp = fileName == QLatin1String("..");
+	_properties.creationDate = creationDate;
+	_properties.modificationDate = modificationDate;
+	_properties.size = type == File ? size : 0;
+}
+
 CFileSystemObject & CFileSystemObject::operator=(const QString & path)
 {
 	setPath(path);
@@ -449,6 +484,22 @@ FileOperationResultCode CFileSystemObject::copyChunk(size_t chunkSize, const QSt
 			return rcFail;
 		}
 
+		_copyMethod = KernelAssistedCopy::preferredCopyMethod();
+		if (_copyMethod == cmReflink)
+		{
+			// A reflink clones the whole file at once, so the operation is complete after the first chunk
+			if (size() > 0 && KernelAssistedCopy::reflink(_thisFile->handle(), _destFile->handle()))
+			{
+				_pos = size();
+				_thisFile.reset();
+				_destFile.reset();
+
+				return rcOk;
+			}
+
+			_copyMethod = KernelAssistedCopy::fallbackCopyMethod(_copyMethod);
+		}
+
 		_destFile->resize(size());
 	}
 
@@ -458,25 +509,9 @@ FileOperationResultCode CFileSystemObject::copyChunk(size_t chunkSize, const QSt
 
 	if (actualChunkSize != 0)
 	{
-		const auto src = _thisFile->map(_pos, actualChunkSize);
-		if (!src)
-		{
-			_lastErrorMessage = _thisFile->errorString();
-			return rcFail;
-		}
-
-		const auto dest = _destFile->map(_pos, actualChunkSize);
-		if (!dest)
-		{
-			_lastErrorMessage = _destFile->errorString();
-			return rcFail;
-		}
-
-		memcpy(dest, src, actualChunkSize);
-		_pos += actualChunkSize;
-
-		_thisFile->unmap(src);
-		_destFile->unmap(dest);
+		const auto result = _copyMethod != cmMemoryMapping ? copyChunkInKernel(actualChunkSize) : copyChunkViaMemoryMapping(actualChunkSize);
+		if (result != rcOk)
+			return result;
 	}
 
 	if (actualChunkSize < chunkSize || actualChunkSize == 0)
@@ -603,6 +638,67 @@ FileOperationResultCode CFileSystemObject::remove()
 		return rcFail;
 }
 
+FileOperationResultCode CFileSystemObject::copyChunkInKernel(size_t chunkSize)
+{
+	size_t bytesCopiedInThisChunk = 0;
+	while (bytesCopiedInThisChunk < chunkSize)
+	{
+		const int64_t result = KernelAssistedCopy::copyRange(_copyMethod, _thisFile->handle(), _destFile->handle(), _pos, chunkSize - bytesCopiedInThisChunk);
+		if (result > 0)
+		{
+			_pos += (uint64_t)result;
+			bytesCopiedInThisChunk += (size_t)result;
+		}
+		else if (result == 0)
+		{
+			// The source file has shrunk since the copying started
+			_lastErrorMessage = QObject::tr("Unexpected end of file");
+			return rcFail;
+		}
+		else if (errno == EINTR)
+			continue;
+		else if (KernelAssistedCopy::errorMeansMethodUnsupported(errno))
+		{
+			// The offsets are explicit, so the remainder of the chunk can be copied with the next method from the same position
+			_copyMethod = KernelAssistedCopy::fallbackCopyMethod(_copyMethod);
+			return _copyMethod != cmMemoryMapping ? copyChunkInKernel(chunkSize - bytesCopiedInThisChunk) : copyChunkViaMemoryMapping(chunkSize - bytesCopiedInThisChunk);
+		}
+		else
+		{
+			_lastErrorMessage = strerror(errno);
+			return rcFail;
+		}
+	}
+
+	return rcOk;
+}
+
+FileOperationResultCode CFileSystemObject::copyChunkViaMemoryMapping(size_t chunkSize)
+{
+	const auto src = _thisFile->map(_pos, chunkSize);
+	if (!src)
+	{
+		_lastErrorMessage = _thisFile->errorString();
+		return rcFail;
+	}
+
+	const auto dest = _destFile->map(_pos, chunkSize);
+	if (!dest)
+	{
+		_lastErrorMessage = _destFile->errorString();
+		_thisFile->unmap(src);
+		return rcFail;
+	}
+
+	memcpy(dest, src, chunkSize);
+	_pos += chunkSize;
+
+	_thisFile->unmap(src);
+	_destFile->unmap(dest);
+
+	return rcOk;
+}
+
 QString CFileSystemObject::lastErrorMessage() const
 {
 	return _lastErrorMessage;
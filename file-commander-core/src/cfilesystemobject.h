@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fileoperationresultcode.h"
+#include "fileoperations/kernelassistedcopy.h"
 #include "compiler/compiler_warnings_control.h"
 
 DISABLE_COMPILER_WARNINGS
@@ -42,6 +43,8 @@ public:
 	CFileSystemObject() = default;
 	explicit CFileSystemObject(const QFileInfo & fileInfo);
 	explicit CFileSystemObject(const QString& path);
+	// Constructs the object from the information already obtained by a directory listing (see directorylister.h) without querying the file system
+	CFileSystemObject(const QString& parentFolder /* with the trailing slash */, const QString& fileName, FileSystemObjectType type, uint64_t size, time_t creationDate, time_t modificationDate);
 
 	inline explicit CFileSystemObject(const QDir& dir) : CFileSystemObject(QString(dir.absolutePath())) {}
 
@@ -116,12 +119,17 @@ public:
 private:
 	static QString expandEnvironmentVariables(const QString& string);
 
+	// Copies the next chunk of an in-progress copy operation with one of the in-kernel methods, downgrading _copyMethod if it's not supported
+	FileOperationResultCode copyChunkInKernel(size_t chunkSize);
+	FileOperationResultCode copyChunkViaMemoryMapping(size_t chunkSize);
+
 private:
 	CFileSystemObjectProperties _properties;
 	// For copying / moving
 	std::shared_ptr<QFile>      _thisFile;
 	std::shared_ptr<QFile>      _destFile;
 	uint64_t                    _pos = 0;
+	CopyMethod                  _copyMethod = cmMemoryMapping;
 	// Can be used to determine whether 2 objects are on the same drive
 	mutable uint64_t            _rootFileSystemId = std::numeric_limits<uint64_t>::max();
 	QFileInfo                   _fileInfo;
@@ -3,35 +3,44 @@
 #include "settings.h"
 #include "filesystemhelperfunctions.h"
 #include "directoryscanner.h"
+#include "directorylister.h"
+#include "dirsizecache/cdirectorysizecache.h"
 #include "assert/advanced_assert.h"
 #include "filesystemwatcher/cfilesystemwatcher.h"
+#include "filesearchengine/cfilecontentsindex.h"
+#include "filesearchengine/cfilenameindex.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QDebug>
 #include <QVector>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
 #include <time.h>
 #include <limits>
+#include <set>
 
 #define exec_on_UI_thread _uiThreadQueue.enqueue
 
 enum {
 	ContentsChangedNotificationTag,
+	IncrementalContentsChangedNotificationTag,
 	ItemDiscoveryProgressNotificationTag
 };
 
 CPanel::CPanel(Panel position) :
+	_items(std::make_shared<const std::map<qulonglong, CFileSystemObject>>()),
+	_volumes(std::make_shared<const CVolumeLookup>()),
 	_watcher(std::make_shared<CFileSystemWatcher>()),
 	_panelPosition(position),
 	_workerThreadPool(4, std::string(position == LeftPanel ? "Left panel" : "Right panel") + " file list refresh thread pool")
 {
-	// The list of items in the current folder is being refreshed asynchronously, not every time a change is detected, to avoid refresh tasks queuing up out of control
+	// The changes are applied to the list as soon as they're detected, but the listeners are notified no more often than the timer ticks
 	_fileListRefreshTimer.start(200);
 	connect(&_fileListRefreshTimer, &QTimer::timeout, this, &CPanel::processContentsChangedEvent);
 
-	_watcher->addCallback([this](const transparent_set<QFileInfo>&, const transparent_set<QFileInfo>&, const transparent_set<QFileInfo>&) {
-		contentsChanged();
+	_watcher->addCallback([this](const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed) {
+		contentsChanged(added, removed, changed);
 	});
 }
 
@@ -118,8 +127,9 @@ FileOperationResultCode CPanel::setPath(const QString &path, FileListRefreshCaus
 
 	// If the new folder is one of the subfolders of the previous folder, mark it as the current for that previous folder
 	// We're using the fact that _currentDirObject is already updated, but the _items list is not as it still corresponds to the previous location
-	const auto newItemInPreviousFolder = _items.find(_currentDirObject.hash());
-	if (operation != refreshCauseCdUp && newItemInPreviousFolder != _items.end() && newItemInPreviousFolder->second.parentDirPath() != newItemInPreviousFolder->second.fullAbsolutePath())
+	const auto previousItems = list();
+	const auto newItemInPreviousFolder = previousItems->find(_currentDirObject.hash());
+	if (operation != refreshCauseCdUp && newItemInPreviousFolder != previousItems->end() && newItemInPreviousFolder->second.parentDirPath() != newItemInPreviousFolder->second.fullAbsolutePath())
 		// Updating the cursor when navigating downwards
 		setCurrentItemForFolder(newItemInPreviousFolder->second.parentDirPath(), _currentDirObject.hash());
 	else if (operation == refreshCauseCdUp)
@@ -180,17 +190,21 @@ void CPanel::showAllFilesFromCurrentFolderAndBelow()
 		std::unique_lock<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
 		const QString path = _currentDirObject.fullAbsolutePath();
 
-		_items.clear();
-
 		//locker.unlock();
 		// TODO: synchronization and lock-ups
+		std::map<qulonglong, CFileSystemObject> items;
 		const bool showHiddenFiles = CSettings().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool();
-		scanDirectory(CFileSystemObject(path), [showHiddenFiles, this](const CFileSystemObject& item) {
-			if (item.isFile() && item.exists() && (showHiddenFiles || !item.isHidden()))
-				_items[item.hash()] = item;
+		scanDirectory(CFileSystemObject(path), [showHiddenFiles, &items](const std::vector<CFileSystemObject>& batch) {
+			for (const CFileSystemObject& item: batch)
+			{
+				if (item.isFile() && item.exists() && (showHiddenFiles || !item.isHidden()))
+					items[item.hash()] = item;
+			}
 		});
 		//locker.lock();
 
+		publishList(std::move(items));
+
 		sendContentsChangedNotification(refreshCauseOther);
 	});
 }
@@ -254,7 +268,7 @@ qulonglong CPanel::currentItemForFolder(const QString &dir) const
 void CPanel::refreshFileList(FileListRefreshCause operation)
 {
 	_workerThreadPool.enqueue([this, operation]() {
-		QFileInfoList list;
+		CFileSystemObject currentDir;
 
 		{
 			std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
@@ -265,35 +279,52 @@ void CPanel::refreshFileList(FileListRefreshCause operation)
 				return;
 			}
 
-			list = _currentDirObject.qDir().entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System);
-			_items.clear();
+			currentDir = _currentDirObject;
 		}
 
 		const bool showHiddenFiles = CSettings().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool();
 		std::vector<CFileSystemObject> objectsList;
 
-		const size_t numItemsFound = (size_t)list.size();
-		objectsList.reserve(numItemsFound);
+		const bool listedNatively = listDirectoryNatively(currentDir.fullAbsolutePath(), showHiddenFiles, objectsList, [this, &currentDir](size_t /*numItemsListed*/) {
+			sendItemDiscoveryProgressNotification(currentDir.hash(), std::numeric_limits<size_t>::max(), currentDir.fullAbsolutePath());
+		});
 
-		for (size_t i = 0; i < numItemsFound; ++i)
+		if (!listedNatively)
 		{
+			const QFileInfoList list = currentDir.qDir().entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDot | QDir::Hidden | QDir::System);
+			const size_t numItemsFound = (size_t)list.size();
+			objectsList.reserve(numItemsFound);
+
+			for (size_t i = 0; i < numItemsFound; ++i)
+			{
 #ifndef _WIN32
-			// TODO: Qt bug?
-			if (list[(int)i].absoluteFilePath() == QLatin1String("/.."))
-				continue;
+				// TODO: Qt bug?
+				if (list[(int)i].absoluteFilePath() == QLatin1String("/.."))
+					continue;
 #endif
-			objectsList.emplace_back(list[(int)i]);
-			sendItemDiscoveryProgressNotification(_currentDirObject.hash(), 20 + 80 * i / numItemsFound, _currentDirObject.fullAbsolutePath());
+				objectsList.emplace_back(list[(int)i]);
+				sendItemDiscoveryProgressNotification(currentDir.hash(), 20 + 80 * i / numItemsFound, currentDir.fullAbsolutePath());
+			}
+		}
+
+		// The previous list remains available to the readers until the new one is complete
+		std::map<qulonglong, CFileSystemObject> items;
+		for (auto& object : objectsList)
+		{
+			if (object.exists() && (showHiddenFiles || !object.isHidden()))
+				items.emplace(object.hash(), std::move(object));
 		}
 
 		{
 			std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
 
-			for (const auto& object : objectsList)
-			{
-				if (object.exists() && (showHiddenFiles || !object.isHidden()))
-					_items[object.hash()] = object;
-			}
+			// The listing is done without holding the lock, and the panel may have navigated elsewhere meanwhile (with another thread of the pool listing the new folder)
+			if (currentDir.hash() != _currentDirObject.hash())
+				return;
+
+			// The full notification supersedes whatever changes have been accumulated
+			_pendingDelta = FileListDelta();
+			publishList(std::move(items));
 		}
 
 		sendContentsChangedNotification(operation);
@@ -301,24 +332,21 @@ void CPanel::refreshFileList(FileListRefreshCause operation)
 }
 
 // Returns the current list of objects on this panel
-std::map<qulonglong, CFileSystemObject> CPanel::list() const
+FileListSnapshot CPanel::list() const
 {
-	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-	return _items;
+	return std::atomic_load(&_items);
 }
 
 bool CPanel::itemHashExists(const qulonglong hash) const
 {
-	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-	return _items.count(hash) > 0;
+	return list()->count(hash) > 0;
 }
 
 CFileSystemObject CPanel::itemByHash(qulonglong hash) const
 {
-	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
-
-	const auto it = _items.find(hash);
-	return it != _items.end() ? it->second : CFileSystemObject();
+	const auto items = list();
+	const auto it = items->find(hash);
+	return it != items->end() ? it->second : CFileSystemObject();
 }
 
 // Calculates total size for the specified objects
@@ -327,23 +355,51 @@ FilesystemObjectsStatistics CPanel::calculateStatistics(const std::vector<qulong
 	if (hashes.empty())
 		return FilesystemObjectsStatistics();
 
+	std::vector<CFileSystemObject> items;
+	items.reserve(hashes.size());
+	for (const auto hash: hashes)
+		items.push_back(itemByHash(hash));
+
+	return calculateStatistics(items, [this](const QString& currentFolder) {
+		sendItemDiscoveryProgressNotification(0, std::numeric_limits<size_t>::max(), currentFolder);
+	});
+}
+
+FilesystemObjectsStatistics CPanel::calculateStatistics(const std::vector<CFileSystemObject>& items, const std::function<void (const QString&)>& progressObserver)
+{
 	FilesystemObjectsStatistics stats;
-	for(const auto hash: hashes)
+	// Hardlinks are counted once across all the items
+	CDirectorySizeCache::CountedInodes countedInodes;
+	for (const CFileSystemObject& rootItem: items)
 	{
-		const CFileSystemObject rootItem = itemByHash(hash);
 		if (rootItem.isDir())
 		{
-			++stats.folders;
-			scanDirectory(rootItem, [this, &stats](const CFileSystemObject& discoveredItem) {
-				if (discoveredItem.isFile())
+			CDirectorySizeCache::Totals totals;
+			const bool calculatedWithCache = CDirectorySizeCache::get().calculate(rootItem.fullAbsolutePath(), countedInodes, totals, progressObserver);
+
+			if (calculatedWithCache)
+			{
+				stats.files += totals.files;
+				stats.folders += totals.folders + 1;
+				stats.occupiedSpace += totals.size;
+				continue;
+			}
+
+			// The root is reported by scanDirectory as well, and counted among the folders
+			scanDirectory(rootItem, [&stats, &progressObserver](const std::vector<CFileSystemObject>& batch) {
+				for (const CFileSystemObject& discoveredItem: batch)
 				{
-					stats.occupiedSpace += discoveredItem.size();
-					++stats.files;
+					if (discoveredItem.isFile())
+					{
+						stats.occupiedSpace += discoveredItem.size();
+						++stats.files;
+					}
+					else if (discoveredItem.isDir())
+						++stats.folders;
 				}
-				else if (discoveredItem.isDir())
-					++stats.folders;
 
-				sendItemDiscoveryProgressNotification(0, std::numeric_limits<size_t>::max(), discoveredItem.fullAbsolutePath());
+				if (progressObserver)
+					progressObserver(batch.back().fullAbsolutePath());
 			});
 		}
 		else if (rootItem.isFile())
@@ -353,6 +409,7 @@ FilesystemObjectsStatistics CPanel::calculateStatistics(const std::vector<qulong
 		}
 	}
 
+	CDirectorySizeCache::get().save();
 	return stats;
 }
 
@@ -360,23 +417,24 @@ FilesystemObjectsStatistics CPanel::calculateStatistics(const std::vector<qulong
 void CPanel::displayDirSize(qulonglong dirHash)
 {
 	_workerThreadPool.enqueue([this, dirHash] {
-		std::unique_lock<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+		const CFileSystemObject item = itemByHash(dirHash);
+		assert_and_return_r(item.isValid(), );
 
-		auto it = _items.find(dirHash);
-		assert_and_return_r(it != _items.end(), );
-
-		if (it->second.isDir())
+		if (item.isDir())
 		{
-			locker.unlock(); // Without this .unlock() the UI thread will get blocked very easily
 			const FilesystemObjectsStatistics stats = calculateStatistics(std::vector<qulonglong>(1, dirHash));
-			locker.lock();
-			// Since we unlocked the mutex, the item we were working on may well be out of the _items list by now
-			// So we find it again and see if it's still there
-			it = _items.find(dirHash);
-			if (it == _items.end())
+
+			std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+			// The list may well have been replaced while the size was being calculated
+			// So we find the item again and see if it's still there
+			const auto items = list();
+			const auto it = items->find(dirHash);
+			if (it == items->end())
 				return;
 
-			it->second.setDirSize(stats.occupiedSpace);
+			ListEdit edit {dirHash, it->second, false};
+			edit.object.setDirSize(stats.occupiedSpace);
+			publishListEdits({std::move(edit)});
 			sendContentsChangedNotification(refreshCauseOther);
 		}
 	});
@@ -390,6 +448,23 @@ void CPanel::sendContentsChangedNotification(FileListRefreshCause operation) con
 	}, ContentsChangedNotificationTag);
 }
 
+void CPanel::sendIncrementalContentsChangedNotification() const
+{
+	exec_on_UI_thread([this]() {
+		FileListDelta delta;
+		{
+			std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+			std::swap(delta, _pendingDelta);
+		}
+
+		if (delta.empty())
+			return;
+
+		for (auto listener : _panelContentsChangedListeners)
+			listener->panelContentsChangedIncrementally(_panelPosition, delta);
+	}, IncrementalContentsChangedNotificationTag);
+}
+
 // progress > 100 means indefinite
 void CPanel::sendItemDiscoveryProgressNotification(qulonglong itemHash, size_t progress, const QString& currentDir) const
 {
@@ -401,7 +476,10 @@ void CPanel::sendItemDiscoveryProgressNotification(qulonglong itemHash, size_t p
 
 void CPanel::volumesChanged(const std::deque<VolumeInfo>& volumes)
 {
-	_volumes = volumes;
+	// The refresh workers may be looking a path up in the current lookup, so it's not modified but replaced
+	auto lookup = std::make_shared<CVolumeLookup>();
+	lookup->setVolumes(volumes);
+	std::atomic_store(&_volumes, std::shared_ptr<const CVolumeLookup>(std::move(lookup)));
 
 	// Handling an unplugged device
 	if (_currentDirObject.isValid() && !volumeInfoForObject(_currentDirObject).isReady)
@@ -418,10 +496,75 @@ void CPanel::uiThreadTimerTick()
 	_uiThreadQueue.exec();
 }
 
-void CPanel::contentsChanged()
+void CPanel::contentsChanged(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed)
 {
-	// The list of items in the current folder is being refreshed asynchronously, not every time a change is detected, to avoid refresh tasks queuing up out of control
-	_bContentsChangedEventPending = true;
+	CFileNameIndex::get().itemsChanged(added, removed);
+	CFileContentsIndex::get().itemsChanged(added, removed, changed);
+
+	// The flattened list isn't being watched
+	if (_currentDisplayMode != NormalMode)
+		return;
+
+	const bool showHiddenFiles = CSettings().value(KEY_INTERFACE_SHOW_HIDDEN_FILES, true).toBool();
+
+	std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+	const QString currentDirPath = _currentDirObject.fullAbsolutePath();
+
+	// The changes are looked up in the published list and applied all at once
+	const FileListSnapshot items = list();
+	std::vector<ListEdit> edits;
+	std::set<qulonglong> removedHashes;
+	std::map<qulonglong, size_t> insertionIndexByHash; // In edits
+
+	for (const auto& removedItem : removed)
+	{
+		// The type of the item that's gone is unknown, and a folder's path (hence the hash) has the trailing slash
+		const QString path = removedItem.absoluteFilePath();
+		auto it = items->find(CFileSystemObject(path).hash());
+		if (it == items->end())
+			it = std::find_if(items->begin(), items->end(), [&path](const std::pair<const qulonglong, CFileSystemObject>& item) {
+				return item.second.isDir() && item.second.fullAbsolutePath().startsWith(path) && item.second.fullAbsolutePath().length() == path.length() + 1;
+			});
+
+		if (it == items->end() || !removedHashes.insert(it->first).second)
+			continue;
+
+		_pendingDelta.removed.push_back(it->first);
+		edits.push_back(ListEdit{it->first, CFileSystemObject(), true});
+	}
+
+	// An item that already exists may be reported as added after the watcher has re-read the whole folder
+	for (const auto* infos : {&added, &changed})
+	{
+		for (const auto& info : *infos)
+		{
+			const CFileSystemObject object(info);
+			// The changes may still be coming from the previous folder
+			if (!object.exists() || object.parentDirPath() != currentDirPath || (!showHiddenFiles && object.isHidden()))
+				continue;
+
+			// Reported both as added and as changed
+			const auto previousInsertion = insertionIndexByHash.find(object.hash());
+			if (previousInsertion != insertionIndexByHash.end())
+			{
+				edits[previousInsertion->second].object = object;
+				continue;
+			}
+
+			const auto existingItem = items->find(object.hash());
+			if (existingItem == items->end() || removedHashes.count(object.hash()) != 0)
+				_pendingDelta.inserted.push_back(object.hash());
+			else if (existingItem->second.size() != object.size() || existingItem->second.properties().modificationDate != object.properties().modificationDate)
+				_pendingDelta.updated.push_back(object.hash());
+			else
+				continue;
+
+			insertionIndexByHash[object.hash()] = edits.size();
+			edits.push_back(ListEdit{object.hash(), object, false});
+		}
+	}
+
+	publishListEdits(std::move(edits));
 }
 
 void CPanel::addPanelContentsChangedListener(PanelContentsChangedListener *listener)
@@ -430,18 +573,65 @@ void CPanel::addPanelContentsChangedListener(PanelContentsChangedListener *liste
 	_panelContentsChangedListeners.push_back(listener);
 }
 
-const VolumeInfo& CPanel::volumeInfoForObject(const CFileSystemObject& object) const
+void CPanel::publishList(std::map<qulonglong, CFileSystemObject>&& items)
 {
-	static const VolumeInfo dummy;
+	_publishedList = std::make_shared<std::map<qulonglong, CFileSystemObject>>(std::move(items));
+	_spareList.reset();
+	_spareListEdits.clear();
+	std::atomic_store(&_items, FileListSnapshot(_publishedList));
+}
 
-	const auto storage = std::find_if(_volumes.cbegin(), _volumes.cend(), [&object](const VolumeInfo& item) {return item.rootObjectInfo.rootFileSystemId() == object.rootFileSystemId();});
-	return storage != _volumes.cend() ? *storage : dummy;
+void CPanel::publishListEdits(std::vector<ListEdit>&& edits)
+{
+	if (edits.empty())
+		return;
+
+	const auto applyListEdits = [](std::map<qulonglong, CFileSystemObject>& items, const std::vector<ListEdit>& editsToApply) {
+		for (const auto& edit: editsToApply)
+		{
+			if (edit.remove)
+				items.erase(edit.hash);
+			else
+				items[edit.hash] = edit.object;
+		}
+	};
+
+	std::shared_ptr<std::map<qulonglong, CFileSystemObject>> list;
+	// The spare list is no longer published, so if there are no readers left, none can appear
+	if (_spareList && _spareList.use_count() == 1)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		list = std::move(_spareList);
+		applyListEdits(*list, _spareListEdits);
+	}
+	else
+		list = std::make_shared<std::map<qulonglong, CFileSystemObject>>(_publishedList ? *_publishedList : *this->list());
+
+	applyListEdits(*list, edits);
+
+	_spareList = std::move(_publishedList);
+	_spareListEdits = std::move(edits);
+	_publishedList = list;
+	std::atomic_store(&_items, FileListSnapshot(std::move(list)));
+}
+
+VolumeInfo CPanel::volumeInfoForObject(const CFileSystemObject& object) const
+{
+	// The snapshot keeps the lookup alive until the info is copied
+	const std::shared_ptr<const CVolumeLookup> volumes = std::atomic_load(&_volumes);
+
+	// The path alone is enough unless it's outside all the volumes, only then does the object have to be stat()ed for its device ID
+	const VolumeInfo* volume = volumes->volumeForPath(object.fullAbsolutePath());
+	if (!volume)
+		volume = volumes->volumeForDevice(object.rootFileSystemId());
+
+	return volume ? *volume : VolumeInfo();
 }
 
 bool CPanel::pathIsAccessible(const QString& path) const
 {
 	const CFileSystemObject pathObject(path);
-	const auto storageInfo = volumeInfoForObject(pathObject);
+	const VolumeInfo storageInfo = volumeInfoForObject(pathObject);
 	if (!pathObject.exists() || !pathObject.isReadable() || (!pathObject.isNetworkObject() && !storageInfo.isReady))
 		return false;
 
@@ -455,9 +645,12 @@ bool CPanel::pathIsAccessible(const QString& path) const
 
 void CPanel::processContentsChangedEvent()
 {
-	if (_bContentsChangedEventPending)
+	bool changesPending = false;
 	{
-		refreshFileList(refreshCauseOther);
-		_bContentsChangedEventPending = false;
+		std::lock_guard<std::recursive_mutex> locker(_fileListAndCurrentDirMutex);
+		changesPending = !_pendingDelta.empty();
 	}
+
+	if (changesPending)
+		sendIncrementalContentsChangedNotification();
 }
@@ -2,12 +2,14 @@
 #define CPANEL_H
 
 #include "cfilesystemobject.h"
+#include "container/ordered_containers.hpp"
 #include "diskenumerator/cvolumeenumerator.h"
 #include "historylist/chistorylist.h"
 #include "threading/cworkerthread.h"
 #include "threading/cexecutionqueue.h"
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -28,10 +30,24 @@ enum FileListRefreshCause
 	refreshCauseOther
 };
 
+// An immutable list of the panel's items. A new snapshot is published whenever the list changes, the old ones stay valid for as long as they're referenced.
+using FileListSnapshot = std::shared_ptr<const std::map<qulonglong, CFileSystemObject>>;
+
+// The items of the current folder that have changed on disk since the previous notification, as reported by the file system watcher
+struct FileListDelta
+{
+	std::vector<qulonglong> inserted;
+	std::vector<qulonglong> removed;
+	std::vector<qulonglong> updated;
+
+	bool empty() const {return inserted.empty() && removed.empty() && updated.empty();}
+};
 
 struct PanelContentsChangedListener
 {
 	virtual void panelContentsChanged(Panel p, FileListRefreshCause operation) = 0;
+	// The panel's list has already been updated. Listeners that can't apply individual changes get the regular full notification.
+	virtual void panelContentsChangedIncrementally(Panel p, const FileListDelta& /*delta*/) {panelContentsChanged(p, refreshCauseOther);}
 	// progress > 100 means indefinite
 	virtual void itemDiscoveryInProgress(Panel p, qulonglong itemHash, size_t progress, const QString& currentDir) = 0;
 };
@@ -82,18 +98,22 @@ public:
 
 	// Enumerates objects in the current directory
 	void refreshFileList(FileListRefreshCause operation);
-	// Returns the current list of objects on this panel
-	std::map<qulonglong, CFileSystemObject> list() const;
+	// Returns the current list of objects on this panel; never null
+	FileListSnapshot list() const;
 
 	bool itemHashExists(const qulonglong hash) const;
 	CFileSystemObject itemByHash(qulonglong hash) const;
 
 	// Calculates total size for the specified objects
 	FilesystemObjectsStatistics calculateStatistics(const std::vector<qulonglong> & hashes);
+	// Same for arbitrary items, not necessarily listed on any panel; the observer is called with the folder currently being scanned
+	static FilesystemObjectsStatistics calculateStatistics(const std::vector<CFileSystemObject>& items, const std::function<void (const QString&)>& progressObserver);
 	// Calculates directory size, stores it in the corresponding CFileSystemObject and sends data change notification
 	void displayDirSize(qulonglong dirHash);
 
 	void sendContentsChangedNotification(FileListRefreshCause operation) const;
+	// Sends the changes accumulated since the previous call, if any
+	void sendIncrementalContentsChangedNotification() const;
 	// progress > 100 means indefinite
 	void sendItemDiscoveryProgressNotification(qulonglong itemHash, size_t progress, const QString& currentDir) const;
 
@@ -105,15 +125,33 @@ public:
 	void uiThreadTimerTick();
 
 private:
-	const VolumeInfo& volumeInfoForObject(const CFileSystemObject& object) const;
+	// Both are called on the worker threads as well as on the UI thread
+	VolumeInfo volumeInfoForObject(const CFileSystemObject& object) const;
 	bool pathIsAccessible(const QString& path) const;
-
-	void contentsChanged();
+	// A change to a single item: it's inserted or replaced with object, or removed
+	struct ListEdit {
+		qulonglong hash;
+		CFileSystemObject object;
+		bool remove;
+	};
+
+	// Both must be called with _fileListAndCurrentDirMutex locked so that concurrent modifications don't get lost
+	void publishList(std::map<qulonglong, CFileSystemObject>&& items);
+	// Publishes the current list with the edits applied. The list is double-buffered: the previously published map is brought up to date and reused
+	// as long as no reader holds it anymore, so that an edit costs O(number of items changed) instead of a copy of the whole list.
+	void publishListEdits(std::vector<ListEdit>&& edits);
+
+	// Applies the watcher's diff to _items
+	void contentsChanged(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed);
 	void processContentsChangedEvent();
 
 private:
 	CFileSystemObject                          _currentDirObject;
-	std::map<qulonglong, CFileSystemObject>    _items;
+	FileListSnapshot                           _items; // Only accessed through std::atomic_load / std::atomic_store, readers don't lock the mutex
+	// The writer's handles of the published map and of the previously published one, and the edits the latter lacks. Guarded by _fileListAndCurrentDirMutex.
+	std::shared_ptr<std::map<qulonglong, CFileSystemObject>> _publishedList, _spareList;
+	std::vector<ListEdit>                      _spareListEdits;
+	mutable FileListDelta                      _pendingDelta; // Guarded by _fileListAndCurrentDirMutex
 	CHistoryList<QString>                      _history;
 	std::map<QString, qulonglong /*hash*/>     _cursorPosForFolder;
 	std::shared_ptr<class CFileSystemWatcher>  _watcher; // Can't use uniqe_ptr because it doesn't play nicely with forward declaration
@@ -121,14 +159,14 @@ private:
 	const Panel                                _panelPosition;
 	CurrentDisplayMode                         _currentDisplayMode = NormalMode;
 
-	std::deque<VolumeInfo> _volumes;
+	// Replaced as a whole when the volumes change, never modified. Only accessed through std::atomic_load / std::atomic_store, same as _items.
+	std::shared_ptr<const CVolumeLookup>       _volumes;
 
 	CWorkerThreadPool                          _workerThreadPool;
 	mutable CExecutionQueue                    _uiThreadQueue;
 	mutable std::recursive_mutex               _fileListAndCurrentDirMutex;
 
 	QTimer                                     _fileListRefreshTimer;
-	std::atomic<bool>                          _bContentsChangedEventPending{false};
 };
 
 #endif // CPANEL_H
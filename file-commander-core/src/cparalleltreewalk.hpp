@@ -0,0 +1,198 @@
+#pragma once
+
+#include "threading/thread_helpers.h"
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The scheduling part of a multithreaded walk of a folder tree: the folder processor is called for the root and then for every subfolder it returns, on a pool of threads.
+// Each thread takes folders from its own queue, newest first, and steals the oldest folder from another thread's queue when its own runs out.
+// The processor is called concurrently. What a folder is and what processing it means is up to the user: see scanDirectory() and CDirectorySizeCache.
+template <typename Folder>
+class CParallelTreeWalk
+{
+public:
+	// Appends the subfolders to be walked to 'subfolders'
+	using FolderProcessor = std::function<void (const Folder& folder, std::vector<Folder>& subfolders)>;
+
+	CParallelTreeWalk(size_t numThreads, const std::atomic<bool>& abort, const char* threadName);
+	~CParallelTreeWalk();
+
+	// Returns immediately, the walk runs in the background
+	void start(const Folder& root, const FolderProcessor& processor);
+	// The threads quit without processing the remaining folders
+	void stop();
+	// Returns once every folder has been processed or the walk has been stopped or aborted
+	void wait();
+
+	bool stopped() const;
+
+private:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Folder> folders; // The owner takes from the back, the others steal from the front
+	};
+
+	void threadFunc(size_t threadIndex);
+	bool takeFolder(size_t threadIndex, Folder& folder);
+	void enqueueFolders(size_t threadIndex, std::vector<Folder>& folders);
+
+private:
+	const std::atomic<bool>& _abort;
+	const char* const _threadName;
+	FolderProcessor _processor;
+
+	std::vector<std::unique_ptr<WorkQueue>> _queues;
+	std::vector<std::thread> _threads;
+	std::atomic<size_t> _numPendingFolders {0}; // Queued or being processed
+	std::atomic<bool> _stop {false};
+
+	std::mutex _idleMutex;
+	std::condition_variable _workAvailable;
+};
+
+template <typename Folder>
+CParallelTreeWalk<Folder>::CParallelTreeWalk(size_t numThreads, const std::atomic<bool>& abort, const char* threadName) :
+	_abort(abort),
+	_threadName(threadName)
+{
+	assert(numThreads > 0);
+	for (size_t i = 0; i < numThreads; ++i)
+		_queues.emplace_back(std::make_unique<WorkQueue>());
+}
+
+template <typename Folder>
+CParallelTreeWalk<Folder>::~CParallelTreeWalk()
+{
+	stop();
+	wait();
+}
+
+template <typename Folder>
+void CParallelTreeWalk<Folder>::start(const Folder& root, const FolderProcessor& processor)
+{
+	assert(_threads.empty());
+
+	_processor = processor;
+	std::vector<Folder> rootFolder(1, root);
+	enqueueFolders(0, rootFolder);
+
+	for (size_t i = 0; i < _queues.size(); ++i)
+		_threads.emplace_back(&CParallelTreeWalk::threadFunc, this, i);
+}
+
+template <typename Folder>
+void CParallelTreeWalk<Folder>::stop()
+{
+	_stop = true;
+	{
+		std::lock_guard<std::mutex> lock(_idleMutex);
+	}
+	_workAvailable.notify_all();
+}
+
+template <typename Folder>
+void CParallelTreeWalk<Folder>::wait()
+{
+	for (auto& thread: _threads)
+		thread.join();
+
+	_threads.clear();
+}
+
+template <typename Folder>
+bool CParallelTreeWalk<Folder>::stopped() const
+{
+	return _stop || _abort;
+}
+
+template <typename Folder>
+void CParallelTreeWalk<Folder>::threadFunc(size_t threadIndex)
+{
+	setThreadName(_threadName);
+
+	std::vector<Folder> subfolders;
+	while (!stopped())
+	{
+		Folder folder;
+		if (!takeFolder(threadIndex, folder))
+		{
+			std::unique_lock<std::mutex> lock(_idleMutex);
+			if (_numPendingFolders == 0)
+				break;
+
+			// Woken up when more folders are queued; the timeout is for noticing the abort flag, which nobody notifies about
+			_workAvailable.wait_for(lock, std::chrono::milliseconds(20));
+			continue;
+		}
+
+		subfolders.clear();
+		_processor(folder, subfolders);
+		if (!stopped())
+			enqueueFolders(threadIndex, subfolders);
+
+		if (--_numPendingFolders == 0)
+		{
+			std::lock_guard<std::mutex> lock(_idleMutex);
+			_workAvailable.notify_all();
+		}
+	}
+}
+
+template <typename Folder>
+bool CParallelTreeWalk<Folder>::takeFolder(size_t threadIndex, Folder& folder)
+{
+	{
+		WorkQueue& ownQueue = *_queues[threadIndex];
+		std::lock_guard<std::mutex> lock(ownQueue.mutex);
+		if (!ownQueue.folders.empty())
+		{
+			folder = std::move(ownQueue.folders.back());
+			ownQueue.folders.pop_back();
+			return true;
+		}
+	}
+
+	// Stealing the oldest folder, which is the closest to the root and is likely to have the most work below it
+	for (size_t i = 1; i < _queues.size(); ++i)
+	{
+		WorkQueue& victimQueue = *_queues[(threadIndex + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(victimQueue.mutex);
+		if (!victimQueue.folders.empty())
+		{
+			folder = std::move(victimQueue.folders.front());
+			victimQueue.folders.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template <typename Folder>
+void CParallelTreeWalk<Folder>::enqueueFolders(size_t threadIndex, std::vector<Folder>& folders)
+{
+	if (folders.empty())
+		return;
+
+	_numPendingFolders += folders.size();
+	{
+		WorkQueue& ownQueue = *_queues[threadIndex];
+		std::lock_guard<std::mutex> lock(ownQueue.mutex);
+		for (Folder& folder: folders)
+			ownQueue.folders.push_back(std::move(folder));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_idleMutex);
+	}
+	_workAvailable.notify_all();
+}
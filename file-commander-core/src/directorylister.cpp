@@ -0,0 +1,155 @@
+#include "directorylister.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFile>
+RESTORE_COMPILER_WARNINGS
+
+#ifdef __linux__
+#include <atomic>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct EntryInfo {
+	FileSystemObjectType type = UnknownType;
+	uint64_t size = 0;
+	time_t creationDate = 0;
+	time_t modificationDate = 0;
+};
+
+inline FileSystemObjectType typeFromMode(mode_t mode)
+{
+	return S_ISDIR(mode) ? Directory : (S_ISREG(mode) ? File : UnknownType);
+}
+
+// Symlinks are followed, like QFileInfo does, unless followSymlinks is false, in which case they're treated as not existing.
+// Returns false if the item doesn't exist, which includes broken symlinks (QFileInfo doesn't consider them existing either).
+bool queryEntryInfo(int dirFd, const char* name, unsigned char direntType, bool followSymlinks, EntryInfo& info)
+{
+	if (!followSymlinks && direntType == DT_LNK)
+		return false;
+
+#ifdef STATX_BASIC_STATS
+	static std::atomic<bool> statxSupported {true};
+	if (statxSupported)
+	{
+		// Only requesting the fields that are displayed; the type is already known for most file systems
+		unsigned int mask = STATX_MTIME | STATX_BTIME | STATX_CTIME;
+		if (direntType != DT_DIR)
+			mask |= STATX_SIZE;
+		if (direntType != DT_DIR && direntType != DT_REG)
+			mask |= STATX_TYPE;
+
+		struct statx statxInfo;
+		if (::statx(dirFd, name, AT_STATX_DONT_SYNC | (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW), mask, &statxInfo) == 0)
+		{
+			if (S_ISLNK(statxInfo.stx_mode))
+				return false;
+
+			info.type = typeFromMode(statxInfo.stx_mode);
+			info.size = info.type == File ? statxInfo.stx_size : 0;
+			info.modificationDate = (time_t)statxInfo.stx_mtime.tv_sec;
+			// Not every file system stores the creation time
+			info.creationDate = (time_t)((statxInfo.stx_mask & STATX_BTIME) ? statxInfo.stx_btime.tv_sec : statxInfo.stx_ctime.tv_sec);
+			return true;
+		}
+		else if (errno != ENOSYS)
+			return false;
+
+		// The kernel is older than 4.11
+		statxSupported = false;
+	}
+#else
+	(void)direntType;
+#endif
+
+	struct stat statInfo;
+	if (::fstatat(dirFd, name, &statInfo, followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0 || S_ISLNK(statInfo.st_mode))
+		return false;
+
+	info.type = typeFromMode(statInfo.st_mode);
+	info.size = info.type == File ? (uint64_t)statInfo.st_size : 0;
+	info.modificationDate = statInfo.st_mtime;
+	info.creationDate = statInfo.st_ctime;
+	return true;
+}
+
+bool listDirectory(const QString& path, bool includeHidden, bool includeCdUp, bool followSymlinks, std::vector<CFileSystemObject>& items, const std::function<void (size_t)>& progressObserver)
+{
+	const QString folderPath = path.endsWith('/') ? path : path + '/';
+	const int fd = ::open(QFile::encodeName(folderPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	items.clear();
+
+	alignas(dirent64) char buffer[64 * 1024];
+	long bytesRead = 0;
+	while ((bytesRead = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (long offset = 0; offset < bytesRead;)
+		{
+			const dirent64* entry = reinterpret_cast<const dirent64*>(buffer + offset);
+			offset += entry->d_reclen;
+
+			const char* name = entry->d_name;
+			if (name[0] == '.')
+			{
+				if (name[1] == '\0')
+					continue;
+				else if (name[1] == '.' && name[2] == '\0')
+				{
+					// The same ".." item QDir would produce, except for the root which has no parent
+					if (includeCdUp && folderPath != QLatin1String("/"))
+						items.emplace_back(QFileInfo(folderPath + QLatin1String("..")));
+					continue;
+				}
+				else if (!includeHidden)
+					continue;
+			}
+
+			EntryInfo info;
+			if (!queryEntryInfo(fd, name, entry->d_type, followSymlinks, info))
+				continue;
+
+			items.emplace_back(folderPath, QFile::decodeName(name), info.type, info.size, info.creationDate, info.modificationDate);
+			if (progressObserver && items.size() % 1024 == 0)
+				progressObserver(items.size());
+		}
+	}
+
+	::close(fd);
+	return bytesRead == 0;
+}
+
+}
+
+bool listDirectoryNatively(const QString& path, bool includeHidden, std::vector<CFileSystemObject>& items, const std::function<void (size_t)>& progressObserver)
+{
+	return listDirectory(path, includeHidden, true, true, items, progressObserver);
+}
+
+bool listDirectoryContentsNatively(const QString& path, std::vector<CFileSystemObject>& items)
+{
+	return listDirectory(path, true, false, false, items, std::function<void (size_t)>());
+}
+
+#else
+
+bool listDirectoryNatively(const QString& /*path*/, bool /*includeHidden*/, std::vector<CFileSystemObject>& /*items*/, const std::function<void (size_t)>& /*progressObserver*/)
+{
+	return false;
+}
+
+bool listDirectoryContentsNatively(const QString& /*path*/, std::vector<CFileSystemObject>& /*items*/)
+{
+	return false;
+}
+
+#endif
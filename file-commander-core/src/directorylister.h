@@ -0,0 +1,15 @@
+#pragma once
+
+#include "cfilesystemobject.h"
+
+#include <functional>
+#include <vector>
+
+// Lists the folder (including the ".." item, except for the root) with getdents64 and statx, constructing the items directly instead of going through QDir::entryInfoList and QFileInfo.
+// Hidden items are skipped without a stat() call unless includeHidden is set. The observer is called every now and then with the number of items listed so far.
+// Returns false if the native listing isn't available (other platforms, or the folder can't be opened), in which case the caller should use QDir.
+bool listDirectoryNatively(const QString& path, bool includeHidden, std::vector<CFileSystemObject>& items, const std::function<void (size_t)>& progressObserver = std::function<void (size_t)>());
+
+// Lists the folder for a recursive walk: hidden items included, no ".." item, and symlinks are skipped rather than followed (like QDir::NoSymLinks) so that the walk can't loop.
+// Returns false under the same conditions as listDirectoryNatively.
+bool listDirectoryContentsNatively(const QString& path, std::vector<CFileSystemObject>& items);
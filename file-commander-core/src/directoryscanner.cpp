@@ -1,21 +1,193 @@
 #include "directoryscanner.h"
+#include "directorylister.h"
+#include "cparalleltreewalk.hpp"
 
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-void scanDirectory(const CFileSystemObject& root, const std::function<void(const CFileSystemObject&)>& observer, const std::atomic<bool>& abort)
+namespace {
+
+struct FolderNode {
+	explicit FolderNode(const CFileSystemObject& folderObject) : folder(folderObject) {}
+
+	const CFileSystemObject folder;
+	// soDeterministic only: the sorted contents and the nodes for the subfolders among them, in the same order
+	std::vector<CFileSystemObject> contents;
+	std::vector<std::shared_ptr<FolderNode>> subfolders;
+	bool listed = false; // Guarded by TreeWalker::_listedMutex
+};
+
+class TreeWalker
 {
-	if (observer)
-		observer(root);
+public:
+	TreeWalker(const ScanBatchObserver& observer, const std::atomic<bool>& abort, ScanOrder order, size_t numThreads);
+
+	void walk(const CFileSystemObject& root);
+
+private:
+	void processFolder(const std::shared_ptr<FolderNode>& node, std::vector<std::shared_ptr<FolderNode>>& subfolders);
+
+	// soDeterministic: reports the folder's contents depth-first as they become available, on the calling thread
+	void reportInOrder(const std::shared_ptr<FolderNode>& node, std::vector<CFileSystemObject>& batch);
+	void report(const std::vector<CFileSystemObject>& batch);
+	bool stopped() const;
+
+private:
+	static const size_t _batchSize = 256;
+
+	const ScanBatchObserver& _observer;
+	const ScanOrder _order;
 
-	if (!root.isDir() || abort)
+	CParallelTreeWalk<std::shared_ptr<FolderNode>> _walk;
+
+	std::mutex _listedMutex;
+	std::condition_variable _folderListed;
+
+	std::mutex _observerMutex;
+};
+
+TreeWalker::TreeWalker(const ScanBatchObserver& observer, const std::atomic<bool>& abort, ScanOrder order, size_t numThreads) :
+	_observer(observer),
+	_order(order),
+	_walk(numThreads, abort, "scanDirectory thread")
+{
+}
+
+void TreeWalker::walk(const CFileSystemObject& root)
+{
+	report(std::vector<CFileSystemObject>(1, root));
+	if (!root.isDir() || stopped())
 		return;
 
-	const auto list = root.qDir().entryInfoList(QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::System);
-	for (const auto& entry : list)
+	const auto rootNode = std::make_shared<FolderNode>(root);
+	_walk.start(rootNode, [this](const std::shared_ptr<FolderNode>& node, std::vector<std::shared_ptr<FolderNode>>& subfolders) {
+		processFolder(node, subfolders);
+	});
+
+	if (_order == soDeterministic)
+	{
+		std::vector<CFileSystemObject> batch;
+		reportInOrder(rootNode, batch);
+		if (!batch.empty() && !stopped())
+			report(batch);
+
+		// Whatever is still being listed is no longer needed
+		_walk.stop();
+	}
+
+	_walk.wait();
+}
+
+void TreeWalker::processFolder(const std::shared_ptr<FolderNode>& node, std::vector<std::shared_ptr<FolderNode>>& subfolders)
+{
+	std::vector<CFileSystemObject> contents;
+	if (!listDirectoryContentsNatively(node->folder.fullAbsolutePath(), contents))
+	{
+		contents.clear();
+		const auto list = node->folder.qDir().entryInfoList(QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::System);
+		contents.reserve((size_t)list.size());
+		for (const auto& entry: list)
+			contents.emplace_back(entry);
+	}
+
+	if (_order == soDeterministic)
 	{
-		scanDirectory(CFileSystemObject(entry), observer, abort);
+		// The same order QDir uses by default
+		std::sort(contents.begin(), contents.end(), [](const CFileSystemObject& l, const CFileSystemObject& r) {
+			return l.fullName().compare(r.fullName(), Qt::CaseInsensitive) < 0;
+		});
 
-		if (abort)
+		for (const auto& item: contents)
+		{
+			if (item.isDir())
+				subfolders.push_back(std::make_shared<FolderNode>(item));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_listedMutex);
+			node->contents = std::move(contents);
+			node->subfolders = subfolders;
+			node->listed = true;
+		}
+
+		_folderListed.notify_all();
+	}
+	else
+	{
+		for (const auto& item: contents)
+		{
+			if (item.isDir())
+				subfolders.push_back(std::make_shared<FolderNode>(item));
+		}
+
+		// The folders must be reported before they're queued, so that nothing inside a folder can be reported ahead of the folder itself
+		if (!contents.empty())
+			report(contents);
+	}
+}
+
+void TreeWalker::reportInOrder(const std::shared_ptr<FolderNode>& node, std::vector<CFileSystemObject>& batch)
+{
+	{
+		std::unique_lock<std::mutex> lock(_listedMutex);
+		while (!node->listed && !stopped())
+			_folderListed.wait_for(lock, std::chrono::milliseconds(20));
+	}
+
+	if (stopped())
+		return;
+
+	auto subfolder = node->subfolders.begin();
+	for (const auto& item: node->contents)
+	{
+		batch.push_back(item);
+		if (batch.size() >= _batchSize)
+		{
+			report(batch);
+			batch.clear();
+		}
+
+		if (item.isDir())
+		{
+			assert(subfolder != node->subfolders.end());
+			reportInOrder(*subfolder, batch);
+			// The subtree has been reported and is no longer needed
+			subfolder->reset();
+			++subfolder;
+		}
+
+		if (stopped())
 			return;
 	}
 }
+
+void TreeWalker::report(const std::vector<CFileSystemObject>& batch)
+{
+	if (!_observer || stopped())
+		return;
+
+	std::lock_guard<std::mutex> lock(_observerMutex);
+	_observer(batch);
+}
+
+bool TreeWalker::stopped() const
+{
+	return _walk.stopped();
+}
+
+}
+
+void scanDirectory(const CFileSystemObject& root, const ScanBatchObserver& observer, const std::atomic<bool>& abort, ScanOrder order, size_t numThreads)
+{
+	if (numThreads == 0)
+		// Most of the time is spent waiting for the file system rather than the CPU, more so over the network
+		numThreads = std::max(8u, std::thread::hardware_concurrency());
+
+	TreeWalker walker(observer, abort, order, numThreads);
+	walker.walk(root);
+}
@@ -2,6 +2,19 @@
 
 #include "cfilesystemobject.h"
 
+#include <atomic>
+#include <functional>
 #include <vector>
 
-void scanDirectory(const CFileSystemObject& root, const std::function<void (const CFileSystemObject&)>& observer, const std::atomic<bool>& abort = std::atomic<bool>{false});
+enum ScanOrder {
+	soAnyOrder,       // Every batch is reported as soon as it's ready, whichever thread has listed it
+	soDeterministic   // The order of a sequential depth-first walk: every folder is immediately followed by its contents, which are sorted by name
+};
+
+// Receives the items found, one batch at a time. Called on the scanning threads, but never concurrently.
+using ScanBatchObserver = std::function<void (const std::vector<CFileSystemObject>& batch)>;
+
+// Walks the tree below root on a pool of threads, each taking folders from its own queue and stealing from the others' when it runs out.
+// Symlinks are skipped. The root itself is reported first, and with either order a folder is reported before anything inside it.
+// Returns once the walk is complete or 'abort' has been set. numThreads = 0 means the default, which also suits high-latency network file systems.
+void scanDirectory(const CFileSystemObject& root, const ScanBatchObserver& observer, const std::atomic<bool>& abort = std::atomic<bool>{false}, ScanOrder order = soAnyOrder, size_t numThreads = 0);
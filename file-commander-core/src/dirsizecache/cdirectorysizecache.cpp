@@ -0,0 +1,402 @@
+#include "cdirectorysizecache.h"
+#include "cparalleltreewalk.hpp"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+RESTORE_COMPILER_WARNINGS
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <time.h>
+
+static const quint32 cacheFileSignature = 0x46434453; // "FCDS"
+static const quint32 cacheFileVersion = 3; // 2: appendable, no subfolder names; 3: the subfolders' names and inodes
+// The entries of the folders that haven't been measured for this long are assumed to be gone and aren't saved
+static const uint32_t entryExpirationDays = 90;
+
+#ifndef _WIN32
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#define st_ctim st_ctimespec
+#endif
+
+static int64_t mtimeNs(const struct stat& statInfo)
+{
+	return (int64_t)statInfo.st_mtim.tv_sec * 1000000000 + statInfo.st_mtim.tv_nsec;
+}
+
+static int64_t ctimeNs(const struct stat& statInfo)
+{
+	return (int64_t)statInfo.st_ctim.tv_sec * 1000000000 + statInfo.st_ctim.tv_nsec;
+}
+#endif
+
+static uint32_t today()
+{
+	return static_cast<uint32_t>(::time(nullptr) / (24 * 60 * 60));
+}
+
+CDirectorySizeCache& CDirectorySizeCache::get()
+{
+	static CDirectorySizeCache cache;
+	return cache;
+}
+
+CDirectorySizeCache::CDirectorySizeCache() :
+	_cacheFilePath(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/directorysizes.dat")
+{
+	load();
+}
+
+bool CDirectorySizeCache::calculate(const QString& folderPath, CountedInodes& countedInodes, Totals& totals, const std::function<void (const QString&)>& currentFolderObserver)
+{
+#ifdef _WIN32
+	(void)folderPath;
+	(void)countedInodes;
+	(void)totals;
+	(void)currentFolderObserver;
+	return false;
+#else
+	std::string path = QFile::encodeName(folderPath).toStdString();
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+
+	struct stat statInfo;
+	if (path.empty() || ::lstat(path.c_str(), &statInfo) != 0 || !S_ISDIR(statInfo.st_mode))
+		return false;
+
+	const Folder root {path, InodeId{(uint64_t)statInfo.st_dev, (uint64_t)statInfo.st_ino}, mtimeNs(statInfo), ctimeNs(statInfo)};
+
+	std::atomic<uint64_t> numFiles {0}, numFolders {0}, size {0};
+	std::atomic<bool> rootInaccessible {false};
+	std::mutex countedInodesMutex, observerMutex;
+
+	const std::atomic<bool> abort {false};
+	// Most of the time is spent waiting for the file system rather than the CPU, same as with scanDirectory()
+	CParallelTreeWalk<Folder> walk(std::max(8u, std::thread::hardware_concurrency()), abort, "Directory size calculation thread");
+	walk.start(root, [&](const Folder& folder, std::vector<Folder>& subfolders) {
+		if (currentFolderObserver)
+		{
+			std::lock_guard<std::mutex> lock(observerMutex);
+			currentFolderObserver(QFile::decodeName(folder.path.c_str()));
+		}
+
+		FolderEntry entry;
+		if (!measureFolder(folder, entry, subfolders))
+		{
+			// A subfolder that can't be read is counted, but not its contents
+			if (folder.id == root.id)
+				rootInaccessible = true;
+			return;
+		}
+
+		numFiles += entry.files;
+		size += entry.size;
+		numFolders += subfolders.size();
+
+		if (!entry.multiplyLinkedFiles.empty())
+		{
+			std::lock_guard<std::mutex> lock(countedInodesMutex);
+			for (const auto& file: entry.multiplyLinkedFiles)
+			{
+				if (countedInodes.insert(file.first).second)
+				{
+					++numFiles;
+					size += file.second;
+				}
+			}
+		}
+	});
+	walk.wait();
+
+	if (rootInaccessible)
+		return false;
+
+	totals.files += numFiles;
+	totals.folders += numFolders;
+	totals.size += size;
+	return true;
+#endif
+}
+
+void CDirectorySizeCache::save()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_modifiedEntries.empty() || _cacheFilePath.isEmpty())
+		return;
+
+	QDir().mkpath(QFileInfo(_cacheFilePath).absolutePath());
+
+	// Every save appends a record per modified entry, so the records of the folders that are measured repeatedly pile up
+	if (_fileMustBeRewritten || _numRecordsInFile > 2 * _entries.size() + 1000)
+	{
+		QSaveFile file(_cacheFilePath);
+		if (!file.open(QFile::WriteOnly))
+		{
+			qInfo() << __FUNCTION__ << "Failed to open" << _cacheFilePath << "for writing:" << file.errorString();
+			return;
+		}
+
+		const uint32_t oldestDayToKeep = today() - entryExpirationDays;
+		size_t numRecords = 0;
+		QDataStream stream(&file);
+		stream << cacheFileSignature << cacheFileVersion;
+		for (const auto& item: _entries)
+		{
+			if (item.second.lastUsedDay >= oldestDayToKeep)
+			{
+				writeEntry(stream, item.first, item.second);
+				++numRecords;
+			}
+		}
+
+		if (stream.status() != QDataStream::Ok || !file.commit())
+		{
+			qInfo() << __FUNCTION__ << "Failed to write" << _cacheFilePath << ":" << file.errorString();
+			return;
+		}
+
+		_numRecordsInFile = numRecords;
+		_fileMustBeRewritten = false;
+		_modifiedEntries.clear();
+		return;
+	}
+
+	QFile file(_cacheFilePath);
+	if (!file.open(QFile::WriteOnly | QFile::Append))
+	{
+		qInfo() << __FUNCTION__ << "Failed to open" << _cacheFilePath << "for writing:" << file.errorString();
+		return;
+	}
+
+	QDataStream stream(&file);
+	if (file.size() == 0)
+		stream << cacheFileSignature << cacheFileVersion;
+
+	for (const InodeId& id: _modifiedEntries)
+	{
+		const auto entry = _entries.find(id);
+		if (entry != _entries.end())
+		{
+			writeEntry(stream, id, entry->second);
+			++_numRecordsInFile;
+		}
+	}
+
+	if (stream.status() != QDataStream::Ok || !file.flush())
+	{
+		// A partially written record can't be appended to
+		qInfo() << __FUNCTION__ << "Failed to write" << _cacheFilePath << ":" << file.errorString();
+		_fileMustBeRewritten = true;
+		return;
+	}
+
+	_modifiedEntries.clear();
+}
+
+bool CDirectorySizeCache::measureFolder(const Folder& folder, FolderEntry& entry, std::vector<Folder>& subfolders)
+{
+#ifdef _WIN32
+	(void)folder;
+	(void)entry;
+	(void)subfolders;
+	return false;
+#else
+	bool entryIsValid = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto it = _entries.find(folder.id);
+		if (it != _entries.end() && it->second.mtime == folder.mtime && it->second.ctime == folder.ctime)
+		{
+			if (it->second.lastUsedDay != today())
+			{
+				it->second.lastUsedDay = today();
+				_modifiedEntries.insert(folder.id);
+			}
+
+			entry = it->second;
+			entryIsValid = true;
+		}
+	}
+
+	if (entryIsValid)
+	{
+		if (statStoredSubfolders(folder, entry, subfolders))
+			return true;
+
+		// The folder's timestamps haven't changed, but its contents have (the timestamps are too coarse, or have been restored). It has to be listed again.
+		subfolders.clear();
+		entry = FolderEntry();
+	}
+
+	DIR* dir = ::opendir(folder.path.c_str());
+	if (!dir)
+		return false;
+
+	entry.mtime = folder.mtime;
+	entry.ctime = folder.ctime;
+	entry.lastUsedDay = today();
+
+	const std::string pathPrefix = folder.path == "/" ? folder.path : folder.path + '/';
+	const int dirFd = ::dirfd(dir);
+	while (const struct dirent* dirEntry = ::readdir(dir))
+	{
+		const char* name = dirEntry->d_name;
+		if (::strcmp(name, ".") == 0 || ::strcmp(name, "..") == 0)
+			continue;
+
+		// Symlinks are neither followed nor counted, like with QDir::NoSymLinks
+		if (dirEntry->d_type == DT_LNK)
+			continue;
+
+		struct stat statInfo;
+		if (::fstatat(dirFd, name, &statInfo, AT_SYMLINK_NOFOLLOW) != 0)
+			continue;
+
+		if (S_ISDIR(statInfo.st_mode))
+		{
+			const InodeId id {(uint64_t)statInfo.st_dev, (uint64_t)statInfo.st_ino};
+			subfolders.push_back(Folder{pathPrefix + name, id, mtimeNs(statInfo), ctimeNs(statInfo)});
+			entry.subfolders.emplace_back(name, id);
+		}
+		else if (S_ISREG(statInfo.st_mode))
+		{
+			if (statInfo.st_nlink > 1)
+				entry.multiplyLinkedFiles.emplace_back(InodeId{(uint64_t)statInfo.st_dev, (uint64_t)statInfo.st_ino}, (uint64_t)statInfo.st_size);
+			else
+			{
+				++entry.files;
+				entry.size += (uint64_t)statInfo.st_size;
+			}
+		}
+	}
+
+	::closedir(dir);
+
+	// A folder that has been modified within the last couple of seconds can be modified again without its timestamps changing,
+	// if the file system's timestamp granularity is coarse. Such a listing isn't stored, the next calculation will redo it.
+	const int64_t now = (int64_t)::time(nullptr) * 1000000000;
+	if (now - std::max(folder.mtime, folder.ctime) > 2 * (int64_t)1000000000)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_entries[folder.id] = entry;
+		_modifiedEntries.insert(folder.id);
+	}
+
+	return true;
+#endif
+}
+
+bool CDirectorySizeCache::statStoredSubfolders(const Folder& folder, const FolderEntry& entry, std::vector<Folder>& subfolders)
+{
+#ifdef _WIN32
+	(void)folder;
+	(void)entry;
+	(void)subfolders;
+	return false;
+#else
+	const std::string pathPrefix = folder.path == "/" ? folder.path : folder.path + '/';
+	subfolders.reserve(entry.subfolders.size());
+	for (const auto& subfolder: entry.subfolders)
+	{
+		std::string path = pathPrefix + subfolder.first;
+		struct stat statInfo;
+		if (::lstat(path.c_str(), &statInfo) != 0 || !S_ISDIR(statInfo.st_mode) || !(InodeId{(uint64_t)statInfo.st_dev, (uint64_t)statInfo.st_ino} == subfolder.second))
+			return false;
+
+		// The subfolder's own timestamps are checked against its own entry when it's measured
+		subfolders.push_back(Folder{std::move(path), subfolder.second, mtimeNs(statInfo), ctimeNs(statInfo)});
+	}
+
+	return true;
+#endif
+}
+
+void CDirectorySizeCache::load()
+{
+	QFile file(_cacheFilePath);
+	if (_cacheFilePath.isEmpty() || !file.open(QFile::ReadOnly))
+		return;
+
+	QDataStream stream(&file);
+	quint32 signature = 0, version = 0;
+	stream >> signature >> version;
+	if (signature != cacheFileSignature || version != cacheFileVersion)
+	{
+		qInfo() << __FUNCTION__ << _cacheFilePath << "is not a directory size cache of a supported version, ignoring it";
+		_fileMustBeRewritten = true;
+		return;
+	}
+
+	// The later records of a folder supersede the earlier ones
+	while (!stream.atEnd())
+	{
+		quint64 device = 0, inode = 0, files = 0, size = 0, numMultiplyLinkedFiles = 0;
+		qint64 mtime = 0, ctime = 0;
+		FolderEntry entry;
+		stream >> device >> inode >> mtime >> ctime >> entry.lastUsedDay >> files >> size;
+		entry.mtime = mtime;
+		entry.ctime = ctime;
+		entry.files = files;
+		entry.size = size;
+
+		stream >> numMultiplyLinkedFiles;
+		for (quint64 i = 0; i < numMultiplyLinkedFiles && stream.status() == QDataStream::Ok; ++i)
+		{
+			quint64 fileDevice = 0, fileInode = 0, fileSize = 0;
+			stream >> fileDevice >> fileInode >> fileSize;
+			entry.multiplyLinkedFiles.emplace_back(InodeId{fileDevice, fileInode}, fileSize);
+		}
+
+		quint64 numSubfolders = 0;
+		stream >> numSubfolders;
+		for (quint64 i = 0; i < numSubfolders && stream.status() == QDataStream::Ok; ++i)
+		{
+			QByteArray name;
+			quint64 subfolderDevice = 0, subfolderInode = 0;
+			stream >> name >> subfolderDevice >> subfolderInode;
+			entry.subfolders.emplace_back(name.toStdString(), InodeId{subfolderDevice, subfolderInode});
+		}
+
+		if (stream.status() != QDataStream::Ok)
+			break;
+
+		_entries[InodeId{device, inode}] = std::move(entry);
+		++_numRecordsInFile;
+	}
+
+	if (stream.status() != QDataStream::Ok)
+	{
+		// Most likely the last record has been cut short while being appended. The complete ones are fine.
+		qInfo() << __FUNCTION__ << _cacheFilePath << "is truncated or corrupt, only the first" << _entries.size() << "folders have been loaded";
+		_fileMustBeRewritten = true;
+	}
+	else
+		qInfo() << __FUNCTION__ << "loaded" << _entries.size() << "folders from" << _cacheFilePath;
+}
+
+void CDirectorySizeCache::writeEntry(QDataStream& stream, const InodeId& id, const FolderEntry& entry)
+{
+	stream << (quint64)id.device << (quint64)id.inode << (qint64)entry.mtime << (qint64)entry.ctime << entry.lastUsedDay << (quint64)entry.files << (quint64)entry.size;
+
+	stream << (quint64)entry.multiplyLinkedFiles.size();
+	for (const auto& file: entry.multiplyLinkedFiles)
+		stream << (quint64)file.first.device << (quint64)file.first.inode << (quint64)file.second;
+
+	stream << (quint64)entry.subfolders.size();
+	for (const auto& subfolder: entry.subfolders)
+		stream << QByteArray::fromStdString(subfolder.first) << (quint64)subfolder.second.device << (quint64)subfolder.second.inode;
+}
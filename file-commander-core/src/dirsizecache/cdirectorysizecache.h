@@ -0,0 +1,92 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+class QDataStream;
+
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Remembers, across sessions, the total size and number of the files directly inside every folder that has been measured.
+// A folder is identified by its device and inode and its entry is only trusted while the folder's mtime and ctime are the same as when it was listed,
+// so a repeated calculation doesn't list an unchanged folder at all: only its subfolders, whose names are stored in the entry, are stat()ed.
+// Caveat: a file that's modified in place doesn't touch its folder's mtime, so its new size is only picked up once something in that folder is added, removed or renamed.
+// The folders are walked on a pool of threads, see CParallelTreeWalk. Not supported on Windows, see calculate().
+class CDirectorySizeCache
+{
+public:
+	struct InodeId {
+		uint64_t device;
+		uint64_t inode;
+
+		bool operator==(const InodeId& other) const {return device == other.device && inode == other.inode;}
+	};
+
+	struct InodeIdHash {
+		size_t operator()(const InodeId& id) const {return std::hash<uint64_t>()(id.inode * 31 + id.device);}
+	};
+
+	// The files with more than one link that have already been counted. Share it between the calculations whose results are added up.
+	using CountedInodes = std::unordered_set<InodeId, InodeIdHash>;
+
+	struct Totals {
+		uint64_t files = 0;
+		uint64_t folders = 0; // Not including the root
+		uint64_t size = 0;
+	};
+
+	static CDirectorySizeCache& get();
+
+	// Adds up everything below the folder, symlinks not followed. currentFolderObserver is called for every folder entered, never concurrently.
+	// Returns false if the calculation isn't supported on this platform or the folder can't be accessed, in which case the caller has to do a regular scan.
+	bool calculate(const QString& folderPath, CountedInodes& countedInodes, Totals& totals, const std::function<void (const QString& currentFolder)>& currentFolderObserver = {});
+
+	// Appends the entries that have changed since the previous call to the cache file. The file is rewritten from scratch instead once most of it is outdated.
+	void save();
+
+private:
+	CDirectorySizeCache();
+
+	struct FolderEntry {
+		int64_t mtime = 0; // ns
+		int64_t ctime = 0; // ns
+		uint32_t lastUsedDay = 0; // Days since epoch, for dropping the entries of folders that are gone
+		uint64_t files = 0; // Not counting the files with multiple links
+		uint64_t size = 0;
+		std::vector<std::pair<InodeId, uint64_t /* size */>> multiplyLinkedFiles;
+		std::vector<std::pair<std::string /* name */, InodeId>> subfolders;
+	};
+
+	struct Folder {
+		std::string path;
+		InodeId id;
+		int64_t mtime; // ns
+		int64_t ctime; // ns
+	};
+
+	// Called on the walk's threads. Fills in the entry, from the cache if it's still valid, and lists the subfolders. Returns false if the folder can't be opened.
+	bool measureFolder(const Folder& folder, FolderEntry& entry, std::vector<Folder>& subfolders);
+	// Finds the subfolders stored in a valid entry without listing the folder. Returns false if any of them is gone or has been replaced.
+	static bool statStoredSubfolders(const Folder& folder, const FolderEntry& entry, std::vector<Folder>& subfolders);
+
+	void load();
+	static void writeEntry(QDataStream& stream, const InodeId& id, const FolderEntry& entry);
+
+private:
+	std::unordered_map<InodeId, FolderEntry, InodeIdHash> _entries;
+	std::unordered_set<InodeId, InodeIdHash> _modifiedEntries; // Not saved yet
+	size_t _numRecordsInFile = 0; // Including the outdated ones, superseded by the later records of the same folders
+	bool _fileMustBeRewritten = false; // It's of an older version, or its end is corrupt, so nothing can be appended to it
+	std::mutex _mutex; // Only held while looking up or storing an entry or saving, not for the duration of a calculation
+	const QString _cacheFilePath;
+};
@@ -11,6 +11,14 @@ RESTORE_COMPILER_WARNINGS
 
 #include <algorithm>
 
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
 void CVolumeEnumerator::addObserver(IVolumeListObserver *observer)
 {
 	assert_r(std::find(_observers.begin(), _observers.end(), observer) == _observers.end());
@@ -30,12 +38,22 @@ std::deque<VolumeInfo> CVolumeEnumerator::drives() const
 	return _drives;
 }
 
+size_t CVolumeEnumerator::volumeIndexForPath(const QString& path) const
+{
+	std::lock_guard<decltype(_mutexForDrives)> lock(_mutexForDrives);
+
+	return _volumeLookup.volumeIndexForPath(path);
+}
+
 void CVolumeEnumerator::updateSynchronously()
 {
 	enumerateVolumes(false);
 }
 
-CVolumeEnumerator::CVolumeEnumerator() : _enumeratorThread(_updateInterval, "CVolumeEnumerator thread")
+CVolumeEnumerator::CVolumeEnumerator()
+#ifndef __linux__
+	: _enumeratorThread(_updateInterval, "CVolumeEnumerator thread")
+#endif
 {
 	// Setting up the timer to fetch the notifications from the queue and execute them on this thread
 	connect(&_timer, &QTimer::timeout, [this](){
@@ -44,22 +62,51 @@ CVolumeEnumerator::CVolumeEnumerator() : _enumeratorThread(_updateInterval, "CVo
 	_timer.start(_updateInterval / 3);
 
 	// Starting the worker thread that actually enumerates the volumes
+#ifdef __linux__
+	if (::pipe2(_wakeUpPipe, O_CLOEXEC) != 0)
+		qInfo() << __FUNCTION__ << "pipe2() failed:" << strerror(errno);
+
+	_mountTableWatcherThread = std::thread(&CVolumeEnumerator::watchMountTable, this);
+#else
 	_enumeratorThread.start([this](){
 		enumerateVolumes(true);
 	});
+#endif
+}
+
+CVolumeEnumerator::~CVolumeEnumerator()
+{
+#ifdef __linux__
+	const char stop = 0;
+	if (_wakeUpPipe[1] >= 0 && ::write(_wakeUpPipe[1], &stop, 1) != 1)
+		qInfo() << __FUNCTION__ << "Failed to wake up the watcher thread:" << strerror(errno);
+
+	if (_mountTableWatcherThread.joinable())
+		_mountTableWatcherThread.join();
+
+	for (const int fd: _wakeUpPipe)
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+#endif
 }
 
 // Refresh the list of available volumes
 void CVolumeEnumerator::enumerateVolumes(bool async)
 {
-	const auto newDrives = enumerateVolumesImpl();
+	updateVolumes(enumerateVolumesImpl(), async);
+}
 
+void CVolumeEnumerator::updateVolumes(const std::deque<VolumeInfo>& newDrives, bool async)
+{
 	std::lock_guard<decltype(_mutexForDrives)> lock(_mutexForDrives);
 
 	if (!async || newDrives != _drives)
 	{
 		_drives.resize(newDrives.size());
 		std::copy(newDrives.cbegin(), newDrives.cend(), _drives.begin());
+		_volumeLookup.setVolumes(_drives);
 
 		notifyObservers(async);
 	}
@@ -183,18 +230,277 @@ const std::deque<VolumeInfo> CVolumeEnumerator::enumerateVolumesImpl()
 
 #elif defined __linux__
 
+#include "threading/thread_helpers.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFile>
+RESTORE_COMPILER_WARNINGS
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <set>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// statvfs() on a stale network mount can block for minutes; such a volume is reported as not ready rather than holding the list up
+const auto freeSpaceQueryTimeout = std::chrono::milliseconds(1000);
+
+struct MountInfoEntry {
+	QString deviceId; // major:minor
+	QString root; // The folder of the file system that's mounted, "/" unless it's a bind mount or a subvolume
+	QString mountPoint;
+	QString fileSystemType;
+	QString source;
+};
+
+// Spaces, tabs, newlines and backslashes in the paths are escaped as \ooo
+QString unescapeMountInfoField(const QByteArray& field)
+{
+	QByteArray result;
+	result.reserve(field.size());
+	for (int i = 0; i < field.size(); ++i)
+	{
+		const auto isOctalDigit = [&field](int index) {return field[index] >= '0' && field[index] <= '7';};
+		if (field[i] == '\\' && i + 3 < field.size() && isOctalDigit(i + 1) && isOctalDigit(i + 2) && isOctalDigit(i + 3))
+		{
+			result.append(static_cast<char>(((field[i + 1] - '0') << 6) | ((field[i + 2] - '0') << 3) | (field[i + 3] - '0')));
+			i += 3;
+		}
+		else
+			result.append(field[i]);
+	}
+
+	return QFile::decodeName(result);
+}
+
+// See proc(5): "36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue"
+std::vector<MountInfoEntry> readMountTable()
+{
+	std::vector<MountInfoEntry> entries;
+
+	QFile file(QStringLiteral("/proc/self/mountinfo"));
+	if (!file.open(QFile::ReadOnly))
+	{
+		qInfo() << __FUNCTION__ << "Failed to open" << file.fileName() << ":" << file.errorString();
+		return entries;
+	}
+
+	// The file is generated on the fly and its size is reported as 0, so it's read until there's nothing more to read
+	for (QByteArray line = file.readLine(); !line.isEmpty(); line = file.readLine())
+	{
+		const QList<QByteArray> fields = line.trimmed().split(' ');
+		// The optional fields end with a single hyphen
+		const int separatorIndex = fields.indexOf("-", 6);
+		if (separatorIndex < 0 || fields.size() < separatorIndex + 3)
+			continue;
+
+		MountInfoEntry entry;
+		entry.deviceId = QString::fromLatin1(fields[2]);
+		entry.root = unescapeMountInfoField(fields[3]);
+		entry.mountPoint = unescapeMountInfoField(fields[4]);
+		entry.fileSystemType = QString::fromLatin1(fields[separatorIndex + 1]);
+		entry.source = unescapeMountInfoField(fields[separatorIndex + 2]);
+		entries.push_back(std::move(entry));
+	}
+
+	return entries;
+}
+
+// Container hosts have hundreds of overlay, bind and pseudo file system mounts that the user has no use for.
+// Only the root, the block devices (without the bind mounts of their subfolders and the read-only images like snaps) and the network shares are listed.
+bool isUserVisibleMount(const MountInfoEntry& entry)
+{
+	static const std::set<QString> networkFileSystems {
+		QStringLiteral("nfs"), QStringLiteral("nfs4"), QStringLiteral("cifs"), QStringLiteral("smb3"), QStringLiteral("smbfs"),
+		QStringLiteral("ncpfs"), QStringLiteral("afs"), QStringLiteral("9p"), QStringLiteral("fuse.sshfs"), QStringLiteral("davfs")
+	};
+
+	if (entry.mountPoint == QLatin1String("/") || networkFileSystems.count(entry.fileSystemType) > 0)
+		return true;
+
+	// A btrfs subvolume is a separate file system as far as the user is concerned
+	return entry.source.startsWith(QLatin1String("/dev/")) && entry.fileSystemType != QLatin1String("squashfs") &&
+		(entry.root == QLatin1String("/") || entry.fileSystemType == QLatin1String("btrfs"));
+}
+
+// Lists the volumes without querying the file systems, so an unresponsive mount can't block it; the sizes are left at 0
+std::deque<VolumeInfo> mountedVolumes()
+{
+	std::deque<VolumeInfo> volumes;
+	std::set<std::pair<QString, QString>> mountedFileSystems;
+	for (const MountInfoEntry& entry: readMountTable())
+	{
+		// The same file system mounted in several places is only listed once
+		if (!isUserVisibleMount(entry) || !mountedFileSystems.emplace(entry.deviceId, entry.root).second)
+			continue;
+
+		VolumeInfo info;
+		if (entry.mountPoint == QLatin1String("/"))
+		{
+			info.rootObjectInfo = QStringLiteral("/");
+			info.volumeLabel = QStringLiteral("root");
+		}
+		else
+		{
+			const int lastSlash = entry.mountPoint.lastIndexOf('/');
+			info.rootObjectInfo = CFileSystemObject(entry.mountPoint.left(lastSlash + 1), entry.mountPoint.mid(lastSlash + 1), Directory, 0, 0, 0);
+			info.volumeLabel = info.rootObjectInfo.fullName();
+		}
+
+		const int colon = entry.deviceId.indexOf(':');
+		bool majorNumberValid = false, minorNumberValid = false;
+		const uint majorNumber = entry.deviceId.leftRef(colon).toUInt(&majorNumberValid), minorNumber = entry.deviceId.midRef(colon + 1).toUInt(&minorNumberValid);
+		if (colon > 0 && majorNumberValid && minorNumberValid)
+			info.deviceId = (uint64_t)makedev(majorNumber, minorNumber);
+
+		info.fileSystemName = entry.fileSystemType;
+		volumes.push_back(info);
+	}
+
+	if (volumes.empty())
+	{
+		VolumeInfo info;
+		info.rootObjectInfo = QStringLiteral("/");
+		info.volumeLabel = QStringLiteral("root");
+		volumes.push_back(info);
+	}
+
+	return volumes;
+}
+
+struct FreeSpaceQuery {
+	std::mutex mutex;
+	std::condition_variable completed;
+	bool done = false;
+	bool succeeded = false;
+	struct statvfs info;
+};
+
+// Queries all the volumes in parallel, each on its own detached thread so that a hung one doesn't hold anything else up.
+// A volume that doesn't respond in time keeps its last known figures and is marked as not ready; no new query is started for it until the pending one returns.
+void updateFreeSpace(std::deque<VolumeInfo>& volumes)
+{
+	static std::mutex pendingQueriesMutex;
+	static std::map<QString, std::shared_ptr<FreeSpaceQuery>> pendingQueries;
+
+	std::vector<std::shared_ptr<FreeSpaceQuery>> queries;
+	{
+		std::lock_guard<std::mutex> lock(pendingQueriesMutex);
+		for (const VolumeInfo& volume: volumes)
+		{
+			const QString path = volume.rootObjectInfo.fullAbsolutePath();
+			std::shared_ptr<FreeSpaceQuery>& query = pendingQueries[path];
+			if (!query)
+			{
+				query = std::make_shared<FreeSpaceQuery>();
+				// The thread only owns a reference to the query, it may outlive everything else if the mount never responds
+				std::thread([query, path]() {
+					struct statvfs info {};
+					const bool succeeded = ::statvfs(QFile::encodeName(path).constData(), &info) == 0;
+					if (!succeeded)
+						qInfo() << "statvfs() failed for" << path << ":" << strerror(errno);
+
+					std::lock_guard<std::mutex> queryLock(query->mutex);
+					query->info = info;
+					query->succeeded = succeeded;
+					query->done = true;
+					query->completed.notify_all();
+				}).detach();
+			}
+
+			queries.push_back(query);
+		}
+	}
+
+	const auto deadline = std::chrono::steady_clock::now() + freeSpaceQueryTimeout;
+	for (size_t i = 0; i < volumes.size(); ++i)
+	{
+		FreeSpaceQuery& query = *queries[i];
+		std::unique_lock<std::mutex> queryLock(query.mutex);
+		if (!query.completed.wait_until(queryLock, deadline, [&query]() {return query.done;}))
+		{
+			volumes[i].isReady = false;
+			continue;
+		}
+
+		volumes[i].isReady = query.succeeded;
+		if (query.succeeded)
+		{
+			volumes[i].volumeSize = (uint64_t)query.info.f_frsize * query.info.f_blocks;
+			volumes[i].freeSize = (uint64_t)query.info.f_frsize * query.info.f_bavail;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(pendingQueriesMutex);
+	for (size_t i = 0; i < volumes.size(); ++i)
+	{
+		std::lock_guard<std::mutex> queryLock(queries[i]->mutex);
+		const auto pendingQuery = pendingQueries.find(volumes[i].rootObjectInfo.fullAbsolutePath());
+		if (queries[i]->done && pendingQuery != pendingQueries.end() && pendingQuery->second == queries[i])
+			pendingQueries.erase(pendingQuery);
+	}
+}
+
+}
+
 const std::deque<VolumeInfo> CVolumeEnumerator::enumerateVolumesImpl()
 {
-	VolumeInfo info;
-	info.rootObjectInfo = "/";
-	info.volumeLabel = "root";
-	info.isReady = true;
+	auto volumes = mountedVolumes();
+	updateFreeSpace(volumes);
+	return volumes;
+}
 
-	const auto sys_info = volumeInfoForPath(info.rootObjectInfo.fullAbsolutePath());
-	info.volumeSize = sys_info.f_bsize * sys_info.f_blocks;
-	info.freeSize = sys_info.f_bsize * sys_info.f_bavail;
+void CVolumeEnumerator::watchMountTable()
+{
+	setThreadName("CVolumeEnumerator thread");
 
-	return std::deque<VolumeInfo>(1, info);
+	// The kernel reports every change of the mount namespace as an exceptional condition on the open descriptors of this file
+	const int mountTableFd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+	if (mountTableFd < 0)
+		qInfo() << __FUNCTION__ << "Failed to open /proc/self/mountinfo, the mount table won't be watched:" << strerror(errno);
+
+	std::deque<VolumeInfo> volumes = mountedVolumes();
+	for (;;)
+	{
+		updateFreeSpace(volumes);
+		updateVolumes(volumes, true);
+
+		pollfd fds[2] = {{_wakeUpPipe[0], POLLIN, 0}, {mountTableFd, POLLPRI, 0}};
+		const int result = ::poll(fds, mountTableFd >= 0 ? 2 : 1, (int)_updateInterval);
+		if (result < 0 && errno != EINTR)
+			qInfo() << __FUNCTION__ << "poll() failed:" << strerror(errno);
+		else if (result > 0 && fds[0].revents != 0)
+			break;
+
+		if (result > 0 && (fds[1].revents & (POLLPRI | POLLERR)) != 0)
+		{
+			// Keeping the last known figures of the volumes that are still mounted, in case they don't respond in time for the next refresh
+			std::deque<VolumeInfo> newVolumes = mountedVolumes();
+			for (VolumeInfo& newVolume: newVolumes)
+			{
+				const auto oldVolume = std::find_if(volumes.cbegin(), volumes.cend(), [&newVolume](const VolumeInfo& v) {
+					return v.rootObjectInfo == newVolume.rootObjectInfo && v.fileSystemName == newVolume.fileSystemName;
+				});
+
+				if (oldVolume != volumes.cend())
+				{
+					newVolume.volumeSize = oldVolume->volumeSize;
+					newVolume.freeSize = oldVolume->freeSize;
+				}
+			}
+
+			volumes = std::move(newVolumes);
+		}
+	}
+
+	if (mountTableFd >= 0)
+		::close(mountTableFd);
 }
 
 #else
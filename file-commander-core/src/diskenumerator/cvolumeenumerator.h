@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cvolumelookup.h"
 #include "volumeinfo.hpp"
 #include "threading/cexecutionqueue.h"
 #include "threading/cperiodicexecutionthread.h"
@@ -10,12 +11,17 @@ RESTORE_COMPILER_WARNINGS
 
 #include <deque>
 #include <mutex>
+#ifdef __linux__
+#include <thread>
+#endif
 
-// Lists all the volumes available on a target machine
+// Lists all the volumes available on a target machine.
+// On Linux, the list is only re-read when the kernel reports a change of the mount table, and the free space is refreshed periodically with a timeout for every volume.
 class CVolumeEnumerator : protected QObject
 {
 public:
 	CVolumeEnumerator();
+	~CVolumeEnumerator();
 
 	// Volumes list observer interface
 	class IVolumeListObserver
@@ -31,6 +37,8 @@ public:
 	void removeObserver(IVolumeListObserver * observer);
 	// Returns the drives found
 	std::deque<VolumeInfo> drives() const;
+	// The index in drives() of the volume the path is on, or std::numeric_limits<size_t>::max(); doesn't query the file system
+	size_t volumeIndexForPath(const QString& path) const;
 
 	// Forces an update in this thread
 	void updateSynchronously();
@@ -38,6 +46,13 @@ public:
 private:
 	// Refresh the list of available volumes
 	void enumerateVolumes(bool async);
+	// Stores the new list and notifies the observers if it's different from the current one (or unconditionally if !async)
+	void updateVolumes(const std::deque<VolumeInfo>& newDrives, bool async);
+
+#ifdef __linux__
+	// The body of the watcher thread: waits for the mount table to change, or for the time to refresh the free space figures
+	void watchMountTable();
+#endif
 
 	// Calls all the registered observers with the latest list of drives found
 	void notifyObservers(bool async) const;
@@ -46,12 +61,18 @@ private:
 
 private:
 	std::deque<VolumeInfo> _drives;
+	CVolumeLookup          _volumeLookup;
 	mutable std::recursive_mutex _mutexForDrives; // Has to be recursive:
 	// enumerateVolumes() can be called synchronously through updateSynchronously(), and then drives() getter will fail to acquire the mutex unless it's recursive
 
 	std::deque<IVolumeListObserver*> _observers;
 	mutable CExecutionQueue          _notificationsQueue;
+#ifdef __linux__
+	std::thread                      _mountTableWatcherThread;
+	int                              _wakeUpPipe[2] = {-1, -1}; // Written to in order to stop the watcher thread
+#else
 	CPeriodicExecutionThread         _enumeratorThread;
+#endif
 	QTimer                           _timer;
 
 	static const unsigned int _updateInterval = 1000; // ms
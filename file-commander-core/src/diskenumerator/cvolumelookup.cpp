@@ -0,0 +1,111 @@
+#include "cvolumelookup.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDir>
+RESTORE_COMPILER_WARNINGS
+
+namespace {
+
+// Calls the functor with every non-empty component of the path in turn
+template <typename Functor>
+void forEachPathComponent(const QString& path, Functor&& functor)
+{
+	const QString posixPath = QDir::fromNativeSeparators(path);
+	for (int begin = 0; begin < posixPath.size();)
+	{
+		int end = posixPath.indexOf('/', begin);
+		if (end < 0)
+			end = posixPath.size();
+
+		if (end > begin)
+		{
+#ifdef _WIN32
+			// Drive letters and paths are case-insensitive
+			if (!functor(posixPath.mid(begin, end - begin).toLower()))
+				return;
+#else
+			if (!functor(posixPath.mid(begin, end - begin)))
+				return;
+#endif
+		}
+
+		begin = end + 1;
+	}
+}
+
+}
+
+void CVolumeLookup::setVolumes(const std::deque<VolumeInfo>& volumes)
+{
+	_volumes = volumes;
+	_trie.assign(1, TrieNode());
+	_volumeIndexByDevice.clear();
+
+	for (size_t i = 0; i < _volumes.size(); ++i)
+	{
+		VolumeInfo& volume = _volumes[i];
+
+		size_t node = 0;
+		forEachPathComponent(volume.rootObjectInfo.fullAbsolutePath(), [this, &node](const QString& component) {
+			const auto child = _trie[node].children.constFind(component);
+			if (child != _trie[node].children.constEnd())
+				node = child.value();
+			else
+			{
+				_trie.emplace_back();
+				_trie[node].children.insert(component, _trie.size() - 1);
+				node = _trie.size() - 1;
+			}
+
+			return true;
+		});
+
+		// If the same folder is listed twice, the first volume is the one that's found
+		if (_trie[node].volumeIndex == std::numeric_limits<size_t>::max())
+			_trie[node].volumeIndex = i;
+
+		if (volume.deviceId == std::numeric_limits<uint64_t>::max())
+			volume.deviceId = volume.rootObjectInfo.rootFileSystemId();
+		if (volume.deviceId != std::numeric_limits<uint64_t>::max())
+			_volumeIndexByDevice.emplace(volume.deviceId, i);
+	}
+}
+
+const std::deque<VolumeInfo>& CVolumeLookup::volumes() const
+{
+	return _volumes;
+}
+
+const VolumeInfo* CVolumeLookup::volumeForPath(const QString& path) const
+{
+	const size_t index = volumeIndexForPath(path);
+	return index < _volumes.size() ? &_volumes[index] : nullptr;
+}
+
+const VolumeInfo* CVolumeLookup::volumeForDevice(uint64_t deviceId) const
+{
+	const auto it = _volumeIndexByDevice.find(deviceId);
+	return it != _volumeIndexByDevice.end() ? &_volumes[it->second] : nullptr;
+}
+
+size_t CVolumeLookup::volumeIndexForPath(const QString& path) const
+{
+	if (_trie.empty())
+		return std::numeric_limits<size_t>::max();
+
+	size_t node = 0;
+	size_t deepestVolume = _trie[0].volumeIndex;
+	forEachPathComponent(path, [this, &node, &deepestVolume](const QString& component) {
+		const auto child = _trie[node].children.constFind(component);
+		if (child == _trie[node].children.constEnd())
+			return false;
+
+		node = child.value();
+		if (_trie[node].volumeIndex != std::numeric_limits<size_t>::max())
+			deepestVolume = _trie[node].volumeIndex;
+
+		return true;
+	});
+
+	return deepestVolume;
+}
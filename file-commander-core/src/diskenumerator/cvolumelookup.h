@@ -0,0 +1,43 @@
+#pragma once
+
+#include "volumeinfo.hpp"
+
+DISABLE_COMPILER_WARNINGS
+#include <QHash>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <deque>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+// A list of volumes indexed for finding the volume of a path or of a device without querying the file system.
+// The root folders of the volumes form a trie of path components, so looking a path up takes one hash lookup per component,
+// and the deepest mount point that contains the path wins.
+class CVolumeLookup
+{
+public:
+	// The device IDs that aren't known from the enumeration are queried here, once per volume
+	void setVolumes(const std::deque<VolumeInfo>& volumes);
+	const std::deque<VolumeInfo>& volumes() const;
+
+	// Both return nullptr if nothing is found. The path may be native or not, with or without the trailing slash.
+	const VolumeInfo* volumeForPath(const QString& path) const;
+	const VolumeInfo* volumeForDevice(uint64_t deviceId) const;
+
+	// The index of volumeForPath(path) in volumes(), or std::numeric_limits<size_t>::max()
+	size_t volumeIndexForPath(const QString& path) const;
+
+private:
+	struct TrieNode {
+		QHash<QString, size_t> children; // Indexes in _trie
+		size_t volumeIndex = std::numeric_limits<size_t>::max();
+	};
+
+	std::deque<VolumeInfo> _volumes;
+	std::vector<TrieNode> _trie; // The first node is the file system root
+	std::unordered_map<uint64_t, size_t> _volumeIndexByDevice;
+};
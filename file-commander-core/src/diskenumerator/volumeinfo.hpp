@@ -2,6 +2,7 @@
 
 #include "cfilesystemobject.h"
 
+#include <limits>
 #include <stdint.h>
 
 struct VolumeInfo
@@ -11,6 +12,8 @@ struct VolumeInfo
 	QString fileSystemName;
 	uint64_t volumeSize = 0;
 	uint64_t freeSize = 0;
+	// The ID of the device the root is on (st_dev), if it's known without querying the volume
+	uint64_t deviceId = std::numeric_limits<uint64_t>::max();
 	bool isReady = false;
 
 	inline bool operator==(const VolumeInfo& other) const {
@@ -19,7 +22,8 @@ struct VolumeInfo
 			volumeLabel == other.volumeLabel &&
 			fileSystemName == other.fileSystemName &&
 			volumeSize == other.volumeSize &&
-			freeSize == other.volumeSize &&
+			freeSize == other.freeSize &&
+			deviceId == other.deviceId &&
 			isReady == other.isReady;
 	}
 
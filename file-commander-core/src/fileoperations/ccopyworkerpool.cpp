@@ -0,0 +1,104 @@
+#include "ccopyworkerpool.h"
+#include "threading/thread_helpers.h"
+
+#include <algorithm>
+
+CCopyWorkerPool::CCopyWorkerPool(size_t numWorkers, size_t maxWorkersPerDevice, JobHandler handler) :
+	_handler(std::move(handler)),
+	_maxWorkersPerDevice(std::max(maxWorkersPerDevice, (size_t)1)),
+	_maxQueueLength(std::max(numWorkers, (size_t)1) * 64)
+{
+	for (size_t i = 0; i < std::max(numWorkers, (size_t)1); ++i)
+		_workers.emplace_back(&CCopyWorkerPool::workerFunc, this);
+}
+
+CCopyWorkerPool::~CCopyWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_terminate = true;
+		_queue.clear();
+	}
+
+	_jobsChanged.notify_all();
+
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+void CCopyWorkerPool::enqueue(const Job& job)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (_queue.size() >= _maxQueueLength && !_terminate)
+		_jobsChanged.wait(lock);
+
+	_queue.push_back(job);
+	lock.unlock();
+
+	_jobsChanged.notify_all();
+}
+
+void CCopyWorkerPool::waitUntilIdle()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_queue.empty() || _numJobsRunning > 0)
+		_jobsChanged.wait(lock);
+}
+
+std::vector<std::pair<size_t, CCopyWorkerPool::JobResult>> CCopyWorkerPool::takeItemsRequiringAttention()
+{
+	std::vector<std::pair<size_t, JobResult>> items;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		items.swap(_itemsRequiringAttention);
+	}
+
+	std::sort(items.begin(), items.end());
+	return items;
+}
+
+void CCopyWorkerPool::workerFunc()
+{
+	setThreadName("CCopyWorkerPool thread");
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;)
+	{
+		auto job = nextStartableJob();
+		while (!_terminate && job == _queue.end())
+		{
+			_jobsChanged.wait(lock);
+			job = nextStartableJob();
+		}
+
+		if (_terminate)
+			return;
+
+		const Job currentJob = *job;
+		_queue.erase(job);
+		++_numJobsRunning;
+		++_runningJobsPerDevice[currentJob.destDeviceId];
+		lock.unlock();
+
+		// The queue now has room for one more job
+		_jobsChanged.notify_all();
+		const JobResult result = _handler(currentJob);
+
+		lock.lock();
+		--_numJobsRunning;
+		--_runningJobsPerDevice[currentJob.destDeviceId];
+		if (result != jrDone)
+			_itemsRequiringAttention.emplace_back(currentJob.itemIndex, result);
+
+		_jobsChanged.notify_all();
+	}
+}
+
+std::deque<CCopyWorkerPool::Job>::iterator CCopyWorkerPool::nextStartableJob()
+{
+	return std::find_if(_queue.begin(), _queue.end(), [this](const Job& job) {
+		const auto runningJobs = _runningJobsPerDevice.find(job.destDeviceId);
+		return runningJobs == _runningJobsPerDevice.end() || runningJobs->second < _maxWorkersPerDevice;
+	});
+}
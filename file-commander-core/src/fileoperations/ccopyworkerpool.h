@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cfilesystemobject.h"
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A bounded pool of threads that copies individual items of the flattened source list on behalf of COperationPerformer.
+// Jobs are started in FIFO order, except that no more than maxWorkersPerDevice jobs writing to the same destination device may run at once.
+class CCopyWorkerPool
+{
+public:
+	struct Job {
+		size_t itemIndex; // Index into COperationPerformer::_source
+		CFileSystemObject item; // A copy of _source[itemIndex], since _source keeps growing while the source tree is being enumerated
+		QString destFolder; // With the trailing slash
+		uint64_t destDeviceId;
+	};
+
+	enum JobResult {
+		jrDone,
+		jrCopyRequiresAttention,  // The item has not been copied and must be processed by the operation thread (e. g. the target exists)
+		jrDeleteRequiresAttention // The item has been copied, but the source could not be deleted after moving
+	};
+
+	using JobHandler = std::function<JobResult (const Job&)>;
+
+	CCopyWorkerPool(size_t numWorkers, size_t maxWorkersPerDevice, JobHandler handler);
+	// Discards the jobs that haven't been started and waits for the running ones to finish
+	~CCopyWorkerPool();
+
+	// Blocks while the queue is full
+	void enqueue(const Job& job);
+	// Blocks until every job enqueued so far has been processed
+	void waitUntilIdle();
+	// Returns (and forgets) the items that the workers couldn't process on their own, in the order of their indices
+	std::vector<std::pair<size_t /* item index */, JobResult>> takeItemsRequiringAttention();
+
+private:
+	void workerFunc();
+	// Must be called with _mutex locked
+	std::deque<Job>::iterator nextStartableJob();
+
+private:
+	const JobHandler _handler;
+	const size_t _maxWorkersPerDevice;
+	const size_t _maxQueueLength;
+
+	std::vector<std::thread> _workers;
+	std::deque<Job> _queue;
+	std::map<uint64_t /* device ID */, size_t /* running jobs */> _runningJobsPerDevice;
+	size_t _numJobsRunning = 0;
+	std::vector<std::pair<size_t, JobResult>> _itemsRequiringAttention;
+	bool _terminate = false;
+
+	std::mutex _mutex;
+	std::condition_variable _jobsChanged;
+};
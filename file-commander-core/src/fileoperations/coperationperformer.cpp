@@ -1,8 +1,29 @@
 #include "coperationperformer.h"
 #include "filesystemhelperfunctions.h"
 #include "directoryscanner.h"
+#include "cparalleldeleter.h"
 #include "threading/thread_helpers.h"
 
+#include <errno.h>
+#include <set>
+#include <string.h>
+
+// Files that fit into a single chunk are considered small and can be handed over to the copy workers
+static const size_t copyChunkSize = 5 * 1024 * 1024;
+
+// The ID of the device that the path is on, or will be on once created
+inline uint64_t deviceIdForPath(const QString& path)
+{
+	for (const auto& pathItem : CFileSystemObject::pathHierarchy(path))
+	{
+		const CFileSystemObject object(pathItem);
+		if (object.exists())
+			return object.rootFileSystemId();
+	}
+
+	return std::numeric_limits<uint64_t>::max();
+}
+
 COperationPerformer::COperationPerformer(Operation operation, const std::vector<CFileSystemObject>& source, QString destination) :
 	_source(source),
 	_destFileSystemObject(destination),
@@ -16,6 +37,9 @@ COperationPerformer::~COperationPerformer()
 
 	if (_thread.joinable())
 		_thread.join();
+
+	if (_enumerationThread.joinable())
+		_enumerationThread.join();
 }
 
 void COperationPerformer::setWatcher(CFileOperationObserver *watcher)
@@ -24,6 +48,13 @@ void COperationPerformer::setWatcher(CFileOperationObserver *watcher)
 	_observer = watcher;
 }
 
+void COperationPerformer::setParallelCopying(size_t numWorkers, size_t maxWorkersPerDevice)
+{
+	assert_r(!_thread.joinable());
+	_numCopyWorkers = std::max(numWorkers, (size_t)1);
+	_maxCopyWorkersPerDevice = std::max(std::min(maxWorkersPerDevice, _numCopyWorkers), (size_t)1);
+}
+
 bool COperationPerformer::togglePause()
 {
 	_paused = !_paused;
@@ -66,6 +97,7 @@ void COperationPerformer::start()
 void COperationPerformer::cancel()
 {
 	_cancelRequested = true;
+	_stopEnumeration = true;
 }
 
 void COperationPerformer::threadFunc()
@@ -81,7 +113,10 @@ void COperationPerformer::threadFunc()
 		copyFiles();
 		break;
 	case operationDelete:
-		deleteFiles();
+		if (CParallelDeleter::supported())
+			deleteFilesInParallel();
+		else
+			deleteFiles();
 		break;
 	default:
 		assert_unconditional_r("Uknown operation");
@@ -93,9 +128,11 @@ void COperationPerformer::waitForResponse()
 {
 	std::unique_lock<std::mutex> lock(_waitForResponseMutex);
 	_totalTimeElapsed.pause();
+	_waitingForUserResponse = true;
 	while (_userResponse == urNone)
 		_waitForResponseCondition.wait(lock);
 
+	_waitingForUserResponse = false;
 	_totalTimeElapsed.resume();
 }
 
@@ -172,33 +209,44 @@ void COperationPerformer::copyFiles()
 		return;
 	}
 
-	uint64_t totalSize = 0, sizeProcessed = 0;
-	const auto destination = flattenSourcesAndCalcDest(totalSize);
-	assert_r(destination.size() == _source.size());
-
+	// Copying starts as soon as the first items are found instead of waiting for the whole source tree to be enumerated
+	_sizeProcessed = 0;
+	_totalSize = 0;
+	_numItemsEnumerated = 0;
+	_enumerationComplete = false;
+	std::vector<CFileSystemObject> roots;
+	roots.swap(_source);
+	_enumerationThread = std::thread(&COperationPerformer::flattenSourcesAndCalcDest, this, std::move(roots));
+
+	if (_numCopyWorkers > 1)
+		_copyWorkers = std::make_unique<CCopyWorkerPool>(_numCopyWorkers, _maxCopyWorkersPerDevice, [this](const CCopyWorkerPool::Job& job) {
+			return transferFileOnWorkerThread(job);
+		});
+
+	std::map<QString, uint64_t> deviceIdForDestFolder;
 	std::vector<CFileSystemObject> dirsToCleanUp;
 
 	_totalTimeElapsed.start();
 
-	for (auto sourceIterator = _source.begin(); sourceIterator != _source.end() && !_cancelRequested; _userResponse = urNone /* needed for normal operation of condition variable */)
+	CFileSystemObject sourceItem;
+	QDir destDir;
+	for (currentItemIndex = 0; !_cancelRequested && waitForSourceItem(currentItemIndex, sourceItem, destDir); _userResponse = urNone /* needed for normal operation of condition variable */)
 	{
-		if (sourceIterator->isCdUp())
+		if (sourceItem.isCdUp())
 		{
-			++sourceIterator;
 			++currentItemIndex;
 			continue;
 		}
 
-		qInfo() << __FUNCTION__ << "Processing" << (sourceIterator->isFile() ? "file" : "DIR ") << sourceIterator->fullAbsolutePath();
-		if (_observer) _observer->onCurrentFileChangedCallback(sourceIterator->fullName());
+		qInfo() << __FUNCTION__ << "Processing" << (sourceItem.isFile() ? "file" : "DIR ") << sourceItem.fullAbsolutePath();
+		if (_observer) _observer->onCurrentFileChangedCallback(sourceItem.fullName());
 
-		const QFileInfo& sourceFileInfo = sourceIterator->qFileInfo();
+		const QFileInfo& sourceFileInfo = sourceItem.qFileInfo();
 		if (!sourceFileInfo.exists())
 		{
-			const auto response = getUserResponse(hrFileDoesntExit, *sourceIterator, CFileSystemObject(), QString());
+			const auto response = getUserResponse(hrFileDoesntExit, sourceItem, CFileSystemObject(), QString());
 			if (response == urSkipThis || response == urSkipAll)
 			{
-				++sourceIterator;
 				++currentItemIndex;
 				continue;
 			}
@@ -211,27 +259,37 @@ void COperationPerformer::copyFiles()
 				assert_unconditional_r("Unknown response");
 		}
 
-		QFileInfo destInfo(destination[currentItemIndex].absoluteFilePath(_newName.isEmpty() ? sourceIterator->fullName() : _newName));
+		QFileInfo destInfo(destDir.absoluteFilePath(_newName.isEmpty() ? sourceItem.fullName() : _newName));
 		_newName.clear();
 		if (destInfo.absoluteFilePath() == sourceFileInfo.absoluteFilePath())
 		{
-			++sourceIterator;
 			++currentItemIndex;
 			continue;
 		}
 
-		if (sourceIterator->isFile())
+		if (sourceItem.isFile())
 		{
-			NextAction nextAction;
-			while ((nextAction = copyItem(*sourceIterator, destInfo, destination[currentItemIndex], sizeProcessed, totalSize, currentItemIndex)) == naRetryOperation);
+			if (_copyWorkers && sourceItem.size() <= copyChunkSize && destInfo.fileName() == sourceItem.fullName())
+			{
+				const QString destFolder = destDir.absolutePath() + '/';
+				auto deviceId = deviceIdForDestFolder.find(destFolder);
+				if (deviceId == deviceIdForDestFolder.end())
+					deviceId = deviceIdForDestFolder.emplace(destFolder, deviceIdForPath(destFolder)).first;
+
+				_copyWorkers->enqueue({currentItemIndex, sourceItem, destFolder, deviceId->second});
+
+				++currentItemIndex;
+				continue;
+			}
+
+			const NextAction nextAction = transferFile(sourceItem, destInfo, destDir, currentItemIndex);
 			switch (nextAction)
 			{
 			case naProceed:
 				break;
 			case naSkip:
-				++sourceIterator;
+				_sizeProcessed += sourceItem.size();
 				++currentItemIndex;
-				sizeProcessed += sourceIterator->size();
 				continue;
 			case naRetryItem:
 				continue;
@@ -240,35 +298,11 @@ void COperationPerformer::copyFiles()
 				finalize();
 				return;
 			default:
-				assert_unconditional_r(QString("Unexpected deleteItem() return value %1").arg(nextAction).toUtf8().constData());
+				assert_unconditional_r(QString("Unexpected transferFile() return value %1").arg(nextAction).toUtf8().constData());
 				continue; // Retry
 			}
-
-			if (_op == operationMove) // result == ok
-			{
-				while ((nextAction = deleteItem(*sourceIterator)) == naRetryOperation);
-
-				switch (nextAction)
-				{
-				case naProceed:
-					break;
-				case naSkip:
-					++sourceIterator;
-					++currentItemIndex;
-					continue;
-				case naRetryItem:
-					continue;
-				case naAbort:
-					finalize();
-					return;
-				default:
-					qInfo() << QString("Unexpected deleteItem() return value %1").arg(nextAction);
-					assert_unconditional_r("Unexpected deleteItem() return value");
-					continue; // Retry
-				}
-			}
 		}
-		else if (sourceIterator->isDir())
+		else if (sourceItem.isDir())
 		{
 			// Creating the folder - empty folders will not be copied without this code
 			CFileSystemObject destObject(destInfo);
@@ -281,7 +315,6 @@ void COperationPerformer::copyFiles()
 				else if (nextAction == naSkip)
 				{
 					++currentItemIndex;
-					++sourceIterator;
 					continue;
 				}
 				else if (nextAction == naRetryOperation)
@@ -295,15 +328,14 @@ void COperationPerformer::copyFiles()
 
 			if (_op == operationMove)
 			{
-				if (sourceIterator->isEmptyDir())
+				if (sourceItem.isEmptyDir())
 				{
-					const auto result = sourceIterator->remove();
+					const auto result = sourceItem.remove();
 					if (result != rcOk)
 					{
-						const auto action = getUserResponse(hrFailedToDelete, *sourceIterator, CFileSystemObject(), sourceIterator->lastErrorMessage());
+						const auto action = getUserResponse(hrFailedToDelete, sourceItem, CFileSystemObject(), sourceItem.lastErrorMessage());
 						if (action == urSkipThis || action == urSkipAll)
 						{
-							++sourceIterator;
 							++currentItemIndex;
 							continue;
 						}
@@ -322,16 +354,46 @@ void COperationPerformer::copyFiles()
 					}
 				}
 				else // not empty
-					dirsToCleanUp.push_back(*sourceIterator);
+					dirsToCleanUp.push_back(sourceItem);
 			}
 		}
 
-		sizeProcessed += sourceIterator->size();
+		_sizeProcessed += sourceItem.size();
 
-		++sourceIterator;
 		++currentItemIndex;
 	}
 
+	// Either the enumeration is complete or the operation has been canceled, in which case the enumeration thread is about to quit
+	if (_enumerationThread.joinable())
+		_enumerationThread.join();
+
+	if (_copyWorkers)
+	{
+		// Whatever the workers couldn't handle on their own is processed here, where the user can be asked for a decision
+		_copyWorkers->waitUntilIdle();
+		const auto itemsRequiringAttention = _copyWorkers->takeItemsRequiringAttention();
+		for (size_t i = 0; i < itemsRequiringAttention.size() && !_cancelRequested; _userResponse = urNone /* needed for normal operation of condition variable */)
+		{
+			const size_t itemIndex = itemsRequiringAttention[i].first;
+			CFileSystemObject& item = _source[itemIndex];
+			if (_observer) _observer->onCurrentFileChangedCallback(item.fullName());
+
+			const QFileInfo destInfo(_destinations[itemIndex].absoluteFilePath(item.fullName()));
+			const NextAction nextAction = transferFile(item, destInfo, _destinations[itemIndex], itemIndex, itemsRequiringAttention[i].second == CCopyWorkerPool::jrDeleteRequiresAttention);
+			_newName.clear();
+			if (nextAction == naRetryItem)
+				continue;
+			else if (nextAction == naAbort || nextAction == naRetryOperation)
+			{
+				finalize();
+				return;
+			}
+
+			_sizeProcessed += item.size();
+			++i;
+		}
+	}
+
 	for (auto& dir: dirsToCleanUp)
 		dir.remove();
 
@@ -350,8 +412,9 @@ void COperationPerformer::deleteFiles()
 	{
 		if (!it->isCdUp())
 		{
-			scanDirectory(*it, [&fileSystemObjectsList](const CFileSystemObject& item) {
-				fileSystemObjectsList.emplace_back(item);
+			// Any order will do, every folder is still listed before its contents
+			scanDirectory(*it, [&fileSystemObjectsList](const std::vector<CFileSystemObject>& batch) {
+				fileSystemObjectsList.insert(fileSystemObjectsList.end(), batch.begin(), batch.end());
 			});
 		}
 	}
@@ -482,8 +545,109 @@ void COperationPerformer::deleteFiles()
 	finalize();
 }
 
+void COperationPerformer::deleteFilesInParallel()
+{
+	_inProgress = true;
+
+	std::vector<std::string> roots;
+	for (const auto& item: _source)
+	{
+		if (!item.isCdUp())
+			roots.emplace_back(QFile::encodeName(item.fullAbsolutePath()).constData());
+	}
+
+	CParallelDeleter deleter(std::max(std::thread::hardware_concurrency(), 4u));
+
+	// Counting the items first so that the progress can be reported as before. This walk doesn't stat() anything and is cheap compared to the deletion.
+	deleter.startCounting(roots);
+	while (!deleter.waitUntilFinished(std::chrono::milliseconds(100)) && !_cancelRequested);
+
+	const uint64_t totalNumberOfObjects = deleter.numItemsProcessed();
+	qInfo() << __FUNCTION__ << "deleting" << totalNumberOfObjects << "items";
+
+	_totalTimeElapsed.start();
+	if (!_cancelRequested)
+		deleter.startDeleting(roots);
+
+	uint64_t numItemsDeletedHere = 0; // The items that the deleter failed to delete and that have been deleted by this thread after all
+	std::set<std::string> foldersKeptByTheUser; // Contain the items the user has chosen to skip, so they can't be removed and there's no point in asking about them
+	for (bool finished = false; !finished && !_cancelRequested;)
+	{
+		finished = deleter.waitUntilFinished(std::chrono::milliseconds(100));
+
+		if (_paused)
+		{
+			deleter.setHeldOff(true);
+			handlePause();
+			deleter.setHeldOff(false);
+		}
+
+		// The failures are handled here in the usual way, which may involve asking the user. The deleter is held off meanwhile.
+		auto failures = deleter.takeFailures();
+		if (!failures.empty())
+		{
+			deleter.setHeldOff(true);
+			for (const auto& failure: failures)
+			{
+				const std::string parentFolder = failure.path.substr(0, failure.path.rfind('/'));
+				if (failure.errorCode == ENOTEMPTY && foldersKeptByTheUser.count(failure.path) != 0)
+				{
+					foldersKeptByTheUser.insert(parentFolder);
+					continue;
+				}
+
+				CFileSystemObject item(QFile::decodeName(failure.path.c_str()));
+				// The item may have been deleted in the meantime
+				if (!item.exists())
+					continue;
+
+				qInfo() << __FUNCTION__ << "failed to delete" << item.fullAbsolutePath() << ", error:" << strerror(failure.errorCode);
+				if (_observer) _observer->onCurrentFileChangedCallback(item.fullName());
+
+				NextAction nextAction;
+				while ((nextAction = deleteItem(item)) == naRetryOperation);
+				_userResponse = urNone;
+
+				if (nextAction == naAbort)
+				{
+					deleter.stop();
+					finalize();
+					return;
+				}
+				else if (nextAction == naProceed)
+					++numItemsDeletedHere;
+				else if (nextAction == naSkip)
+					foldersKeptByTheUser.insert(parentFolder);
+			}
+
+			// No need to hand the read-only files back anymore
+			const auto readOnlyResponse = _globalResponses.find(hrSourceFileIsReadOnly);
+			deleter.setReadOnlyFilesAllowed(readOnlyResponse != _globalResponses.end() && readOnlyResponse->second == urProceedWithAll);
+			deleter.setHeldOff(false);
+		}
+
+		const uint64_t numItemsDeleted = std::min(deleter.numItemsProcessed() + numItemsDeletedHere, std::max(totalNumberOfObjects, (uint64_t)1));
+		const uint64_t speed = numItemsDeleted * 1000000 / std::max(_totalTimeElapsed.elapsed<std::chrono::microseconds>(), (uint64_t)1);
+		const uint32_t secondsRemaining = speed > 0 ? (uint32_t) ((totalNumberOfObjects - numItemsDeleted) / speed) : 0;
+		if (_observer)
+		{
+			_observer->onCurrentFileChangedCallback(QFile::decodeName(deleter.currentFolder().c_str()));
+			_observer->onProgressChangedCallback(numItemsDeleted * 100.0f / std::max(totalNumberOfObjects, (uint64_t)1), numItemsDeleted, totalNumberOfObjects, 0, speed, secondsRemaining);
+		}
+	}
+
+	deleter.stop();
+	qInfo() << __FUNCTION__ << "took" << _totalTimeElapsed.elapsed() << "ms";
+	finalize();
+}
+
 void COperationPerformer::finalize()
 {
+	stopEnumeration();
+
+	// Discards the copy jobs that haven't been started yet and waits for the rest to finish
+	_copyWorkers.reset();
+
 	_done = true;
 	_paused   = false;
 	if (_observer) _observer->onProcessFinishedCallback();
@@ -509,44 +673,84 @@ inline QDir destinationFolder(const QString &absoluteSourcePath, const QString &
 	return CFileSystemObject(destPath % '/' % localPath).parentDirPath();
 }
 
-// Iterates over all dirs in the source vector, and their subdirs, and so on and replaces _sources with a flat list of files. Returns a list of destination folders where each of the files must be copied to according to _dest
+// Executed by _enumerationThread. Iterates over all the roots, and their subdirs, and so on, and appends each file to _source as soon as it's found, along with its destination folder (according to _dest) to _destinations
 // Also counts the total size of all the files to monitor progress
 
 // TODO: refactor to a separate algorithm that iterates recursively over subdirs.
 // Then I would no longer need to calculate the total size of all files in the same method just to avoid code duplication.
-std::vector<QDir> COperationPerformer::flattenSourcesAndCalcDest(uint64_t &totalSize)
+void COperationPerformer::flattenSourcesAndCalcDest(const std::vector<CFileSystemObject>& roots)
 {
-	totalSize = 0;
-	std::vector<CFileSystemObject> newSourceVector;
-	std::vector<QDir> destinations;
-	const bool destIsFileName = _source.size() == 1 && !_destFileSystemObject.isDir();
-	for (auto& o: _source)
+	setThreadName("COperationPerformer enumeration thread");
+
+	const auto appendItem = [this](const CFileSystemObject& item, QDir&& destination) {
+		if (item.isFile())
+			_totalSize += item.size();
+
+		{
+			std::lock_guard<std::mutex> lock(_sourceMutex);
+			_source.push_back(item);
+			_destinations.emplace_back(std::move(destination));
+			_numItemsEnumerated = _source.size();
+		}
+
+		_sourceItemsAvailable.notify_all();
+	};
+
+	const bool destIsFileName = roots.size() == 1 && !_destFileSystemObject.isDir();
+	for (auto& o: roots)
 	{
+		if (_stopEnumeration)
+			break;
+
 		if (o.isFile())
 		{
-			totalSize += o.size();
 			// Ignoring the new file name here if it was supplied. We're only calculating dest dir here, not the file name
-			destinations.emplace_back(destinationFolder(o.fullAbsolutePath(), o.parentDirPath(), destIsFileName ? _destFileSystemObject.parentDirPath() : _destFileSystemObject.fullAbsolutePath(), false));
-			newSourceVector.push_back(o);
+			appendItem(o, destinationFolder(o.fullAbsolutePath(), o.parentDirPath(), destIsFileName ? _destFileSystemObject.parentDirPath() : _destFileSystemObject.fullAbsolutePath(), false));
 		}
 		else if (o.isDir())
 		{
-			scanDirectory(o, [&](const CFileSystemObject& item) {
-				if (item.isFile())
+			scanDirectory(o, [&](const std::vector<CFileSystemObject>& batch) {
+				for (const CFileSystemObject& item: batch)
 				{
-					totalSize += item.size();
-					destinations.emplace_back(destinationFolder(item.fullAbsolutePath(), o.parentDirPath(), _destFileSystemObject.fullAbsolutePath(), item.isDir() /* TODO: 'false' ? */)); 
-					newSourceVector.push_back(item);
+					if (item.isFile())
+						appendItem(item, destinationFolder(item.fullAbsolutePath(), o.parentDirPath(), _destFileSystemObject.fullAbsolutePath(), item.isDir() /* TODO: 'false' ? */));
 				}
-			});
+			}, _stopEnumeration, soDeterministic);
 
-			destinations.emplace_back(destinationFolder(o.fullAbsolutePath(), o.parentDirPath(), _destFileSystemObject.fullAbsolutePath(), true));
-			newSourceVector.push_back(o);
+			// The folder itself must follow its contents so that it can be removed after moving
+			if (!_stopEnumeration)
+				appendItem(o, destinationFolder(o.fullAbsolutePath(), o.parentDirPath(), _destFileSystemObject.fullAbsolutePath(), true));
 		}
 	};
 
-	_source = newSourceVector;
-	return destinations;
+	{
+		std::lock_guard<std::mutex> lock(_sourceMutex);
+		_enumerationComplete = true;
+	}
+
+	_sourceItemsAvailable.notify_all();
+	qInfo() << __FUNCTION__ << (_stopEnumeration ? "stopped," : "done,") << _numItemsEnumerated << "items," << _totalSize << "bytes";
+}
+
+bool COperationPerformer::waitForSourceItem(size_t index, CFileSystemObject& item, QDir& destination)
+{
+	std::unique_lock<std::mutex> lock(_sourceMutex);
+	while (index >= _source.size() && !_enumerationComplete)
+		_sourceItemsAvailable.wait(lock);
+
+	if (index >= _source.size())
+		return false;
+
+	item = _source[index];
+	destination = _destinations[index];
+	return true;
+}
+
+void COperationPerformer::stopEnumeration()
+{
+	_stopEnumeration = true;
+	if (_enumerationThread.joinable())
+		_enumerationThread.join();
 }
 
 UserResponse COperationPerformer::getUserResponse(HaltReason hr, const CFileSystemObject& src, const CFileSystemObject& dst, const QString& message)
@@ -627,7 +831,7 @@ COperationPerformer::NextAction COperationPerformer::makeItemWriteable(CFileSyst
 	return naProceed;
 }
 
-COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, uint64_t sizeProcessedPreviously, uint64_t totalSize, size_t currentItemIndex)
+COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, uint64_t sizeProcessedPreviously, size_t currentItemIndex)
 {
 	if (!item.isFile())
 		return naProceed;
@@ -682,7 +886,6 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 			return nextAction;
 	}
 
-	const int chunkSize = 5 * 1024 * 1024;
 	const QString destPath = destDir.absolutePath() + '/';
 	FileOperationResultCode result = rcFail;
 
@@ -690,18 +893,13 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 	{
 		handlePause();
 
-		result = item.copyChunk(chunkSize, destPath, _newName.isEmpty() ? (!destFile.isDir() ? destFile.fullName() : QString()) : _newName);
+		result = item.copyChunk(copyChunkSize, destPath, _newName.isEmpty() ? (!destFile.isDir() ? destFile.fullName() : QString()) : _newName);
 		// Error handling
 		if (result != rcOk)
 			break;
 
-		const auto actualSizeProcessed = sizeProcessedPreviously + item.bytesCopied();
-		const float totalPercentage = totalSize > 0 ? actualSizeProcessed * 100.0f / totalSize : 0.0f; // Bytes
 		const float filePercentage = item.size() > 0 ? item.bytesCopied() * 100.0f / item.size() : 0.0f;
-
-		const uint64_t meanSpeed = uint64_t(totalPercentage / 100.0f * actualSizeProcessed * 1e6f) / std::max(_totalTimeElapsed.elapsed<std::chrono::microseconds>(), (uint64_t)1); // Bytes / sec
-		const uint32_t secondsRemaining = (uint32_t)((100.0f - totalPercentage) / 100.0f * totalSize / meanSpeed);
-		if (_observer) _observer->onProgressChangedCallback(totalPercentage, currentItemIndex, _source.size(), filePercentage, meanSpeed, secondsRemaining);
+		reportProgress(sizeProcessedPreviously + item.bytesCopied(), currentItemIndex, filePercentage);
 
 		// TODO: why isn't this block at the start of 'do-while'?
 		if (_cancelRequested)
@@ -733,6 +931,22 @@ COperationPerformer::NextAction COperationPerformer::copyItem(CFileSystemObject&
 	return naProceed;
 }
 
+COperationPerformer::NextAction COperationPerformer::transferFile(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, size_t currentItemIndex, bool alreadyCopied)
+{
+	NextAction nextAction = naProceed;
+	if (!alreadyCopied)
+	{
+		while ((nextAction = copyItem(item, destInfo, destDir, _sizeProcessed, currentItemIndex)) == naRetryOperation);
+		if (nextAction != naProceed)
+			return nextAction;
+	}
+
+	if (_op == operationMove)
+		while ((nextAction = deleteItem(item)) == naRetryOperation);
+
+	return nextAction;
+}
+
 COperationPerformer::NextAction COperationPerformer::mkPath(const QDir& dir)
 {
 	if (dir.mkpath(".") || dir.exists())
@@ -752,6 +966,55 @@ COperationPerformer::NextAction COperationPerformer::mkPath(const QDir& dir)
 	}
 }
 
+CCopyWorkerPool::JobResult COperationPerformer::transferFileOnWorkerThread(const CCopyWorkerPool::Job& job)
+{
+	// The workers hold off while the operation is paused or waiting for the user's decision about another item
+	while ((_paused || _waitingForUserResponse) && !_cancelRequested)
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	if (_cancelRequested)
+		return CCopyWorkerPool::jrDone;
+
+	// Working on a copy since the copying state is stored in the object
+	CFileSystemObject item = job.item;
+	if (QFileInfo::exists(job.destFolder + item.fullName()))
+		return CCopyWorkerPool::jrCopyRequiresAttention;
+	else if (!QFileInfo::exists(job.destFolder) && !QDir().mkpath(job.destFolder))
+		return CCopyWorkerPool::jrCopyRequiresAttention;
+
+	do
+	{
+		if (item.copyChunk(copyChunkSize, job.destFolder) != rcOk)
+		{
+			item.cancelCopy();
+			return CCopyWorkerPool::jrCopyRequiresAttention;
+		}
+		else if (_cancelRequested)
+		{
+			item.cancelCopy();
+			return CCopyWorkerPool::jrDone;
+		}
+	} while (item.copyOperationInProgress());
+
+	if (_op == operationMove && (!item.isWriteable() || item.remove() != rcOk))
+		return CCopyWorkerPool::jrDeleteRequiresAttention;
+
+	reportProgress(_sizeProcessed += item.size(), job.itemIndex, 100.0f);
+	return CCopyWorkerPool::jrDone;
+}
+
+void COperationPerformer::reportProgress(uint64_t sizeProcessed, size_t currentItemIndex, float filePercentage)
+{
+	// Until the enumeration is complete, the totals only account for the items found so far
+	const bool totalsEstimated = !_enumerationComplete;
+	const uint64_t totalSize = _totalSize;
+	const float totalPercentage = totalSize > 0 ? std::min(sizeProcessed * 100.0f / totalSize, 100.0f) : 0.0f; // Bytes
+
+	const uint64_t meanSpeed = uint64_t(totalPercentage / 100.0f * sizeProcessed * 1e6f) / std::max(_totalTimeElapsed.elapsed<std::chrono::microseconds>(), (uint64_t)1); // Bytes / sec
+	const uint32_t secondsRemaining = meanSpeed > 0 && !totalsEstimated ? (uint32_t)((100.0f - totalPercentage) / 100.0f * totalSize / meanSpeed) : 0;
+	if (_observer) _observer->onProgressChangedCallback(totalPercentage, currentItemIndex, _numItemsEnumerated, filePercentage, meanSpeed, secondsRemaining, totalsEstimated);
+}
+
 void COperationPerformer::handlePause()
 {
 	if (_paused) // This code is not strictly thread-safe (the value of _paused may change between 'if' and 'while'), but in this context I'm OK with that
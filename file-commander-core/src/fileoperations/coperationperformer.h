@@ -1,6 +1,7 @@
 #pragma once
 
 #include "operationcodes.h"
+#include "ccopyworkerpool.h"
 #include "cfilesystemobject.h"
 #include "system/ctimeelapsed.h"
 #include "assert/advanced_assert.h"
@@ -9,6 +10,7 @@
 #include <condition_variable>
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -23,7 +25,8 @@ friend class COperationPerformer;
 public:
 	CFileOperationObserver() {}
 
-	virtual void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining) = 0;
+	// totalsEstimated is true while the source tree is still being enumerated: totalNumFiles and totalPercentage are based on the items found so far, and secondsRemaining is unknown (0)
+	virtual void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining, bool totalsEstimated) = 0;
 	virtual void onProcessHalted(HaltReason reason, CFileSystemObject source, CFileSystemObject dest, QString errorMessage) = 0; // User decision required (file exists, file is read-only etc.)
 	virtual void onProcessFinished(QString message = QString()) = 0; // Done or canceled
 	virtual void onCurrentFileChanged(QString file) = 0; // Starting to process a new file
@@ -33,11 +36,11 @@ public:
 	inline std::mutex& callbackMutex() { return _callbackMutex; }
 
 private:
-	inline void onProgressChangedCallback(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining) {
+	inline void onProgressChangedCallback(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining, bool totalsEstimated = false) {
 		assert_r(filePercentage < 100.5f && totalPercentage < 100.5f);
 		std::lock_guard<std::mutex> lock(_callbackMutex);
 		_callbacks.emplace_back([=]() {
-			onProgressChanged(totalPercentage, numFilesProcessed, totalNumFiles, filePercentage, speed, secondsRemaining);
+			onProgressChanged(totalPercentage, numFilesProcessed, totalNumFiles, filePercentage, speed, secondsRemaining, totalsEstimated);
 		});
 	}
 
@@ -92,6 +95,9 @@ public:
 	~COperationPerformer();
 
 	void setWatcher(CFileOperationObserver *watcher);
+	// Small files will be copied by a pool of numWorkers threads, no more than maxWorkersPerDevice of which may write to the same destination device at once.
+	// A single worker (the default) means sequential copying on the operation thread. Must be called before start().
+	void setParallelCopying(size_t numWorkers, size_t maxWorkersPerDevice);
 
 	bool togglePause();
 	bool paused()  const;
@@ -111,12 +117,17 @@ private:
 
 	void copyFiles();
 	void deleteFiles();
+	// Same as deleteFiles, but the trees are walked and deleted by CParallelDeleter. Only the items it fails to delete go through deleteItem().
+	void deleteFilesInParallel();
 
 	void finalize();
 
-	// Iterates over all dirs in the source vector, and their subdirs, and so on and replaces _sources with a flat list of files. Returns a list of destination folders where each of the files must be copied to according to _dest
+	// Executed by _enumerationThread. Iterates over all the roots, and their subdirs, and so on, and appends each file to _source as soon as it's found, along with its destination folder (according to _dest) to _destinations
 	// Also counts the total size of all the files to monitor progress
-	std::vector<QDir> flattenSourcesAndCalcDest(uint64_t& totalSize);
+	void flattenSourcesAndCalcDest(const std::vector<CFileSystemObject>& roots);
+	// Blocks until the item number 'index' has been enumerated. Returns false if there's no such item (the enumeration is complete or has been stopped).
+	bool waitForSourceItem(size_t index, CFileSystemObject& item, QDir& destination);
+	void stopEnumeration();
 
 	UserResponse getUserResponse(HaltReason hr, const CFileSystemObject& src, const CFileSystemObject& dst, const QString& message);
 
@@ -124,9 +135,15 @@ private:
 	enum NextAction {naProceed, naRetryItem, naRetryOperation, naSkip, naAbort};
 	NextAction deleteItem(CFileSystemObject& item);
 	NextAction makeItemWriteable(CFileSystemObject& item);
-	NextAction copyItem(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, uint64_t sizeProcessedPreviously, uint64_t totalSize, size_t currentItemIndex);
+	NextAction copyItem(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, uint64_t sizeProcessedPreviously, size_t currentItemIndex);
+	// Copies a file and, for the move operation, deletes the source
+	NextAction transferFile(CFileSystemObject& item, const QFileInfo& destInfo, const QDir& destDir, size_t currentItemIndex, bool alreadyCopied = false);
 	NextAction mkPath(const QDir& dir);
 
+	// Executed by _copyWorkers. Never asks the user: anything that needs a decision is returned to the operation thread.
+	CCopyWorkerPool::JobResult transferFileOnWorkerThread(const CCopyWorkerPool::Job& job);
+
+	void reportProgress(uint64_t sizeProcessed, size_t currentItemIndex, float filePercentage);
 	void handlePause();
 
 private:
@@ -139,8 +156,24 @@ private:
 	std::atomic<bool>              _inProgress {false};
 	std::atomic<bool>              _done {false};
 	std::atomic<bool>              _cancelRequested {false};
+	std::atomic<bool>              _waitingForUserResponse {false};
 	UserResponse                   _userResponse = urNone;
 
+	std::atomic<uint64_t>          _sizeProcessed {0};
+	size_t                         _numCopyWorkers = 1;
+	size_t                         _maxCopyWorkersPerDevice = 1;
+	std::unique_ptr<CCopyWorkerPool> _copyWorkers;
+
+	// The source tree is enumerated by _enumerationThread while the items found so far are already being copied
+	std::vector<QDir>              _destinations; // Guarded by _sourceMutex, as is _source while the enumeration is in progress
+	std::mutex                     _sourceMutex;
+	std::condition_variable        _sourceItemsAvailable;
+	std::thread                    _enumerationThread;
+	std::atomic<bool>              _enumerationComplete {false};
+	std::atomic<bool>              _stopEnumeration {false};
+	std::atomic<uint64_t>          _totalSize {0};
+	std::atomic<size_t>            _numItemsEnumerated {0};
+
 	std::thread                    _thread;
 	std::mutex                     _waitForResponseMutex;
 	std::condition_variable        _waitForResponseCondition;
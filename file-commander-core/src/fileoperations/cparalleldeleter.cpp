@@ -0,0 +1,361 @@
+#include "cparalleldeleter.h"
+#include "threading/thread_helpers.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Every folder is opened and removed relative to its parent's fd, so that no path is ever resolved again once the walk has started:
+// a folder replaced with a symlink in the meantime is not followed, and there's no limit on the depth of the tree.
+struct CParallelDeleter::Folder {
+	// A root owns the fd of the folder that contains it
+	Folder(std::string folderPath, size_t folderNameOffset, std::shared_ptr<Folder> parentFolder, int parentFolderFd) :
+		path(std::move(folderPath)), nameOffset(folderNameOffset), parent(std::move(parentFolder)), parentFd(parentFolderFd) {}
+	~Folder();
+
+	// Relative to parentFd
+	const char* name() const {return path.c_str() + nameOffset;}
+
+	const std::string path; // Only for reporting
+	const size_t nameOffset;
+	const std::shared_ptr<Folder> parent;
+	const int parentFd;
+	int fd = -1; // Stays open for as long as any of the subfolders may need it
+	std::atomic<size_t> pendingSubfolders {1}; // Plus one until the folder itself has been listed
+	bool listingFailed = false;
+};
+
+#ifdef __linux__
+// Same as QFileInfo::isWritable() returning false
+static bool isReadOnly(int folderFd, const char* name)
+{
+	return ::faccessat(folderFd, name, W_OK, 0) != 0 && errno == EACCES;
+}
+#endif
+
+CParallelDeleter::Folder::~Folder()
+{
+#ifdef __linux__
+	if (fd >= 0)
+		::close(fd);
+	if (!parent && parentFd >= 0)
+		::close(parentFd);
+#endif
+}
+
+bool CParallelDeleter::supported()
+{
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+CParallelDeleter::CParallelDeleter(size_t numThreads) : _numThreads(std::max(numThreads, (size_t)1))
+{
+}
+
+CParallelDeleter::~CParallelDeleter()
+{
+	stop();
+}
+
+void CParallelDeleter::startCounting(const std::vector<std::string>& roots)
+{
+	start(roots, Counting);
+}
+
+void CParallelDeleter::startDeleting(const std::vector<std::string>& roots)
+{
+	start(roots, Deleting);
+}
+
+bool CParallelDeleter::waitUntilFinished(std::chrono::milliseconds timeout)
+{
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (!_stateChanged.wait_for(lock, timeout, [this]() {return _numRunningThreads == 0;}))
+			return false;
+	}
+
+	joinThreads();
+	return true;
+}
+
+void CParallelDeleter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+
+	_stateChanged.notify_all();
+	joinThreads();
+}
+
+void CParallelDeleter::setHeldOff(bool heldOff)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_heldOff = heldOff;
+	}
+
+	_stateChanged.notify_all();
+}
+
+void CParallelDeleter::setReadOnlyFilesAllowed(bool allowed)
+{
+	_readOnlyFilesAllowed = allowed;
+}
+
+uint64_t CParallelDeleter::numItemsProcessed() const
+{
+	return _numItemsProcessed;
+}
+
+std::string CParallelDeleter::currentFolder() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _currentFolder;
+}
+
+std::vector<CParallelDeleter::Failure> CParallelDeleter::takeFailures()
+{
+	std::vector<Failure> failures;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	failures.swap(_failures);
+	return failures;
+}
+
+void CParallelDeleter::start(const std::vector<std::string>& roots, Mode mode)
+{
+	stop();
+
+	_mode = mode;
+	_stop = false;
+	_numItemsProcessed = 0;
+	_pendingFolders.clear();
+	_failures.clear();
+	_currentFolder.clear();
+
+#ifdef __linux__
+	for (std::string root: roots)
+	{
+		while (root.size() > 1 && root.back() == '/')
+			root.pop_back();
+
+		// The path of a root is only resolved once, to open the folder containing it
+		const size_t lastSeparator = root.rfind('/');
+		const size_t nameOffset = lastSeparator == std::string::npos ? 0 : lastSeparator + 1;
+		const std::string parentPath = lastSeparator == std::string::npos ? std::string(".") : (lastSeparator == 0 ? std::string("/") : root.substr(0, lastSeparator));
+		if (nameOffset >= root.size())
+		{
+			reportFailure(root, EBUSY); // The file system root
+			continue;
+		}
+
+		const int parentFd = ::open(parentPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (parentFd < 0)
+		{
+			if (errno != ENOENT)
+				reportFailure(root, errno);
+			continue;
+		}
+
+		const char* name = root.c_str() + nameOffset;
+		struct stat rootStat;
+		if (::fstatat(parentFd, name, &rootStat, AT_SYMLINK_NOFOLLOW) != 0)
+		{
+			if (errno != ENOENT)
+				reportFailure(root, errno);
+		}
+		else if (S_ISDIR(rootStat.st_mode))
+		{
+			_pendingFolders.emplace_back(std::make_shared<Folder>(root, nameOffset, nullptr, parentFd));
+			continue;
+		}
+		else if (_mode == Counting)
+			++_numItemsProcessed;
+		else if (S_ISREG(rootStat.st_mode) && !_readOnlyFilesAllowed && isReadOnly(parentFd, name))
+			reportFailure(root, EACCES);
+		else if (::unlinkat(parentFd, name, 0) == 0)
+			++_numItemsProcessed;
+		else if (errno != ENOENT)
+			reportFailure(root, errno);
+
+		::close(parentFd);
+	}
+
+	if (_pendingFolders.empty())
+		return;
+
+	_numBusyThreads = 0;
+	_numRunningThreads = _numThreads;
+	for (size_t i = 0; i < _numThreads; ++i)
+		_threads.emplace_back(&CParallelDeleter::threadFunc, this);
+#else
+	for (const auto& root: roots)
+		reportFailure(root, ENOSYS);
+#endif
+}
+
+void CParallelDeleter::threadFunc()
+{
+	setThreadName("CParallelDeleter thread");
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;)
+	{
+		// Waiting for more folders while any other thread may still find some
+		_stateChanged.wait(lock, [this]() {
+			return _stop || (!_heldOff && (!_pendingFolders.empty() || _numBusyThreads == 0));
+		});
+
+		if (_stop || _pendingFolders.empty())
+			break;
+
+		const auto folder = std::move(_pendingFolders.back());
+		_pendingFolders.pop_back();
+		_currentFolder = folder->path;
+		++_numBusyThreads;
+		lock.unlock();
+
+		processFolder(folder);
+
+		lock.lock();
+		--_numBusyThreads;
+		_stateChanged.notify_all();
+	}
+
+	--_numRunningThreads;
+	_stateChanged.notify_all();
+}
+
+void CParallelDeleter::processFolder(const std::shared_ptr<Folder>& folder)
+{
+#ifdef __linux__
+	const int fd = ::openat(folder->parentFd, folder->name(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	{
+		folder->listingFailed = true;
+		reportFailure(folder->path, errno);
+		finishFolder(folder);
+		return;
+	}
+
+	folder->fd = fd;
+
+	// The entries are deleted as soon as they're listed, one buffer at a time, like 'rm -rf' does
+	alignas(dirent64) char buffer[32 * 1024];
+	std::vector<std::shared_ptr<Folder>> subfolders;
+	while (!_stop)
+	{
+		const long bytesRead = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+		if (bytesRead <= 0)
+		{
+			if (bytesRead < 0)
+			{
+				folder->listingFailed = true;
+				reportFailure(folder->path, errno);
+			}
+
+			break;
+		}
+
+		for (long offset = 0; offset < bytesRead;)
+		{
+			const dirent64* entry = reinterpret_cast<const dirent64*>(buffer + offset);
+			offset += entry->d_reclen;
+
+			const char* name = entry->d_name;
+			if (::strcmp(name, ".") == 0 || ::strcmp(name, "..") == 0)
+				continue;
+
+			// Not every file system reports the entry type
+			bool isFolder = entry->d_type == DT_DIR, isFile = entry->d_type == DT_REG;
+			if (entry->d_type == DT_UNKNOWN)
+			{
+				struct stat entryStat;
+				if (::fstatat(fd, name, &entryStat, AT_SYMLINK_NOFOLLOW) == 0)
+				{
+					isFolder = S_ISDIR(entryStat.st_mode);
+					isFile = S_ISREG(entryStat.st_mode);
+				}
+			}
+
+			if (isFolder)
+			{
+				++folder->pendingSubfolders;
+				subfolders.emplace_back(std::make_shared<Folder>(folder->path + '/' + name, folder->path.size() + 1, folder, fd));
+			}
+			else if (_mode == Counting)
+				++_numItemsProcessed;
+			else if (isFile && !_readOnlyFilesAllowed && isReadOnly(fd, name))
+				reportFailure(folder->path + '/' + name, EACCES);
+			else if (::unlinkat(fd, name, 0) == 0)
+				++_numItemsProcessed;
+			else if (errno != ENOENT)
+				reportFailure(folder->path + '/' + name, errno);
+		}
+
+		if (!subfolders.empty())
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				std::move(subfolders.begin(), subfolders.end(), std::back_inserter(_pendingFolders));
+			}
+
+			subfolders.clear();
+			_stateChanged.notify_all();
+		}
+	}
+#endif
+
+	finishFolder(folder);
+}
+
+void CParallelDeleter::finishFolder(std::shared_ptr<Folder> folder)
+{
+	for (; folder && --folder->pendingSubfolders == 0; folder = folder->parent)
+	{
+#ifdef __linux__
+		if (folder->fd >= 0)
+		{
+			// Not needed by the subfolders anymore
+			::close(folder->fd);
+			folder->fd = -1;
+		}
+
+		if (_stop || folder->listingFailed)
+			continue;
+		else if (_mode == Counting || ::unlinkat(folder->parentFd, folder->name(), AT_REMOVEDIR) == 0)
+			++_numItemsProcessed;
+		else if (errno != ENOENT)
+			reportFailure(folder->path, errno);
+#endif
+	}
+}
+
+void CParallelDeleter::joinThreads()
+{
+	for (auto& thread: _threads)
+		thread.join();
+
+	_threads.clear();
+}
+
+void CParallelDeleter::reportFailure(std::string path, int errorCode)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_failures.push_back({std::move(path), errorCode});
+}
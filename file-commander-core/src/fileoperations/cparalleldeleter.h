@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Deletes folder trees the way 'rm -rf' does: walks them with getdents64, opens the subfolders and unlinks the entries relative to the folder's fd,
+// without stat()-ing every item or creating a CFileSystemObject for it. Independent subtrees are processed by a pool of threads.
+// Nothing is ever asked from the user: the items that can't be deleted are skipped and reported to the owner via takeFailures().
+// The files the user has no write permission for are left alone and reported with EACCES, so that the owner can ask about them like the sequential deletion does.
+// Linux only, supported() returns false on other platforms.
+class CParallelDeleter
+{
+public:
+	struct Failure {
+		std::string path; // In the local 8-bit encoding, see QFile::decodeName
+		int errorCode;
+	};
+
+	static bool supported();
+
+	explicit CParallelDeleter(size_t numThreads);
+	// Stops the walk that's in progress
+	~CParallelDeleter();
+
+	// Counts the items (files, links and folders, the roots included) in the background without deleting anything
+	void startCounting(const std::vector<std::string>& roots);
+	// Deletes the roots and everything inside them in the background
+	void startDeleting(const std::vector<std::string>& roots);
+
+	// Returns true if the walk is complete (or has been stopped) within the timeout
+	bool waitUntilFinished(std::chrono::milliseconds timeout);
+	void stop();
+	// While held off, the threads don't enter any new folders
+	void setHeldOff(bool heldOff);
+	// For when the user has already agreed to delete every read-only file
+	void setReadOnlyFilesAllowed(bool allowed);
+
+	// The number of items counted or deleted so far
+	uint64_t numItemsProcessed() const;
+	// The folder that has been entered most recently
+	std::string currentFolder() const;
+	// Returns (and forgets) the failures so far, in the order they occurred. A folder always comes after the failed items inside it.
+	std::vector<Failure> takeFailures();
+
+private:
+	enum Mode {Counting, Deleting};
+	struct Folder;
+
+	void start(const std::vector<std::string>& roots, Mode mode);
+	void threadFunc();
+	void processFolder(const std::shared_ptr<Folder>& folder);
+	// Called when the folder has been listed, and again whenever one of its subfolders is done. Removes the folder once it's empty.
+	void finishFolder(std::shared_ptr<Folder> folder);
+	void joinThreads();
+	void reportFailure(std::string path, int errorCode);
+
+private:
+	const size_t _numThreads;
+	Mode _mode = Counting;
+
+	std::vector<std::thread> _threads;
+	std::vector<std::shared_ptr<Folder>> _pendingFolders; // Processed LIFO to keep the number of pending folders low
+	size_t _numBusyThreads = 0;
+	size_t _numRunningThreads = 0;
+	std::vector<Failure> _failures;
+	std::string _currentFolder;
+
+	std::atomic<uint64_t> _numItemsProcessed {0};
+	std::atomic<bool> _stop {false};
+	std::atomic<bool> _readOnlyFilesAllowed {false};
+	bool _heldOff = false;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _stateChanged;
+};
@@ -0,0 +1,93 @@
+#include "kernelassistedcopy.h"
+
+#include <errno.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+CopyMethod KernelAssistedCopy::preferredCopyMethod()
+{
+#ifdef __linux__
+	return cmReflink;
+#else
+	return cmMemoryMapping;
+#endif
+}
+
+CopyMethod KernelAssistedCopy::fallbackCopyMethod(CopyMethod method)
+{
+	switch (method)
+	{
+	case cmReflink:
+		return cmCopyFileRange;
+	case cmCopyFileRange:
+		return cmSendfile;
+	default:
+		return cmMemoryMapping;
+	}
+}
+
+bool KernelAssistedCopy::errorMeansMethodUnsupported(int errorCode)
+{
+	// EXDEV: source and dest are on different file systems (copy_file_range before Linux 5.3, FICLONE)
+	// EINVAL / EOPNOTSUPP / ENOTTY: the file system or the file type doesn't support the operation
+	// ENOSYS: the kernel is too old
+	return errorCode == EXDEV || errorCode == EINVAL || errorCode == EOPNOTSUPP || errorCode == ENOTTY || errorCode == ENOSYS
+#if defined ENOTSUP && ENOTSUP != EOPNOTSUPP
+		|| errorCode == ENOTSUP
+#endif
+		;
+}
+
+bool KernelAssistedCopy::reflink(int sourceFd, int destFd)
+{
+#if defined __linux__ && defined FICLONE
+	return ::ioctl(destFd, FICLONE, sourceFd) == 0;
+#else
+	(void)sourceFd;
+	(void)destFd;
+	errno = ENOSYS;
+	return false;
+#endif
+}
+
+int64_t KernelAssistedCopy::copyRange(CopyMethod method, int sourceFd, int destFd, uint64_t offset, size_t size)
+{
+#ifdef __linux__
+	if (method == cmCopyFileRange)
+	{
+#ifdef __NR_copy_file_range
+		// Calling through syscall() since the glibc wrapper only appeared in 2.27
+		loff_t sourceOffset = (loff_t)offset, destOffset = (loff_t)offset;
+		return (int64_t)::syscall(__NR_copy_file_range, sourceFd, &sourceOffset, destFd, &destOffset, size, 0u);
+#else
+		errno = ENOSYS;
+		return -1;
+#endif
+	}
+	else if (method == cmSendfile)
+	{
+		// sendfile() writes at the current position of the output file
+		if (::lseek(destFd, (off_t)offset, SEEK_SET) == (off_t)-1)
+			return -1;
+
+		off_t sourceOffset = (off_t)offset;
+		return (int64_t)::sendfile(destFd, sourceFd, &sourceOffset, size);
+	}
+#else
+	(void)sourceFd;
+	(void)destFd;
+	(void)offset;
+	(void)size;
+#endif
+
+	(void)method;
+	errno = ENOSYS;
+	return -1;
+}
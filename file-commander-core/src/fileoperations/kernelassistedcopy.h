@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The ways CFileSystemObject::copyChunk can transfer file contents, from the fastest to the most universal.
+// Copying starts with the first method and falls back to the next one whenever the current method is not supported for the given pair of files.
+enum CopyMethod {
+	cmReflink,        // Copy-on-write clone of the whole file (FICLONE), instant on btrfs / XFS
+	cmCopyFileRange,  // In-kernel copy (copy_file_range), can be offloaded to the storage by some file systems
+	cmSendfile,       // In-kernel copy (sendfile), works across file systems on older kernels
+	cmMemoryMapping   // Userspace memcpy between memory-mapped windows of both files
+};
+
+namespace KernelAssistedCopy {
+
+// The first method worth trying on the current platform
+CopyMethod preferredCopyMethod();
+// The method to try when 'method' turns out to be unsupported
+CopyMethod fallbackCopyMethod(CopyMethod method);
+// Returns true if the errno value means that the method is not supported for these files (as opposed to an actual I/O error)
+bool errorMeansMethodUnsupported(int errorCode);
+
+// Makes destFd a copy-on-write clone of sourceFd. Returns false (errno is set) if the file system doesn't support reflinks.
+bool reflink(int sourceFd, int destFd);
+// Copies up to 'size' bytes at 'offset' from sourceFd to the same offset in destFd using cmCopyFileRange or cmSendfile.
+// Returns the number of bytes copied (0 means the end of the source file), or -1 in case of an error (errno is set).
+int64_t copyRange(CopyMethod method, int sourceFd, int destFd, uint64_t offset, size_t size);
+
+}
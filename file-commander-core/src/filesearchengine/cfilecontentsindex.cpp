@@ -0,0 +1,637 @@
+#include "cfilecontentsindex.h"
+#include "cfilecontentsmatcher.h"
+#include "directoryscanner.h"
+#include "settings/csettings.h"
+#include "settings.h"
+#include "threading/thread_helpers.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringBuilder>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unordered_map>
+
+namespace {
+
+const quint32 indexFileSignature = 0x46434349; // "FCCI"
+const quint32 indexFileVersion = 2; // 2: fileMustBeReread; the files of a version 1 index could have changed unnoticed
+const int64_t updateIntervalSeconds = 60 * 60;
+// Larger files aren't indexed and are always verified
+const qint64 maxIndexedFileSize = 64 * 1024 * 1024;
+const size_t readBlockSize = 1024 * 1024;
+// Same rule as in CFileContentsMatcher: a file with a NUL byte among this many first bytes is binary and never matches
+const size_t binaryDetectionRange = 8 * 1024;
+
+const quint32 fileIsBinary = 1;
+const quint32 fileIsNotIndexed = 2;
+// The file was modified so shortly before it was read that another modification may not have changed its modification time
+const quint32 fileMustBeReread = 4;
+// How recent the modification time of a file that has been read must be for the file to be flagged fileMustBeReread
+const int64_t unreliableModificationTimeSeconds = 2;
+
+inline QString withTrailingSlash(const QString& path)
+{
+	return path.endsWith('/') ? path : path + '/';
+}
+
+inline uint8_t toLowerAscii(uint8_t c)
+{
+	return (c >= 'A' && c <= 'Z') ? static_cast<uint8_t>(c + ('a' - 'A')) : c;
+}
+
+// A removed folder hides everything inside it
+bool isRemoved(QString path, const std::set<QString>& removedPaths)
+{
+	while (!removedPaths.empty() && !path.isEmpty())
+	{
+		if (removedPaths.count(path) > 0)
+			return true;
+
+		const int lastSlash = path.lastIndexOf('/');
+		if (lastSlash <= 0)
+			break;
+
+		path.truncate(lastSlash);
+	}
+
+	return false;
+}
+
+// Collects the distinct trigrams of a file, fed to it in any number of pieces. A trigram is three consecutive bytes (ASCII folded to lower case) packed into 24 bits.
+// The set of the trigrams seen is a bitmap of all the 2^24 possible ones, so that adding one is a single bit test.
+class TrigramCollector
+{
+public:
+	TrigramCollector() : _seen((1u << 24) / 64, 0) {}
+
+	void add(const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			_window = ((_window << 8) | toLowerAscii((uint8_t)data[i])) & 0xFFFFFFu;
+			if (_numBytes < 2)
+			{
+				++_numBytes;
+				continue;
+			}
+
+			uint64_t& word = _seen[_window / 64];
+			const uint64_t bit = uint64_t(1) << (_window % 64);
+			if ((word & bit) == 0)
+			{
+				word |= bit;
+				_trigrams.push_back(_window);
+			}
+		}
+	}
+
+	// Returns the trigrams of the data added so far, sorted, and gets ready for the next file
+	std::vector<uint32_t> take()
+	{
+		for (const uint32_t trigram: _trigrams)
+			_seen[trigram / 64] = 0;
+
+		std::sort(_trigrams.begin(), _trigrams.end());
+		std::vector<uint32_t> result;
+		result.swap(_trigrams);
+		_window = 0;
+		_numBytes = 0;
+		return result;
+	}
+
+private:
+	std::vector<uint64_t> _seen;
+	std::vector<uint32_t> _trigrams;
+	uint32_t _window = 0;
+	size_t _numBytes = 0;
+};
+
+// Returns the file's flags; the trigrams are only collected for a text file that has been read successfully
+quint32 readFileTrigrams(const QString& path, TrigramCollector& collector, std::vector<uint32_t>& trigrams)
+{
+	QFile file(path);
+	const qint64 size = file.size();
+	if (size > maxIndexedFileSize || !file.open(QFile::ReadOnly))
+		return fileIsNotIndexed;
+
+	const char* data = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+	if (data)
+	{
+		const bool binary = ::memchr(data, 0, std::min((size_t)size, binaryDetectionRange)) != nullptr;
+		if (!binary)
+			collector.add(data, (size_t)size);
+		file.unmap((uchar*)data);
+		trigrams = collector.take();
+		return binary ? fileIsBinary : 0;
+	}
+
+	bool firstBlock = true;
+	for (;;)
+	{
+		const QByteArray block = file.read((qint64)readBlockSize);
+		if (block.isEmpty())
+			break;
+
+		if (firstBlock && ::memchr(block.constData(), 0, std::min((size_t)block.size(), binaryDetectionRange)) != nullptr)
+		{
+			collector.take();
+			return fileIsBinary;
+		}
+
+		firstBlock = false;
+		collector.add(block.constData(), (size_t)block.size());
+	}
+
+	trigrams = collector.take();
+	return file.error() == QFile::NoError ? 0 : fileIsNotIndexed;
+}
+
+}
+
+struct CFileContentsIndex::Index {
+	struct File {
+		QString relativePath;
+		qint64 modificationTime;
+		quint64 size;
+		quint32 flags;
+	};
+
+	int64_t updateTime = 0;
+	std::vector<File> files;
+	// The postings of trigrams[i] are the indexes of the files that contain it, postings[postingsBegin[i] .. postingsBegin[i + 1]), in ascending order
+	std::vector<uint32_t> trigrams;
+	std::vector<uint32_t> postingsBegin;
+	std::vector<uint32_t> postings;
+	// The files flagged fileIsNotIndexed, which are candidates for any query
+	std::vector<uint32_t> unindexedFiles;
+
+	void listUnindexedFiles()
+	{
+		unindexedFiles.clear();
+		for (uint32_t i = 0; i < (uint32_t)files.size(); ++i)
+		{
+			if (files[i].flags & fileIsNotIndexed)
+				unindexedFiles.push_back(i);
+		}
+	}
+};
+
+CFileContentsIndex& CFileContentsIndex::get()
+{
+	static CFileContentsIndex index;
+	return index;
+}
+
+CFileContentsIndex::CFileContentsIndex() :
+	_updaterThreadPool(1, "File contents index updater")
+{
+}
+
+CFileContentsIndex::~CFileContentsIndex()
+{
+	_stopUpdating = true;
+}
+
+void CFileContentsIndex::settingsChanged()
+{
+	{
+		std::vector<IndexedLocation> locations;
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const QString& location: CSettings().value(KEY_OTHER_CONTENTS_INDEX_LOCATIONS).toStringList())
+		{
+			if (location.trimmed().isEmpty())
+				continue;
+
+			const QString path = withTrailingSlash(QDir::cleanPath(QDir::fromNativeSeparators(location.trimmed())));
+			const auto existing = std::find_if(_locations.begin(), _locations.end(), [&path](const IndexedLocation& l) {return l.location == path;});
+			if (existing != _locations.end())
+				locations.push_back(std::move(*existing));
+			else
+			{
+				IndexedLocation newLocation;
+				newLocation.location = path;
+				locations.push_back(std::move(newLocation));
+			}
+		}
+
+		_locations = std::move(locations);
+	}
+
+	// Unlike the file name indexes, these have to be read into memory, which is done by the update on the updater thread
+	updateOutdatedIndexes();
+}
+
+void CFileContentsIndex::updateOutdatedIndexes()
+{
+	startUpdates(true);
+}
+
+void CFileContentsIndex::updateAllIndexes()
+{
+	startUpdates(false);
+}
+
+bool CFileContentsIndex::findCandidates(const QString& location, const CFileContentsMatcher& matcher, const std::function<void (const QString&)>& observer, const std::atomic<bool>& abort) const
+{
+	const QByteArray& literal = matcher.literal();
+	if (literal.size() < 3)
+		return false;
+
+	const QString locationPath = withTrailingSlash(location);
+
+	QString indexedLocation;
+	std::shared_ptr<const Index> index;
+	std::set<QString> modifiedPaths, removedPaths;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const IndexedLocation& l: _locations)
+		{
+			if (l.index && locationPath.startsWith(l.location))
+			{
+				indexedLocation = l.location;
+				index = l.index;
+				modifiedPaths = l.modifiedPaths;
+				removedPaths = l.removedPaths;
+				break;
+			}
+		}
+	}
+
+	if (!index)
+		return false;
+
+	TrigramCollector collector;
+	collector.add(literal.constData(), (size_t)literal.size());
+	const std::vector<uint32_t> queryTrigrams = collector.take();
+
+	// Intersecting the postings of the query's trigrams, starting with the shortest one
+	std::vector<std::pair<const uint32_t*, const uint32_t*>> postingRanges;
+	bool allTrigramsPresent = true;
+	for (const uint32_t trigram: queryTrigrams)
+	{
+		const auto it = std::lower_bound(index->trigrams.begin(), index->trigrams.end(), trigram);
+		if (it == index->trigrams.end() || *it != trigram)
+		{
+			allTrigramsPresent = false;
+			break;
+		}
+
+		const size_t i = (size_t)(it - index->trigrams.begin());
+		postingRanges.emplace_back(index->postings.data() + index->postingsBegin[i], index->postings.data() + index->postingsBegin[i + 1]);
+	}
+
+	std::vector<uint32_t> candidates;
+	if (allTrigramsPresent)
+	{
+		std::sort(postingRanges.begin(), postingRanges.end(), [](const std::pair<const uint32_t*, const uint32_t*>& l, const std::pair<const uint32_t*, const uint32_t*>& r) {
+			return l.second - l.first < r.second - r.first;
+		});
+
+		candidates.assign(postingRanges.front().first, postingRanges.front().second);
+		for (size_t i = 1; i < postingRanges.size() && !candidates.empty() && !abort; ++i)
+		{
+			std::vector<uint32_t> intersection;
+			std::set_intersection(candidates.begin(), candidates.end(), postingRanges[i].first, postingRanges[i].second, std::back_inserter(intersection));
+			candidates.swap(intersection);
+		}
+	}
+
+	candidates.insert(candidates.end(), index->unindexedFiles.begin(), index->unindexedFiles.end());
+	for (const uint32_t fileIndex: candidates)
+	{
+		if (abort)
+			return true;
+
+		const QString path = indexedLocation % index->files[fileIndex].relativePath;
+		// The modified files are reported below, once
+		if (path.startsWith(locationPath) && modifiedPaths.count(path) == 0 && !isRemoved(path, removedPaths))
+			observer(path);
+	}
+
+	for (const QString& path: modifiedPaths)
+	{
+		if (path.startsWith(locationPath))
+			observer(path);
+	}
+
+	return true;
+}
+
+void CFileContentsIndex::itemsChanged(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_locations.empty())
+		return;
+
+	const auto locationForPath = [this](const QString& path) -> IndexedLocation* {
+		for (IndexedLocation& location: _locations)
+		{
+			if (path.startsWith(location.location))
+				return &location;
+		}
+
+		return nullptr;
+	};
+
+	for (const QFileInfo& item: removed)
+	{
+		const QString path = item.absoluteFilePath();
+		IndexedLocation* location = locationForPath(path);
+		if (!location)
+			continue;
+
+		location->removedPaths.insert(path);
+		location->modifiedPaths.erase(path);
+		const QString folderPath = path + '/';
+		for (auto it = location->modifiedPaths.lower_bound(folderPath); it != location->modifiedPaths.end() && it->startsWith(folderPath);)
+			it = location->modifiedPaths.erase(it);
+	}
+
+	// A folder that has been added is only searched after the next update
+	for (const auto* items: {&added, &changed})
+	{
+		for (const QFileInfo& item: *items)
+		{
+			if (!item.isFile())
+				continue;
+
+			const QString path = item.absoluteFilePath();
+			IndexedLocation* location = locationForPath(path);
+			if (location)
+				location->modifiedPaths.insert(path);
+		}
+	}
+}
+
+void CFileContentsIndex::startUpdates(bool outdatedOnly)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const int64_t now = (int64_t)::time(nullptr);
+	for (IndexedLocation& location: _locations)
+	{
+		if (location.updateInProgress || (outdatedOnly && location.index && now - location.index->updateTime < updateIntervalSeconds))
+			continue;
+
+		location.updateInProgress = true;
+		_updaterThreadPool.enqueue([this, path = location.location, outdatedOnly]() {
+			updateIndex(path, outdatedOnly);
+		});
+	}
+}
+
+void CFileContentsIndex::updateIndex(const QString& location, bool outdatedOnly)
+{
+	std::shared_ptr<const Index> previousIndex;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto it = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+		if (it == _locations.end())
+			return;
+
+		previousIndex = it->index;
+	}
+
+	if (!previousIndex)
+	{
+		previousIndex = loadIndex(location);
+		if (previousIndex)
+		{
+			// Stale or not, the index can serve the searches while it's being updated
+			std::lock_guard<std::mutex> lock(_mutex);
+			const auto it = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+			if (it == _locations.end())
+				return;
+
+			it->index = previousIndex;
+			if (outdatedOnly && (int64_t)::time(nullptr) - previousIndex->updateTime < updateIntervalSeconds)
+			{
+				it->updateInProgress = false;
+				return;
+			}
+		}
+	}
+
+	qInfo() << __FUNCTION__ << "updating the contents index of" << location;
+
+	auto index = std::make_shared<Index>();
+	scanDirectory(CFileSystemObject(location), [&](const std::vector<CFileSystemObject>& batch) {
+		for (const CFileSystemObject& item: batch)
+		{
+			if (item.isFile())
+				index->files.push_back(Index::File{item.fullAbsolutePath().mid(location.size()), (qint64)item.properties().modificationDate, item.size(), 0});
+		}
+	}, _stopUpdating);
+
+	if (_stopUpdating)
+		return;
+
+	// The files that haven't changed keep their trigrams, the rest are read on a pool of threads
+	static const uint32_t noFile = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> newIndexOfPreviousFile(previousIndex ? previousIndex->files.size() : 0, noFile);
+	std::vector<uint32_t> filesToRead;
+	{
+		QHash<QString, uint32_t> previousFileByPath;
+		if (previousIndex)
+		{
+			previousFileByPath.reserve((int)previousIndex->files.size());
+			for (uint32_t i = 0; i < (uint32_t)previousIndex->files.size(); ++i)
+				previousFileByPath.insert(previousIndex->files[i].relativePath, i);
+		}
+
+		for (uint32_t i = 0; i < (uint32_t)index->files.size(); ++i)
+		{
+			Index::File& file = index->files[i];
+			const auto previous = previousFileByPath.constFind(file.relativePath);
+			const Index::File* previousFile = previous != previousFileByPath.constEnd() ? &previousIndex->files[previous.value()] : nullptr;
+			if (previousFile && previousFile->size == file.size && previousFile->modificationTime == file.modificationTime && (previousFile->flags & (fileIsNotIndexed | fileMustBeReread)) == 0)
+			{
+				file.flags = previousFile->flags;
+				newIndexOfPreviousFile[previous.value()] = i;
+			}
+			else
+				filesToRead.push_back(i);
+		}
+	}
+
+	std::vector<std::vector<uint32_t>> trigramsOfFilesRead(filesToRead.size());
+	std::atomic<size_t> nextFileToRead {0};
+	std::vector<std::thread> readerThreads;
+	for (unsigned int i = 0, numThreads = std::max(std::thread::hardware_concurrency(), 2u); i < numThreads; ++i)
+	{
+		readerThreads.emplace_back([&]() {
+			setThreadName("File contents indexing thread");
+
+			TrigramCollector collector;
+			for (size_t n = nextFileToRead++; n < filesToRead.size() && !_stopUpdating; n = nextFileToRead++)
+			{
+				Index::File& file = index->files[filesToRead[n]];
+				file.flags = readFileTrigrams(location % file.relativePath, collector, trigramsOfFilesRead[n]);
+				// The modification time is checked after reading: a file modified after that within the same second would be taken for unchanged
+				if ((int64_t)::time(nullptr) - file.modificationTime <= unreliableModificationTimeSeconds)
+					file.flags |= fileMustBeReread;
+			}
+		});
+	}
+
+	for (auto& thread: readerThreads)
+		thread.join();
+
+	if (_stopUpdating)
+		return;
+
+	std::unordered_map<uint32_t, std::vector<uint32_t>> postingsByTrigram;
+	if (previousIndex)
+	{
+		for (size_t t = 0; t < previousIndex->trigrams.size(); ++t)
+		{
+			for (uint32_t p = previousIndex->postingsBegin[t]; p < previousIndex->postingsBegin[t + 1]; ++p)
+			{
+				const uint32_t newFileIndex = newIndexOfPreviousFile[previousIndex->postings[p]];
+				if (newFileIndex != noFile)
+					postingsByTrigram[previousIndex->trigrams[t]].push_back(newFileIndex);
+			}
+		}
+	}
+
+	for (size_t n = 0; n < filesToRead.size(); ++n)
+	{
+		for (const uint32_t trigram: trigramsOfFilesRead[n])
+			postingsByTrigram[trigram].push_back(filesToRead[n]);
+		std::vector<uint32_t>().swap(trigramsOfFilesRead[n]);
+	}
+
+	index->trigrams.reserve(postingsByTrigram.size());
+	for (const auto& item: postingsByTrigram)
+		index->trigrams.push_back(item.first);
+	std::sort(index->trigrams.begin(), index->trigrams.end());
+
+	index->postingsBegin.reserve(index->trigrams.size() + 1);
+	for (const uint32_t trigram: index->trigrams)
+	{
+		std::vector<uint32_t>& filesWithTrigram = postingsByTrigram[trigram];
+		std::sort(filesWithTrigram.begin(), filesWithTrigram.end());
+		index->postingsBegin.push_back((uint32_t)index->postings.size());
+		index->postings.insert(index->postings.end(), filesWithTrigram.begin(), filesWithTrigram.end());
+		std::vector<uint32_t>().swap(filesWithTrigram);
+	}
+	index->postingsBegin.push_back((uint32_t)index->postings.size());
+
+	index->listUnindexedFiles();
+	index->updateTime = (int64_t)::time(nullptr);
+
+	if (!saveIndex(location, *index))
+		qInfo() << __FUNCTION__ << "failed to save the contents index of" << location;
+
+	qInfo() << __FUNCTION__ << "indexed" << index->files.size() << "files in" << location << "," << filesToRead.size() << "of them have been read";
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	const auto it = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+	if (it == _locations.end())
+		return;
+
+	it->updateInProgress = false;
+	it->index = std::move(index);
+	// The walk has seen the changes, save for the ones that happened while it was in progress
+	it->modifiedPaths.clear();
+	it->removedPaths.clear();
+}
+
+std::shared_ptr<CFileContentsIndex::Index> CFileContentsIndex::loadIndex(const QString& location)
+{
+	QFile file(indexFilePath(location));
+	if (!file.open(QFile::ReadOnly))
+		return nullptr;
+
+	QDataStream stream(&file);
+	quint32 signature = 0, version = 0;
+	QString indexedLocation;
+	stream >> signature >> version >> indexedLocation;
+	if (signature != indexFileSignature || version != indexFileVersion || indexedLocation != location)
+	{
+		qInfo() << __FUNCTION__ << file.fileName() << "is not a contents index of" << location << "of a supported version, ignoring it";
+		return nullptr;
+	}
+
+	auto index = std::make_shared<Index>();
+	qint64 updateTime = 0;
+	quint32 numFiles = 0, numTrigrams = 0;
+	stream >> updateTime >> numFiles;
+	index->updateTime = updateTime;
+	for (quint32 i = 0; i < numFiles && stream.status() == QDataStream::Ok; ++i)
+	{
+		Index::File indexedFile;
+		stream >> indexedFile.relativePath >> indexedFile.modificationTime >> indexedFile.size >> indexedFile.flags;
+		index->files.push_back(std::move(indexedFile));
+	}
+
+	// Validating the postings once so that the queries don't have to
+	bool valid = true;
+	stream >> numTrigrams;
+	for (quint32 t = 0; t < numTrigrams && valid && stream.status() == QDataStream::Ok; ++t)
+	{
+		quint32 trigram = 0, numPostings = 0;
+		stream >> trigram >> numPostings;
+		valid = trigram <= 0xFFFFFFu && (index->trigrams.empty() || trigram > index->trigrams.back()) && numPostings <= numFiles;
+		index->trigrams.push_back(trigram);
+		index->postingsBegin.push_back((uint32_t)index->postings.size());
+		for (quint32 p = 0; p < numPostings && valid && stream.status() == QDataStream::Ok; ++p)
+		{
+			quint32 fileIndex = 0;
+			stream >> fileIndex;
+			valid = fileIndex < numFiles && (p == 0 || fileIndex > index->postings.back());
+			index->postings.push_back(fileIndex);
+		}
+	}
+	index->postingsBegin.push_back((uint32_t)index->postings.size());
+
+	if (!valid || stream.status() != QDataStream::Ok)
+	{
+		qInfo() << __FUNCTION__ << file.fileName() << "is corrupt, ignoring it";
+		return nullptr;
+	}
+
+	index->listUnindexedFiles();
+	qInfo() << __FUNCTION__ << "loaded the contents index of" << index->files.size() << "files in" << location;
+	return index;
+}
+
+bool CFileContentsIndex::saveIndex(const QString& location, const Index& index)
+{
+	const QString path = indexFilePath(location);
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	QSaveFile file(path);
+	if (!file.open(QFile::WriteOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream << indexFileSignature << indexFileVersion << location << (qint64)index.updateTime << (quint32)index.files.size();
+	for (const Index::File& indexedFile: index.files)
+		stream << indexedFile.relativePath << indexedFile.modificationTime << indexedFile.size << indexedFile.flags;
+
+	stream << (quint32)index.trigrams.size();
+	for (size_t t = 0; t < index.trigrams.size(); ++t)
+	{
+		stream << (quint32)index.trigrams[t] << (quint32)(index.postingsBegin[t + 1] - index.postingsBegin[t]);
+		for (uint32_t p = index.postingsBegin[t]; p < index.postingsBegin[t + 1]; ++p)
+			stream << (quint32)index.postings[p];
+	}
+
+	return stream.status() == QDataStream::Ok && file.commit();
+}
+
+QString CFileContentsIndex::indexFilePath(const QString& location)
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) % "/contentsindex/" % QString::number(qHash(location), 16) % ".idx";
+}
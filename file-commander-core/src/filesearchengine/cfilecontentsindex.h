@@ -0,0 +1,78 @@
+#pragma once
+
+#include "filesystemwatcher/cfilesystemwatcherinterface.h"
+#include "threading/cworkerthread.h"
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFileInfo>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CFileContentsMatcher;
+
+// An optional trigram index of the contents of the files in the locations listed in the settings, for the locations that are searched by contents over and over.
+// For every three-byte sequence (with ASCII folded to lower case) it lists the files that contain it, so a contents search only has to verify
+// the files that contain every trigram of the query's literal. The indexes are stored on disk and updated in the background:
+// an update walks the location and only reads the files whose size or modification time has changed since the previous one.
+// The modification time only has a resolution of a second (or worse, depending on the file system), so a file that was modified within a couple of seconds
+// before it was read is read again by the next update regardless: it could have been modified once more without the time changing.
+// The files reported changed by the panels' file system watchers are always verified until the next update.
+class CFileContentsIndex
+{
+public:
+	static CFileContentsIndex& get();
+	~CFileContentsIndex();
+
+	// Re-reads the list of indexed locations, loads their indexes and starts updating the ones that are missing or outdated
+	void settingsChanged();
+	// Starts updating the indexes that are older than an hour, in the background
+	void updateOutdatedIndexes();
+	// Starts updating every index regardless of its age, in the background
+	void updateAllIndexes();
+
+	// Calls the observer for every file inside location that may contain the matcher's literal; those files still have to be checked with the matcher.
+	// Returns false without calling the observer if location isn't covered by an index that's ready, or the literal is too short to narrow the search down.
+	bool findCandidates(const QString& location, const CFileContentsMatcher& matcher, const std::function<void (const QString& path)>& observer, const std::atomic<bool>& abort) const;
+
+	// Called with the changes detected by a file system watcher
+	void itemsChanged(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed);
+
+private:
+	CFileContentsIndex();
+
+	struct Index;
+
+	void startUpdates(bool outdatedOnly);
+	// Loads the index from disk if it isn't loaded yet, walks the location and replaces the index with the updated one.
+	// If 'outdatedOnly' is set, an index loaded from disk that is recent enough isn't updated.
+	void updateIndex(const QString& location, bool outdatedOnly);
+	// Returns nullptr if the file is missing or invalid
+	static std::shared_ptr<Index> loadIndex(const QString& location);
+	static bool saveIndex(const QString& location, const Index& index);
+	static QString indexFilePath(const QString& location);
+
+private:
+	// Locations are stored with a trailing slash
+	struct IndexedLocation {
+		QString location;
+		std::shared_ptr<const Index> index; // nullptr until it's loaded or built
+		std::set<QString> modifiedPaths; // Files added or changed since the last update
+		std::set<QString> removedPaths;
+		bool updateInProgress = false;
+	};
+
+	std::vector<IndexedLocation> _locations;
+	mutable std::mutex _mutex;
+
+	std::atomic<bool> _stopUpdating {false};
+	CWorkerThreadPool _updaterThreadPool;
+};
@@ -0,0 +1,312 @@
+#include "cfilecontentsmatcher.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFile>
+#include <QTextCodec>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define CONTENTS_MATCHER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+const size_t chunkSize = 1024 * 1024;
+// Like git and grep, a file is binary if there's a NUL byte in this many first bytes
+const size_t binaryDetectionRange = 8 * 1024;
+
+inline char toLowerAscii(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// The needle is expected in lower case if the comparison is case-insensitive
+inline bool equalAt(const char* data, const char* needle, size_t length, bool caseInsensitive)
+{
+	if (!caseInsensitive)
+		return ::memcmp(data, needle, length) == 0;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (toLowerAscii(data[i]) != needle[i])
+			return false;
+	}
+
+	return true;
+}
+
+#ifdef CONTENTS_MATCHER_SSE2
+inline unsigned int indexOfLowestSetBit(uint32_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz(value);
+#endif
+}
+#endif
+
+bool isBinary(const char* data, size_t size)
+{
+	return ::memchr(data, 0, std::min(size, binaryDetectionRange)) != nullptr;
+}
+
+}
+
+CFileContentsMatcher::CFileContentsMatcher(const QString& query, bool caseSensitive) :
+	_query(query),
+	_caseSensitivity(caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive),
+	_hasWildcards(query.contains(QRegExp("[*?]")))
+{
+	if (_hasWildcards)
+	{
+		_wildcardPattern.setPatternSyntax(QRegExp::Wildcard);
+		_wildcardPattern.setPattern(query);
+		_wildcardPattern.setCaseSensitivity(_caseSensitivity);
+	}
+
+	const QTextCodec* localeCodec = QTextCodec::codecForLocale();
+	_localEncodingFallback = localeCodec && localeCodec->mibEnum() != 106 /* UTF-8 */;
+
+	// Picking the longest run of characters that must be present in a matching line as is.
+	// The raw bytes can only be compared case-insensitively for ASCII, and their encoding is only known for ASCII if a line may be decoded with the locale's codec,
+	// so any other character breaks the run in these cases.
+	// A [...] set matches one of several characters, so none of the characters inside the brackets is a part of a literal.
+	QString longestRun, currentRun;
+	for (int i = 0; i < query.size(); ++i)
+	{
+		const QChar ch = query[i];
+		const bool breaksRun = ch == '\n' || ch == '\r' ||
+			(_hasWildcards && (ch == '*' || ch == '?' || ch == '[')) ||
+			((!caseSensitive || _localEncodingFallback) && ch.unicode() >= 0x80);
+
+		if (!breaksRun)
+			currentRun.append(ch);
+		else if (_hasWildcards && ch == '[')
+		{
+			// Skipping the set; the first character after '[' (or after "[!" / "[^") is a part of the set even if it's ']'.
+			// Without the closing bracket, nothing after '[' is counted on.
+			int setEnd = i + 1;
+			if (setEnd < query.size() && (query[setEnd] == '!' || query[setEnd] == '^'))
+				++setEnd;
+			setEnd = query.indexOf(']', setEnd + 1);
+			i = setEnd >= 0 ? setEnd : query.size() - 1;
+		}
+
+		if (breaksRun || i == query.size() - 1)
+		{
+			if (currentRun.toUtf8().size() > longestRun.toUtf8().size())
+				longestRun = currentRun;
+			currentRun.clear();
+		}
+	}
+
+	_literalIsConclusive = !_hasWildcards && longestRun == query;
+	_literal = longestRun.toUtf8();
+	if (!caseSensitive)
+		std::transform(_literal.begin(), _literal.end(), _literal.begin(), toLowerAscii);
+}
+
+bool CFileContentsMatcher::fileMatches(const QString& path, const std::atomic<bool>& abort) const
+{
+	QFile file(path);
+	if (!file.open(QFile::ReadOnly))
+		return false;
+
+	const qint64 size = file.size();
+	if (size > 0 && (quint64)size <= (quint64)std::numeric_limits<size_t>::max())
+	{
+		const char* data = reinterpret_cast<const char*>(file.map(0, size));
+		if (data)
+		{
+			const bool match = !isBinary(data, (size_t)size) && dataMatches(data, (size_t)size, abort);
+			file.unmap((uchar*)data);
+			return match;
+		}
+	}
+
+	// The file can't be mapped (e. g. it's not a regular file, or doesn't fit into the address space): reading it in blocks, each ending at the end of a line
+	QByteArray buffer;
+	bool firstBlock = true;
+	while (!abort)
+	{
+		const QByteArray block = file.read((qint64)chunkSize);
+		if (firstBlock && isBinary(block.constData(), (size_t)block.size()))
+			return false;
+		firstBlock = false;
+
+		buffer.append(block);
+		const bool atEnd = block.isEmpty();
+		const int processedSize = atEnd ? buffer.size() : buffer.lastIndexOf('\n') + 1;
+		if (processedSize > 0 && chunkMatches(buffer.constData(), buffer.constData() + processedSize))
+			return true;
+
+		if (atEnd)
+			break;
+
+		buffer.remove(0, processedSize);
+	}
+
+	return false;
+}
+
+bool CFileContentsMatcher::dataMatches(const char* data, size_t size, const std::atomic<bool>& abort) const
+{
+	const char* const end = data + size;
+	for (const char* chunkBegin = data; chunkBegin < end && !abort;)
+	{
+		const char* chunkEnd = chunkBegin + std::min(chunkSize, (size_t)(end - chunkBegin));
+		if (chunkEnd < end)
+		{
+			// Extending the chunk to the end of the line so that a match can't be split between two chunks
+			const char* newLine = (const char*)::memchr(chunkEnd, '\n', (size_t)(end - chunkEnd));
+			chunkEnd = newLine ? newLine + 1 : end;
+		}
+
+		if (chunkMatches(chunkBegin, chunkEnd))
+			return true;
+
+		chunkBegin = chunkEnd;
+	}
+
+	return false;
+}
+
+const QByteArray& CFileContentsMatcher::literal() const
+{
+	return _literal;
+}
+
+const char* CFileContentsMatcher::findLiteral(const char* begin, const char* end) const
+{
+	const size_t length = (size_t)_literal.size();
+	if (length == 0 || (size_t)(end - begin) < length)
+		return nullptr;
+
+	const char* const needle = _literal.constData();
+	const bool caseInsensitive = _caseSensitivity == Qt::CaseInsensitive;
+	const char* const lastCandidate = end - length;
+	const char* position = begin;
+
+#ifdef CONTENTS_MATCHER_SSE2
+	// Comparing 16 positions at a time by the first and the last byte of the literal, and only comparing the whole literal where both are equal.
+	// For a case-insensitive search, bit 5 is set in both the data and the needle, which maps the upper case ASCII letters to the lower case ones
+	// (and some punctuation to other punctuation, but that's sorted out by the full comparison).
+	const char foldingBits = caseInsensitive ? 0x20 : 0;
+	const __m128i folding = _mm_set1_epi8(foldingBits);
+	const __m128i firstByte = _mm_set1_epi8(static_cast<char>(needle[0] | foldingBits));
+	const __m128i lastByte = _mm_set1_epi8(static_cast<char>(needle[length - 1] | foldingBits));
+
+	for (; position + 15 <= lastCandidate; position += 16)
+	{
+		const __m128i blockFirst = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(position)), folding);
+		const __m128i blockLast = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(position + length - 1)), folding);
+		uint32_t candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, firstByte), _mm_cmpeq_epi8(blockLast, lastByte)));
+		while (candidates != 0)
+		{
+			const char* candidate = position + indexOfLowestSetBit(candidates);
+			if (equalAt(candidate, needle, length, caseInsensitive))
+				return candidate;
+
+			candidates &= candidates - 1;
+		}
+	}
+#endif
+
+	for (; position <= lastCandidate; ++position)
+	{
+		if (!caseInsensitive)
+		{
+			// memchr is vectorized by the C library on most platforms
+			position = (const char*)::memchr(position, needle[0], (size_t)(lastCandidate - position) + 1);
+			if (!position)
+				return nullptr;
+		}
+
+		if (equalAt(position, needle, length, caseInsensitive))
+			return position;
+	}
+
+	return nullptr;
+}
+
+bool CFileContentsMatcher::lineMatches(const char* lineBegin, const char* lineEnd) const
+{
+	// The line terminator isn't a part of the line, same as with QTextStream::readLine()
+	if (lineEnd > lineBegin && lineEnd[-1] == '\n')
+		--lineEnd;
+	if (lineEnd > lineBegin && lineEnd[-1] == '\r')
+		--lineEnd;
+
+	const int lineLength = (int)(lineEnd - lineBegin);
+	QString line;
+	if (_localEncodingFallback)
+	{
+		QTextCodec::ConverterState state;
+		line = QTextCodec::codecForMib(106)->toUnicode(lineBegin, lineLength, &state);
+		if (state.invalidChars > 0)
+			line = QString::fromLocal8Bit(lineBegin, lineLength);
+	}
+	else
+		line = QString::fromUtf8(lineBegin, lineLength);
+
+	if (!_hasWildcards)
+		return line.contains(_query, _caseSensitivity);
+
+	// QRegExp stores the match state in itself, so the threads can't share an instance
+	QRegExp pattern(_wildcardPattern);
+	return pattern.exactMatch(line);
+}
+
+bool CFileContentsMatcher::chunkMatches(const char* begin, const char* end) const
+{
+	if (_literal.isEmpty())
+	{
+		// Nothing to look for in the raw data, every line has to be checked
+		for (const char* lineBegin = begin; lineBegin < end;)
+		{
+			const char* newLine = (const char*)::memchr(lineBegin, '\n', (size_t)(end - lineBegin));
+			const char* lineEnd = newLine ? newLine + 1 : end;
+			if (lineMatches(lineBegin, lineEnd))
+				return true;
+
+			lineBegin = lineEnd;
+		}
+
+		return false;
+	}
+
+	for (const char* position = begin; position < end;)
+	{
+		const char* occurrence = findLiteral(position, end);
+		if (!occurrence)
+			return false;
+		else if (_literalIsConclusive)
+			return true;
+
+		const char* lineBegin = occurrence;
+		while (lineBegin > begin && lineBegin[-1] != '\n')
+			--lineBegin;
+
+		const char* newLine = (const char*)::memchr(occurrence, '\n', (size_t)(end - occurrence));
+		const char* lineEnd = newLine ? newLine + 1 : end;
+		if (lineMatches(lineBegin, lineEnd))
+			return true;
+
+		// Other occurrences on the same line can't make a difference
+		position = lineEnd;
+	}
+
+	return false;
+}
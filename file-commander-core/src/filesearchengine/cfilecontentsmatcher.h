@@ -0,0 +1,54 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QByteArray>
+#include <QRegExp>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <stddef.h>
+
+// Checks whether a text file contains a line matching the query, the same way CFileSearchEngine used to with QTextStream:
+// a query with '*' or '?' must match a whole line as a wildcard pattern, any other query is a substring of a line.
+// The file is memory-mapped (or read in blocks if it can't be mapped) and its raw bytes are scanned for the longest literal part of the query.
+// Only the lines around the candidate positions are decoded and checked against the full query, and only if the literal alone isn't conclusive.
+// A line is decoded as UTF-8, or with the locale's 8-bit codec (which is what QTextStream used) if it's not valid UTF-8 and the locale isn't UTF-8 either;
+// in the latter case the literal is made of the ASCII characters of the query only, since the raw bytes of the others depend on the encoding.
+// Files with a NUL byte near the beginning are considered binary and never match; that includes UTF-16 text.
+// The matcher is immutable and can be used by multiple threads at once.
+class CFileContentsMatcher
+{
+public:
+	CFileContentsMatcher(const QString& query, bool caseSensitive);
+
+	// Returns false as soon as possible once abort is set
+	bool fileMatches(const QString& path, const std::atomic<bool>& abort) const;
+	// Same as fileMatches, for data that's already in memory; doesn't check for binary data
+	bool dataMatches(const char* data, size_t size, const std::atomic<bool>& abort) const;
+
+	// The bytes that every matching file contains (in ASCII lower case if the search is case-insensitive); may be empty
+	const QByteArray& literal() const;
+
+private:
+	// Returns the first occurrence of _literal in [begin, end), or nullptr
+	const char* findLiteral(const char* begin, const char* end) const;
+	// Decodes the line and checks it against the query
+	bool lineMatches(const char* lineBegin, const char* lineEnd) const;
+	// Checks the lines in [begin, end), which must start at the beginning of a line and end at the end of one
+	bool chunkMatches(const char* begin, const char* end) const;
+
+private:
+	QString _query;
+	QRegExp _wildcardPattern;
+	// The longest part of the query that any matching line must contain byte for byte (in ASCII lower case if the search is case-insensitive)
+	QByteArray _literal;
+	Qt::CaseSensitivity _caseSensitivity;
+	bool _hasWildcards;
+	// True if finding the literal means a match, without decoding the line
+	bool _literalIsConclusive;
+	// True if the lines that aren't valid UTF-8 are decoded with the locale's codec
+	bool _localEncodingFallback;
+};
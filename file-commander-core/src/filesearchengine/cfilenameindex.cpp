@@ -0,0 +1,447 @@
+#include "cfilenameindex.h"
+#include "cfilenamequery.h"
+#include "directoryscanner.h"
+#include "settings/csettings.h"
+#include "settings.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringBuilder>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <time.h>
+
+namespace {
+
+const uint32_t indexFileSignature = 0x46434E49; // "FCNI"
+const uint32_t indexFileVersion = 1;
+const int64_t rebuildIntervalSeconds = 24 * 60 * 60;
+
+// The file consists of the header, the folder records, the entry records and the names, in this order, with no padding in between.
+// The first folder is the indexed location itself, its name is the full path. Every folder comes after its parent.
+struct FileHeader {
+	uint32_t signature;
+	uint32_t version;
+	int64_t buildTime;
+	uint32_t numFolders;
+	uint32_t numEntries;
+	uint64_t namesSize;
+};
+
+struct FolderRecord {
+	uint32_t parentFolder;
+	uint32_t nameOffset; // UTF-8
+	uint32_t nameLength;
+};
+
+// All the items, folders included
+struct EntryRecord {
+	uint32_t folder;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t flags;
+};
+
+const uint32_t entryIsFolder = 1;
+
+static_assert(sizeof(FileHeader) % 4 == 0 && sizeof(FolderRecord) % 4 == 0 && sizeof(EntryRecord) % 4 == 0, "The records must stay aligned when the file is mapped");
+
+inline QString withTrailingSlash(const QString& path)
+{
+	return path.endsWith('/') ? path : path + '/';
+}
+
+// A removed folder hides everything that was indexed inside it
+bool isRemoved(QString path, const std::set<QString>& removedPaths)
+{
+	if (removedPaths.empty())
+		return false;
+
+	if (path.endsWith('/'))
+		path.chop(1);
+
+	while (!path.isEmpty())
+	{
+		if (removedPaths.count(path) > 0)
+			return true;
+
+		const int lastSlash = path.lastIndexOf('/');
+		if (lastSlash <= 0)
+			break;
+
+		path.truncate(lastSlash);
+	}
+
+	return false;
+}
+
+}
+
+struct CFileNameIndex::Index {
+	~Index()
+	{
+		if (data)
+			file.unmap(const_cast<uchar*>(data));
+	}
+
+	QFile file;
+	const uchar* data = nullptr;
+	const FileHeader* header = nullptr;
+	const FolderRecord* folders = nullptr;
+	const EntryRecord* entries = nullptr;
+	const char* names = nullptr;
+};
+
+CFileNameIndex& CFileNameIndex::get()
+{
+	static CFileNameIndex index;
+	return index;
+}
+
+CFileNameIndex::CFileNameIndex() :
+	_builderThreadPool(1, "File name index builder")
+{
+}
+
+CFileNameIndex::~CFileNameIndex()
+{
+	_stopBuilding = true;
+}
+
+void CFileNameIndex::settingsChanged()
+{
+	std::vector<QString> configuredLocations;
+	for (const QString& location: CSettings().value(KEY_OTHER_FILE_NAME_INDEX_LOCATIONS).toStringList())
+	{
+		if (!location.trimmed().isEmpty())
+			configuredLocations.push_back(withTrailingSlash(QDir::cleanPath(QDir::fromNativeSeparators(location.trimmed()))));
+	}
+
+	std::vector<IndexedLocation> locations;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const QString& location: configuredLocations)
+		{
+			const auto existing = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+			if (existing != _locations.end())
+				locations.push_back(std::move(*existing));
+			else
+			{
+				IndexedLocation newLocation;
+				newLocation.location = location;
+				locations.push_back(std::move(newLocation));
+			}
+		}
+
+		_locations = std::move(locations);
+	}
+
+	// Loading is cheap, the files are only mapped
+	for (const QString& location: configuredLocations)
+	{
+		bool alreadyLoaded = false;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const auto it = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+			alreadyLoaded = it != _locations.end() && it->index;
+		}
+
+		if (alreadyLoaded)
+			continue;
+
+		std::shared_ptr<const Index> index = loadIndex(location);
+		if (!index)
+			continue;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto it = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+		if (it != _locations.end() && !it->index)
+			it->index = std::move(index);
+	}
+
+	rebuildOutdatedIndexes();
+}
+
+void CFileNameIndex::rebuildOutdatedIndexes()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const int64_t now = (int64_t)::time(nullptr);
+	for (IndexedLocation& location: _locations)
+	{
+		if (location.buildInProgress || (location.index && now - location.index->header->buildTime < rebuildIntervalSeconds))
+			continue;
+
+		location.buildInProgress = true;
+		_builderThreadPool.enqueue([this, path = location.location]() {
+			buildIndex(path);
+		});
+	}
+}
+
+bool CFileNameIndex::findItems(const QString& location, const CFileNameQuery& query, const std::function<void (const QString&, bool)>& observer, const std::atomic<bool>& abort) const
+{
+	const QString locationPath = withTrailingSlash(location);
+
+	std::shared_ptr<const Index> index;
+	std::set<QString> addedPaths, removedPaths;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const IndexedLocation& indexedLocation: _locations)
+		{
+			if (indexedLocation.index && locationPath.startsWith(indexedLocation.location))
+			{
+				index = indexedLocation.index;
+				addedPaths = indexedLocation.addedPaths;
+				removedPaths = indexedLocation.removedPaths;
+				break;
+			}
+		}
+	}
+
+	if (!index)
+		return false;
+
+	const FileHeader& header = *index->header;
+	const bool matchComponentsSeparately = query.matchesPathComponentsSeparately();
+
+	// The full paths of the folders are only built once per query rather than for every item
+	std::vector<QString> folderPaths(header.numFolders);
+	std::vector<uint8_t> folderIsInLocation(header.numFolders, 0), folderPathMatches(header.numFolders, 0);
+	for (uint32_t i = 0; i < header.numFolders; ++i)
+	{
+		const FolderRecord& folder = index->folders[i];
+		const QString name = QString::fromUtf8(index->names + folder.nameOffset, (int)folder.nameLength);
+		folderPaths[i] = i == 0 ? name : folderPaths[folder.parentFolder] % name % '/';
+		folderIsInLocation[i] = folderPaths[i].startsWith(locationPath);
+		folderPathMatches[i] = matchComponentsSeparately && folderIsInLocation[i] && query.matches(folderPaths[i]);
+	}
+
+	for (uint32_t i = 0; i < header.numEntries; ++i)
+	{
+		if ((i & 0xFFF) == 0 && abort)
+			return true;
+
+		const EntryRecord& entry = index->entries[i];
+		if (!folderIsInLocation[entry.folder])
+			continue;
+
+		const bool isDir = (entry.flags & entryIsFolder) != 0;
+		const QString name = QString::fromUtf8(index->names + entry.nameOffset, (int)entry.nameLength);
+		QString path;
+		if (matchComponentsSeparately)
+		{
+			if (!folderPathMatches[entry.folder] && !query.matches(name))
+				continue;
+		}
+		else
+		{
+			path = folderPaths[entry.folder] % name % (isDir ? QStringLiteral("/") : QString());
+			if (!query.matches(path))
+				continue;
+		}
+
+		if (path.isEmpty())
+			path = folderPaths[entry.folder] % name % (isDir ? QStringLiteral("/") : QString());
+
+		if (!isRemoved(path, removedPaths))
+			observer(path, isDir);
+	}
+
+	for (const QString& path: addedPaths)
+	{
+		if (path.startsWith(locationPath) && path != locationPath && query.matches(path))
+			observer(path, path.endsWith('/'));
+	}
+
+	return true;
+}
+
+void CFileNameIndex::itemsChanged(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_locations.empty())
+		return;
+
+	const auto locationForPath = [this](const QString& path) -> IndexedLocation* {
+		for (IndexedLocation& location: _locations)
+		{
+			if (path.startsWith(location.location))
+				return &location;
+		}
+
+		return nullptr;
+	};
+
+	for (const QFileInfo& item: removed)
+	{
+		const QString path = item.absoluteFilePath();
+		IndexedLocation* location = locationForPath(path);
+		if (!location)
+			continue;
+
+		location->removedPaths.insert(path);
+		// Forgetting the item if it was added after the index was built, along with anything that was added inside it
+		location->addedPaths.erase(path);
+		const QString folderPath = path + '/';
+		for (auto it = location->addedPaths.lower_bound(folderPath); it != location->addedPaths.end() && it->startsWith(folderPath);)
+			it = location->addedPaths.erase(it);
+	}
+
+	for (const QFileInfo& item: added)
+	{
+		const QString path = item.isDir() ? withTrailingSlash(item.absoluteFilePath()) : item.absoluteFilePath();
+		IndexedLocation* location = locationForPath(path);
+		if (location)
+			location->addedPaths.insert(path);
+	}
+}
+
+void CFileNameIndex::buildIndex(const QString& location)
+{
+	qInfo() << __FUNCTION__ << "indexing" << location;
+
+	std::vector<FolderRecord> folders;
+	std::vector<EntryRecord> entries;
+	QByteArray names;
+	QHash<QString, uint32_t> folderIndexByPath;
+
+	const auto appendName = [&names](const QString& name, uint32_t& offset, uint32_t& length) {
+		const QByteArray utf8Name = name.toUtf8();
+		offset = (uint32_t)names.size();
+		length = (uint32_t)utf8Name.size();
+		names.append(utf8Name);
+	};
+
+	FolderRecord root;
+	root.parentFolder = std::numeric_limits<uint32_t>::max();
+	appendName(location, root.nameOffset, root.nameLength);
+	folders.push_back(root);
+	folderIndexByPath.insert(location, 0);
+
+	// Every folder is reported before its contents, so the parent of an item is always known by the time the item arrives
+	scanDirectory(CFileSystemObject(location), [&](const std::vector<CFileSystemObject>& batch) {
+		for (const CFileSystemObject& item: batch)
+		{
+			const auto parent = folderIndexByPath.constFind(item.parentDirPath());
+			if (item.isCdUp() || parent == folderIndexByPath.constEnd() || item.fullAbsolutePath() == location)
+				continue;
+
+			EntryRecord entry;
+			entry.folder = parent.value();
+			entry.flags = item.isDir() ? entryIsFolder : 0;
+			appendName(item.fullName(), entry.nameOffset, entry.nameLength);
+			entries.push_back(entry);
+
+			if (item.isDir())
+			{
+				folderIndexByPath.insert(item.fullAbsolutePath(), (uint32_t)folders.size());
+				folders.push_back(FolderRecord{entry.folder, entry.nameOffset, entry.nameLength});
+			}
+		}
+	}, _stopBuilding);
+
+	if (_stopBuilding)
+		return;
+
+	// The files are named by the build time; an older file can still be mapped by a search in progress and is removed later
+	FileHeader header;
+	header.signature = indexFileSignature;
+	header.version = indexFileVersion;
+	header.buildTime = (int64_t)::time(nullptr);
+	header.numFolders = (uint32_t)folders.size();
+	header.numEntries = (uint32_t)entries.size();
+	header.namesSize = (uint64_t)names.size();
+
+	const QString indexFolder = indexFolderPath(location);
+	QDir().mkpath(indexFolder);
+	QSaveFile file(indexFolder + '/' + QString::number(header.buildTime) + ".idx");
+	const bool written = file.open(QFile::WriteOnly) &&
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == (qint64)sizeof(header) &&
+		file.write(reinterpret_cast<const char*>(folders.data()), (qint64)(folders.size() * sizeof(FolderRecord))) == (qint64)(folders.size() * sizeof(FolderRecord)) &&
+		file.write(reinterpret_cast<const char*>(entries.data()), (qint64)(entries.size() * sizeof(EntryRecord))) == (qint64)(entries.size() * sizeof(EntryRecord)) &&
+		file.write(names) == (qint64)names.size() &&
+		file.commit();
+
+	std::shared_ptr<const Index> index = written ? loadIndex(location) : nullptr;
+	if (!written)
+		qInfo() << __FUNCTION__ << "failed to write the index of" << location << ":" << file.errorString();
+	else
+		qInfo() << __FUNCTION__ << "indexed" << entries.size() << "items in" << location;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto it = std::find_if(_locations.begin(), _locations.end(), [&location](const IndexedLocation& l) {return l.location == location;});
+		if (it == _locations.end())
+			return;
+
+		it->buildInProgress = false;
+		if (index)
+		{
+			it->index = std::move(index);
+			// The walk has seen the changes, save for the ones that happened while it was in progress
+			it->addedPaths.clear();
+			it->removedPaths.clear();
+		}
+	}
+
+	for (const QFileInfo& oldFile: QDir(indexFolder).entryInfoList(QStringList("*.idx"), QDir::Files))
+	{
+		if (oldFile.fileName() != QFileInfo(file.fileName()).fileName())
+			QFile::remove(oldFile.absoluteFilePath());
+	}
+}
+
+std::shared_ptr<CFileNameIndex::Index> CFileNameIndex::loadIndex(const QString& location)
+{
+	// The newest file first
+	const QFileInfoList files = QDir(indexFolderPath(location)).entryInfoList(QStringList("*.idx"), QDir::Files, QDir::Name | QDir::Reversed);
+	for (const QFileInfo& fileInfo: files)
+	{
+		auto index = std::make_shared<Index>();
+		index->file.setFileName(fileInfo.absoluteFilePath());
+		const qint64 fileSize = index->file.size();
+		if (fileSize < (qint64)sizeof(FileHeader) || !index->file.open(QFile::ReadOnly) || (index->data = index->file.map(0, fileSize)) == nullptr)
+			continue;
+
+		const FileHeader* header = reinterpret_cast<const FileHeader*>(index->data);
+		const uint64_t expectedSize = sizeof(FileHeader) + (uint64_t)header->numFolders * sizeof(FolderRecord) + (uint64_t)header->numEntries * sizeof(EntryRecord) + header->namesSize;
+		if (header->signature != indexFileSignature || header->version != indexFileVersion || header->numFolders == 0 || expectedSize != (uint64_t)fileSize)
+		{
+			qInfo() << __FUNCTION__ << fileInfo.absoluteFilePath() << "is not a valid index file";
+			continue;
+		}
+
+		index->header = header;
+		index->folders = reinterpret_cast<const FolderRecord*>(index->data + sizeof(FileHeader));
+		index->entries = reinterpret_cast<const EntryRecord*>(index->folders + header->numFolders);
+		index->names = reinterpret_cast<const char*>(index->entries + header->numEntries);
+
+		// Validating the references once so that the queries don't have to
+		bool valid = index->folders[0].nameOffset + (uint64_t)index->folders[0].nameLength <= header->namesSize &&
+			QString::fromUtf8(index->names + index->folders[0].nameOffset, (int)index->folders[0].nameLength) == location;
+		for (uint32_t i = 1; valid && i < header->numFolders; ++i)
+			valid = index->folders[i].parentFolder < i && index->folders[i].nameOffset + (uint64_t)index->folders[i].nameLength <= header->namesSize;
+		for (uint32_t i = 0; valid && i < header->numEntries; ++i)
+			valid = index->entries[i].folder < header->numFolders && index->entries[i].nameOffset + (uint64_t)index->entries[i].nameLength <= header->namesSize;
+
+		if (valid)
+			return index;
+
+		qInfo() << __FUNCTION__ << fileInfo.absoluteFilePath() << "is corrupt or belongs to another location";
+	}
+
+	return nullptr;
+}
+
+QString CFileNameIndex::indexFolderPath(const QString& location)
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) % "/filenameindex/" % QString::number(qHash(location), 16);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "filesystemwatcher/cfilesystemwatcherinterface.h"
+#include "threading/cworkerthread.h"
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+class CFileNameQuery;
+
+// An optional locate-style index of the file names in the locations listed in the settings (typically whole volumes), so that name searches
+// in those locations don't have to walk the file system. Every location has its own index file, which is built in the background
+// and is memory-mapped rather than loaded. The changes reported by the panels' file system watchers are applied on top of it until the next rebuild;
+// anything else that changes is only picked up by the periodic rebuild.
+class CFileNameIndex
+{
+public:
+	static CFileNameIndex& get();
+	~CFileNameIndex();
+
+	// Re-reads the list of indexed locations, loads their indexes and starts building the ones that are missing or outdated
+	void settingsChanged();
+	// Starts rebuilding the indexes that are missing or older than a day, in the background
+	void rebuildOutdatedIndexes();
+
+	// Calls the observer for every indexed item inside location (not including location itself) whose full path matches the query.
+	// Returns false without calling the observer if location isn't covered by an index that's ready, in which case the caller has to walk it.
+	bool findItems(const QString& location, const CFileNameQuery& query, const std::function<void (const QString& path, bool isDir)>& observer, const std::atomic<bool>& abort) const;
+
+	// Keeps the indexes up to date between the rebuilds. Called with the changes detected by a file system watcher.
+	void itemsChanged(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed);
+
+private:
+	CFileNameIndex();
+
+	struct Index;
+
+	// Walks the location and writes its index file, then replaces the index in memory with the new one
+	void buildIndex(const QString& location);
+	// Returns nullptr if the file is missing or invalid
+	static std::shared_ptr<Index> loadIndex(const QString& location);
+	static QString indexFolderPath(const QString& location);
+
+private:
+	// Locations are stored with a trailing slash. The index files are immutable, the changes detected since they were built are kept separately.
+	struct IndexedLocation {
+		QString location;
+		std::shared_ptr<const Index> index; // nullptr until it's built
+		std::set<QString> addedPaths; // Folders with a trailing slash
+		std::set<QString> removedPaths; // Without the trailing slash, as a removed item's type is unknown
+		bool buildInProgress = false;
+	};
+
+	std::vector<IndexedLocation> _locations;
+	mutable std::mutex _mutex;
+
+	std::atomic<bool> _stopBuilding {false};
+	CWorkerThreadPool _builderThreadPool;
+};
@@ -0,0 +1,25 @@
+#include "cfilenamequery.h"
+
+CFileNameQuery::CFileNameQuery(const QString& query, bool caseSensitive) :
+	_query(query),
+	_caseSensitivity(caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive),
+	_hasWildcards(query.contains(QRegExp("[*?]")))
+{
+	if (_hasWildcards)
+	{
+		_wildcardPattern.setPatternSyntax(QRegExp::Wildcard);
+		_wildcardPattern.setPattern(query);
+		_wildcardPattern.setCaseSensitivity(_caseSensitivity);
+	}
+}
+
+bool CFileNameQuery::matches(const QString& fullPath) const
+{
+	// contains() is faster than RegEx match (as of Qt 5.4.2)
+	return _hasWildcards ? _wildcardPattern.exactMatch(fullPath) : fullPath.contains(_query, _caseSensitivity);
+}
+
+bool CFileNameQuery::matchesPathComponentsSeparately() const
+{
+	return !_hasWildcards && !_query.contains('/');
+}
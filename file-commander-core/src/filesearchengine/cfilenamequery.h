@@ -0,0 +1,28 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QRegExp>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+// The file name part of a search: a query with '*' or '?' is a wildcard pattern that must match the whole path, any other query is a substring of the path.
+// Folder paths end with a slash. Not thread-safe, QRegExp keeps the state of the last match in itself.
+class CFileNameQuery
+{
+public:
+	CFileNameQuery(const QString& query, bool caseSensitive);
+
+	bool matches(const QString& fullPath) const;
+
+	// True for a substring query that doesn't contain a slash: such a query can't span multiple path components,
+	// so a path matches if and only if its folder path or its name does, and the two can be checked separately.
+	bool matchesPathComponentsSeparately() const;
+
+private:
+	QString _query;
+	QRegExp _wildcardPattern;
+	Qt::CaseSensitivity _caseSensitivity;
+	bool _hasWildcards;
+};
@@ -1,17 +1,27 @@
-#include "../ccontroller.h"
+#include "cfilesearchengine.h"
+#include "assert/advanced_assert.h"
 #include "system/ctimeelapsed.h"
 #include "directoryscanner.h"
+#include "cfilecontentsindex.h"
+#include "cfilecontentsmatcher.h"
+#include "cfilenameindex.h"
+#include "cfilenamequery.h"
+#include "threading/thread_helpers.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QDebug>
-#include <qhash.h>
-#include <QTextStream>
+#include <QStringList>
 RESTORE_COMPILER_WARNINGS
 
-const int tag = abs((int)qHash(QString("CFileSearchEngine")));
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-CFileSearchEngine::CFileSearchEngine(CController& controller) :
-	_controller(controller),
+CFileSearchEngine::CFileSearchEngine() :
 	_workerThread("File search thread")
 {
 }
@@ -27,6 +37,11 @@ void CFileSearchEngine::removeListener(CFileSearchEngine::FileSearchListener* li
 	_listeners.erase(listener);
 }
 
+void CFileSearchEngine::uiThreadTimerTick()
+{
+	_uiQueue.exec(CExecutionQueue::execAll);
+}
+
 bool CFileSearchEngine::searchInProgress() const
 {
 	return _workerThread.running();
@@ -43,77 +58,155 @@ void CFileSearchEngine::search(const QString& what, bool subjectCaseSensitive, c
 	if (what.isEmpty() || where.empty())
 		return;
 
+	{
+		std::lock_guard<std::mutex> lock(_notificationsMutex);
+		_pendingMatches.clear();
+		_lastScannedItem.clear();
+	}
+
 	_workerThread.exec([this, what, subjectCaseSensitive, where, contentsToFind, contentsCaseSensitive](){
 
 		uint64_t itemCounter = 0;
 		CTimeElapsed timer;
 		timer.start();
 
-		const bool nameQueryHasWildcards = what.contains(QRegExp("[*?]"));
-		QRegExp queryRegExp;
-		if (nameQueryHasWildcards)
+		// The notifications held back by the throttling are sent from here once they're due, even if nothing else is found or scanned in the meantime
+		std::mutex searchDoneMutex;
+		std::condition_variable searchDoneCondition;
+		bool searchDone = false;
+		std::thread notificationThread([&]() {
+			setThreadName("File search notification thread");
+
+			std::unique_lock<std::mutex> lock(searchDoneMutex);
+			while (!searchDone)
+			{
+				searchDoneCondition.wait_for(lock, std::chrono::milliseconds(50));
+
+				std::lock_guard<std::mutex> notificationsLock(_notificationsMutex);
+				sendNotifications(false);
+			}
+		});
+
+		const CFileNameQuery nameQuery(what, subjectCaseSensitive);
+		CFileNameIndex::get().rebuildOutdatedIndexes();
+		if (!contentsToFind.isEmpty())
+			CFileContentsIndex::get().updateOutdatedIndexes();
+
+		// The contents of the files whose names match are searched on a pool of threads while the folders are still being walked
+		const CFileContentsMatcher contentsMatcher(contentsToFind, contentsCaseSensitive);
+		std::deque<QString> filesToSearch;
+		bool walkComplete = false;
+		std::mutex filesToSearchMutex;
+		std::condition_variable fileQueued;
+
+		std::vector<std::thread> contentsSearchThreads;
+		if (!contentsToFind.isEmpty())
 		{
-			queryRegExp.setPatternSyntax(QRegExp::Wildcard);
-			queryRegExp.setPattern(what);
-			queryRegExp.setCaseSensitivity(subjectCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+			for (unsigned int i = 0, numThreads = std::max(std::thread::hardware_concurrency(), 2u); i < numThreads; ++i)
+			{
+				contentsSearchThreads.emplace_back([&]() {
+					setThreadName("File contents search thread");
+
+					for (;;)
+					{
+						QString path;
+						{
+							std::unique_lock<std::mutex> lock(filesToSearchMutex);
+							// The timeout is for noticing the termination flag
+							while (filesToSearch.empty() && !walkComplete && !_workerThread.terminationFlag())
+								fileQueued.wait_for(lock, std::chrono::milliseconds(50));
+
+							if (filesToSearch.empty() || _workerThread.terminationFlag())
+								return;
+
+							path = std::move(filesToSearch.front());
+							filesToSearch.pop_front();
+						}
+
+						if (contentsMatcher.fileMatches(path, _workerThread.terminationFlag()))
+							reportMatch(path);
+					}
+				});
+			}
 		}
 
+		// Returns true if the file has been queued for the contents search
+		const auto nameMatched = [&](const QString& path, bool isFile) {
+			if (contentsToFind.isEmpty())
+				reportMatch(path);
+			else if (isFile)
+			{
+				std::lock_guard<std::mutex> lock(filesToSearchMutex);
+				filesToSearch.push_back(path);
+				return true;
+			}
+
+			return false;
+		};
+
 		for (const QString& pathToLookIn: where)
 		{
-			scanDirectory(CFileSystemObject(pathToLookIn),
-				[&](const CFileSystemObject& item) {
-
+			// Only the files that may contain the text have to be checked, and only their names are matched
+			const bool candidatesFoundInIndex = !contentsToFind.isEmpty() && CFileContentsIndex::get().findCandidates(pathToLookIn, contentsMatcher, [&](const QString& path) {
 				++itemCounter;
+				if (nameQuery.matches(path) && nameMatched(path, true))
+					fileQueued.notify_all();
+			}, _workerThread.terminationFlag());
 
-				const QString path = item.fullAbsolutePath();
-				_controller.execOnUiThread([this, path, what](){
-					for (const auto& listener: _listeners)
-						listener->itemScanned(path);
-				}, tag);
+			if (candidatesFoundInIndex)
+				continue;
 
-				// contains() is faster than RegEx match (as of Qt 5.4.2)
-				if ((nameQueryHasWildcards && queryRegExp.exactMatch(path)) || (!nameQueryHasWildcards && path.contains(what, subjectCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive)))
-				{
-					QFile file(path);
-					if (!contentsToFind.isEmpty())
-					{
-						if (!file.open(QFile::ReadOnly))
-							return;
-					}
+			// An indexed location doesn't have to be walked, only the matching items are reported
+			const bool foundInIndex = CFileNameIndex::get().findItems(pathToLookIn, nameQuery, [&](const QString& path, bool isDir) {
+				++itemCounter;
+				if (nameMatched(path, !isDir))
+					fileQueued.notify_all();
+			}, _workerThread.terminationFlag());
 
-					QTextStream stream(&file);
-					bool match = contentsToFind.isEmpty();
-					QRegExp fileContentsRegExp;
-					const bool contentsQueryHasWildcards = contentsToFind.contains(QRegExp("[*?]"));
-					const auto subjectCaseSensitivity = subjectCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-					if (contentsQueryHasWildcards)
-					{
-						fileContentsRegExp.setPatternSyntax(QRegExp::Wildcard);
-						fileContentsRegExp.setPattern(contentsToFind);
-						fileContentsRegExp.setCaseSensitivity(subjectCaseSensitivity);
-					}
+			if (foundInIndex)
+				continue;
 
-					while (!match && !_workerThread.terminationFlag() && !stream.atEnd())
-					{
-						const QString line = stream.readLine();
-						// contains() is faster than RegEx match (as of Qt 5.4.2)
-						match = contentsQueryHasWildcards ? fileContentsRegExp.exactMatch(line) : line.contains(contentsToFind, subjectCaseSensitivity);
-					}
+			scanDirectory(CFileSystemObject(pathToLookIn),
+				[&](const std::vector<CFileSystemObject>& batch) {
+				itemCounter += batch.size();
+				reportScannedItem(batch.back().fullAbsolutePath());
 
-					if (match)
-					{
-						_controller.execOnUiThread([this, path, what](){
-						for (const auto& listener : _listeners)
-							listener->matchFound(path);
-						});
-					}
+				size_t numFilesQueued = 0;
+				for (const CFileSystemObject& item: batch)
+				{
+					const QString path = item.fullAbsolutePath();
+					if (nameQuery.matches(path) && nameMatched(path, item.isFile()))
+						++numFilesQueued;
 				}
 
+				if (numFilesQueued > 0)
+					fileQueued.notify_all();
 			}, _workerThread.terminationFlag());
 		}
 
+		{
+			std::lock_guard<std::mutex> lock(filesToSearchMutex);
+			walkComplete = true;
+		}
+		fileQueued.notify_all();
+
+		for (auto& thread: contentsSearchThreads)
+			thread.join();
+
+		{
+			std::lock_guard<std::mutex> lock(searchDoneMutex);
+			searchDone = true;
+		}
+		searchDoneCondition.notify_all();
+		notificationThread.join();
+
+		{
+			std::lock_guard<std::mutex> lock(_notificationsMutex);
+			sendNotifications(true);
+		}
+
 		const uint32_t speed = timer.elapsed() > 0 ? static_cast<uint32_t>(itemCounter * 1000u / timer.elapsed()) : 0;
-		_controller.execOnUiThread([this, speed](){
+		_uiQueue.enqueue([this, speed](){
 			for (const auto& listener: _listeners)
 				listener->searchFinished(_workerThread.terminationFlag() ? SearchCancelled : SearchFinished, speed);
 		});
@@ -125,3 +218,42 @@ void CFileSearchEngine::stopSearching()
 	_workerThread.interrupt();
 }
 
+void CFileSearchEngine::reportScannedItem(const QString& path)
+{
+	std::lock_guard<std::mutex> lock(_notificationsMutex);
+	_lastScannedItem = path;
+	sendNotifications(false);
+}
+
+void CFileSearchEngine::reportMatch(const QString& path)
+{
+	std::lock_guard<std::mutex> lock(_notificationsMutex);
+	_pendingMatches.push_back(path);
+	sendNotifications(false);
+}
+
+void CFileSearchEngine::sendNotifications(bool force)
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (!force && now - _lastNotificationTime < std::chrono::milliseconds(50))
+		return;
+
+	_lastNotificationTime = now;
+	if (_pendingMatches.empty() && _lastScannedItem.isEmpty())
+		return;
+
+	// Only the latest scanned item is of interest, the matches are all delivered
+	_uiQueue.enqueue([this, matches = std::move(_pendingMatches), scannedItem = _lastScannedItem](){
+		for (const auto& listener: _listeners)
+		{
+			if (!scannedItem.isEmpty())
+				listener->itemScanned(scannedItem);
+			if (!matches.empty())
+				listener->matchesFound(matches);
+		}
+	});
+
+	_pendingMatches.clear();
+	_lastScannedItem.clear();
+}
+
@@ -1,17 +1,21 @@
 #pragma once
 
+#include "threading/cexecutionqueue.h"
 #include "threading/cinterruptablethread.h"
+#include "compiler/compiler_warnings_control.h"
 
-class CController;
+DISABLE_COMPILER_WARNINGS
+#include <QString>
+RESTORE_COMPILER_WARNINGS
 
-class QString;
 class QStringList;
 
+#include <chrono>
+#include <mutex>
 #include <set>
+#include <vector>
 
-class CController;
-class QString;
-
+// Doesn't depend on the rest of the core (the controller, the panels), so that it can be used on its own
 class CFileSearchEngine
 {
 public:
@@ -23,24 +27,40 @@ public:
 	struct FileSearchListener {
 		virtual ~FileSearchListener() {}
 
+		// The notifications are delivered in batches no more often than every 50 ms:
+		// only the item scanned most recently is reported, and all the matches since the previous batch.
 		virtual void itemScanned(const QString& currentItem) = 0;
-		virtual void matchFound(const QString& path) = 0;
+		virtual void matchesFound(const std::vector<QString>& paths) = 0;
 		virtual void searchFinished(SearchStatus status, uint32_t itemsPerSecond) = 0;
 	};
 
-	CFileSearchEngine(CController& controller);
+	CFileSearchEngine();
 	void addListener(FileSearchListener* listener);
 	void removeListener(FileSearchListener* listener);
 
+	// The listeners are notified from here; must be called periodically on the thread they live on (normally the UI thread)
+	void uiThreadTimerTick();
 
 	bool searchInProgress() const;
 	void search(const QString& what, bool subjectCaseSensitive, const QStringList& where, const QString& contentsToFind, bool contentsCaseSensitive);
 	void stopSearching();
 
 private:
-	CController& _controller;
+	// Called on the worker threads
+	void reportScannedItem(const QString& path);
+	void reportMatch(const QString& path);
+	// Must be called with _notificationsMutex locked. Posts the pending notifications to the UI thread, unless the previous batch is too recent and 'force' isn't set;
+	// the ones held back are sent later by the search's notification thread, which calls this periodically.
+	void sendNotifications(bool force);
 
+private:
+	CExecutionQueue _uiQueue;
 	CInterruptableThread _workerThread;
 	std::set<FileSearchListener*> _listeners;
+
+	std::mutex _notificationsMutex;
+	std::vector<QString> _pendingMatches;
+	QString _lastScannedItem;
+	std::chrono::steady_clock::time_point _lastNotificationTime;
 };
 
@@ -1,94 +1,21 @@
 #pragma once
 
-#include "compiler/compiler_warnings_control.h"
-#include "container/std_container_helpers.hpp"
-#include "container/ordered_containers.hpp"
+#include "cfilesystemwatchertimerbased.h"
 
-DISABLE_COMPILER_WARNINGS
-#include <QDateTime>
-#include <QFileInfo>
-#include <QTimer>
-RESTORE_COMPILER_WARNINGS
+#ifdef __linux__
+#include "cfilesystemwatcherinotify.h"
+#endif
 
-#include <deque>
-#include <functional>
-#include <mutex>
-#include <set>
-
-struct BasicFileSystemItemInfo
-{
-	QString fullPath;
-	qint64 size;
-	uint modificationTime;
-
-	inline BasicFileSystemItemInfo(const QFileInfo& fullInfo) : fullPath(fullInfo.absoluteFilePath()), size(fullInfo.size()), modificationTime(fullInfo.lastModified().toTime_t()) {}
-
-	inline bool operator<(const BasicFileSystemItemInfo& other) const {
-		return fullPath < other.fullPath;
-	}
-
-	inline bool operator<(const QFileInfo& fullInfo) const {
-		return fullPath < fullInfo.absoluteFilePath();
-	}
-
-	inline bool operator==(const BasicFileSystemItemInfo& other) const {
-		return fullPath == other.fullPath;
-	}
-
-	inline bool operator==(const QFileInfo& fullInfo) const {
-		return fullPath == fullInfo.absoluteFilePath();
-	}
-
-	inline operator QFileInfo() const {
-		return QFileInfo(fullPath);
-	}
-
-	inline bool fileDetailsChanged(const QFileInfo& otherFullInfo) const {
-		return size != otherFullInfo.size() || modificationTime != otherFullInfo.lastModified().toTime_t();
-	}
-};
-
-using ChangeDetectedCallback = std::function<void(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed)>;
-
-namespace detail {
-
-class CFileSystemWatcherInterface
+// Watches the folder with the OS notifications where they're available and reliable, and falls back to polling otherwise (e. g. for network and FUSE file systems)
+class CFileSystemWatcher
 {
 public:
-	virtual ~CFileSystemWatcherInterface() = default;
-
 	void addCallback(ChangeDetectedCallback callback);
-	virtual bool setPathToWatch(const QString& path) = 0;
-
-protected:
-	void processChangesAndNotifySubscribers(const QFileInfoList& newState);
-
-protected:
-	std::recursive_mutex _pathMutex;
-	QString _pathToWatch;
-
-private:
-	std::deque<ChangeDetectedCallback> _callbacks;
-	transparent_set<BasicFileSystemItemInfo> _previousState;
-};
-
-}
-
-inline bool operator<(const QFileInfo& lItem, const QFileInfo& rItem)
-{
-	return lItem.absoluteFilePath() < rItem.absoluteFilePath();
-}
-
-class CFileSystemWatcher : public detail::CFileSystemWatcherInterface
-{
-public:
-	CFileSystemWatcher();
-
-	bool setPathToWatch(const QString &path) override;
-
-private:
-	void onCheckForChanges();
+	bool setPathToWatch(const QString& path);
 
 private:
-	QTimer _timer;
+#ifdef __linux__
+	CFileSystemWatcherInotify _inotifyWatcher;
+#endif
+	CFileSystemWatcherTimerBased _pollingWatcher;
 };
@@ -0,0 +1,176 @@
+#include "cfilesystemwatcherinotify.h"
+#include "assert/advanced_assert.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QDir>
+RESTORE_COMPILER_WARNINGS
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+static const uint32_t eventsToWatch = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+// Only change the item's details, not the list of items, so they can wait
+static const uint32_t contentsChangeEvents = IN_MODIFY | IN_ATTRIB;
+static const int modifiedItemsFlushIntervalMs = 150;
+
+// inotify only reports the changes made through the local kernel, so it's blind to other clients of network file systems and to most FUSE back-ends
+inline bool inotifyIsReliableFor(const QByteArray& path)
+{
+	struct statfs fileSystemInfo;
+	if (::statfs(path.constData(), &fileSystemInfo) != 0)
+		return false;
+
+	switch ((uint32_t)fileSystemInfo.f_type)
+	{
+	case 0x6969u:     // NFS
+	case 0x517Bu:     // SMB
+	case 0xFF534D42u: // CIFS
+	case 0xFE534D42u: // SMB2
+	case 0x564Cu:     // NCP
+	case 0x01021997u: // 9P
+	case 0x73757245u: // Coda
+	case 0x5346414Fu: // AFS
+	case 0x00C36400u: // Ceph
+	case 0x65735546u: // FUSE
+		return false;
+	default:
+		return true;
+	}
+}
+
+CFileSystemWatcherInotify::CFileSystemWatcherInotify()
+{
+	_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotifyFd < 0)
+	{
+		qInfo() << "inotify_init1 failed:" << strerror(errno);
+		return;
+	}
+
+	_notifier = std::make_unique<QSocketNotifier>(_inotifyFd, QSocketNotifier::Read);
+	QObject::connect(_notifier.get(), &QSocketNotifier::activated, [this]() {onEventsAvailable();});
+
+	// Not restarted by every event, or a file that's being written continuously would never be updated
+	_modifiedItemsFlushTimer.setSingleShot(true);
+	_modifiedItemsFlushTimer.setInterval(modifiedItemsFlushIntervalMs);
+	QObject::connect(&_modifiedItemsFlushTimer, &QTimer::timeout, [this]() {flushModifiedItems();});
+}
+
+CFileSystemWatcherInotify::~CFileSystemWatcherInotify()
+{
+	_modifiedItemsFlushTimer.stop();
+	_notifier.reset();
+	if (_inotifyFd >= 0)
+		::close(_inotifyFd);
+}
+
+bool CFileSystemWatcherInotify::setPathToWatch(const QString& path)
+{
+	std::lock_guard<std::recursive_mutex> locker(_pathMutex);
+
+	if (_watchDescriptor >= 0)
+	{
+		::inotify_rm_watch(_inotifyFd, _watchDescriptor);
+		_watchDescriptor = -1;
+	}
+
+	_pathToWatch.clear();
+	_modifiedItems.clear();
+	_modifiedItemsFlushTimer.stop();
+	if (path.isEmpty())
+		return true;
+	else if (_inotifyFd < 0)
+		return false;
+
+	const QByteArray nativePath = QFile::encodeName(path);
+	if (!inotifyIsReliableFor(nativePath))
+		return false;
+
+	_watchDescriptor = ::inotify_add_watch(_inotifyFd, nativePath.constData(), eventsToWatch);
+	if (_watchDescriptor < 0)
+	{
+		// ENOSPC means the fs.inotify.max_user_watches limit has been reached
+		qInfo() << "inotify_add_watch failed for" << path << ":" << strerror(errno);
+		return false;
+	}
+
+	_pathToWatch = path;
+	// The events only name the items, the rest of the information is obtained by comparing against the previous state
+	setPreviousState(QDir(path).entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot));
+	return true;
+}
+
+void CFileSystemWatcherInotify::onEventsAvailable()
+{
+	std::lock_guard<std::recursive_mutex> locker(_pathMutex);
+
+	const QDir directory(_pathToWatch);
+	std::set<QString> changedItems;
+	bool rescanRequired = false;
+
+	alignas(inotify_event) char buffer[64 * 1024];
+	for (ssize_t bytesRead; (bytesRead = ::read(_inotifyFd, buffer, sizeof(buffer))) > 0;)
+	{
+		for (ssize_t offset = 0; offset < bytesRead;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += (ssize_t)(sizeof(inotify_event) + event->len);
+
+			if (event->mask & IN_Q_OVERFLOW)
+				rescanRequired = true; // Some events have been lost
+			else if (event->wd != _watchDescriptor)
+				continue; // A late event for the previously watched folder
+			else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				// The folder itself is gone, listing it will report all of its items as removed
+				rescanRequired = true;
+				if (event->mask & IN_IGNORED)
+					_watchDescriptor = -1;
+			}
+			else if (event->len > 0)
+			{
+				QString itemPath = directory.absoluteFilePath(QFile::decodeName(event->name));
+				if ((event->mask & eventsToWatch & ~contentsChangeEvents) == 0)
+					_modifiedItems.insert(std::move(itemPath));
+				else
+					changedItems.insert(std::move(itemPath));
+			}
+		}
+	}
+
+	if (_pathToWatch.isEmpty())
+		return;
+
+	if (rescanRequired)
+	{
+		_modifiedItems.clear();
+		_modifiedItemsFlushTimer.stop();
+		processChangesAndNotifySubscribers(directory.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot));
+	}
+	else if (!changedItems.empty())
+	{
+		// The pending modified items are checked along with the rest, there's no point in waiting for them any longer
+		changedItems.insert(_modifiedItems.begin(), _modifiedItems.end());
+		_modifiedItems.clear();
+		_modifiedItemsFlushTimer.stop();
+		processChangesAndNotifySubscribers(changedItems);
+	}
+	else if (!_modifiedItems.empty() && !_modifiedItemsFlushTimer.isActive())
+		_modifiedItemsFlushTimer.start();
+}
+
+void CFileSystemWatcherInotify::flushModifiedItems()
+{
+	std::lock_guard<std::recursive_mutex> locker(_pathMutex);
+
+	if (_pathToWatch.isEmpty() || _modifiedItems.empty())
+		return;
+
+	std::set<QString> modifiedItems;
+	modifiedItems.swap(_modifiedItems);
+	processChangesAndNotifySubscribers(modifiedItems);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cfilesystemwatcherinterface.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QSocketNotifier>
+#include <QTimer>
+RESTORE_COMPILER_WARNINGS
+
+#include <memory>
+#include <set>
+
+// Turns the Linux inotify events for the folder into the same notifications the timer-based watcher produces, without any work while nothing changes.
+// The events are delivered by the event loop of the thread that has created the object.
+class CFileSystemWatcherInotify : public detail::CFileSystemWatcherInterface
+{
+public:
+	CFileSystemWatcherInotify();
+	~CFileSystemWatcherInotify() override;
+
+	// Returns false if inotify can't be used for this path: it's unavailable, the watch limit has been reached,
+	// or the path is on a network or FUSE file system where the changes made by other clients don't generate events
+	bool setPathToWatch(const QString &path) override;
+
+private:
+	void onEventsAvailable();
+	void flushModifiedItems();
+
+private:
+	int _inotifyFd = -1;
+	int _watchDescriptor = -1;
+	std::unique_ptr<QSocketNotifier> _notifier;
+
+	// A file being written generates a stream of IN_MODIFY events, its name is only checked once per timer interval
+	std::set<QString> _modifiedItems;
+	QTimer _modifiedItemsFlushTimer;
+};
@@ -0,0 +1,92 @@
+#include "cfilesystemwatcherinterface.h"
+#include "assert/advanced_assert.h"
+#include "container/set_operations.hpp"
+
+void detail::CFileSystemWatcherInterface::addCallback(ChangeDetectedCallback callback)
+{
+	_callbacks.push_back(callback);
+}
+
+inline bool operator==(const QFileInfo& fullInfo, const BasicFileSystemItemInfo& basicInfo)
+{
+	return fullInfo.absoluteFilePath() == basicInfo.fullPath;
+}
+
+inline bool operator<(const QFileInfo& fullInfo, const BasicFileSystemItemInfo& basicInfo)
+{
+	return fullInfo.absoluteFilePath() < basicInfo.fullPath;
+}
+
+void detail::CFileSystemWatcherInterface::processChangesAndNotifySubscribers(const QFileInfoList& newState)
+{
+	// Note: QFileInfo::operator== does exactly what's needed
+	// http://doc.qt.io/qt-5/qfileinfo.html#operator-eq-eq
+	// If this changes, a custom comparator will be required
+
+	std::set<QFileInfo, std::less<>> newItemsSet;
+	std::copy(begin_to_end(newState), std::inserter(newItemsSet, newItemsSet.end()));
+
+	const auto diff = SetOperations::calculateDiff(_previousState, newItemsSet);
+
+	transparent_set<QFileInfo> changedItems;
+	for (const auto& newItem : diff.common_elements)
+	{
+		const auto sameOldItem = container_aware_find(_previousState, newItem);
+		assert(sameOldItem != _previousState.end());
+		if (sameOldItem->fileDetailsChanged(newItem))
+			changedItems.insert(newItem);
+	}
+
+	if (!changedItems.empty() || !diff.elements_from_a_not_in_b.empty() || !diff.elements_from_b_not_in_a.empty())
+	{
+		notifySubscribers(diff.elements_from_b_not_in_a, diff.elements_from_a_not_in_b, changedItems);
+		setPreviousState(newState);
+	}
+}
+
+void detail::CFileSystemWatcherInterface::processChangesAndNotifySubscribers(const std::set<QString>& possiblyChangedItems)
+{
+	transparent_set<QFileInfo> addedItems, removedItems, changedItems;
+	for (const auto& path : possiblyChangedItems)
+	{
+		const QFileInfo newItem(path);
+		// A broken symlink doesn't exist according to QFileInfo, but it's still listed in the folder
+		const bool itemExists = newItem.exists() || newItem.isSymLink();
+		const auto oldItem = container_aware_find(_previousState, newItem);
+		if (oldItem == _previousState.end())
+		{
+			if (itemExists)
+				addedItems.insert(newItem);
+		}
+		else if (!itemExists)
+		{
+			removedItems.insert(newItem);
+			_previousState.erase(oldItem);
+		}
+		else if (oldItem->fileDetailsChanged(newItem))
+		{
+			changedItems.insert(newItem);
+			_previousState.erase(oldItem);
+		}
+	}
+
+	if (addedItems.empty() && removedItems.empty() && changedItems.empty())
+		return;
+
+	notifySubscribers(addedItems, removedItems, changedItems);
+
+	std::copy(begin_to_end(addedItems), std::inserter(_previousState, _previousState.end()));
+	std::copy(begin_to_end(changedItems), std::inserter(_previousState, _previousState.end()));
+}
+
+void detail::CFileSystemWatcherInterface::setPreviousState(const QFileInfoList& state)
+{
+	_previousState.clear();
+	std::copy(begin_to_end(state), std::inserter(_previousState, _previousState.end()));
+}
+
+void detail::CFileSystemWatcherInterface::notifySubscribers(const transparent_set<QFileInfo>& added, const transparent_set<QFileInfo>& removed, const transparent_set<QFileInfo>& changed)
+{
+	for (const auto& callback : _callbacks)
+		callback(added, removed, changed);
+}
@@ -0,0 +1,35 @@
+#include "cfilesystemwatchertimerbased.h"
+#include "assert/advanced_assert.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDir>
+RESTORE_COMPILER_WARNINGS
+
+CFileSystemWatcherTimerBased::CFileSystemWatcherTimerBased()
+{
+	QObject::connect(&_timer, &QTimer::timeout, [this]() {onCheckForChanges();});
+	_timer.start(333);
+}
+
+bool CFileSystemWatcherTimerBased::setPathToWatch(const QString& path)
+{
+	std::lock_guard<std::recursive_mutex> locker(_pathMutex);
+
+	assert_and_return_r(path.isEmpty() || QFileInfo(path).isDir(), false);
+
+	_pathToWatch = path;
+	return true;
+}
+
+void CFileSystemWatcherTimerBased::onCheckForChanges()
+{
+	{
+		std::lock_guard<std::recursive_mutex> locker(_pathMutex);
+		if (_pathToWatch.isEmpty())
+			return;
+	}
+
+	QDir directory(_pathToWatch);
+	const auto state = directory.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+	processChangesAndNotifySubscribers(state);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "cfilesystemwatcherinterface.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QTimer>
+RESTORE_COMPILER_WARNINGS
+
+// Lists the folder periodically and compares the result against the previous state. Works on any file system.
+class CFileSystemWatcherTimerBased : public detail::CFileSystemWatcherInterface
+{
+public:
+	CFileSystemWatcherTimerBased();
+
+	bool setPathToWatch(const QString &path) override;
+
+private:
+	void onCheckForChanges();
+
+private:
+	QTimer _timer;
+};
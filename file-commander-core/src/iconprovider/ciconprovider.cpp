@@ -1,24 +1,75 @@
 #include "ciconprovider.h"
 #include "cfilesystemobject.h"
 #include "ciconproviderimpl.h"
-#include "fasthash.h"
+#include "container/algorithms.hpp"
 #include "assert/advanced_assert.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QIcon>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
+#include <utility>
+
 std::unique_ptr<CIconProvider> CIconProvider::_instance;
 
+// When there are more icons cached by path than this, the least recently used ones are dropped, a quarter of them at a time
+static const int maxIconsByPath = 1000;
+
 const QIcon& CIconProvider::iconForFilesystemObject(const CFileSystemObject &object)
 {
-	if (!_instance)
+	CIconProvider& provider = instance();
+	const QString key = provider.cacheKey(object);
+	if (const QIcon* icon = provider.cachedIcon(key))
+		return *icon;
+
+	const QIcon icon = provider._provider->iconFor(object);
+	assert_r(!icon.isNull());
+	return provider.storeIcon(key, icon.isNull() ? (object.isDir() ? provider._folderPlaceholder : provider._filePlaceholder) : icon);
+}
+
+const QIcon& CIconProvider::iconForFilesystemObjectAsync(const CFileSystemObject& object, bool* placeholder)
+{
+	CIconProvider& provider = instance();
+	const QString key = provider.cacheKey(object);
+	if (placeholder)
+		*placeholder = false;
+	if (const QIcon* icon = provider.cachedIcon(key))
+		return *icon;
+
+	if (placeholder)
+		*placeholder = true;
+
+	bool newRequest = false;
 	{
-		_instance = std::unique_ptr<CIconProvider>(new CIconProvider);
-		settingsChanged();
+		std::lock_guard<std::mutex> lock(provider._requestsMutex);
+		newRequest = provider._requestedKeys.insert(key).second;
 	}
 
-	return _instance->iconFor(object);
+	// A folder's own icon (with the overlays) only comes from the platform
+	if (newRequest)
+		provider.enqueueRequest(Request{key, object.fullAbsolutePath(), object.isDir(), object.isDir() && provider._showOverlayIcons, provider._generation});
+
+	return object.isDir() ? provider._folderPlaceholder : provider._filePlaceholder;
+}
+
+bool CIconProvider::iconResolved(const CFileSystemObject& object)
+{
+	CIconProvider& provider = instance();
+	return provider.cachedIcon(provider.cacheKey(object)) != nullptr;
+}
+
+void CIconProvider::addListener(IconsResolvedListener* listener)
+{
+	CIconProvider& provider = instance();
+	assert_r(std::find(provider._listeners.begin(), provider._listeners.end(), listener) == provider._listeners.end());
+	provider._listeners.push_back(listener);
+}
+
+void CIconProvider::removeListener(IconsResolvedListener* listener)
+{
+	if (_instance)
+		ContainerAlgorithms::erase_all_occurrences(_instance->_listeners, listener);
 }
 
 void CIconProvider::settingsChanged()
@@ -26,49 +77,173 @@ void CIconProvider::settingsChanged()
 	if (_instance && _instance->_provider)
 	{
 		_instance->_provider->settingsChanged();
-		_instance->_iconCache.clear();
-		_instance->_iconForObject.clear();
+		_instance->_showOverlayIcons = CSettings().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool();
+		_instance->_filePlaceholder = _instance->_provider->placeholderIcon(false);
+		_instance->_folderPlaceholder = _instance->_provider->placeholderIcon(true);
+		_instance->_iconByType.clear();
+		_instance->_iconByPath.clear();
+		++_instance->_generation;
+	}
+}
+
+void CIconProvider::uiThreadTimerTick()
+{
+	if (_instance)
+		_instance->_uiQueue.exec(CExecutionQueue::execAll);
+}
+
+CIconProvider::CIconProvider() :
+	_provider(new CIconProviderImpl),
+	_resolverThread(1, "Icon resolver thread")
+{
+}
+
+CIconProvider& CIconProvider::instance()
+{
+	if (!_instance)
+	{
+		_instance = std::unique_ptr<CIconProvider>(new CIconProvider);
+		settingsChanged();
 	}
+
+	return *_instance;
 }
 
-CIconProvider::CIconProvider() : _provider(new CIconProviderImpl)
+QString CIconProvider::cacheKey(const CFileSystemObject& object) const
 {
+	if (object.isDir())
+		return _showOverlayIcons ? object.fullAbsolutePath() : QStringLiteral("*/");
+
+	// These have icons of their own rather than of their type, and the type of a file without an extension may only be known from its contents
+	const QString extension = object.extension().toLower();
+	if (extension.isEmpty() || extension == QLatin1String("exe") || extension == QLatin1String("lnk") || extension == QLatin1String("ico") ||
+		extension == QLatin1String("cur") || extension == QLatin1String("url") || extension == QLatin1String("desktop") || extension == QLatin1String("appimage"))
+		return object.fullAbsolutePath();
+
+	return QStringLiteral("*.") + extension;
 }
 
-inline static qulonglong hash(const CFileSystemObject& object)
+const QIcon* CIconProvider::cachedIcon(const QString& key)
 {
-	const auto properties = object.properties();
-	const auto hashData =
-		QByteArray::fromRawData((const char*) &properties.modificationDate, sizeof(properties.modificationDate)) +
-		QByteArray::fromRawData((const char*) &properties.creationDate, sizeof(properties.creationDate)) +
-		QByteArray::fromRawData((const char*) &properties.size, sizeof(properties.size)) +
-		QByteArray::fromRawData((const char*) &properties.type, sizeof(properties.type));
-
-	return fasthash64(hashData.constData(), hashData.size(), 0) ^ (uint64_t) properties.hash;
+	if (key.startsWith('*'))
+	{
+		const auto it = _iconByType.constFind(key);
+		return it != _iconByType.constEnd() ? &it.value() : nullptr;
+	}
+
+	const auto it = _iconByPath.find(key);
+	if (it == _iconByPath.end())
+		return nullptr;
+
+	it->lastUsed = ++_useCounter;
+	return &it->icon;
 }
 
-const QIcon& CIconProvider::iconFor(const CFileSystemObject& object)
+const QIcon& CIconProvider::storeIcon(const QString& key, const QIcon& icon)
 {
-	const qulonglong objectHash = hash(object);
-	if (_iconForObject.count(objectHash) == 0)
+	if (key.startsWith('*'))
+		return _iconByType[key] = icon;
+
+	if (_iconByPath.size() >= maxIconsByPath && !_iconByPath.contains(key))
+		dropLeastRecentlyUsedIcons();
+
+	PathIcon& pathIcon = _iconByPath[key];
+	pathIcon.icon = icon;
+	pathIcon.lastUsed = ++_useCounter;
+	return pathIcon.icon;
+}
+
+void CIconProvider::dropLeastRecentlyUsedIcons()
+{
+	std::vector<std::pair<uint64_t, QString>> iconsByUse;
+	iconsByUse.reserve((size_t)_iconByPath.size());
+	for (auto it = _iconByPath.cbegin(); it != _iconByPath.cend(); ++it)
+		iconsByUse.emplace_back(it->lastUsed, it.key());
+
+	const size_t numIconsToDrop = iconsByUse.size() / 4 + 1;
+	std::nth_element(iconsByUse.begin(), iconsByUse.begin() + (ptrdiff_t)(numIconsToDrop - 1), iconsByUse.end(), [](const std::pair<uint64_t, QString>& l, const std::pair<uint64_t, QString>& r) {
+		return l.first < r.first;
+	});
+
+	for (size_t i = 0; i < numIconsToDrop; ++i)
+		_iconByPath.remove(iconsByUse[i].second);
+}
+
+void CIconProvider::enqueueRequest(Request request)
+{
+	bool startResolver = false;
+	{
+		std::lock_guard<std::mutex> lock(_requestsMutex);
+		_pendingRequests.push_back(std::move(request));
+		startResolver = !_resolverBusy;
+		_resolverBusy = true;
+	}
+
+	if (startResolver)
+	{
+		_resolverThread.enqueue([this]() {
+			resolvePendingRequests();
+		});
+	}
+}
+
+void CIconProvider::resolvePendingRequests()
+{
+	for (;;)
 	{
-		const QIcon icon = _provider->iconFor(object);
-		assert_r(!icon.isNull());
+		std::vector<Request> requests;
+		{
+			std::lock_guard<std::mutex> lock(_requestsMutex);
+			if (_pendingRequests.empty())
+			{
+				_resolverBusy = false;
+				return;
+			}
 
-		const auto qimage = icon.pixmap(icon.availableSizes().front()).toImage();
-		const qulonglong iconHash = fasthash64((const char*) qimage.constBits(), qimage.bytesPerLine() * qimage.height(), 0);
+			requests.swap(_pendingRequests);
+		}
 
-		if (_iconCache.size() > 300)
+		std::vector<std::pair<Request, CIconProviderImpl::IconData>> results;
+		results.reserve(requests.size());
+		for (Request& request: requests)
 		{
-			_iconCache.clear();
-			_iconForObject.clear();
+			CIconProviderImpl::IconData data = _provider->iconData(request.path, request.isDir, request.platformIcon);
+			results.emplace_back(std::move(request), std::move(data));
 		}
 
-		const auto iconInContainer = _iconCache.insert(std::make_pair(iconHash, icon)).first;
-		_iconForObject[objectHash] = iconHash;
+		// The whole batch is delivered at once, and the listeners are notified once per batch
+		_uiQueue.enqueue([this, results = std::move(results)]() {
+			bool iconsAdded = false;
+			for (const auto& result: results)
+			{
+				const bool currentSettings = result.first.generation == _generation;
+				const QIcon icon = currentSettings ? _provider->icon(result.second) : QIcon();
+				if (currentSettings && icon.isNull() && !result.first.platformIcon)
+				{
+					// Not in the icon theme, the platform's icon is resolved in the background as well. The key remains requested.
+					Request request = result.first;
+					request.platformIcon = true;
+					enqueueRequest(std::move(request));
+					continue;
+				}
 
-		return iconInContainer->second;
-	}
+				{
+					std::lock_guard<std::mutex> lock(_requestsMutex);
+					_requestedKeys.erase(result.first.key);
+				}
+
+				if (!currentSettings)
+					continue;
 
-	return _iconCache[_iconForObject[objectHash]];
+				storeIcon(result.first.key, icon.isNull() ? (result.first.isDir ? _folderPlaceholder : _filePlaceholder) : icon);
+				iconsAdded = true;
+			}
+
+			if (iconsAdded)
+			{
+				for (IconsResolvedListener* listener: _listeners)
+					listener->iconsResolved();
+			}
+		});
+	}
 }
@@ -1,37 +1,101 @@
 #ifndef CICONPROVIDER_H
 #define CICONPROVIDER_H
 
+#include "threading/cexecutionqueue.h"
+#include "threading/cworkerthread.h"
 #include "compiler/compiler_warnings_control.h"
 
 DISABLE_COMPILER_WARNINGS
+#include <QHash>
 #include <QIcon>
+#include <QString>
 RESTORE_COMPILER_WARNINGS
 
-#include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <vector>
 
 class CFileSystemObject;
 class CIconProviderImpl;
 
-class CIconProviderImpl;
-
+// The icons are cached at two levels: most files get the icon of their type, which only depends on the extension (and all the folders share one),
+// while the files whose icons are their own (executables, shortcuts, files without an extension) are cached by path.
+// Everything but the resolver thread is only to be used on the UI thread.
 class CIconProvider
 {
 public:
+	// Gets notified whenever a batch of icons requested by iconForFilesystemObjectAsync() has been resolved
+	class IconsResolvedListener
+	{
+	public:
+		virtual ~IconsResolvedListener() = default;
+		virtual void iconsResolved() = 0;
+	};
+
+	// Resolves the icon on the calling thread, unless it's cached
 	static const QIcon& iconForFilesystemObject(const CFileSystemObject& object);
+	// Never waits for the file system: returns the cached icon, or a generic file or folder icon while the actual one is being resolved in the background
+	static const QIcon& iconForFilesystemObjectAsync(const CFileSystemObject& object, bool* placeholder = nullptr);
+	// True if the actual icon is cached and iconForFilesystemObjectAsync() will return it
+	static bool iconResolved(const CFileSystemObject& object);
+
+	static void addListener(IconsResolvedListener* listener);
+	static void removeListener(IconsResolvedListener* listener);
+
 	static void settingsChanged();
 
+	// Delivers the resolved icons, must be called on the UI thread
+	static void uiThreadTimerTick();
+
 private:
+	struct Request {
+		QString key;
+		QString path;
+		bool isDir;
+		bool platformIcon; // See CIconProviderImpl::iconData()
+		uint32_t generation;
+	};
+
+	struct PathIcon {
+		QIcon icon;
+		uint64_t lastUsed;
+	};
+
 	CIconProvider();
-	const QIcon& iconFor(const CFileSystemObject& object);
+	static CIconProvider& instance();
+
+	// Type keys start with '*', which a path can't
+	QString cacheKey(const CFileSystemObject& object) const;
+	const QIcon* cachedIcon(const QString& key);
+	const QIcon& storeIcon(const QString& key, const QIcon& icon);
+	void dropLeastRecentlyUsedIcons();
+
+	// The key must be in _requestedKeys already
+	void enqueueRequest(Request request);
+	// Runs on the resolver thread until there are no more requests
+	void resolvePendingRequests();
 
 private:
 	static std::unique_ptr<CIconProvider> _instance;
 
-	std::unordered_map<qulonglong, QIcon> _iconCache;
-	std::unordered_map<qulonglong, qulonglong> _iconForObject;
+	QHash<QString, QIcon> _iconByType;
+	QHash<QString, PathIcon> _iconByPath;
+	uint64_t _useCounter = 0;
+	QIcon _filePlaceholder, _folderPlaceholder;
+	std::vector<IconsResolvedListener*> _listeners;
+	bool _showOverlayIcons = false;
+	uint32_t _generation = 0; // Incremented when the settings change, so that the icons resolved with the old ones are discarded
+
+	std::mutex _requestsMutex;
+	std::vector<Request> _pendingRequests;
+	std::set<QString> _requestedKeys; // Pending or being resolved, so that every icon is only requested once
+	bool _resolverBusy = false;
 
 	std::unique_ptr<CIconProviderImpl> _provider;
+	CExecutionQueue _uiQueue;
+	CWorkerThreadPool _resolverThread;
 };
 
 #endif // CICONPROVIDER_H
@@ -5,37 +5,76 @@
 
 DISABLE_COMPILER_WARNINGS
 #ifdef _WIN32
+#include <QImage>
 #include <QtWin>
 #else
 #include <QFileIconProvider>
+#include <QImage>
+#include <QMimeDatabase>
+#include <QStringList>
 #endif
 RESTORE_COMPILER_WARNINGS
 
+#include <vector>
+
+// Resolving an icon is split in two: the slow part, which queries the file system and runs on the resolver thread,
+// produces IconData, which only holds images; turning it into a QIcon (which is only allowed on the UI thread) is cheap.
+// If icon() returns a null icon, the platform's icon of the particular file is needed: iconData() is called again with platformIcon set.
+// iconFor() does everything on the calling thread.
+
 #ifdef _WIN32
 
+#include <objbase.h>
 #include <shellapi.h>
+#pragma comment(lib, "Ole32.lib")
 #pragma comment(lib, "Shell32.lib")
 #pragma comment(lib, "User32.lib")
 
 class CIconProviderImpl
 {
 public:
+	struct IconData {
+		QImage image;
+	};
+
 	inline QIcon iconFor(const CFileSystemObject& object)
 	{
-		QIcon icon;
+		return icon(iconData(object.fullAbsolutePath(), object.isDir(), true));
+	}
+
+	// Thread-safe. The shell's icon is always the platform's own.
+	inline IconData iconData(QString path, bool isDir, bool /*platformIcon*/) const
+	{
+		// The shell requires COM on the calling thread
+		const bool comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED));
+
+		IconData data;
 		SHFILEINFO info;
 		memset(&info, 0, sizeof(info));
-		SHGetFileInfoW((WCHAR*)object.fullAbsolutePath().replace('/', '\\').utf16(), object.isDir() ? FILE_ATTRIBUTE_DIRECTORY : 0, &info, sizeof(SHFILEINFO),
+		SHGetFileInfoW((WCHAR*)path.replace('/', '\\').utf16(), isDir ? FILE_ATTRIBUTE_DIRECTORY : 0, &info, sizeof(SHFILEINFO),
 					   SHGFI_ICON | SHGFI_USEFILEATTRIBUTES | SHGFI_SMALLICON | (_showOverlayIcons ? SHGFI_ADDOVERLAYS : 0));
 
 		if (info.hIcon)
 		{
-			icon = QIcon(QtWin::fromHICON(info.hIcon));
+			data.image = QtWin::imageFromHICON(info.hIcon);
 			DestroyIcon(info.hIcon);
 		}
 
-		auto sizes = icon.availableSizes();
-		return icon;
+		if (comInitialized)
+			CoUninitialize();
+
+		return data;
+	}
+
+	inline QIcon icon(const IconData& data) const
+	{
+		return data.image.isNull() ? QIcon() : QIcon(QPixmap::fromImage(data.image));
+	}
+
+	// The generic icon, without looking at any particular file
+	inline QIcon placeholderIcon(bool isDir) const
+	{
+		return icon(iconData(isDir ? QStringLiteral("folder") : QStringLiteral("file"), isDir, true));
 	}
 
 	inline void settingsChanged()
@@ -52,11 +91,70 @@ private:
 class CIconProviderImpl
 {
 public:
+	struct IconData {
+		QStringList themeIconNames; // The most specific one first
+		std::vector<QImage> platformIcon; // At a couple of sizes, only if asked for
+		bool isDir = false;
+	};
+
 	inline QIcon iconFor(const CFileSystemObject& object)
 	{
 		return _provider.icon(object.qFileInfo());
 	}
 
+	// Only to be called on the resolver thread. Determining the MIME type of a file may require reading it.
+	// platformIcon is for the icon of the particular file or folder rather than of its type, which takes even longer.
+	inline IconData iconData(const QString& path, bool isDir, bool platformIcon)
+	{
+		IconData data;
+		data.isDir = isDir;
+		if (platformIcon)
+		{
+			// The resolver thread has a provider of its own, and only the images are handed over to the UI thread
+			const QIcon icon = _resolverThreadProvider.icon(QFileInfo(path));
+			for (const int size: {16, 32})
+			{
+				const QImage image = icon.pixmap(size, size).toImage();
+				if (!image.isNull())
+					data.platformIcon.push_back(image);
+			}
+		}
+		else if (!isDir)
+		{
+			const QMimeType type = QMimeDatabase().mimeTypeForFile(path);
+			data.themeIconNames << type.iconName() << type.genericIconName();
+		}
+
+		return data;
+	}
+
+	inline QIcon icon(const IconData& data)
+	{
+		if (!data.platformIcon.empty())
+		{
+			QIcon icon;
+			for (const QImage& image: data.platformIcon)
+				icon.addPixmap(QPixmap::fromImage(image));
+			return icon;
+		}
+		else if (data.isDir)
+			return _provider.icon(QFileIconProvider::Folder);
+
+		for (const QString& name: data.themeIconNames)
+		{
+			if (QIcon::hasThemeIcon(name))
+				return QIcon::fromTheme(name);
+		}
+
+		// No icon theme (e. g. on macOS), the platform's icon is needed
+		return QIcon();
+	}
+
+	inline QIcon placeholderIcon(bool isDir)
+	{
+		return _provider.icon(isDir ? QFileIconProvider::Folder : QFileIconProvider::File);
+	}
+
 	inline void settingsChanged()
 	{
 		_showOverlayIcons = CSettings().value(KEY_INTERFACE_SHOW_SPECIAL_FOLDER_ICONS, false).toBool();
@@ -70,7 +168,7 @@ public:
 private:
 	bool _showOverlayIcons = false;
 	QFileIconProvider _provider;
+	QFileIconProvider _resolverThreadProvider;
 };
 
 #endif
-
@@ -17,7 +17,7 @@ void CPluginProxy::createToolMenuEntries(const MenuTree& menuTree)
 	createToolMenuEntries(std::vector<MenuTree>(1, menuTree));
 }
 
-void CPluginProxy::panelContentsChanged(PanelPosition panel, const QString &folder, const std::map<qulonglong, CFileSystemObject>& contents)
+void CPluginProxy::panelContentsChanged(PanelPosition panel, const QString &folder, const std::shared_ptr<const std::map<qulonglong, CFileSystemObject>>& contents)
 {
 	PanelState& state = _panelState[panel];
 
@@ -110,10 +110,10 @@ const CFileSystemObject& CPluginProxy::currentItemForPanel(const PanelPosition p
 	static const CFileSystemObject dummy;
 
 	const PanelState& state = panelState(panel);
-	if (state.currentItemHash != 0)
+	if (state.currentItemHash != 0 && state.panelContents)
 	{
-		auto fileSystemObject = state.panelContents.find(state.currentItemHash);
-		assert_and_return_r(fileSystemObject != state.panelContents.end(), dummy);
+		auto fileSystemObject = state.panelContents->find(state.currentItemHash);
+		assert_and_return_r(fileSystemObject != state.panelContents->end(), dummy);
 
 		return fileSystemObject->second;
 	}
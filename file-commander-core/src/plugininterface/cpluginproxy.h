@@ -7,15 +7,16 @@ DISABLE_COMPILER_WARNINGS
 RESTORE_COMPILER_WARNINGS
 
 #include <functional>
+#include <memory>
 #include <vector>
 #include <map>
 
 
 struct PanelState {
-	std::map<qulonglong/*hash*/, CFileSystemObject> panelContents;
-	std::vector<qulonglong/*hash*/>                 selectedItemsHashes;
-	qulonglong                                      currentItemHash = 0;
-	QString                                         currentFolder;
+	std::shared_ptr<const std::map<qulonglong/*hash*/, CFileSystemObject>> panelContents; // The panel's own immutable snapshot, shared rather than copied
+	std::vector<qulonglong/*hash*/>                                        selectedItemsHashes;
+	qulonglong                                                             currentItemHash = 0;
+	QString                                                                currentFolder;
 };
 
 enum PanelPosition {PluginLeftPanel, PluginRightPanel, PluginUnknownPanel};
@@ -45,7 +46,7 @@ public:
 	void createToolMenuEntries(const MenuTree& menuTree);
 
 // Events and data updates from the core
-	void panelContentsChanged(PanelPosition panel, const QString& folder, const std::map<qulonglong /*hash*/, CFileSystemObject>& contents);
+	void panelContentsChanged(PanelPosition panel, const QString& folder, const std::shared_ptr<const std::map<qulonglong /*hash*/, CFileSystemObject>>& contents);
 
 // Events and data updates from UI
 	void selectionChanged(PanelPosition panel, const std::vector<qulonglong/*hash*/>& selectedItemsHashes);
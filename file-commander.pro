@@ -1,6 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS += qt_app qtutils text_encoding_detector file_commander_core autoupdater cpputils image-processing
+SUBDIRS += qt_app cli_app qtutils text_encoding_detector file_commander_core autoupdater cpputils image-processing
 SUBDIRS += textviewerplugin cpp-template-utils imageviewerplugin filecomparisonplugin
 
 qtutils.depends = cpputils
@@ -25,5 +25,8 @@ text_encoding_detector.depends = cpputils
 
 image-processing.depends = cpputils
 
+cli_app.subdir  = cli-app
+cli_app.depends = file_commander_core qtutils
+
 qt_app.subdir  = qt-app
 qt_app.depends = file_commander_core qtutils imageviewerplugin textviewerplugin autoupdater image-processing
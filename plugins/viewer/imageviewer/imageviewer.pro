@@ -73,12 +73,14 @@ linux*|mac*{
 HEADERS += \
 	src/cimageviewerplugin.h \
 	src/cimageviewerwidget.h \
-	src/cimageviewerwindow.h
+	src/cimageviewerwindow.h \
+	src/ctiledimagedecoder.h
 
 SOURCES += \
 	src/cimageviewerplugin.cpp \
 	src/cimageviewerwidget.cpp \
-	src/cimageviewerwindow.cpp
+	src/cimageviewerwindow.cpp \
+	src/ctiledimagedecoder.cpp
 
 win32*:!*msvc2012:*msvc* {
 	QMAKE_CXXFLAGS += /FS
@@ -8,50 +8,53 @@ DISABLE_COMPILER_WARNINGS
 #include <QImageReader>
 #include <QMainWindow>
 #include <QMessageBox>
+#include <QMouseEvent>
 #include <QPainter>
-#include <QTimer>
+#include <QWheelEvent>
 RESTORE_COMPILER_WARNINGS
 
-CImageViewerWidget::CImageViewerWidget(QWidget *parent) :
-	QWidget(parent)
+#include <algorithm>
+#include <cmath>
+
+// Zooming in stops at this many displayed pixels per image pixel
+static const double maxDisplayScale = 8.0;
+
+static QSize maxWidgetSize()
 {
-	// To avoid double image rendering - on show and on resize
-	setUpdatesEnabled(false);
+	return QApplication::desktop()->availableGeometry().size() - QSize(30, 100);
 }
 
-bool CImageViewerWidget::displayImage(const QImage& image)
+static QSize fitToScreen(QSize imageSize)
 {
-	_sourceImage = image;
-	if (image.isNull())
-		return false;
+	const QSize screenSize = maxWidgetSize();
+	if (imageSize.height() > screenSize.height() || imageSize.width() > screenSize.width())
+		imageSize.scale(screenSize, Qt::KeepAspectRatio);
 
-	const QSize screenSize = QApplication::desktop()->availableGeometry().size() - QSize(30, 100);
-	QSize widgetSize = _sourceImage.size();
-	if (widgetSize.height() > screenSize.height() || widgetSize.width() > screenSize.width())
-		widgetSize.scale(screenSize, Qt::KeepAspectRatio);
-
-	resize(widgetSize);
+	return imageSize;
+}
 
-	QTimer::singleShot(0, [this]() {
-		// Apparently, we need the timer in order for the resize to actually be applied before parent's resize
-		QMainWindow * mainWindow = nullptr;
-		for (QWidget * widget = dynamic_cast<QWidget*>(parent()); widget != nullptr; widget = dynamic_cast<QWidget*>(widget->parent()))
-		{
-			widget->resize(widget->sizeHint());
-			if (!mainWindow)
-				mainWindow = dynamic_cast<QMainWindow*>(widget);
-		}
+CImageViewerWidget::CImageViewerWidget(QWidget *parent) :
+	QWidget(parent)
+{
+	// To avoid double image rendering - on show and on resize
+	setUpdatesEnabled(false);
 
-		if (mainWindow)
-		{
-			const auto availableGeometry = QApplication::desktop()->availableGeometry();
-			mainWindow->move(QPoint(availableGeometry.width()/2 - mainWindow->frameGeometry().width()/2, availableGeometry.height()/2 - mainWindow->frameGeometry().height()/2));
-		}
+	_tileDecoderTimer.setInterval(30);
+	connect(&_tileDecoderTimer, &QTimer::timeout, [this]() {
+		if (_tileDecoder.collectDecodedTiles())
+			update();
 
-		setUpdatesEnabled(true);
+		if (!_tileDecoder.busy())
+			_tileDecoderTimer.stop();
 	});
+}
 
-	return true;
+bool CImageViewerWidget::displayImage(const QImage& image)
+{
+	// The image is already decoded in full, no tiles needed
+	_tileDecoder.clear();
+	_imageSize = image.size();
+	return displayPreview(image);
 }
 
 bool CImageViewerWidget::displayImage(const QString& imagePath)
@@ -60,16 +63,38 @@ bool CImageViewerWidget::displayImage(const QString& imagePath)
 	reader.setDecideFormatFromContent(true);
 
 	_currentImageFormat = QString::fromLatin1(reader.format()); // Must be called before read()
+
+	// Only the header has been read so far. If the format supports it, the image is decoded right at the size it's displayed at (JPEG, for one, decodes at 1/2, 1/4 or 1/8 of the resolution natively).
+	const QSize imageSize = reader.size();
+	const bool scaledDecoding = imageSize.isValid() && fitToScreen(imageSize) != imageSize && reader.supportsOption(QImageIOHandler::ScaledSize);
+	if (scaledDecoding)
+		reader.setScaledSize(fitToScreen(imageSize));
+
+	const bool clipRectSupported = reader.supportsOption(QImageIOHandler::ClipRect);
+
 	QImage img = reader.read();
 	if (!img.isNull())
 	{
 		_currentImageFileSize = reader.device()->size();
-		return displayImage(img);
+		_imageSize = imageSize.isValid() ? imageSize : img.size();
+
+		// Only the preview is kept, the full resolution is decoded again when zoomed in
+		const QSize previewSize = fitToScreen(_imageSize);
+		if (img.size() != previewSize)
+			img = CImageResizer::resize(img, previewSize, CImageResizer::Smart);
+
+		if (previewSize != _imageSize)
+			_tileDecoder.setImage(imagePath, _imageSize, clipRectSupported);
+		else
+			_tileDecoder.clear();
+
+		return displayPreview(img);
 	}
 
 	_currentImageFileSize = 0;
 	_currentImageFormat.clear();
-	
+	_tileDecoder.clear();
+
 	QMessageBox::warning(dynamic_cast<QWidget*>(parent()), tr("Failed to load the image"), tr("Failed to load the image\n\n%1\n\nIt is inaccessible, doesn't exist or is not a supported image file.").arg(imagePath));
 	return false;
 }
@@ -81,11 +106,11 @@ QString CImageViewerWidget::imageInfoString() const
 
 	const int numChannels = _sourceImage.isGrayscale() ? 1 : (3 + (_sourceImage.hasAlphaChannel() ? 1 : 0));
 	return _currentImageFormat.toUpper() + ' ' + tr("%1x%2, %3 channels, %4 bits per pixel, compressed to %5 bits per pixel").
-		arg(_sourceImage.width()).
-		arg(_sourceImage.height()).
+		arg(_imageSize.width()).
+		arg(_imageSize.height()).
 		arg(numChannels).
 		arg(_sourceImage.bitPlaneCount()).
-		arg(QString::number(8 * _currentImageFileSize / (double(_sourceImage.width()) * _sourceImage.height()), 'f', 2));
+		arg(QString::number(8 * _currentImageFileSize / (double(_imageSize.width()) * _imageSize.height()), 'f', 2));
 }
 
 QSize CImageViewerWidget::sizeHint() const
@@ -108,9 +133,167 @@ QIcon CImageViewerWidget::imageIcon(const QList<QSize>& sizes) const
 
 void CImageViewerWidget::paintEvent(QPaintEvent*)
 {
-	if (_scaledImage.isNull() || _scaledImage.size() != _sourceImage.size().scaled(size(), Qt::KeepAspectRatio))
-		_scaledImage = CImageResizer::resize(_sourceImage, size(), CImageResizer::Smart);
+	if (_sourceImage.isNull())
+		return;
 
-	if (!_sourceImage.isNull())
-		QPainter(this).drawImage(0, 0, _scaledImage);
+	QPainter painter(this);
+	if (_zoom <= 1.0)
+	{
+		_tileDecoder.cancelRequests();
+
+		if (_scaledImage.isNull() || _scaledImage.size() != _sourceImage.size().scaled(size(), Qt::KeepAspectRatio))
+			_scaledImage = CImageResizer::resize(_sourceImage, size(), CImageResizer::Smart);
+
+		painter.drawImage(0, 0, _scaledImage);
+		return;
+	}
+
+	// The preview stretched stands in for the tiles that haven't been decoded yet
+	painter.setRenderHint(QPainter::SmoothPixmapTransform);
+	const QRectF visibleRect = QRectF(widgetToImage(QPointF(0.0, 0.0)), widgetToImage(QPointF(width(), height()))).intersected(QRectF(QPointF(0.0, 0.0), QSizeF(_imageSize)));
+	const double previewScale = _sourceImage.width() / (double)_imageSize.width();
+	painter.drawImage(imageToWidget(visibleRect), _sourceImage, QRectF(visibleRect.topLeft() * previewScale, visibleRect.size() * previewScale));
+
+	if (displayScale() <= previewScale)
+	{
+		_tileDecoder.cancelRequests();
+		return;
+	}
+
+	if (!_tileDecoder.paint(painter, visibleRect, displayScale(), [this](const QRectF& rect) { return imageToWidget(rect); }) && !_tileDecoderTimer.isActive())
+		_tileDecoderTimer.start();
+}
+
+void CImageViewerWidget::resizeEvent(QResizeEvent* e)
+{
+	QWidget::resizeEvent(e);
+	clampCenter();
+}
+
+void CImageViewerWidget::wheelEvent(QWheelEvent* e)
+{
+	if (_sourceImage.isNull() || e->angleDelta().y() == 0)
+		return QWidget::wheelEvent(e);
+
+	setZoom(_zoom * std::pow(1.25, e->angleDelta().y() / 120.0), e->posF());
+	e->accept();
+}
+
+void CImageViewerWidget::mousePressEvent(QMouseEvent* e)
+{
+	_lastDragPosition = e->pos();
+	QWidget::mousePressEvent(e);
+}
+
+void CImageViewerWidget::mouseMoveEvent(QMouseEvent* e)
+{
+	if (!(e->buttons() & Qt::LeftButton) || _zoom <= 1.0)
+		return QWidget::mouseMoveEvent(e);
+
+	_center -= QPointF(e->pos() - _lastDragPosition) / displayScale();
+	_lastDragPosition = e->pos();
+	clampCenter();
+	update();
+}
+
+void CImageViewerWidget::mouseDoubleClickEvent(QMouseEvent* e)
+{
+	if (_zoom <= 1.0)
+		return QWidget::mouseDoubleClickEvent(e);
+
+	resetZoom();
+	update();
+}
+
+bool CImageViewerWidget::displayPreview(const QImage& preview)
+{
+	_sourceImage = preview;
+	_scaledImage = QImage();
+	resetZoom();
+	if (preview.isNull())
+		return false;
+
+	resize(fitToScreen(_imageSize));
+
+	QTimer::singleShot(0, [this]() {
+		// Apparently, we need the timer in order for the resize to actually be applied before parent's resize
+		QMainWindow * mainWindow = nullptr;
+		for (QWidget * widget = dynamic_cast<QWidget*>(parent()); widget != nullptr; widget = dynamic_cast<QWidget*>(widget->parent()))
+		{
+			widget->resize(widget->sizeHint());
+			if (!mainWindow)
+				mainWindow = dynamic_cast<QMainWindow*>(widget);
+		}
+
+		if (mainWindow)
+		{
+			const auto availableGeometry = QApplication::desktop()->availableGeometry();
+			mainWindow->move(QPoint(availableGeometry.width()/2 - mainWindow->frameGeometry().width()/2, availableGeometry.height()/2 - mainWindow->frameGeometry().height()/2));
+		}
+
+		setUpdatesEnabled(true);
+	});
+
+	return true;
+}
+
+double CImageViewerWidget::displayScale() const
+{
+	if (_imageSize.isEmpty())
+		return 1.0;
+
+	const double fitScale = std::min(width() / (double)_imageSize.width(), height() / (double)_imageSize.height());
+	return fitScale * _zoom;
+}
+
+QPointF CImageViewerWidget::imageToWidget(const QPointF& point) const
+{
+	return (point - _center) * displayScale() + QPointF(width() / 2.0, height() / 2.0);
+}
+
+QRectF CImageViewerWidget::imageToWidget(const QRectF& rect) const
+{
+	return QRectF(imageToWidget(rect.topLeft()), imageToWidget(rect.bottomRight()));
+}
+
+QPointF CImageViewerWidget::widgetToImage(const QPointF& point) const
+{
+	return (point - QPointF(width() / 2.0, height() / 2.0)) / displayScale() + _center;
+}
+
+void CImageViewerWidget::setZoom(double zoom, const QPointF& anchor)
+{
+	if (_imageSize.isEmpty())
+		return;
+
+	// The point under the anchor stays where it is
+	const QPointF anchorInImage = widgetToImage(anchor);
+	const double maxZoom = std::max(1.0, _zoom * maxDisplayScale / displayScale());
+	_zoom = std::max(1.0, std::min(zoom, maxZoom));
+	_center = anchorInImage - (anchor - QPointF(width() / 2.0, height() / 2.0)) / displayScale();
+	clampCenter();
+	update();
+}
+
+void CImageViewerWidget::resetZoom()
+{
+	_zoom = 1.0;
+	_center = QPointF(_imageSize.width() / 2.0, _imageSize.height() / 2.0);
+}
+
+void CImageViewerWidget::clampCenter()
+{
+	// No empty space around the image unless it's smaller than the widget along that axis
+	const double scale = displayScale();
+	const double halfWidth = width() / (2.0 * scale), halfHeight = height() / (2.0 * scale);
+
+	if (_imageSize.width() <= 2.0 * halfWidth)
+		_center.setX(_imageSize.width() / 2.0);
+	else
+		_center.setX(std::max(halfWidth, std::min(_center.x(), _imageSize.width() - halfWidth)));
+
+	if (_imageSize.height() <= 2.0 * halfHeight)
+		_center.setY(_imageSize.height() / 2.0);
+	else
+		_center.setY(std::max(halfHeight, std::min(_center.y(), _imageSize.height() - halfHeight)));
 }
@@ -1,15 +1,22 @@
 #ifndef CIMAGEVIEWERWIDGET_H
 #define CIMAGEVIEWERWIDGET_H
 
+#include "ctiledimagedecoder.h"
 #include "compiler/compiler_warnings_control.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QIcon>
 #include <QImage>
+#include <QPointF>
+#include <QRectF>
 #include <QSize>
+#include <QTimer>
 #include <QWidget>
 RESTORE_COMPILER_WARNINGS
 
+// Displays the image fit into the widget; zoomed in with the mouse wheel, panned by dragging and reset with a double click.
+// Files are decoded at no more than the size they're displayed at if the format can do that, and when zoomed in the visible details are decoded tile by tile in the background,
+// so the memory used and the time to open an image depend on the screen size rather than on the image size.
 class CImageViewerWidget : public QWidget
 {
 public:
@@ -26,10 +33,37 @@ public:
 
 protected:
 	void paintEvent(QPaintEvent* e) override;
+	void resizeEvent(QResizeEvent* e) override;
+	void wheelEvent(QWheelEvent* e) override;
+	void mousePressEvent(QMouseEvent* e) override;
+	void mouseMoveEvent(QMouseEvent* e) override;
+	void mouseDoubleClickEvent(QMouseEvent* e) override;
 
 private:
-	QImage _sourceImage;
+	// The preview is the image scaled down to no more than the screen size
+	bool displayPreview(const QImage& preview);
+
+	// The displayed size of a full resolution image pixel
+	double displayScale() const;
+	QPointF imageToWidget(const QPointF& point) const;
+	QRectF imageToWidget(const QRectF& rect) const;
+	QPointF widgetToImage(const QPointF& point) const;
+
+	void setZoom(double zoom, const QPointF& anchor);
+	void resetZoom();
+	void clampCenter();
+
+private:
+	QImage _sourceImage; // The preview
 	QImage _scaledImage;
+	QSize _imageSize; // The full resolution
+
+	double _zoom = 1.0; // Relative to the image fit into the widget
+	QPointF _center; // The point of the full resolution image displayed in the center of the widget
+	QPoint _lastDragPosition;
+
+	CTiledImageDecoder _tileDecoder;
+	QTimer _tileDecoderTimer;
 
 	QString _currentImageFormat;
 	qint64 _currentImageFileSize = 0;
@@ -0,0 +1,275 @@
+#include "ctiledimagedecoder.h"
+#include "assert/advanced_assert.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QImageReader>
+#include <QPainter>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <cmath>
+
+// The least recently drawn tiles are dropped when the decoded ones take more than this
+static const size_t maxCacheSizeInBytes = 256 * 1024 * 1024;
+
+bool CTiledImageDecoder::TileKey::operator<(const TileKey& other) const
+{
+	if (level != other.level)
+		return level < other.level;
+	else if (row != other.row)
+		return row < other.row;
+	else
+		return column < other.column;
+}
+
+CTiledImageDecoder::CTiledImageDecoder() :
+	_decoderThreads(2, "Image tile decoder thread")
+{
+}
+
+CTiledImageDecoder::~CTiledImageDecoder()
+{
+	// The queued requests are skipped
+	clear();
+}
+
+void CTiledImageDecoder::setImage(const QString& imagePath, const QSize& imageSize, bool clipRectSupported)
+{
+	clear();
+
+	_imagePath = imagePath;
+	_imageSize = imageSize;
+	_clipRectSupported = clipRectSupported;
+}
+
+void CTiledImageDecoder::clear()
+{
+	{
+		std::lock_guard<std::mutex> lock(_requestsMutex);
+		++_generation;
+		_requestedTiles.clear();
+		_wantedTiles.clear();
+		_decodedTiles.clear();
+	}
+
+	_tiles.clear();
+	_tilesSizeInBytes = 0;
+	_imagePath.clear();
+	_imageSize = QSize();
+}
+
+bool CTiledImageDecoder::paint(QPainter& painter, const QRectF& sourceRect, double scale, const std::function<QRectF (const QRectF&)>& imageToWidget)
+{
+	if (_imagePath.isEmpty() || _imageSize.isEmpty())
+		return true;
+
+	assert_and_return_r(scale > 0.0, true);
+
+	// The coarsest level that still has at least one decoded pixel per displayed pixel
+	int level = 1;
+	if (_clipRectSupported)
+	{
+		while (level < 256 && 2.0 * level * scale <= 1.0)
+			level *= 2;
+	}
+
+	const int tileSide = _clipRectSupported ? tileSize * level : std::max(_imageSize.width(), _imageSize.height());
+	const QRectF visibleRect = sourceRect.intersected(QRectF(QPointF(0.0, 0.0), QSizeF(_imageSize)));
+	if (visibleRect.isEmpty())
+		return true;
+
+	const int firstColumn = (int)(visibleRect.left() / tileSide), lastColumn = (int)std::ceil(visibleRect.right() / tileSide) - 1;
+	const int firstRow = (int)(visibleRect.top() / tileSide), lastRow = (int)std::ceil(visibleRect.bottom() / tileSide) - 1;
+
+	std::vector<TileKey> missingTiles;
+	for (int row = firstRow; row <= lastRow; ++row)
+	{
+		for (int column = firstColumn; column <= lastColumn; ++column)
+		{
+			const TileKey key {_clipRectSupported ? level : 1, column, row};
+			const auto tile = _tiles.find(key);
+			if (tile == _tiles.end())
+			{
+				missingTiles.push_back(key);
+				continue;
+			}
+
+			tile->second.lastUsed = ++_useCounter;
+			if (!tile->second.image.isNull()) // Failed to decode
+				painter.drawImage(imageToWidget(QRectF(tileRect(key, _imageSize, _clipRectSupported))), tile->second.image);
+		}
+	}
+
+	requestTiles(missingTiles);
+	return missingTiles.empty();
+}
+
+void CTiledImageDecoder::cancelRequests()
+{
+	requestTiles({});
+}
+
+bool CTiledImageDecoder::collectDecodedTiles()
+{
+	std::vector<std::pair<TileKey, QImage>> decodedTiles;
+	{
+		std::lock_guard<std::mutex> lock(_requestsMutex);
+		decodedTiles.swap(_decodedTiles);
+	}
+
+	for (auto& decodedTile: decodedTiles)
+	{
+		// Stored as if it has failed to decode so that it's not requested again
+		if ((size_t)decodedTile.second.byteCount() > maxCacheSizeInBytes)
+			decodedTile.second = QImage();
+
+		Tile& tile = _tiles[decodedTile.first];
+		_tilesSizeInBytes -= (size_t)tile.image.byteCount();
+		tile.image = std::move(decodedTile.second);
+		tile.lastUsed = ++_useCounter;
+		_tilesSizeInBytes += (size_t)tile.image.byteCount();
+	}
+
+	dropLeastRecentlyUsedTiles();
+	return !decodedTiles.empty();
+}
+
+bool CTiledImageDecoder::busy() const
+{
+	std::lock_guard<std::mutex> lock(_requestsMutex);
+	return !_requestedTiles.empty() || !_decodedTiles.empty();
+}
+
+QRect CTiledImageDecoder::tileRect(const TileKey& key, const QSize& imageSize, bool clipRectSupported)
+{
+	if (!clipRectSupported)
+		return QRect(QPoint(0, 0), imageSize);
+
+	const int tileSide = tileSize * key.level;
+	return QRect(key.column * tileSide, key.row * tileSide, tileSide, tileSide).intersected(QRect(QPoint(0, 0), imageSize));
+}
+
+void CTiledImageDecoder::requestTiles(const std::vector<TileKey>& keys)
+{
+	std::lock_guard<std::mutex> lock(_requestsMutex);
+	_wantedTiles.clear();
+	_wantedTiles.insert(keys.begin(), keys.end());
+
+	// Decoding a clip rect still decodes the whole width of the rows it spans (and everything above it, for JPEG),
+	// so the tiles that share a row are decoded with one read instead of repeating that work for each of them
+	std::map<std::pair<int /* level */, int /* row */>, std::vector<TileKey>> tilesByRow;
+	for (const TileKey& key: keys)
+	{
+		// The whole image as a single 32 bpp tile. Not worth decoding if it can't be cached.
+		if (!_clipRectSupported && (uint64_t)_imageSize.width() * (uint64_t)_imageSize.height() * 4 > maxCacheSizeInBytes)
+		{
+			if (_requestedTiles.insert(key).second)
+				_decodedTiles.emplace_back(key, QImage());
+
+			continue;
+		}
+
+		if (_requestedTiles.insert(key).second)
+			tilesByRow[std::make_pair(key.level, key.row)].push_back(key);
+	}
+
+	for (auto& row: tilesByRow)
+	{
+		_decoderThreads.enqueue([this, rowKeys = std::move(row.second), generation = _generation, imagePath = _imagePath, imageSize = _imageSize, clipRectSupported = _clipRectSupported]() {
+			decodeTiles(rowKeys, generation, imagePath, imageSize, clipRectSupported);
+		});
+	}
+}
+
+void CTiledImageDecoder::decodeTiles(std::vector<TileKey> keys, uint32_t generation, const QString& imagePath, const QSize& imageSize, bool clipRectSupported)
+{
+	{
+		std::lock_guard<std::mutex> lock(_requestsMutex);
+		if (generation != _generation)
+			return;
+
+		// Scrolled or zoomed away from some of the tiles before the decoding has started
+		keys.erase(std::remove_if(keys.begin(), keys.end(), [this](const TileKey& key) {
+			if (_wantedTiles.count(key) != 0)
+				return false;
+
+			_requestedTiles.erase(key);
+			return true;
+		}), keys.end());
+
+		if (keys.empty())
+			return;
+	}
+
+	QImageReader reader(imagePath);
+	reader.setDecideFormatFromContent(true);
+
+	// The strip spans from the first tile to the last one, including the ones in between that aren't needed
+	QRect stripRect;
+	const int level = keys.front().level;
+	if (clipRectSupported)
+	{
+		for (const TileKey& key: keys)
+			stripRect |= tileRect(key, imageSize, clipRectSupported);
+
+		// The clip rect is applied first, and the scaled size is the size of the clipped part
+		reader.setClipRect(stripRect);
+		if (level > 1)
+			reader.setScaledSize(QSize((stripRect.width() + level - 1) / level, (stripRect.height() + level - 1) / level));
+	}
+
+	const QImage strip = reader.read();
+	if (strip.isNull())
+		qInfo() << __FUNCTION__ << "Failed to decode a tile of" << imagePath << ':' << reader.errorString();
+
+	// A tile that has failed to decode is stored as a null image so that it's not requested over and over again
+	std::vector<std::pair<TileKey, QImage>> tiles;
+	tiles.reserve(keys.size());
+	for (const TileKey& key: keys)
+	{
+		if (strip.isNull() || !clipRectSupported)
+		{
+			tiles.emplace_back(key, strip);
+			continue;
+		}
+
+		// Every tile but the last one in the row is a whole number of decoded pixels wide
+		const QRect rect = tileRect(key, imageSize, clipRectSupported);
+		const QRect rectInStrip((rect.left() - stripRect.left()) / level, 0, (rect.width() + level - 1) / level, strip.height());
+		tiles.emplace_back(key, strip.copy(rectInStrip.intersected(strip.rect())));
+	}
+
+	std::lock_guard<std::mutex> lock(_requestsMutex);
+	if (generation == _generation)
+	{
+		for (auto& tile: tiles)
+		{
+			_requestedTiles.erase(tile.first);
+			_decodedTiles.push_back(std::move(tile));
+		}
+	}
+}
+
+void CTiledImageDecoder::dropLeastRecentlyUsedTiles()
+{
+	if (_tilesSizeInBytes <= maxCacheSizeInBytes)
+		return;
+
+	std::vector<std::pair<uint64_t, TileKey>> tilesByUse;
+	tilesByUse.reserve(_tiles.size());
+	for (const auto& tile: _tiles)
+		tilesByUse.emplace_back(tile.second.lastUsed, tile.first);
+
+	std::sort(tilesByUse.begin(), tilesByUse.end(), [](const std::pair<uint64_t, TileKey>& l, const std::pair<uint64_t, TileKey>& r) {
+		return l.first < r.first;
+	});
+
+	// The most recently used one is always kept. None is over the limit on its own, see collectDecodedTiles().
+	for (size_t i = 0; i + 1 < tilesByUse.size() && _tilesSizeInBytes > maxCacheSizeInBytes; ++i)
+	{
+		const auto tile = _tiles.find(tilesByUse[i].second);
+		_tilesSizeInBytes -= (size_t)tile->second.image.byteCount();
+		_tiles.erase(tile);
+	}
+}
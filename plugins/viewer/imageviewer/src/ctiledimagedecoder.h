@@ -0,0 +1,91 @@
+#pragma once
+
+#include "threading/cworkerthread.h"
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QImage>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+class QPainter;
+
+// Decodes the parts of an image that are being looked at, on worker threads, at no more than the resolution they're displayed at.
+// If the format can decode a clip rect (like JPEG, which also decodes scaled down by 1/2, 1/4 or 1/8 natively), the image is split in tiles of tileSize x tileSize decoded pixels
+// at power of 2 levels of detail, otherwise the whole image is decoded as a single tile. The decoded tiles are kept in a cache of a limited size, the least recently drawn ones are dropped first.
+// A tile that alone wouldn't fit in the cache isn't decoded at all, the caller's preview has to do.
+// Everything but the decoding itself is only to be used on the UI thread.
+class CTiledImageDecoder
+{
+public:
+	enum { tileSize = 512 };
+
+	CTiledImageDecoder();
+	~CTiledImageDecoder();
+
+	// imageSize is the size of the image at full resolution
+	void setImage(const QString& imagePath, const QSize& imageSize, bool clipRectSupported);
+	void clear();
+
+	// Draws the tiles covering sourceRect (in the full resolution image pixels) at scale, the displayed size of an image pixel;
+	// the ones that aren't decoded yet are requested instead, and the ones requested previously that are no longer needed are cancelled.
+	// Returns true if everything has been drawn.
+	bool paint(QPainter& painter, const QRectF& sourceRect, double scale, const std::function<QRectF (const QRectF&)>& imageToWidget);
+	// For when no tiles are being displayed: the queued requests are skipped
+	void cancelRequests();
+
+	// Moves the tiles decoded since the previous call into the cache. Returns true if there were any.
+	bool collectDecodedTiles();
+	// True if any requested tiles haven't been collected yet
+	bool busy() const;
+
+private:
+	struct TileKey {
+		int level; // The tile is decoded at 1/level of the full resolution
+		int column;
+		int row;
+
+		bool operator<(const TileKey& other) const;
+	};
+
+	struct Tile {
+		QImage image;
+		uint64_t lastUsed;
+	};
+
+	// The part of the full resolution image covered by the tile
+	static QRect tileRect(const TileKey& key, const QSize& imageSize, bool clipRectSupported);
+
+	void requestTiles(const std::vector<TileKey>& keys);
+	// Called on the decoder threads. The tiles are of the same row and level, and are decoded with a single read.
+	void decodeTiles(std::vector<TileKey> keys, uint32_t generation, const QString& imagePath, const QSize& imageSize, bool clipRectSupported);
+	void dropLeastRecentlyUsedTiles();
+
+private:
+	QString _imagePath;
+	QSize _imageSize;
+	bool _clipRectSupported = false;
+
+	std::map<TileKey, Tile> _tiles;
+	size_t _tilesSizeInBytes = 0;
+	uint64_t _useCounter = 0;
+
+	mutable std::mutex _requestsMutex;
+	std::set<TileKey> _requestedTiles; // Queued or being decoded, so that every tile is only requested once
+	std::set<TileKey> _wantedTiles; // The tiles missing from the latest paint() - the rest of the queued ones are skipped
+	std::vector<std::pair<TileKey, QImage>> _decodedTiles;
+	uint32_t _generation = 0; // Incremented when the image changes, so that the tiles of the previous one are discarded
+
+	CWorkerThreadPool _decoderThreads;
+};
@@ -0,0 +1,354 @@
+#include "clargetextview.h"
+#include "assert/advanced_assert.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTextCodec>
+#include <QTextOption>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <limits>
+
+CLargeTextView::CLargeTextView(QWidget* parent) :
+	QAbstractScrollArea(parent)
+{
+	setFocusPolicy(Qt::StrongFocus);
+	verticalScrollBar()->setSingleStep(1);
+
+	_indexingProgressTimer.setInterval(100);
+	connect(&_indexingProgressTimer, &QTimer::timeout, this, &CLargeTextView::updateIndexingProgress);
+}
+
+CLargeTextView::~CLargeTextView()
+{
+	close();
+}
+
+bool CLargeTextView::open(const QString& path)
+{
+	close();
+
+	_file.setFileName(path);
+	if (!_file.open(QFile::ReadOnly) || _file.size() <= 0)
+	{
+		_file.close();
+		return false;
+	}
+
+	_size = static_cast<uint64_t>(_file.size());
+	_data = _file.map(0, _file.size());
+	if (!_data)
+	{
+		qInfo() << __FUNCTION__ << "Failed to map" << path << ":" << _file.errorString();
+		close();
+		return false;
+	}
+
+	_index.build(_data, _size, _codeUnitSize);
+	_indexingProgressTimer.start();
+
+	verticalScrollBar()->setValue(0);
+	horizontalScrollBar()->setValue(0);
+	updateScrollBars();
+	viewport()->update();
+
+	return true;
+}
+
+void CLargeTextView::close()
+{
+	_indexingProgressTimer.stop();
+	// The indexer must not touch the data once it's unmapped
+	_index.clear();
+
+	if (_data)
+		_file.unmap(_data);
+
+	_data = nullptr;
+	_size = 0;
+	_file.close();
+
+	updateScrollBars();
+	viewport()->update();
+}
+
+bool CLargeTextView::isOpen() const
+{
+	return _data != nullptr;
+}
+
+bool CLargeTextView::mapAppendedData()
+{
+	if (!_data)
+		return false;
+
+	const qint64 newSize = _file.size();
+	if (newSize < 0 || static_cast<uint64_t>(newSize) < _size)
+	{
+		close();
+		return false;
+	}
+	else if (static_cast<uint64_t>(newSize) == _size)
+		return false;
+
+	uchar* newData = _file.map(0, newSize);
+	if (!newData)
+	{
+		qInfo() << __FUNCTION__ << "Failed to map" << _file.fileName() << ":" << _file.errorString();
+		return false;
+	}
+
+	// The indexer is switched to the new mapping before the old one is gone
+	_index.extend(newData, static_cast<uint64_t>(newSize));
+	_file.unmap(_data);
+	_data = newData;
+	_size = static_cast<uint64_t>(newSize);
+
+	_indexingProgressTimer.start();
+	updateScrollBars();
+	viewport()->update();
+
+	return true;
+}
+
+void CLargeTextView::scrollToEnd()
+{
+	updateScrollBars();
+	verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+}
+
+void CLargeTextView::setPinnedToEnd(bool pinned)
+{
+	_pinnedToEnd = pinned;
+}
+
+void CLargeTextView::setCodec(QTextCodec* codec)
+{
+	assert_and_return_r(codec, );
+	_codec = codec;
+
+	const int codeUnitSize = CTextLineIndex::codeUnitSize(codec);
+	if (codeUnitSize != _codeUnitSize)
+	{
+		_codeUnitSize = codeUnitSize;
+		if (_data)
+		{
+			_index.build(_data, _size, _codeUnitSize);
+			_indexingProgressTimer.start();
+			verticalScrollBar()->setValue(0);
+			updateScrollBars();
+		}
+	}
+
+	viewport()->update();
+}
+
+QTextCodec* CLargeTextView::codec() const
+{
+	return _codec ? _codec : QTextCodec::codecForName("UTF-8");
+}
+
+const uchar* CLargeTextView::data() const
+{
+	return _data;
+}
+
+uint64_t CLargeTextView::firstVisibleOffset() const
+{
+	return _data ? _index.rowRange(static_cast<uint64_t>(verticalScrollBar()->value())).first : 0;
+}
+
+void CLargeTextView::setSearchHits(const std::vector<CTextSearcher::Hit>* hits)
+{
+	_hits = hits;
+	_currentHit = CTextSearcher::Hit{0, 0};
+	viewport()->update();
+}
+
+void CLargeTextView::showHit(const CTextSearcher::Hit& hit)
+{
+	_currentHit = hit;
+	if (!_data || closeIfTruncated())
+		return;
+
+	const int rowHeight = std::max(fontMetrics().lineSpacing(), 1);
+	const int visibleRows = std::max(viewport()->height() / rowHeight, 1);
+	const uint64_t row = _index.rowForOffset(hit.offset);
+	const uint64_t firstRow = static_cast<uint64_t>(verticalScrollBar()->value());
+	if (row < firstRow || row >= firstRow + static_cast<uint64_t>(visibleRows))
+		verticalScrollBar()->setValue(static_cast<int>(std::min<uint64_t>(row - std::min<uint64_t>(row, static_cast<uint64_t>(visibleRows / 3)), std::numeric_limits<int>::max())));
+
+	// Scrolling horizontally if the hit is out of view
+	const auto range = _index.rowRange(row);
+	if (hit.offset >= range.first && hit.offset <= range.second)
+	{
+		QTextLayout layout;
+		layoutRow(layout, rowText(range));
+		const int x = static_cast<int>(layout.lineAt(0).cursorToX(decode(range.first, hit.offset).size()));
+		if (x < horizontalScrollBar()->value() || x >= horizontalScrollBar()->value() + viewport()->width() - fontMetrics().averageCharWidth() * 8)
+			horizontalScrollBar()->setValue(x - viewport()->width() / 3);
+	}
+
+	viewport()->update();
+}
+
+uint64_t CLargeTextView::size() const
+{
+	return _size;
+}
+
+void CLargeTextView::paintEvent(QPaintEvent* /*e*/)
+{
+	QPainter painter(viewport());
+	painter.fillRect(viewport()->rect(), palette().base());
+	if (!_data || closeIfTruncated())
+		return;
+
+	painter.setPen(palette().text().color());
+
+	const int rowHeight = std::max(fontMetrics().lineSpacing(), 1);
+	const uint64_t firstRow = std::min(static_cast<uint64_t>(verticalScrollBar()->value()), _index.rowCount() - 1);
+	// The partially visible row at the bottom included
+	const uint64_t visibleRows = static_cast<uint64_t>(viewport()->height() / rowHeight + 1);
+
+	const int left = -horizontalScrollBar()->value();
+	qreal y = 0;
+	for (const auto& range: _index.rowRanges(firstRow, visibleRows))
+	{
+		QTextLayout layout;
+		layoutRow(layout, rowText(range));
+		layout.draw(&painter, QPointF(left, y), hitFormats(range));
+		y += rowHeight;
+	}
+}
+
+void CLargeTextView::resizeEvent(QResizeEvent* e)
+{
+	QAbstractScrollArea::resizeEvent(e);
+	updateScrollBars();
+}
+
+void CLargeTextView::keyPressEvent(QKeyEvent* e)
+{
+	if (e->key() == Qt::Key_Home && e->modifiers() == Qt::ControlModifier)
+		verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMinimum);
+	else if (e->key() == Qt::Key_End && e->modifiers() == Qt::ControlModifier)
+		verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum);
+	else if (e->key() == Qt::Key_Home && e->modifiers() == Qt::NoModifier)
+		horizontalScrollBar()->triggerAction(QAbstractSlider::SliderToMinimum);
+	else if (e->key() == Qt::Key_End && e->modifiers() == Qt::NoModifier)
+		horizontalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum);
+	else
+		QAbstractScrollArea::keyPressEvent(e);
+}
+
+bool CLargeTextView::closeIfTruncated()
+{
+	const qint64 currentSize = _file.size();
+	if (currentSize >= 0 && static_cast<uint64_t>(currentSize) >= _size)
+		return false;
+
+	qInfo() << __FUNCTION__ << _file.fileName() << "has shrunk from" << _size << "to" << currentSize << "bytes";
+	close();
+	emit fileTruncated();
+	return true;
+}
+
+void CLargeTextView::updateIndexingProgress()
+{
+	if (!_index.building())
+		_indexingProgressTimer.stop();
+
+	updateScrollBars();
+	viewport()->update();
+	emit indexingProgressChanged(_index.building() ? _index.progress() : 100);
+}
+
+void CLargeTextView::updateScrollBars()
+{
+	const int rowHeight = std::max(fontMetrics().lineSpacing(), 1);
+	const int visibleRows = viewport()->height() / rowHeight;
+	const uint64_t rowCount = _data ? _index.rowCount() : 0;
+	const bool keepAtEnd = _pinnedToEnd && verticalScrollBar()->value() == verticalScrollBar()->maximum();
+
+	// A scroll bar position is an int, which is plenty for the rows of a file of any practical size
+	const uint64_t maxFirstRow = rowCount > static_cast<uint64_t>(visibleRows) ? rowCount - static_cast<uint64_t>(visibleRows) : 0;
+	verticalScrollBar()->setRange(0, static_cast<int>(std::min<uint64_t>(maxFirstRow, std::numeric_limits<int>::max())));
+	verticalScrollBar()->setPageStep(std::max(visibleRows - 1, 1));
+	if (keepAtEnd)
+		verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+
+	// The bytes of the longest row is an estimate of its width in characters
+	const uint64_t textWidth = (_data ? _index.maxRowLengthFound() : 0) * static_cast<uint64_t>(fontMetrics().averageCharWidth()) / static_cast<uint64_t>(_codeUnitSize);
+	const uint64_t maxLeft = textWidth > static_cast<uint64_t>(viewport()->width()) ? textWidth - static_cast<uint64_t>(viewport()->width()) : 0;
+	horizontalScrollBar()->setRange(0, static_cast<int>(std::min<uint64_t>(maxLeft, std::numeric_limits<int>::max())));
+	horizontalScrollBar()->setPageStep(viewport()->width());
+	horizontalScrollBar()->setSingleStep(fontMetrics().averageCharWidth());
+}
+
+QString CLargeTextView::decode(uint64_t begin, uint64_t end) const
+{
+	return codec()->toUnicode(reinterpret_cast<const char*>(_data + begin), static_cast<int>(end - begin));
+}
+
+QString CLargeTextView::rowText(const std::pair<uint64_t, uint64_t>& rowRange) const
+{
+	QString text = decode(rowRange.first, rowRange.second);
+	while (!text.isEmpty() && (text.endsWith('\n') || text.endsWith('\r')))
+		text.chop(1);
+
+	return text;
+}
+
+void CLargeTextView::layoutRow(QTextLayout& layout, const QString& text) const
+{
+	QTextOption textOption;
+	textOption.setWrapMode(QTextOption::NoWrap);
+	textOption.setTabStop(4 * fontMetrics().width(' '));
+
+	layout.setText(text);
+	layout.setFont(font());
+	layout.setTextOption(textOption);
+	layout.beginLayout();
+	// A row is at most CTextLineIndex::maxRowLength bytes long, so it surely fits
+	layout.createLine().setLineWidth(1e6);
+	layout.endLayout();
+}
+
+QVector<QTextLayout::FormatRange> CLargeTextView::hitFormats(const std::pair<uint64_t, uint64_t>& rowRange) const
+{
+	QVector<QTextLayout::FormatRange> formats;
+	if (!_hits)
+		return formats;
+
+	// The hits are sorted and don't overlap, so only the one before the first hit in the row may extend into it
+	auto hit = std::lower_bound(_hits->begin(), _hits->end(), rowRange.first, [](const CTextSearcher::Hit& h, uint64_t offset) {
+		return h.offset < offset;
+	});
+	if (hit != _hits->begin())
+		--hit;
+
+	for (; hit != _hits->end() && hit->offset < rowRange.second; ++hit)
+	{
+		const uint64_t begin = std::max(hit->offset, rowRange.first);
+		const uint64_t end = std::min(hit->offset + hit->length, rowRange.second);
+		if (begin >= end)
+			continue;
+
+		QTextLayout::FormatRange format;
+		format.start = decode(rowRange.first, begin).size();
+		format.length = decode(begin, end).size();
+		const bool current = hit->offset == _currentHit.offset && hit->length == _currentHit.length;
+		format.format.setBackground(current ? palette().highlight() : QBrush(Qt::yellow));
+		if (current)
+			format.format.setForeground(palette().highlightedText());
+
+		formats.push_back(format);
+	}
+
+	return formats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ctextlineindex.h"
+#include "ctextsearcher.h"
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QAbstractScrollArea>
+#include <QFile>
+#include <QTextLayout>
+#include <QTimer>
+RESTORE_COMPILER_WARNINGS
+
+class QTextCodec;
+
+// A read-only view of a memory-mapped text file of any size. Only the rows in the viewport are decoded and painted,
+// so opening and scrolling take the same time regardless of the file size.
+class CLargeTextView : public QAbstractScrollArea
+{
+	Q_OBJECT
+
+public:
+	explicit CLargeTextView(QWidget* parent = nullptr);
+	~CLargeTextView();
+
+	// Maps the file and starts indexing its rows. Returns false if the file can't be mapped.
+	bool open(const QString& path);
+	void close();
+	bool isOpen() const;
+
+	// Maps and indexes the data written to the end of the file since it was opened or last checked, returns true if there was any.
+	// The file is assumed to only ever grow; if it has shrunk, the view is closed.
+	bool mapAppendedData();
+	void scrollToEnd();
+	// Keeps the last row in view as more rows are indexed, for as long as the view is scrolled to the end
+	void setPinnedToEnd(bool pinned);
+
+	// The codec doesn't have to be stateless, but every row is decoded on its own
+	void setCodec(QTextCodec* codec);
+	// UTF-8 unless set otherwise
+	QTextCodec* codec() const;
+
+	const uchar* data() const;
+	uint64_t size() const;
+	uint64_t firstVisibleOffset() const;
+
+	// The hits are highlighted, the vector is owned by the caller and must be sorted. nullptr clears the highlighting.
+	void setSearchHits(const std::vector<CTextSearcher::Hit>* hits);
+	// Scrolls to the hit if it isn't in view, and highlights it as the current one
+	void showHit(const CTextSearcher::Hit& hit);
+
+signals:
+	// 0 - 100
+	void indexingProgressChanged(int percent);
+	// The file has shrunk while it was mapped, so the view has closed it
+	void fileTruncated();
+
+protected:
+	void paintEvent(QPaintEvent* e) override;
+	void resizeEvent(QResizeEvent* e) override;
+	void keyPressEvent(QKeyEvent* e) override;
+
+private:
+	// Reading the pages of the mapping past the new end of the file raises SIGBUS, so the view is closed instead
+	bool closeIfTruncated();
+	void updateIndexingProgress();
+	void updateScrollBars();
+	QString decode(uint64_t begin, uint64_t end) const;
+	// Without the line break
+	QString rowText(const std::pair<uint64_t, uint64_t>& rowRange) const;
+	void layoutRow(QTextLayout& layout, const QString& text) const;
+	QVector<QTextLayout::FormatRange> hitFormats(const std::pair<uint64_t, uint64_t>& rowRange) const;
+
+private:
+	QFile _file;
+	uchar* _data = nullptr;
+	uint64_t _size = 0;
+
+	QTextCodec* _codec = nullptr;
+	int _codeUnitSize = 1;
+	CTextLineIndex _index;
+	bool _pinnedToEnd = false;
+
+	const std::vector<CTextSearcher::Hit>* _hits = nullptr;
+	CTextSearcher::Hit _currentHit {0, 0};
+
+	QTimer _indexingProgressTimer;
+};
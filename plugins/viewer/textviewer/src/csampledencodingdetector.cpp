@@ -0,0 +1,233 @@
+#include "csampledencodingdetector.h"
+#include "ctextencodingdetector.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <vector>
+
+static const uint64_t sampleSize = 64 * 1024;
+// The cache is dropped entirely when it gets this big
+static const int maxCachedFiles = 1000;
+
+namespace {
+
+struct CachedResult {
+	qint64 size;
+	QDateTime modified;
+	CSampledEncodingDetector::Scope scope;
+	CSampledEncodingDetector::Result result;
+};
+
+struct Sample {
+	const char* data;
+	uint64_t size;
+};
+
+enum Utf8Validity {
+	Utf8Invalid,
+	Utf8Ascii, // Valid, nothing but ASCII
+	Utf8Valid
+};
+
+// The sample may begin and end in the middle of a sequence, which isn't an error
+Utf8Validity validateUtf8(const Sample& sample, bool atTheBeginning, bool atTheEnd)
+{
+	const uchar* bytes = reinterpret_cast<const uchar*>(sample.data);
+	uint64_t i = 0;
+	if (!atTheBeginning)
+	{
+		while (i < sample.size && i < 3 && (bytes[i] & 0xC0u) == 0x80u)
+			++i;
+	}
+
+	bool asciiOnly = true;
+	while (i < sample.size)
+	{
+		// Skipping ASCII 8 bytes at a time, since a whole text may have to be validated
+		for (uint64_t word = 0; i + sizeof(word) <= sample.size; i += sizeof(word))
+		{
+			memcpy(&word, bytes + i, sizeof(word));
+			if ((word & 0x8080808080808080ull) != 0)
+				break;
+		}
+
+		if (i >= sample.size)
+			break;
+
+		const uchar c = bytes[i];
+		if (c < 0x80u)
+		{
+			++i;
+			continue;
+		}
+
+		asciiOnly = false;
+		uint64_t sequenceLength = 0;
+		if (c >= 0xC2u && c <= 0xDFu)
+			sequenceLength = 2;
+		else if (c >= 0xE0u && c <= 0xEFu)
+			sequenceLength = 3;
+		else if (c >= 0xF0u && c <= 0xF4u)
+			sequenceLength = 4;
+		else
+			return Utf8Invalid;
+
+		if (i + sequenceLength > sample.size)
+			return atTheEnd ? Utf8Invalid : Utf8Valid;
+
+		for (uint64_t j = 1; j < sequenceLength; ++j)
+		{
+			if ((bytes[i + j] & 0xC0u) != 0x80u)
+				return Utf8Invalid;
+		}
+
+		// Overlong sequences, surrogates and the code points past U+10FFFF, which the decoder would replace with U+FFFD
+		const uchar second = bytes[i + 1];
+		if ((c == 0xE0u && second < 0xA0u) || (c == 0xEDu && second > 0x9Fu) || (c == 0xF0u && second < 0x90u) || (c == 0xF4u && second > 0x8Fu))
+			return Utf8Invalid;
+
+		i += sequenceLength;
+	}
+
+	return asciiOnly ? Utf8Ascii : Utf8Valid;
+}
+
+}
+
+CSampledEncodingDetector::Result CSampledEncodingDetector::detect(const QString& filePath, const char* data, uint64_t size, Scope scope)
+{
+	static QHash<QString, CachedResult> cache;
+
+	const QFileInfo fileInfo(filePath);
+	const auto cached = cache.constFind(filePath);
+	if (cached != cache.constEnd() && cached->size == fileInfo.size() && cached->modified == fileInfo.lastModified() && cached->scope == scope)
+		return cached->result;
+
+	Result result = detect(data, size, scope);
+	if (cache.size() >= maxCachedFiles)
+		cache.clear();
+
+	CachedResult cachedResult {fileInfo.size(), fileInfo.lastModified(), scope, result};
+	cachedResult.result.text.clear();
+	cache.insert(filePath, cachedResult);
+	return result;
+}
+
+CSampledEncodingDetector::Result CSampledEncodingDetector::detect(const char* data, uint64_t size, Scope scope)
+{
+	Result result;
+	const uchar* bytes = reinterpret_cast<const uchar*>(data);
+
+	// A byte order mark leaves no doubt
+	if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+	{
+		result.codecName = "UTF-8";
+		result.encoding = "UTF-8";
+		result.confidence = 100;
+		return result;
+	}
+	else if (size >= 2 && ((bytes[0] == 0xFF && bytes[1] == 0xFE) || (bytes[0] == 0xFE && bytes[1] == 0xFF)))
+	{
+		// The codec of the specific byte order: the rows of a large file and the data appended in follow mode are decoded separately, without the BOM
+		result.codecName = bytes[0] == 0xFF ? "UTF-16LE" : "UTF-16BE";
+		result.encoding = result.codecName;
+		result.confidence = 100;
+		return result;
+	}
+
+	std::vector<Sample> samples;
+	if (scope == WholeText || size <= 3 * sampleSize)
+		samples.push_back(Sample{data, size});
+	else
+	{
+		samples.push_back(Sample{data, sampleSize});
+		samples.push_back(Sample{data + (size - sampleSize) / 2, sampleSize});
+		samples.push_back(Sample{data + size - sampleSize, sampleSize});
+	}
+
+	// UTF-16 without a BOM: most of the ASCII characters have zero as one of their bytes
+	{
+		const Sample& head = samples.front();
+		uint64_t zerosAtEven = 0, zerosAtOdd = 0;
+		for (uint64_t i = 0; i + 1 < head.size; i += 2)
+		{
+			zerosAtEven += bytes[i] == 0 ? 1 : 0;
+			zerosAtOdd += bytes[i + 1] == 0 ? 1 : 0;
+		}
+
+		const uint64_t numCharacters = std::max<uint64_t>(head.size / 2, 1);
+		if (zerosAtOdd * 10 > numCharacters * 3 && zerosAtEven * 20 < numCharacters)
+		{
+			result.codecName = "UTF-16LE";
+			result.encoding = "UTF-16LE";
+			result.confidence = static_cast<int>(std::min<uint64_t>(zerosAtOdd * 100 / numCharacters + 30, 95));
+			return result;
+		}
+		else if (zerosAtEven * 10 > numCharacters * 3 && zerosAtOdd * 20 < numCharacters)
+		{
+			result.codecName = "UTF-16BE";
+			result.encoding = "UTF-16BE";
+			result.confidence = static_cast<int>(std::min<uint64_t>(zerosAtEven * 100 / numCharacters + 30, 95));
+			return result;
+		}
+	}
+
+	// UTF-8 is by far the most likely, and has to be valid in every sample
+	bool utf8 = true, asciiOnly = true;
+	for (size_t i = 0; i < samples.size() && utf8; ++i)
+	{
+		const Sample& sample = samples[i];
+		const Utf8Validity validity = validateUtf8(sample, sample.data == data, sample.data + sample.size == data + size);
+		utf8 = validity != Utf8Invalid;
+		asciiOnly = asciiOnly && validity == Utf8Ascii;
+	}
+
+	if (utf8)
+	{
+		result.codecName = "UTF-8";
+		result.encoding = "UTF-8";
+		// Pure ASCII is valid in most encodings, but nothing else is valid UTF-8 by chance
+		result.confidence = asciiOnly ? 90 : 100;
+		return result;
+	}
+
+	// Each sample is analyzed separately, and the confidence is the share of the samples that agree with the majority
+	std::map<QString, std::pair<int, QString>> votes; // Encoding -> number of samples, language
+	QString wholeText; // The only sample is the whole text, no need for the caller to decode it again
+	for (const Sample& sample: samples)
+	{
+		auto sampleResult = CTextEncodingDetector::decode(QByteArray::fromRawData(sample.data, static_cast<int>(sample.size)));
+		if (sampleResult.encoding.isEmpty())
+			continue;
+
+		if (scope == WholeText)
+			wholeText = std::move(sampleResult.text);
+
+		auto& vote = votes[sampleResult.encoding];
+		++vote.first;
+		if (vote.second.isEmpty())
+			vote.second = sampleResult.language;
+	}
+
+	const auto winner = std::max_element(votes.cbegin(), votes.cend(), [](const std::pair<const QString, std::pair<int, QString>>& l, const std::pair<const QString, std::pair<int, QString>>& r) {
+		return l.second.first < r.second.first;
+	});
+
+	if (winner != votes.cend())
+	{
+		result.codecName = winner->first.toUtf8();
+		result.encoding = winner->first;
+		result.language = winner->second.second;
+		result.confidence = winner->second.first * 100 / static_cast<int>(samples.size());
+		result.text = std::move(wholeText);
+	}
+
+	return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QByteArray>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <stdint.h>
+
+// Detects the encoding of a text, either from at most three bounded samples of it (the beginning, the middle and the end), so the cost doesn't depend on the text size,
+// or from the whole text. Sampling is for the texts too large to be loaded: a few non-UTF-8 characters outside the samples go unnoticed, and the text is taken for UTF-8.
+// The results are cached per file, and are reused for as long as the file's size and modification time stay the same.
+class CSampledEncodingDetector
+{
+public:
+	struct Result {
+		QByteArray codecName; // Empty if nothing could be detected
+		QString encoding;
+		QString language;
+		int confidence = 0; // 0 - 100
+		// The whole text decoded with the codec, if the detection had to decode it anyway (WholeText only, and not for UTF-8 and UTF-16). Not cached.
+		QString text;
+	};
+
+	enum Scope {
+		SampledText,
+		WholeText
+	};
+
+	static Result detect(const QString& filePath, const char* data, uint64_t size, Scope scope);
+	// Same without the cache
+	static Result detect(const char* data, uint64_t size, Scope scope);
+};
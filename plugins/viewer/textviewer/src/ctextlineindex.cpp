@@ -0,0 +1,276 @@
+#include "ctextlineindex.h"
+#include "assert/advanced_assert.h"
+#include "threading/thread_helpers.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QTextCodec>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <string.h>
+
+// The rows found are published for the UI after every this many bytes scanned
+static const uint64_t publishInterval = 16 * 1024 * 1024;
+
+CTextLineIndex::~CTextLineIndex()
+{
+	stop();
+}
+
+int CTextLineIndex::codeUnitSize(const QTextCodec* codec)
+{
+	const int mib = codec ? codec->mibEnum() : 106;
+	return mib == 1013 /* UTF-16BE */ || mib == 1014 /* UTF-16LE */ || mib == 1015 /* UTF-16 */ ? 2 : 1;
+}
+
+void CTextLineIndex::build(const uchar* data, uint64_t size, int codeUnitSize)
+{
+	assert_r(codeUnitSize == 1 || codeUnitSize == 2);
+	clear();
+
+	_data = data;
+	_size = size;
+	_codeUnitSize = codeUnitSize;
+	if (!_data || _size == 0)
+		return;
+
+	_building = true;
+	_thread = std::thread(&CTextLineIndex::buildIndex, this);
+}
+
+void CTextLineIndex::extend(const uchar* data, uint64_t size)
+{
+	stop();
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		assert_r(size >= _size);
+		_data = data;
+		_size = size;
+		// The last row may continue in the new data
+		_indexedSize = _lastRowStart;
+	}
+
+	if (!_data || _size == 0)
+		return;
+
+	_building = true;
+	_thread = std::thread(&CTextLineIndex::buildIndex, this);
+}
+
+void CTextLineIndex::clear()
+{
+	stop();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_data = nullptr;
+	_size = 0;
+	_checkpoints.assign(1, 0);
+	_rowCount = 1;
+	_indexedSize = 0;
+	_lastRowStart = 0;
+	_maxRowLength = 0;
+}
+
+bool CTextLineIndex::building() const
+{
+	return _building;
+}
+
+int CTextLineIndex::progress() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _size > 0 ? static_cast<int>(_indexedSize * 100 / _size) : 100;
+}
+
+uint64_t CTextLineIndex::rowCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _rowCount;
+}
+
+uint64_t CTextLineIndex::maxRowLengthFound() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _maxRowLength;
+}
+
+std::pair<uint64_t, uint64_t> CTextLineIndex::rowRange(uint64_t row) const
+{
+	uint64_t rowStart = 0, rowCount = 0, indexedSize = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_data || _checkpoints.empty())
+			return {0, 0};
+
+		assert_r(row < _rowCount);
+		row = std::min(row, _rowCount - 1);
+		rowStart = _checkpoints[static_cast<size_t>(row / rowsPerCheckpoint)];
+		rowCount = _rowCount;
+		indexedSize = _indexedSize;
+	}
+
+	// The rows before the indexed size can't change, and neither can the start of the last one, so the data can be scanned without the lock
+	for (uint64_t i = 0, n = row % rowsPerCheckpoint; i < n; ++i)
+		rowStart = nextRowStart(rowStart, indexedSize);
+
+	// The last row is only complete once the whole data is indexed
+	return {rowStart, nextRowStart(rowStart, row == rowCount - 1 ? _size : indexedSize)};
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> CTextLineIndex::rowRanges(uint64_t firstRow, uint64_t maxRows) const
+{
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+	uint64_t rowCount = 0, indexedSize = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_data || _checkpoints.empty())
+			return ranges;
+
+		rowCount = _rowCount;
+		indexedSize = _indexedSize;
+	}
+
+	assert_r(firstRow < rowCount);
+	if (firstRow >= rowCount || maxRows == 0)
+		return ranges;
+
+	// Every following row starts where the previous one ends, only the first one needs to be looked up
+	const uint64_t lastRow = std::min(rowCount, firstRow + maxRows) - 1;
+	ranges.reserve(static_cast<size_t>(lastRow - firstRow + 1));
+	uint64_t rowStart = rowRange(firstRow).first;
+	for (uint64_t row = firstRow; row <= lastRow; ++row)
+	{
+		const uint64_t rowEnd = nextRowStart(rowStart, row == rowCount - 1 ? _size : indexedSize);
+		ranges.emplace_back(rowStart, rowEnd);
+		rowStart = rowEnd;
+	}
+
+	return ranges;
+}
+
+uint64_t CTextLineIndex::rowForOffset(uint64_t offset) const
+{
+	uint64_t row = 0, rowStart = 0, rowCount = 0, indexedSize = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_data || _checkpoints.empty())
+			return 0;
+
+		const auto checkpoint = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), offset) - 1;
+		row = static_cast<uint64_t>(checkpoint - _checkpoints.begin()) * rowsPerCheckpoint;
+		rowStart = *checkpoint;
+		rowCount = _rowCount;
+		indexedSize = _indexedSize;
+	}
+
+	while (row + 1 < rowCount)
+	{
+		const uint64_t next = nextRowStart(rowStart, indexedSize);
+		if (next > offset || next >= indexedSize)
+			break;
+
+		rowStart = next;
+		++row;
+	}
+
+	return row;
+}
+
+void CTextLineIndex::stop()
+{
+	_abort = true;
+	if (_thread.joinable())
+		_thread.join();
+
+	_abort = false;
+	_building = false;
+}
+
+void CTextLineIndex::buildIndex()
+{
+	setThreadName("Text line indexer");
+
+	std::vector<uint64_t> newCheckpoints;
+	uint64_t rowStart = 0, rowCount = 0, maxRowLength = 0;
+	{
+		// Resuming from the last row published, if any. If the indexing was interrupted, what wasn't published is done again.
+		std::lock_guard<std::mutex> lock(_mutex);
+		rowStart = _lastRowStart;
+		rowCount = _rowCount;
+		maxRowLength = _maxRowLength;
+	}
+
+	uint64_t lastPublishedOffset = rowStart;
+	for (;;)
+	{
+		const uint64_t next = nextRowStart(rowStart, _size);
+		maxRowLength = std::max(maxRowLength, next - rowStart);
+		// The last row, no data after it
+		if (next >= _size)
+			break;
+
+		rowStart = next;
+		if (rowCount % rowsPerCheckpoint == 0)
+			newCheckpoints.push_back(rowStart);
+		++rowCount;
+
+		if (rowStart - lastPublishedOffset >= publishInterval)
+		{
+			if (_abort)
+				return;
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_checkpoints.insert(_checkpoints.end(), newCheckpoints.begin(), newCheckpoints.end());
+			_rowCount = rowCount;
+			_indexedSize = rowStart;
+			_lastRowStart = rowStart;
+			_maxRowLength = maxRowLength;
+
+			newCheckpoints.clear();
+			lastPublishedOffset = rowStart;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_checkpoints.insert(_checkpoints.end(), newCheckpoints.begin(), newCheckpoints.end());
+	_rowCount = rowCount;
+	_indexedSize = _size;
+	_lastRowStart = rowStart;
+	_maxRowLength = maxRowLength;
+	_building = false;
+}
+
+uint64_t CTextLineIndex::nextRowStart(uint64_t rowStart, uint64_t size) const
+{
+	const uint64_t limit = std::min(size, rowStart + maxRowLength);
+	if (rowStart >= limit)
+		return size;
+
+	if (_codeUnitSize == 1)
+	{
+		// memchr is vectorized by every standard library
+		const void* lineBreak = memchr(_data + rowStart, '\n', static_cast<size_t>(limit - rowStart));
+		if (lineBreak)
+			return static_cast<uint64_t>(static_cast<const uchar*>(lineBreak) - _data) + 1;
+		if (limit == size)
+			return size;
+
+		// Not cutting in the middle of a UTF-8 sequence
+		uint64_t cut = limit;
+		while (cut > rowStart + 1 && (_data[cut] & 0xC0u) == 0x80u)
+			--cut;
+
+		return cut;
+	}
+	else
+	{
+		for (uint64_t i = rowStart; i + 1 < limit; i += 2)
+		{
+			if ((_data[i] == '\n' && _data[i + 1] == 0) || (_data[i] == 0 && _data[i + 1] == '\n'))
+				return i + 2;
+		}
+
+		return limit == size ? size : limit;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QtGlobal>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class QTextCodec;
+
+// Splits a memory-mapped text into display rows. A row ends after a line break, or after maxRowLength bytes, so that a file without line breaks
+// can still be shown a screenful at a time. Only the start of every rowsPerCheckpoint-th row is stored;
+// the others are found by scanning forward from the nearest checkpoint, which keeps the index small even for files with billions of lines.
+// The index is built on a worker thread; the rows indexed so far can be queried from any thread while it's running.
+class CTextLineIndex
+{
+public:
+	enum : uint64_t {
+		rowsPerCheckpoint = 64,
+		maxRowLength = 4096
+	};
+
+	~CTextLineIndex();
+
+	// The line breaks are two bytes wide in UTF-16, one byte in everything else
+	static int codeUnitSize(const QTextCodec* codec);
+
+	// Starts indexing from scratch. The data must stay valid until clear() or the next build().
+	// codeUnitSize is 2 for UTF-16 (little endian) and 1 for everything else, in which case a row is never cut in the middle of a UTF-8 sequence.
+	void build(const uchar* data, uint64_t size, int codeUnitSize);
+	// For data that has grown at the end (e. g. a log being written), with the old data unchanged: only the new part is indexed,
+	// starting from the last row, which may not have been complete. The old data need not remain valid.
+	void extend(const uchar* data, uint64_t size);
+	void clear();
+
+	bool building() const;
+	// Of the whole data, 0 - 100
+	int progress() const;
+
+	// Only counts the rows indexed so far; there's always at least one
+	uint64_t rowCount() const;
+	// The longest row indexed so far, in bytes
+	uint64_t maxRowLengthFound() const;
+	// The byte range [begin, end) of the row, line break included; row must be less than rowCount()
+	std::pair<uint64_t, uint64_t> rowRange(uint64_t row) const;
+	// The ranges of up to maxRows consecutive rows starting with firstRow, found in a single scan; firstRow must be less than rowCount()
+	std::vector<std::pair<uint64_t, uint64_t>> rowRanges(uint64_t firstRow, uint64_t maxRows) const;
+	// The row that the byte at the offset belongs to, or the last row indexed so far if the offset is past it
+	uint64_t rowForOffset(uint64_t offset) const;
+
+private:
+	void stop();
+	void buildIndex();
+	// Returns the start of the row following the one at rowStart, or size if the row doesn't end before size
+	uint64_t nextRowStart(uint64_t rowStart, uint64_t size) const;
+
+private:
+	const uchar* _data = nullptr;
+	uint64_t _size = 0;
+	int _codeUnitSize = 1;
+
+	mutable std::mutex _mutex;
+	std::vector<uint64_t> _checkpoints; // _checkpoints[i] is the start of the row i * rowsPerCheckpoint
+	uint64_t _rowCount = 1;
+	uint64_t _indexedSize = 0; // Everything before this offset has been split into rows
+	uint64_t _lastRowStart = 0;
+	uint64_t _maxRowLength = 0;
+
+	std::thread _thread;
+	std::atomic<bool> _abort {false};
+	std::atomic<bool> _building {false};
+};
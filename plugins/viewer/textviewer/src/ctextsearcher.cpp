@@ -0,0 +1,511 @@
+#include "ctextsearcher.h"
+#include "ctextlineindex.h"
+#include "assert/advanced_assert.h"
+#include "threading/thread_helpers.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QDebug>
+#include <QSysInfo>
+#include <QTextCodec>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+// The progress is updated after every this many bytes searched
+static const uint64_t progressUpdateInterval = 4 * 1024 * 1024;
+// Longer lines are matched against a regular expression in pieces, which may miss a match across two pieces
+static const uint64_t maxLineLength = 1024 * 1024;
+
+// Every character is always encoded the same way, and no part of a multi-byte character can be mistaken for another character
+static bool byteSearchable(const QTextCodec* codec)
+{
+	const int mib = codec->mibEnum();
+	return mib == 106 /* UTF-8 */ || (mib >= 1013 && mib <= 1015) /* UTF-16 */ ||
+		(mib >= 3 && mib <= 12) /* ASCII, ISO-8859-1 - 9 */ || (mib >= 109 && mib <= 112) /* ISO-8859-13 - 16 */ ||
+		mib == 2084 || mib == 2088 /* KOI8 */ || (mib >= 2250 && mib <= 2258) /* Windows-125x */;
+}
+
+static inline uchar foldAscii(uchar c)
+{
+	return c >= 'A' && c <= 'Z' ? static_cast<uchar>(c + ('a' - 'A')) : c;
+}
+
+static QByteArray encode(QTextCodec* codec, const QChar* text, int length)
+{
+	QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+	return codec->fromUnicode(text, length, &state);
+}
+
+// The length of the byte order mark the data starts with, if it's the one of the encoding
+static uint64_t byteOrderMarkLength(const uchar* data, uint64_t size, const QTextCodec* codec, int codeUnitSize)
+{
+	const int mib = codec->mibEnum();
+	if (codeUnitSize == 2 && size >= 2 && ((data[0] == 0xFF && data[1] == 0xFE && mib != 1013 /* UTF-16BE */) || (data[0] == 0xFE && data[1] == 0xFF && mib != 1014 /* UTF-16LE */)))
+		return 2;
+	else if (codeUnitSize == 1 && mib == 106 && size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+		return 3;
+	else
+		return 0;
+}
+
+// The byte order of the UTF-16 code units: fixed by the codec, or by the byte order mark for the generic UTF-16, which otherwise decodes in the host order
+static bool bigEndianUtf16(const uchar* data, uint64_t size, const QTextCodec* codec)
+{
+	const int mib = codec->mibEnum();
+	if (mib == 1013 /* UTF-16BE */)
+		return true;
+	else if (mib == 1014 /* UTF-16LE */)
+		return false;
+	else if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+		return true;
+	else if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+		return false;
+	else
+		return QSysInfo::ByteOrder == QSysInfo::BigEndian;
+}
+
+// Decodes UTF-8 replacing every byte of an invalid sequence with U+FFFD, recording the offsets as described for decodeLineWithOffsets()
+static QString decodeUtf8WithOffsets(const uchar* data, int size, std::vector<int>& unitOffsets)
+{
+	QString text;
+	text.reserve(size);
+	for (int i = 0; i < size;)
+	{
+		const uchar lead = data[i];
+		// The sequence length, the bits of the lead byte that belong to the code point, and the smallest code point that needs this many bytes
+		int length = 0;
+		uint codePoint = 0, minCodePoint = 0;
+		if (lead < 0x80)
+		{
+			length = 1;
+			codePoint = lead;
+		}
+		else if ((lead & 0xE0u) == 0xC0u)
+		{
+			length = 2;
+			codePoint = lead & 0x1Fu;
+			minCodePoint = 0x80;
+		}
+		else if ((lead & 0xF0u) == 0xE0u)
+		{
+			length = 3;
+			codePoint = lead & 0x0Fu;
+			minCodePoint = 0x800;
+		}
+		else if ((lead & 0xF8u) == 0xF0u)
+		{
+			length = 4;
+			codePoint = lead & 0x07u;
+			minCodePoint = 0x10000;
+		}
+
+		bool valid = length > 0 && i + length <= size;
+		for (int n = 1; valid && n < length; ++n)
+		{
+			valid = (data[i + n] & 0xC0u) == 0x80u;
+			codePoint = (codePoint << 6) | (data[i + n] & 0x3Fu);
+		}
+
+		// Overlong sequences, surrogates and the code points past U+10FFFF are invalid, too
+		valid = valid && codePoint >= minCodePoint && codePoint <= 0x10FFFFu && (codePoint < 0xD800u || codePoint > 0xDFFFu);
+		if (!valid)
+		{
+			text.append(QChar(QChar::ReplacementCharacter));
+			unitOffsets.push_back(i);
+			++i;
+			continue;
+		}
+
+		if (QChar::requiresSurrogates(codePoint))
+		{
+			text.append(QChar(QChar::highSurrogate(codePoint)));
+			text.append(QChar(QChar::lowSurrogate(codePoint)));
+			unitOffsets.push_back(i);
+			unitOffsets.push_back(i);
+		}
+		else
+		{
+			text.append(QChar(static_cast<ushort>(codePoint)));
+			unitOffsets.push_back(i);
+		}
+
+		i += length;
+	}
+
+	unitOffsets.push_back(size);
+	return text;
+}
+
+bool CTextSearcher::Query::operator==(const Query& other) const
+{
+	return expression == other.expression && regex == other.regex && caseSensitive == other.caseSensitive && wholeWords == other.wholeWords;
+}
+
+bool CTextSearcher::Query::operator!=(const Query& other) const
+{
+	return !(*this == other);
+}
+
+CTextSearcher::~CTextSearcher()
+{
+	stop();
+}
+
+void CTextSearcher::start(const QString& text, const Query& query)
+{
+	stop();
+
+	// Searching the UTF-16 code units as bytes, two per character
+	_text = text;
+	_data = reinterpret_cast<const uchar*>(_text.utf16());
+	_size = static_cast<uint64_t>(_text.size()) * 2;
+	_codec = QTextCodec::codecForName(QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "UTF-16LE" : "UTF-16BE");
+	_codeUnitSize = 2;
+	_bigEndianCodeUnits = QSysInfo::ByteOrder == QSysInfo::BigEndian;
+	_searchingText = true;
+
+	startThread(query);
+}
+
+bool CTextSearcher::start(const QString& filePath, uint64_t size, QTextCodec* codec, const Query& query)
+{
+	stop();
+	assert_and_return_r(codec, false);
+
+	_text.clear();
+	_file.setFileName(filePath);
+	if (!_file.open(QFile::ReadOnly) || size == 0 || (_mappedData = _file.map(0, static_cast<qint64>(size))) == nullptr)
+	{
+		qInfo() << __FUNCTION__ << "Failed to map" << filePath << ":" << _file.errorString();
+		_file.close();
+		return false;
+	}
+
+	_data = _mappedData;
+	_size = size;
+	_codec = codec;
+	_codeUnitSize = CTextLineIndex::codeUnitSize(codec);
+	_bigEndianCodeUnits = _codeUnitSize == 2 && bigEndianUtf16(_data, _size, codec);
+	_searchingText = false;
+
+	startThread(query);
+	return true;
+}
+
+void CTextSearcher::stop()
+{
+	_abort = true;
+	if (_thread.joinable())
+		_thread.join();
+
+	_abort = false;
+	_searching = false;
+
+	if (_mappedData)
+		_file.unmap(_mappedData);
+
+	_mappedData = nullptr;
+	_data = nullptr;
+	_size = 0;
+	_file.close();
+}
+
+bool CTextSearcher::searching() const
+{
+	return _searching;
+}
+
+int CTextSearcher::progress() const
+{
+	return _size > 0 ? static_cast<int>(_bytesSearched * 100 / _size) : 100;
+}
+
+bool CTextSearcher::hitLimitReached() const
+{
+	return _hitLimitReached;
+}
+
+void CTextSearcher::takeNewHits(std::vector<Hit>& hits)
+{
+	std::lock_guard<std::mutex> lock(_hitsMutex);
+	hits.insert(hits.end(), _newHits.begin(), _newHits.end());
+	_newHits.clear();
+}
+
+void CTextSearcher::startThread(const Query& query)
+{
+	{
+		std::lock_guard<std::mutex> lock(_hitsMutex);
+		_newHits.clear();
+	}
+
+	_numHits = 0;
+	_hitLimitReached = false;
+	_bytesSearched = 0;
+	_searching = true;
+
+	_thread = std::thread([this, query]() {
+		setThreadName("Text viewer search thread");
+		search(query);
+		_bytesSearched = _size;
+		_searching = false;
+	});
+}
+
+void CTextSearcher::search(const Query& query)
+{
+	if (query.expression.isEmpty() || !_data)
+		return;
+
+	if (!query.regex)
+	{
+		const bool asciiOnly = std::all_of(query.expression.cbegin(), query.expression.cend(), [](QChar c) {
+			return c.unicode() < 0x80;
+		});
+
+		// Only ASCII letters can be matched case-insensitively byte for byte
+		if ((_searchingText || byteSearchable(_codec)) && (query.caseSensitive || asciiOnly))
+		{
+			searchBytes(encode(_codec, query.expression.constData(), query.expression.size()), !query.caseSensitive, query.wholeWords);
+			return;
+		}
+	}
+
+	QString pattern = query.regex ? query.expression : QRegularExpression::escape(query.expression);
+	if (query.wholeWords)
+		pattern = "\\b(?:" + pattern + ")\\b";
+
+	QRegularExpression regex(pattern, query.caseSensitive ? QRegularExpression::UseUnicodePropertiesOption : (QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption));
+	if (!regex.isValid())
+	{
+		qInfo() << __FUNCTION__ << "Invalid regular expression" << pattern << ":" << regex.errorString();
+		return;
+	}
+
+	regex.optimize();
+	if (_searchingText)
+		searchTextWithRegex(regex);
+	else
+		searchLinesWithRegex(regex);
+}
+
+void CTextSearcher::searchBytes(const QByteArray& needle, bool foldAsciiCase, bool wholeWords)
+{
+	const uint64_t needleLength = static_cast<uint64_t>(needle.size());
+	if (needleLength == 0 || needleLength > _size)
+		return;
+
+	QByteArray pattern = needle;
+	if (foldAsciiCase)
+		std::transform(pattern.begin(), pattern.end(), pattern.begin(), [](char c) { return static_cast<char>(foldAscii(static_cast<uchar>(c))); });
+
+	const uchar* patternBytes = reinterpret_cast<const uchar*>(pattern.constData());
+	const uchar first = patternBytes[0];
+	const uchar firstOtherCase = foldAsciiCase && first >= 'a' && first <= 'z' ? static_cast<uchar>(first - ('a' - 'A')) : first;
+
+	const uint64_t lastStart = _size - needleLength;
+	uint64_t nextProgressUpdate = progressUpdateInterval;
+	for (uint64_t pos = 0; pos <= lastStart;)
+	{
+		if (_abort)
+			return;
+
+		if (pos >= nextProgressUpdate)
+		{
+			_bytesSearched = pos;
+			nextProgressUpdate = pos + progressUpdateInterval;
+		}
+
+		// memchr is vectorized by every standard library; the other case of the first byte is only looked for up to the first candidate found
+		const uchar* begin = _data + pos;
+		const size_t length = static_cast<size_t>(std::min(lastStart + 1, pos + progressUpdateInterval) - pos);
+		const uchar* candidate = static_cast<const uchar*>(memchr(begin, first, length));
+		if (firstOtherCase != first)
+		{
+			const uchar* otherCaseCandidate = static_cast<const uchar*>(memchr(begin, firstOtherCase, candidate ? static_cast<size_t>(candidate - begin) : length));
+			if (otherCaseCandidate)
+				candidate = otherCaseCandidate;
+		}
+
+		if (!candidate)
+		{
+			pos += length;
+			continue;
+		}
+
+		const uint64_t offset = static_cast<uint64_t>(candidate - _data);
+		bool matches = offset % static_cast<uint64_t>(_codeUnitSize) == 0;
+		if (matches && foldAsciiCase)
+		{
+			for (uint64_t i = 1; i < needleLength && matches; ++i)
+				matches = foldAscii(candidate[i]) == patternBytes[i];
+		}
+		else if (matches)
+			matches = memcmp(candidate + 1, patternBytes + 1, static_cast<size_t>(needleLength - 1)) == 0;
+
+		if (matches && wholeWords)
+			matches = (offset == 0 || !isWordCharacterAt(offset - static_cast<uint64_t>(_codeUnitSize))) && (offset + needleLength + static_cast<uint64_t>(_codeUnitSize) > _size || !isWordCharacterAt(offset + needleLength));
+
+		if (!matches)
+		{
+			pos = offset + 1;
+			continue;
+		}
+
+		// The text is searched as bytes, but the hits are reported in characters
+		const uint64_t unitSize = _searchingText ? 2 : 1;
+		if (!addHit(offset / unitSize, needleLength / unitSize))
+			return;
+
+		pos = offset + needleLength;
+	}
+}
+
+void CTextSearcher::searchTextWithRegex(const QRegularExpression& regex)
+{
+	QRegularExpressionMatchIterator it = regex.globalMatch(_text);
+	while (it.hasNext())
+	{
+		if (_abort)
+			return;
+
+		const QRegularExpressionMatch match = it.next();
+		if (match.capturedLength() <= 0)
+			continue;
+
+		_bytesSearched = static_cast<uint64_t>(match.capturedStart()) * 2;
+		if (!addHit(static_cast<uint64_t>(match.capturedStart()), static_cast<uint64_t>(match.capturedLength())))
+			return;
+	}
+}
+
+void CTextSearcher::searchLinesWithRegex(const QRegularExpression& regex)
+{
+	// The codecs only skip the byte order mark at the beginning of what they decode, which for the lines other than the first one would be a character of the text;
+	// so the lines are decoded without skipping it, and the mark itself isn't searched
+	std::vector<int> unitOffsets;
+	for (uint64_t lineStart = byteOrderMarkLength(_data, _size, _codec, _codeUnitSize); lineStart < _size;)
+	{
+		if (_abort)
+			return;
+
+		const uint64_t limit = std::min(_size, lineStart + maxLineLength);
+		uint64_t lineEnd = limit;
+		if (_codeUnitSize == 1)
+		{
+			const void* lineBreak = memchr(_data + lineStart, '\n', static_cast<size_t>(limit - lineStart));
+			if (lineBreak)
+				lineEnd = static_cast<uint64_t>(static_cast<const uchar*>(lineBreak) - _data) + 1;
+			else // Not cutting in the middle of a UTF-8 sequence
+				while (lineEnd < _size && lineEnd > lineStart + 1 && (_data[lineEnd] & 0xC0u) == 0x80u)
+					--lineEnd;
+		}
+		else
+		{
+			for (uint64_t i = lineStart; i + 1 < limit; i += 2)
+			{
+				if ((_data[i] == '\n' && _data[i + 1] == 0) || (_data[i] == 0 && _data[i + 1] == '\n'))
+				{
+					lineEnd = i + 2;
+					break;
+				}
+			}
+		}
+
+		const uchar* lineData = _data + lineStart;
+		const int lineSize = static_cast<int>(lineEnd - lineStart);
+		QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+		QString line = _codec->toUnicode(reinterpret_cast<const char*>(lineData), lineSize, &state);
+
+		// Re-encoding the text before a match wouldn't give its byte offset if anything in the line has been decoded as U+FFFD,
+		// so the rare lines that have matches are decoded once more, keeping track of where each character comes from
+		QRegularExpressionMatchIterator it = regex.globalMatch(line);
+		if (it.hasNext())
+		{
+			unitOffsets.clear();
+			line = decodeLineWithOffsets(lineData, lineSize, unitOffsets);
+			it = regex.globalMatch(line);
+		}
+
+		while (it.hasNext())
+		{
+			const QRegularExpressionMatch match = it.next();
+			if (match.capturedLength() <= 0)
+				continue;
+
+			const int matchStart = unitOffsets[static_cast<size_t>(match.capturedStart())], matchEnd = unitOffsets[static_cast<size_t>(match.capturedEnd())];
+			if (!addHit(lineStart + static_cast<uint64_t>(matchStart), static_cast<uint64_t>(matchEnd - matchStart)))
+				return;
+		}
+
+		lineStart = lineEnd;
+		_bytesSearched = lineStart;
+	}
+}
+
+QString CTextSearcher::decodeLineWithOffsets(const uchar* line, int size, std::vector<int>& unitOffsets) const
+{
+	const int mib = _codec->mibEnum();
+	if (mib == 106)
+		return decodeUtf8WithOffsets(line, size, unitOffsets);
+
+	QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+	QString text = _codec->toUnicode(reinterpret_cast<const char*>(line), size, &state);
+	if (text.size() * _codeUnitSize == size && (_codeUnitSize == 2 || byteSearchable(_codec)))
+	{
+		// One code unit per character (or two bytes per UTF-16 code unit)
+		for (int i = 0; i <= text.size(); ++i)
+			unitOffsets.push_back(i * _codeUnitSize);
+		return text;
+	}
+
+	// A multi-byte encoding: the bytes are fed to the decoder one by one, and the characters it outputs start where the previous ones ended
+	text.clear();
+	QTextDecoder decoder(_codec, QTextCodec::IgnoreHeader);
+	int characterStart = 0;
+	for (int i = 0; i < size; ++i)
+	{
+		const QString characters = decoder.toUnicode(reinterpret_cast<const char*>(line + i), 1);
+		if (characters.isEmpty())
+			continue;
+
+		text.append(characters);
+		unitOffsets.insert(unitOffsets.end(), static_cast<size_t>(characters.size()), characterStart);
+		characterStart = i + 1;
+	}
+
+	unitOffsets.push_back(size);
+	return text;
+}
+
+bool CTextSearcher::isWordCharacterAt(uint64_t offset) const
+{
+	if (_codeUnitSize == 2)
+	{
+		const ushort unit = _bigEndianCodeUnits ? static_cast<ushort>(_data[offset] << 8 | _data[offset + 1]) : static_cast<ushort>(_data[offset + 1] << 8 | _data[offset]);
+		const QChar c(unit);
+		return c.isLetterOrNumber() || c == '_';
+	}
+
+	// The non-ASCII bytes are parts of letters more often than not
+	const uchar c = _data[offset];
+	return c >= 0x80 || isalnum(c) || c == '_';
+}
+
+bool CTextSearcher::addHit(uint64_t offset, uint64_t length)
+{
+	{
+		std::lock_guard<std::mutex> lock(_hitsMutex);
+		_newHits.push_back(Hit{offset, length});
+	}
+
+	if (++_numHits >= maxHits)
+	{
+		_hitLimitReached = true;
+		return false;
+	}
+
+	return !_abort;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QFile>
+#include <QRegularExpression>
+#include <QString>
+RESTORE_COMPILER_WARNINGS
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class QTextCodec;
+
+// Finds all the occurrences of an expression in a text on a worker thread, delivering the hits as they are found.
+// Plain expressions are looked for in the encoded bytes with memchr() + memcmp() (case-insensitively for ASCII by looking for both cases of the first character),
+// regular expressions and the plain ones that can't be matched byte for byte are matched against the text decoded one line at a time.
+class CTextSearcher
+{
+public:
+	struct Query {
+		QString expression;
+		bool regex = false;
+		bool caseSensitive = false;
+		bool wholeWords = false;
+
+		bool operator==(const Query& other) const;
+		bool operator!=(const Query& other) const;
+	};
+
+	struct Hit {
+		uint64_t offset;
+		uint64_t length;
+	};
+
+	enum : uint64_t { maxHits = 5000000 };
+
+	~CTextSearcher();
+
+	// Searches a copy of the text; the hits are in characters
+	void start(const QString& text, const Query& query);
+	// Searches the first size bytes of the file, mapped separately from any view of it, so the view can remap or close the file meanwhile; the hits are in bytes
+	bool start(const QString& filePath, uint64_t size, QTextCodec* codec, const Query& query);
+	void stop();
+
+	bool searching() const;
+	// 0 - 100
+	int progress() const;
+	// True if the search has stopped at maxHits
+	bool hitLimitReached() const;
+	// Appends the hits found since the previous call, in ascending order
+	void takeNewHits(std::vector<Hit>& hits);
+
+private:
+	void startThread(const Query& query);
+	void search(const Query& query);
+
+	void searchBytes(const QByteArray& needle, bool foldAsciiCase, bool wholeWords);
+	void searchTextWithRegex(const QRegularExpression& regex);
+	void searchLinesWithRegex(const QRegularExpression& regex);
+	// Decodes a line of the file the same way as the codec, recording for every UTF-16 code unit of the result the offset (from the line start)
+	// of the first byte of its character, so that the match positions can be mapped back to bytes exactly; the last offset is the size of the line
+	QString decodeLineWithOffsets(const uchar* line, int size, std::vector<int>& unitOffsets) const;
+
+	bool isWordCharacterAt(uint64_t offset) const;
+	// Returns false if the search is to be stopped
+	bool addHit(uint64_t offset, uint64_t length);
+
+private:
+	// The text searched is either _text, viewed as UTF-16 bytes, or the mapped file
+	QString _text;
+	QFile _file;
+	uchar* _mappedData = nullptr;
+
+	const uchar* _data = nullptr;
+	uint64_t _size = 0;
+	QTextCodec* _codec = nullptr;
+	int _codeUnitSize = 1;
+	bool _bigEndianCodeUnits = false; // For UTF-16, which may not be in the host byte order
+	bool _searchingText = false;
+
+	uint64_t _numHits = 0;
+
+	mutable std::mutex _hitsMutex;
+	std::vector<Hit> _newHits;
+
+	std::thread _thread;
+	std::atomic<bool> _abort {false};
+	std::atomic<bool> _searching {false};
+	std::atomic<bool> _hitLimitReached {false};
+	std::atomic<uint64_t> _bytesSearched {0};
+};
@@ -1,21 +1,43 @@
 #include "ctextviewerwindow.h"
-#include "ctextencodingdetector.h"
+#include "csampledencodingdetector.h"
 #include "widgets/cpersistentwindow.h"
+#include "assert/advanced_assert.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QLabel>
 #include <QMimeDatabase>
 #include <QMessageBox>
+#include <QScrollBar>
 #include <QShortcut>
 #include <QStringBuilder>
+#include <QSysInfo>
 #include <QTextCodec>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
+
+// The files larger than this are memory-mapped, and only the part on the screen is decoded
+static const qint64 largeFileThreshold = 32 * 1024 * 1024;
+// How often the file size is checked in follow mode, ms
+static const int followModeInterval = 300;
+
+// The byte order of the BOM, or the host's if there's none
+static QTextCodec* utf16Codec(const uchar* data, uint64_t size)
+{
+	if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+		return QTextCodec::codecForName("UTF-16BE");
+	else if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+		return QTextCodec::codecForName("UTF-16LE");
+	else
+		return QTextCodec::codecForName(QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "UTF-16LE" : "UTF-16BE");
+}
 
 CTextViewerWindow::CTextViewerWindow(QWidget* parent) :
 	CPluginWindow(parent),
 	_textBrowser(this),
+	_largeTextView(this),
 	_findDialog(this, "Plugins/TextViewer/Find/")
 {
 	setupUi(this);
@@ -27,6 +49,7 @@ CTextViewerWindow::CTextViewerWindow(QWidget* parent) :
 	_textBrowser.setUndoRedoEnabled(false);
 	_textBrowser.setWordWrapMode(QTextOption::NoWrap);
 	_textBrowser.setTabStopWidth(4 * _textBrowser.fontMetrics().width(' '));
+	_largeTextView.hide();
 
 	connect(actionOpen, &QAction::triggered, [this]() {
 		const QString fileName = QFileDialog::getOpenFileName(this);
@@ -50,6 +73,10 @@ CTextViewerWindow::CTextViewerWindow(QWidget* parent) :
 	connect(actionUTF_16, &QAction::triggered, this, &CTextViewerWindow::asUtf16);
 	connect(actionHTML_RTF, &QAction::triggered, this, &CTextViewerWindow::asRichText);
 
+	connect(actionFollow, &QAction::toggled, this, &CTextViewerWindow::setFollowMode);
+	_followTimer.setInterval(followModeInterval);
+	connect(&_followTimer, &QTimer::timeout, this, &CTextViewerWindow::displayAppendedData);
+
 	QActionGroup * group = new QActionGroup(this);
 	group->addAction(actionASCII_Windows_1252);
 	group->addAction(actionSystemLocale);
@@ -60,11 +87,28 @@ CTextViewerWindow::CTextViewerWindow(QWidget* parent) :
 	connect(&_findDialog, &CFindDialog::find, this, &CTextViewerWindow::find);
 	connect(&_findDialog, &CFindDialog::findNext, this, &CTextViewerWindow::findNext);
 
+	_searchProgressTimer.setInterval(100);
+	connect(&_searchProgressTimer, &QTimer::timeout, this, &CTextViewerWindow::processSearchResults);
+	connect(_textBrowser.verticalScrollBar(), &QScrollBar::valueChanged, this, &CTextViewerWindow::highlightVisibleHits);
+
 	auto escScut = new QShortcut(QKeySequence("Esc"), this, SLOT(close()));
 	connect(this, &QObject::destroyed, escScut, &QShortcut::deleteLater);
 
 	_encodingLabel = new QLabel(this);
 	QMainWindow::statusBar()->addWidget(_encodingLabel);
+
+	_searchStatusLabel = new QLabel(this);
+	QMainWindow::statusBar()->addPermanentWidget(_searchStatusLabel);
+
+	_indexingProgressLabel = new QLabel(this);
+	QMainWindow::statusBar()->addPermanentWidget(_indexingProgressLabel);
+	connect(&_largeTextView, &CLargeTextView::indexingProgressChanged, [this](int percent) {
+		_indexingProgressLabel->setText(percent < 100 ? tr("Indexing lines: %1%").arg(percent) : QString());
+	});
+	// Not reloading from within the view's paint event
+	connect(&_largeTextView, &CLargeTextView::fileTruncated, this, [this]() {
+		loadTextFile(_sourceFilePath);
+	}, Qt::QueuedConnection);
 }
 
 bool CTextViewerWindow::loadTextFile(const QString& file)
@@ -72,6 +116,12 @@ bool CTextViewerWindow::loadTextFile(const QString& file)
 	setWindowTitle(file);
 	_sourceFilePath = file;
 
+	// If a large file can't be mapped, there's still a chance it fits in memory
+	const bool largeFile = QFileInfo(file).size() > largeFileThreshold && _largeTextView.open(file);
+	if (!largeFile)
+		_largeTextView.close();
+	showLargeTextView(largeFile);
+
 	const QString fileType = QMimeDatabase().mimeTypeForFile(_sourceFilePath, QMimeDatabase::MatchContent).name();
 
 	try
@@ -92,10 +142,20 @@ bool CTextViewerWindow::loadTextFile(const QString& file)
 
 bool CTextViewerWindow::asDetectedAutomatically()
 {
-	QTextCodec::ConverterState state;
-	QTextCodec *codec = QTextCodec::codecForName("UTF-8");
-	if (!codec)
-		return false;
+	// The encoding of a large file is detected from samples of the text, and only the part on the screen is decoded;
+	// a text that fits in memory is checked as a whole, since it has to be decoded as a whole anyway
+	if (_largeTextView.isOpen())
+	{
+		const auto result = CSampledEncodingDetector::detect(_sourceFilePath, reinterpret_cast<const char*>(_largeTextView.data()), _largeTextView.size(), CSampledEncodingDetector::SampledText);
+		QTextCodec* codec = result.codecName.isEmpty() ? nullptr : QTextCodec::codecForName(result.codecName);
+		if (!codec)
+			return asSystemDefault();
+
+		_largeTextView.setCodec(codec);
+		encodingChanged(result.encoding, result.language, result.confidence);
+		actionUTF_8->setChecked(result.codecName == "UTF-8");
+		return true;
+	}
 
 	QByteArray textData;
 	if (!readSource(textData))
@@ -104,25 +164,16 @@ bool CTextViewerWindow::asDetectedAutomatically()
 		return false;
 	}
 
-	QString text(codec->toUnicode(textData.constData(), textData.size(), &state));
-	if (state.invalidChars > 0)
-	{
-		const auto result = CTextEncodingDetector::decode(textData);
-		text = result.text;
-		if (!text.isEmpty())
-		{
-			encodingChanged(result.encoding, result.language);
-			_textBrowser.setPlainText(text);
-		}
-		else
-			return asSystemDefault();
-	}
-	else
-	{
-		encodingChanged("UTF-8");
-		actionUTF_8->setChecked(true);
-		_textBrowser.setPlainText(text);
-	}
+	const auto result = CSampledEncodingDetector::detect(_sourceFilePath, textData.constData(), static_cast<uint64_t>(textData.size()), CSampledEncodingDetector::WholeText);
+	QTextCodec* codec = result.codecName.isEmpty() ? nullptr : QTextCodec::codecForName(result.codecName);
+	if (!codec)
+		return asSystemDefault();
+
+	// The detection may have decoded the text already
+	_textBrowser.setPlainText(result.text.isEmpty() ? codec->toUnicode(textData) : result.text);
+	textLoaded(codec, textData.size());
+	encodingChanged(result.encoding, result.language, result.confidence);
+	actionUTF_8->setChecked(result.codecName == "UTF-8");
 
 	return true;
 }
@@ -133,6 +184,14 @@ bool CTextViewerWindow::asSystemDefault()
 	if (!codec)
 		return false;
 
+	if (_largeTextView.isOpen())
+	{
+		_largeTextView.setCodec(codec);
+		encodingChanged(codec->name());
+		actionSystemLocale->setChecked(true);
+		return true;
+	}
+
 	QByteArray textData;
 	if (!readSource(textData))
 	{
@@ -141,6 +200,7 @@ bool CTextViewerWindow::asSystemDefault()
 	}
 
 	_textBrowser.setPlainText(codec->toUnicode(textData));
+	textLoaded(codec, textData.size());
 	encodingChanged(codec->name());
 	actionSystemLocale->setChecked(true);
 
@@ -153,6 +213,14 @@ bool CTextViewerWindow::asAscii()
 	if (!codec)
 		return false;
 
+	if (_largeTextView.isOpen())
+	{
+		_largeTextView.setCodec(codec);
+		encodingChanged(codec->name());
+		actionASCII_Windows_1252->setChecked(true);
+		return true;
+	}
+
 	QByteArray textData;
 	if (!readSource(textData))
 	{
@@ -161,6 +229,7 @@ bool CTextViewerWindow::asAscii()
 	}
 
 	_textBrowser.setPlainText(codec->toUnicode(textData));
+	textLoaded(codec, textData.size());
 	encodingChanged(codec->name());
 	actionASCII_Windows_1252->setChecked(true);
 
@@ -169,6 +238,14 @@ bool CTextViewerWindow::asAscii()
 
 bool CTextViewerWindow::asUtf8()
 {
+	if (_largeTextView.isOpen())
+	{
+		_largeTextView.setCodec(QTextCodec::codecForName("UTF-8"));
+		encodingChanged("UTF-8");
+		actionUTF_8->setChecked(true);
+		return true;
+	}
+
 	QByteArray textData;
 	if (!readSource(textData))
 	{
@@ -178,6 +255,7 @@ bool CTextViewerWindow::asUtf8()
 
 	encodingChanged("UTF-8");
 	_textBrowser.setPlainText(QString::fromUtf8(textData));
+	textLoaded(QTextCodec::codecForName("UTF-8"), textData.size());
 	actionUTF_8->setChecked(true);
 
 	return true;
@@ -185,6 +263,16 @@ bool CTextViewerWindow::asUtf8()
 
 bool CTextViewerWindow::asUtf16()
 {
+	if (_largeTextView.isOpen())
+	{
+		QTextCodec* codec = utf16Codec(_largeTextView.data(), _largeTextView.size());
+		assert_and_return_r(codec, false);
+		_largeTextView.setCodec(codec);
+		encodingChanged(codec->name());
+		actionUTF_16->setChecked(true);
+		return true;
+	}
+
 	QByteArray textData;
 	if (!readSource(textData))
 	{
@@ -192,8 +280,11 @@ bool CTextViewerWindow::asUtf16()
 		return false;
 	}
 
-	encodingChanged("UTF-16");
-	_textBrowser.setPlainText(QString::fromUtf16((const ushort*)textData.constData()));
+	QTextCodec* codec = utf16Codec(reinterpret_cast<const uchar*>(textData.constData()), static_cast<uint64_t>(textData.size()));
+	assert_and_return_r(codec, false);
+	_textBrowser.setPlainText(codec->toUnicode(textData));
+	textLoaded(codec, textData.size());
+	encodingChanged(codec->name());
 	actionUTF_16->setChecked(true);
 
 	return true;
@@ -207,40 +298,220 @@ bool CTextViewerWindow::asRichText()
 
 void CTextViewerWindow::find()
 {
-	_textBrowser.moveCursor(_findDialog.searchBackwards() ? QTextCursor::End : QTextCursor::Start);
-	findNext();
+	const CTextSearcher::Query query = searchQuery();
+	if (query.expression.isEmpty())
+		return;
+
+	// Starting over from the beginning (or the end, if searching backwards)
+	startSearch(query);
+	jumpToHit(true);
 }
 
 void CTextViewerWindow::findNext()
 {
-	const QString expression = _findDialog.searchExpression();
-	if (expression.isEmpty())
+	const CTextSearcher::Query query = searchQuery();
+	if (query.expression.isEmpty())
 		return;
 
-	QTextDocument::FindFlags flags = 0;
-	if (_findDialog.caseSensitive())
-		flags |= QTextDocument::FindCaseSensitively;
-	if (_findDialog.searchBackwards())
-		flags |= QTextDocument::FindBackward;
-	if (_findDialog.wholeWords())
-		flags |= QTextDocument::FindWholeWords;
-
-	const QTextCursor startCursor = _textBrowser.textCursor();
-	bool found = false;
-	if (_findDialog.regex())
-		found = _textBrowser.find(QRegExp(_findDialog.searchExpression(), _findDialog.caseSensitive() ? Qt::CaseSensitive : Qt::CaseInsensitive), flags);
+	// A new search continues from the current position
+	if (query != _searchQuery || !_searchStarted)
+		startSearch(query);
+
+	jumpToHit(false);
+}
+
+CTextSearcher::Query CTextViewerWindow::searchQuery() const
+{
+	CTextSearcher::Query query;
+	query.expression = _findDialog.searchExpression();
+	query.regex = _findDialog.regex();
+	query.caseSensitive = _findDialog.caseSensitive();
+	query.wholeWords = _findDialog.wholeWords();
+	return query;
+}
+
+void CTextViewerWindow::startSearch(const CTextSearcher::Query& query)
+{
+	clearSearch();
+
+	_searchQuery = query;
+	if (_largeTextView.isOpen())
+		_searchStarted = _searcher.start(_sourceFilePath, _largeTextView.size(), _largeTextView.codec(), query);
 	else
-		found = _textBrowser.find(_findDialog.searchExpression(), flags);
+	{
+		_searcher.start(_textBrowser.toPlainText(), query);
+		_searchStarted = true;
+	}
+
+	if (_searchStarted)
+	{
+		_largeTextView.setSearchHits(&_hits);
+		_searchProgressTimer.start();
+		updateSearchStatus();
+	}
+}
+
+void CTextViewerWindow::clearSearch()
+{
+	_searcher.stop();
+	_searchProgressTimer.stop();
+	_searchStarted = false;
+	_jumpPending = false;
+	_hits.clear();
+	_currentHit = noHit;
+
+	_largeTextView.setSearchHits(nullptr);
+	_textBrowser.setExtraSelections({});
+	_searchStatusLabel->clear();
+}
+
+void CTextViewerWindow::processSearchResults()
+{
+	const bool searchFinished = !_searcher.searching();
+	if (searchFinished)
+		_searchProgressTimer.stop();
+
+	const size_t numHitsBefore = _hits.size();
+	_searcher.takeNewHits(_hits);
+	updateSearchStatus();
+
+	if (_jumpPending && (_hits.size() > numHitsBefore || searchFinished))
+		jumpToHit(_jumpFromStart);
 
-	if(!found && (startCursor.isNull() || startCursor.position() == 0))
-		QMessageBox::information(this, tr("Not found"), tr("Expression \"%1\" not found").arg(expression));
-	else if (!found && startCursor.position() > 0)
+	if (_hits.size() > numHitsBefore)
 	{
-		if (QMessageBox::question(this, tr("Not found"), _findDialog.searchBackwards() ? tr("Beginning of file reached, do you want to restart search from the end?") : tr("End of file reached, do you want to restart search from the top?")) == QMessageBox::Yes)
-			find();
+		if (_largeTextView.isOpen())
+			_largeTextView.viewport()->update();
+		else
+			highlightVisibleHits();
 	}
 }
 
+void CTextViewerWindow::updateSearchStatus()
+{
+	QString status = _searcher.hitLimitReached() ? tr("%1+ hits").arg(_hits.size()) : tr("%1 hits").arg(_hits.size());
+	if (_currentHit != noHit)
+		status = tr("Hit %1 of %2").arg(_currentHit + 1).arg(status);
+	if (_searcher.searching())
+		status += tr(", searching: %1%").arg(_searcher.progress());
+
+	_searchStatusLabel->setText(status);
+}
+
+void CTextViewerWindow::jumpToHit(bool fromStart)
+{
+	const bool backwards = _findDialog.searchBackwards();
+	const bool searching = _searcher.searching();
+
+	// The position the next hit is looked for from: the current hit, or where the user is in the text
+	uint64_t position = 0;
+	if (fromStart)
+		position = backwards ? std::numeric_limits<uint64_t>::max() : 0;
+	else if (_currentHit != noHit)
+		position = _hits[_currentHit].offset;
+	else if (_largeTextView.isOpen())
+		position = _largeTextView.firstVisibleOffset();
+	else
+		position = static_cast<uint64_t>(_textBrowser.textCursor().selectionStart());
+
+	const bool skipHitAtPosition = !fromStart && _currentHit != noHit;
+	size_t hitIndex = noHit;
+	if (!backwards)
+	{
+		const auto hit = std::lower_bound(_hits.cbegin(), _hits.cend(), position, [skipHitAtPosition](const CTextSearcher::Hit& h, uint64_t offset) {
+			return skipHitAtPosition ? h.offset <= offset : h.offset < offset;
+		});
+
+		if (hit != _hits.cend())
+			hitIndex = static_cast<size_t>(hit - _hits.cbegin());
+	}
+	else
+	{
+		const auto hit = std::lower_bound(_hits.cbegin(), _hits.cend(), position, [](const CTextSearcher::Hit& h, uint64_t offset) {
+			return h.offset < offset;
+		});
+
+		// The hits before the position are only all known once the search has got past it
+		const bool searchPassedPosition = !searching || hit != _hits.cend();
+		if (hit != _hits.cbegin() && searchPassedPosition)
+			hitIndex = static_cast<size_t>(hit - _hits.cbegin()) - 1;
+	}
+
+	if (hitIndex != noHit)
+	{
+		_jumpPending = false;
+		showHit(hitIndex);
+		return;
+	}
+
+	if (searching)
+	{
+		// Will jump as soon as the hit is found
+		_jumpPending = true;
+		_jumpFromStart = fromStart;
+		return;
+	}
+
+	_jumpPending = false;
+	if (_hits.empty())
+		QMessageBox::information(this, tr("Not found"), tr("Expression \"%1\" not found").arg(_searchQuery.expression));
+	else if (!fromStart)
+	{
+		if (QMessageBox::question(this, tr("Not found"), backwards ? tr("Beginning of file reached, do you want to restart search from the end?") : tr("End of file reached, do you want to restart search from the top?")) == QMessageBox::Yes)
+			jumpToHit(true);
+	}
+}
+
+void CTextViewerWindow::showHit(size_t hitIndex)
+{
+	assert_and_return_r(hitIndex < _hits.size(), );
+	_currentHit = hitIndex;
+	const CTextSearcher::Hit& hit = _hits[hitIndex];
+
+	if (_largeTextView.isOpen())
+		_largeTextView.showHit(hit);
+	else
+	{
+		QTextCursor cursor(_textBrowser.document());
+		cursor.setPosition(static_cast<int>(hit.offset));
+		cursor.setPosition(static_cast<int>(hit.offset + hit.length), QTextCursor::KeepAnchor);
+		_textBrowser.setTextCursor(cursor);
+		highlightVisibleHits();
+	}
+
+	updateSearchStatus();
+}
+
+void CTextViewerWindow::highlightVisibleHits()
+{
+	if (_hits.empty() || _largeTextView.isOpen())
+		return;
+
+	// Only the hits on the screen are highlighted, there may be millions of them in total
+	const uint64_t visibleBegin = static_cast<uint64_t>(_textBrowser.cursorForPosition(QPoint(0, 0)).position());
+	const uint64_t visibleEnd = static_cast<uint64_t>(_textBrowser.cursorForPosition(QPoint(_textBrowser.viewport()->width(), _textBrowser.viewport()->height())).position());
+
+	QList<QTextEdit::ExtraSelection> selections;
+	auto hit = std::lower_bound(_hits.cbegin(), _hits.cend(), visibleBegin, [](const CTextSearcher::Hit& h, uint64_t offset) {
+		return h.offset < offset;
+	});
+	// The lines are not wrapped, so a hit that's visible may start before the first visible character
+	if (hit != _hits.cbegin())
+		--hit;
+
+	for (; hit != _hits.cend() && hit->offset <= visibleEnd; ++hit)
+	{
+		QTextEdit::ExtraSelection selection;
+		selection.cursor = QTextCursor(_textBrowser.document());
+		selection.cursor.setPosition(static_cast<int>(hit->offset));
+		selection.cursor.setPosition(static_cast<int>(hit->offset + hit->length), QTextCursor::KeepAnchor);
+		selection.format.setBackground(Qt::yellow);
+		selections.push_back(selection);
+	}
+
+	_textBrowser.setExtraSelections(selections);
+}
+
 bool CTextViewerWindow::readSource(QByteArray& textData) const
 {
 	QFile file(_sourceFilePath);
@@ -253,13 +524,110 @@ bool CTextViewerWindow::readSource(QByteArray& textData) const
 		return false;
 }
 
-void CTextViewerWindow::encodingChanged(const QString& encoding, const QString& language)
+void CTextViewerWindow::textLoaded(QTextCodec* codec, qint64 size)
+{
+	if (!codec)
+		codec = QTextCodec::codecForLocale();
+
+	_loadedSize = size;
+	_appendedDataDecoder.reset(codec ? codec->makeDecoder() : nullptr);
+
+	if (actionFollow->isChecked())
+		_textBrowser.verticalScrollBar()->setValue(_textBrowser.verticalScrollBar()->maximum());
+}
+
+void CTextViewerWindow::setFollowMode(bool follow)
 {
+	_largeTextView.setPinnedToEnd(follow);
+	if (!follow)
+	{
+		_followTimer.stop();
+		return;
+	}
+
+	displayAppendedData();
+	if (_largeTextView.isOpen())
+		_largeTextView.scrollToEnd();
+	else
+		_textBrowser.verticalScrollBar()->setValue(_textBrowser.verticalScrollBar()->maximum());
+
+	_followTimer.start();
+}
+
+void CTextViewerWindow::displayAppendedData()
+{
+	if (_sourceFilePath.isEmpty())
+		return;
+
+	if (_largeTextView.isOpen())
+	{
+		// The view has closed the file if it has shrunk (e. g. the log was rotated)
+		if (!_largeTextView.mapAppendedData() && !_largeTextView.isOpen())
+			loadTextFile(_sourceFilePath);
+
+		return;
+	}
+
+	QFile file(_sourceFilePath);
+	if (!file.open(QFile::ReadOnly) || !_appendedDataDecoder)
+		return;
+
+	const qint64 size = file.size();
+	if (size < _loadedSize)
+	{
+		loadTextFile(_sourceFilePath);
+		return;
+	}
+	else if (size == _loadedSize || !file.seek(_loadedSize))
+		return;
+
+	const QByteArray appendedData = file.read(size - _loadedSize);
+	_loadedSize += appendedData.size();
+
+	// Only following the end if the user hasn't scrolled away from it
+	QScrollBar* scrollBar = _textBrowser.verticalScrollBar();
+	const bool atEnd = scrollBar->value() == scrollBar->maximum();
+
+	// The decoder keeps the incomplete character at the end of the previous chunk, if any
+	QTextCursor cursor(_textBrowser.document());
+	cursor.movePosition(QTextCursor::End);
+	cursor.insertText(_appendedDataDecoder->toUnicode(appendedData));
+
+	if (atEnd)
+		scrollBar->setValue(scrollBar->maximum());
+}
+
+void CTextViewerWindow::showLargeTextView(bool show)
+{
+	QWidget* view = show ? static_cast<QWidget*>(&_largeTextView) : static_cast<QWidget*>(&_textBrowser);
+	if (centralWidget() != view)
+	{
+		// Not letting the main window delete the view that's being replaced
+		takeCentralWidget()->hide();
+		setCentralWidget(view);
+		view->show();
+	}
+
+	if (show)
+		_textBrowser.clear();
+
+	// Rich text isn't supported in the large file view
+	actionHTML_RTF->setEnabled(!show);
+	_indexingProgressLabel->clear();
+}
+
+void CTextViewerWindow::encodingChanged(const QString& encoding, const QString& language, int confidence)
+{
+	// The text has been reloaded or decoded differently, so the hits are no longer valid
+	clearSearch();
+
 	QString message;
 	if (!encoding.isEmpty())
 		message = tr("Text encoding: ") % encoding;
 	if (!language.isEmpty())
 		message = message % ", " % tr("language: ") % language;
+	if (confidence >= 0 && confidence < 100)
+		message = message % " " % tr("(%1% confidence)").arg(confidence);
 
 	_encodingLabel->setText(message);
 }
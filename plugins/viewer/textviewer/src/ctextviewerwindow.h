@@ -3,13 +3,21 @@
 
 #include "plugininterface/cpluginwindow.h"
 #include "cfinddialog.h"
+#include "clargetextview.h"
+#include "ctextsearcher.h"
 
 #include "ui_ctextviewerwindow.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QPlainTextEdit>
+#include <QTextCodec>
+#include <QTimer>
 RESTORE_COMPILER_WARNINGS
 
+#include <limits>
+#include <memory>
+#include <vector>
+
 class QLabel;
 
 class CTextViewerWindow : public CPluginWindow, private Ui::CTextViewerWindow
@@ -30,16 +38,54 @@ private:
 	void find();
 	void findNext();
 
+	CTextSearcher::Query searchQuery() const;
+	void startSearch(const CTextSearcher::Query& query);
+	void clearSearch();
+	// Collects the hits found since the previous call
+	void processSearchResults();
+	void updateSearchStatus();
+	// Goes to the next or the previous hit, depending on the search direction, starting from the current hit, or the current position in the text
+	// (the beginning or the end of the text if fromStart is true). If the hit isn't found yet, it's shown as soon as it is.
+	void jumpToHit(bool fromStart);
+	void showHit(size_t hitIndex);
+	void highlightVisibleHits();
+
 	bool readSource(QByteArray& data) const;
+	// Remembers how many bytes of the file are displayed and in what encoding, for decoding the data appended to the file in follow mode
+	void textLoaded(QTextCodec* codec, qint64 size);
+
+	void setFollowMode(bool follow);
+	// Only decodes and displays what has been written since the previous check; reloads the file if it has shrunk
+	void displayAppendedData();
+	// Switches between the regular text view and the large file view
+	void showLargeTextView(bool show);
 
-	void encodingChanged(const QString& encoding, const QString& language = QString());
+	// The confidence is only shown for the detected encoding
+	void encodingChanged(const QString& encoding, const QString& language = QString(), int confidence = -1);
 
 private:
 	QPlainTextEdit _textBrowser;
+	CLargeTextView _largeTextView;
 	CFindDialog    _findDialog;
 	QString        _sourceFilePath;
 
+	QTimer         _followTimer;
+	qint64         _loadedSize = 0;
+	std::unique_ptr<QTextDecoder> _appendedDataDecoder;
+
+	static constexpr size_t noHit = std::numeric_limits<size_t>::max();
+	CTextSearcher  _searcher;
+	CTextSearcher::Query _searchQuery;
+	std::vector<CTextSearcher::Hit> _hits; // In characters for the regular view, in bytes for the large file view
+	size_t         _currentHit = noHit;
+	bool           _searchStarted = false;
+	bool           _jumpPending = false;
+	bool           _jumpFromStart = false;
+	QTimer         _searchProgressTimer;
+
 	QLabel       * _encodingLabel = nullptr;
+	QLabel       * _indexingProgressLabel = nullptr;
+	QLabel       * _searchStatusLabel = nullptr;
 };
 
 #endif // CTEXTVIEWERWINDOW_H
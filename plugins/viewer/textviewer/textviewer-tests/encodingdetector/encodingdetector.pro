@@ -0,0 +1,31 @@
+TEMPLATE = app
+TARGET   = encodingdetector_test
+
+include(../../../../../file-commander-core/config.pri)
+
+QT = core testlib
+
+DESTDIR  = ../../../../../bin/$${OUTPUT_DIR}
+OBJECTS_DIR = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+MOC_DIR     = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+UI_DIR      = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+RCC_DIR     = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+
+mac*|linux*{
+	PRE_TARGETDEPS += $${DESTDIR}/libtext_encoding_detector.a $${DESTDIR}/libcpputils.a
+}
+
+INCLUDEPATH += \
+	$${PWD}/ \
+	../../src/ \
+	../../../../../cpputils \
+	../../../../../text-encoding-detector/text-encoding-detector/src
+
+LIBS += -L$${DESTDIR} -ltext_encoding_detector -lcpputils
+
+SOURCES += \
+	encodingdetectortest.cpp \
+	../../src/csampledencodingdetector.cpp
+
+HEADERS += \
+	../../src/csampledencodingdetector.h
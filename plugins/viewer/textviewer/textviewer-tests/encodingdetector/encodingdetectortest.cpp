@@ -0,0 +1,117 @@
+#include "csampledencodingdetector.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QTextCodec>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+class EncodingDetectorTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void ascii();
+	void utf8();
+	void invalidUtf8_data();
+	void invalidUtf8();
+	void rareNonUtf8CharactersOutsideTheSamples();
+	void utf16ByteOrderMark_data();
+	void utf16ByteOrderMark();
+
+private:
+	// A mostly ASCII text of about 'size' bytes, with 'insertion' a quarter of the way in, which is outside the samples of a large text
+	static QByteArray text(int size, const QByteArray& insertion = QByteArray());
+	static CSampledEncodingDetector::Result detect(const QByteArray& data, CSampledEncodingDetector::Scope scope);
+};
+
+void EncodingDetectorTest::ascii()
+{
+	const auto result = detect(text(1024 * 1024), CSampledEncodingDetector::WholeText);
+	QCOMPARE(result.codecName, QByteArray("UTF-8"));
+	QCOMPARE(result.confidence, 90);
+}
+
+void EncodingDetectorTest::utf8()
+{
+	for (const auto scope: {CSampledEncodingDetector::SampledText, CSampledEncodingDetector::WholeText})
+	{
+		const auto result = detect(text(100 * 1024, "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xF0\x9F\x98\x80"), scope);
+		QCOMPARE(result.codecName, QByteArray("UTF-8"));
+		QCOMPARE(result.confidence, 100);
+	}
+}
+
+void EncodingDetectorTest::invalidUtf8_data()
+{
+	QTest::addColumn<QByteArray>("sequence");
+
+	QTest::newRow("Windows-1251") << QByteArray("\xEF\xF0\xE8\xE2\xE5\xF2");
+	QTest::newRow("truncated") << QByteArray("\xE2\x82 ");
+	QTest::newRow("overlong") << QByteArray("\xE0\x80\xAF");
+	QTest::newRow("surrogate") << QByteArray("\xED\xA0\x80");
+	QTest::newRow("past U+10FFFF") << QByteArray("\xF4\x90\x80\x80");
+}
+
+void EncodingDetectorTest::invalidUtf8()
+{
+	QFETCH(QByteArray, sequence);
+	QVERIFY(detect(text(1000, sequence), CSampledEncodingDetector::WholeText).codecName != "UTF-8");
+}
+
+// The in-memory text is checked as a whole; the samples of a large one miss a non-UTF-8 character in between them
+void EncodingDetectorTest::rareNonUtf8CharactersOutsideTheSamples()
+{
+	const QByteArray data = text(4 * 1024 * 1024, "\xEF\xF0\xE8\xE2\xE5\xF2 (Windows-1251)");
+	QVERIFY(detect(data, CSampledEncodingDetector::WholeText).codecName != "UTF-8");
+	QCOMPARE(detect(data, CSampledEncodingDetector::SampledText).codecName, QByteArray("UTF-8"));
+}
+
+void EncodingDetectorTest::utf16ByteOrderMark_data()
+{
+	QTest::addColumn<QByteArray>("data");
+	QTest::addColumn<QByteArray>("codecName");
+
+	// "a\nb\n"
+	QTest::newRow("LE") << QByteArray("\xFF\xFE" "a\0\n\0b\0\n\0", 10) << QByteArray("UTF-16LE");
+	QTest::newRow("BE") << QByteArray("\xFE\xFF" "\0a\0\n\0b\0\n", 10) << QByteArray("UTF-16BE");
+}
+
+// The codec must be of the byte order of the BOM, as the rows after the first one are decoded without the BOM
+void EncodingDetectorTest::utf16ByteOrderMark()
+{
+	QFETCH(QByteArray, data);
+	QFETCH(QByteArray, codecName);
+
+	const auto result = detect(data, CSampledEncodingDetector::WholeText);
+	QCOMPARE(result.codecName, codecName);
+	QCOMPARE(result.encoding, QString(codecName));
+	QCOMPARE(result.confidence, 100);
+
+	QTextCodec* codec = QTextCodec::codecForName(result.codecName);
+	QVERIFY(codec);
+	QCOMPARE(codec->toUnicode(data), QString("a\nb\n"));
+	QCOMPARE(codec->toUnicode(data.mid(6)), QString("b\n"));
+}
+
+QByteArray EncodingDetectorTest::text(int size, const QByteArray& insertion)
+{
+	const QByteArray line = "The quick brown fox jumps over the lazy dog.\n";
+	QByteArray result;
+	result.reserve(size + insertion.size() + line.size());
+	while (result.size() < size / 4)
+		result += line;
+	result += insertion;
+	while (result.size() < size)
+		result += line;
+	return result;
+}
+
+CSampledEncodingDetector::Result EncodingDetectorTest::detect(const QByteArray& data, CSampledEncodingDetector::Scope scope)
+{
+	return CSampledEncodingDetector::detect(data.constData(), static_cast<uint64_t>(data.size()), scope);
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_APPLESS_MAIN(EncodingDetectorTest)
+#include "encodingdetectortest.moc"
+RESTORE_COMPILER_WARNINGS
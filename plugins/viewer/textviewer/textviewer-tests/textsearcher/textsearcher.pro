@@ -0,0 +1,32 @@
+TEMPLATE = app
+TARGET   = textsearcher_test
+
+include(../../../../../file-commander-core/config.pri)
+
+QT = core testlib
+
+DESTDIR  = ../../../../../bin/$${OUTPUT_DIR}
+OBJECTS_DIR = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+MOC_DIR     = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+UI_DIR      = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+RCC_DIR     = ../../../../../build/$${OUTPUT_DIR}/$${TARGET}
+
+mac*|linux*{
+	PRE_TARGETDEPS += $${DESTDIR}/libcpputils.a
+}
+
+INCLUDEPATH += \
+	$${PWD}/ \
+	../../src/ \
+	../../../../../cpputils
+
+LIBS += -L$${DESTDIR} -lcpputils
+
+SOURCES += \
+	textsearchertest.cpp \
+	../../src/ctextsearcher.cpp \
+	../../src/ctextlineindex.cpp
+
+HEADERS += \
+	../../src/ctextsearcher.h \
+	../../src/ctextlineindex.h
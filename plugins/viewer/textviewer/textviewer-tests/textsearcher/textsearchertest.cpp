@@ -0,0 +1,207 @@
+#include "ctextsearcher.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QSysInfo>
+#include <QTemporaryFile>
+#include <QTextCodec>
+#include <QThread>
+#include <QtTest>
+RESTORE_COMPILER_WARNINGS
+
+#include <utility>
+#include <vector>
+
+using Hits = std::vector<std::pair<uint64_t, uint64_t>>; // Offset, length
+
+class TextSearcherTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void bytes_data();
+	void bytes();
+
+	void regex_data();
+	void regex();
+
+	void multiByteEncoding();
+
+	void caseFoldingAtOddOffsets_data();
+	void caseFoldingAtOddOffsets();
+	void caseFoldingAtOddOffsetsInText();
+
+private:
+	static CTextSearcher::Query query(const QString& expression, bool regex, bool caseSensitive, bool wholeWords = false);
+	// Searches the data written to a file; the hits are in bytes
+	static Hits searchFile(const QByteArray& data, const char* codecName, const CTextSearcher::Query& query);
+	// The hits are in characters
+	static Hits searchText(const QString& text, const CTextSearcher::Query& query);
+	static Hits waitForHits(CTextSearcher& searcher);
+};
+
+Q_DECLARE_METATYPE(Hits)
+
+void TextSearcherTest::bytes_data()
+{
+	QTest::addColumn<QByteArray>("data");
+	QTest::addColumn<QString>("expression");
+	QTest::addColumn<bool>("caseSensitive");
+	QTest::addColumn<bool>("wholeWords");
+	QTest::addColumn<Hits>("hits");
+
+	QTest::newRow("case-sensitive") << QByteArray("foo Foo foo\nfoofoo") << "foo" << true << false << Hits{{0, 3}, {8, 3}, {12, 3}, {15, 3}};
+	QTest::newRow("case-insensitive") << QByteArray("foo Foo FOO") << "fOo" << false << false << Hits{{0, 3}, {4, 3}, {8, 3}};
+	QTest::newRow("whole words") << QByteArray("foo foobar barfoo (foo)") << "foo" << true << true << Hits{{0, 3}, {19, 3}};
+	QTest::newRow("at the end") << QByteArray("xxfoo") << "foo" << true << false << Hits{{2, 3}};
+	QTest::newRow("UTF-8") << QByteArray("\xC3\xA4 \xC3\xA4\xC3\xA4") << QString::fromUtf8("\xC3\xA4\xC3\xA4") << true << false << Hits{{3, 4}};
+	QTest::newRow("with a BOM") << QByteArray("\xEF\xBB\xBF" "abc abc") << "abc" << true << false << Hits{{3, 3}, {7, 3}};
+}
+
+void TextSearcherTest::bytes()
+{
+	QFETCH(QByteArray, data);
+	QFETCH(QString, expression);
+	QFETCH(bool, caseSensitive);
+	QFETCH(bool, wholeWords);
+	QFETCH(Hits, hits);
+
+	QCOMPARE(searchFile(data, "UTF-8", query(expression, false, caseSensitive, wholeWords)), hits);
+}
+
+void TextSearcherTest::regex_data()
+{
+	QTest::addColumn<QByteArray>("data");
+	QTest::addColumn<QByteArray>("codecName");
+	QTest::addColumn<QString>("expression");
+	QTest::addColumn<bool>("regex");
+	QTest::addColumn<bool>("caseSensitive");
+	QTest::addColumn<Hits>("hits");
+
+	QTest::newRow("lines") << QByteArray("abc def\nxyz def\r\ndxf") << QByteArray("UTF-8") << "d.f" << true << true << Hits{{4, 3}, {12, 3}, {17, 3}};
+	// The codec strips the BOM, the hits must still be in the file's bytes
+	QTest::newRow("UTF-8 BOM") << QByteArray("\xEF\xBB\xBF" "abc def\nxyz def") << QByteArray("UTF-8") << "d.f" << true << true << Hits{{7, 3}, {15, 3}};
+	QTest::newRow("multi-byte characters") << QByteArray("\xC3\xA4 d\xC3\xA4" "f") << QByteArray("UTF-8") << "d.f" << true << true << Hits{{3, 4}};
+	// Every invalid byte is decoded as U+FFFD, which takes 3 bytes to encode
+	QTest::newRow("invalid UTF-8") << QByteArray("a\xFF\xFE" "b def \xE2\x82 dxf") << QByteArray("UTF-8") << "d.f" << true << true << Hits{{5, 3}, {12, 3}};
+	QTest::newRow("4-byte characters") << QByteArray("\xF0\x9F\x98\x80 d\xF0\x9F\x98\x80" "f") << QByteArray("UTF-8") << "d.f" << true << true << Hits{{5, 6}};
+	// A non-ASCII expression can't be matched case-insensitively byte for byte
+	QTest::newRow("non-ASCII, case-insensitive") << QByteArray("xx \xC3\xA4" "bc \xC3\x84" "BC") << QByteArray("UTF-8") << QString::fromUtf8("\xC3\x84" "bc") << false << false << Hits{{3, 4}, {8, 4}};
+	QTest::newRow("Windows-1251") << QByteArray("\xEF\xF0\xE8\xE2\xE5\xF2 d\xE5" "f") << QByteArray("Windows-1251") << "d.f" << true << true << Hits{{7, 3}};
+	QTest::newRow("UTF-16LE BOM") << QByteArray("\xFF\xFE" "a\0b\0\n\0d\0e\0f\0", 14) << QByteArray("UTF-16LE") << "d.f" << true << true << Hits{{8, 6}};
+	QTest::newRow("UTF-16BE BOM") << QByteArray("\xFE\xFF\0a\0b\0\n\0d\0e\0f", 14) << QByteArray("UTF-16BE") << "d.f" << true << true << Hits{{8, 6}};
+	// A U+FEFF that isn't at the beginning of the file is a character
+	QTest::newRow("UTF-16LE U+FEFF in the text") << QByteArray("a\0\n\0\xFF\xFE" "d\0e\0f\0", 12) << QByteArray("UTF-16LE") << ".d" << true << true << Hits{{4, 4}};
+}
+
+void TextSearcherTest::regex()
+{
+	QFETCH(QByteArray, data);
+	QFETCH(QByteArray, codecName);
+	QFETCH(QString, expression);
+	QFETCH(bool, regex);
+	QFETCH(bool, caseSensitive);
+	QFETCH(Hits, hits);
+
+	QCOMPARE(searchFile(data, codecName.constData(), query(expression, regex, caseSensitive)), hits);
+}
+
+void TextSearcherTest::multiByteEncoding()
+{
+	QTextCodec* shiftJis = QTextCodec::codecForName("Shift_JIS");
+	if (!shiftJis)
+		QSKIP("Shift_JIS is not available");
+
+	// Two 2-byte characters and a space before the match
+	const QString text = QString::fromUtf8("\xE6\x97\xA5\xE6\x9C\xAC abc \xE6\x97\xA5");
+	const QByteArray data = shiftJis->fromUnicode(text);
+	QCOMPARE(searchFile(data, "Shift_JIS", query("a.c", true, true)), (Hits{{5, 3}}));
+	QCOMPARE(searchFile(data, "Shift_JIS", query("c .", true, true)), (Hits{{7, 4}}));
+}
+
+void TextSearcherTest::caseFoldingAtOddOffsets_data()
+{
+	QTest::addColumn<QByteArray>("codecName");
+	QTest::newRow("UTF-16LE") << QByteArray("UTF-16LE");
+	QTest::newRow("UTF-16BE") << QByteArray("UTF-16BE");
+}
+
+// When the bytes of the UTF-16 text are folded to lower case, an 'A' made of the bytes of two code units looks like "a" at an odd offset, which must not be taken for a match:
+// U+4120 U+2000 is 20 41 00 20 in little endian, U+2000 U+4120 is 20 00 41 20 in big endian
+static QString textWithAStraddlingTwoCodeUnits(bool littleEndian)
+{
+	return littleEndian ? QString() + QChar(0x4120) + QChar(0x2000) + "xA" : QString() + QChar(0x2000) + QChar(0x4120) + "xA";
+}
+
+void TextSearcherTest::caseFoldingAtOddOffsets()
+{
+	QFETCH(QByteArray, codecName);
+	QTextCodec* codec = QTextCodec::codecForName(codecName);
+	QVERIFY(codec);
+
+	const QString text = textWithAStraddlingTwoCodeUnits(codecName == "UTF-16LE");
+	QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+	const QByteArray data = codec->fromUnicode(text.constData(), text.size(), &state);
+	QCOMPARE(data.size(), 8);
+
+	QCOMPARE(searchFile(data, codecName.constData(), query("a", false, false)), (Hits{{6, 2}}));
+	QCOMPARE(searchFile(data, codecName.constData(), query("xa", false, false)), (Hits{{4, 4}}));
+}
+
+void TextSearcherTest::caseFoldingAtOddOffsetsInText()
+{
+	// The text is searched as UTF-16 in the native byte order
+	const QString text = textWithAStraddlingTwoCodeUnits(QSysInfo::ByteOrder == QSysInfo::LittleEndian);
+	QCOMPARE(searchText(text, query("a", false, false)), (Hits{{3, 1}}));
+	QCOMPARE(searchText(text, query("X", false, false)), (Hits{{2, 1}}));
+	QCOMPARE(searchText(text, query("x.", true, true)), (Hits{{2, 2}}));
+}
+
+CTextSearcher::Query TextSearcherTest::query(const QString& expression, bool regex, bool caseSensitive, bool wholeWords)
+{
+	CTextSearcher::Query query;
+	query.expression = expression;
+	query.regex = regex;
+	query.caseSensitive = caseSensitive;
+	query.wholeWords = wholeWords;
+	return query;
+}
+
+Hits TextSearcherTest::searchFile(const QByteArray& data, const char* codecName, const CTextSearcher::Query& query)
+{
+	QTemporaryFile file;
+	if (!file.open() || file.write(data) != data.size() || !file.flush())
+		return Hits{{0, 0}};
+
+	QTextCodec* codec = QTextCodec::codecForName(codecName);
+	CTextSearcher searcher;
+	if (!codec || !searcher.start(file.fileName(), static_cast<uint64_t>(data.size()), codec, query))
+		return Hits{{0, 0}};
+
+	return waitForHits(searcher);
+}
+
+Hits TextSearcherTest::searchText(const QString& text, const CTextSearcher::Query& query)
+{
+	CTextSearcher searcher;
+	searcher.start(text, query);
+	return waitForHits(searcher);
+}
+
+Hits TextSearcherTest::waitForHits(CTextSearcher& searcher)
+{
+	while (searcher.searching())
+		QThread::msleep(1);
+
+	std::vector<CTextSearcher::Hit> hits;
+	searcher.takeNewHits(hits);
+
+	Hits result;
+	for (const CTextSearcher::Hit& hit: hits)
+		result.emplace_back(hit.offset, hit.length);
+	return result;
+}
+
+DISABLE_COMPILER_WARNINGS
+QTEST_APPLESS_MAIN(TextSearcherTest)
+#include "textsearchertest.moc"
+RESTORE_COMPILER_WARNINGS
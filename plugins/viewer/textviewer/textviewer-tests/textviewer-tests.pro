@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+
+SUBDIRS = textsearcher encodingdetector
+SUBDIRS += cpputils text_encoding_detector
+
+cpputils.subdir = ../../../../cpputils
+
+text_encoding_detector.subdir = ../../../../text-encoding-detector/text-encoding-detector
+text_encoding_detector.depends = cpputils
+
+textsearcher.depends = cpputils
+encodingdetector.depends = cpputils text_encoding_detector
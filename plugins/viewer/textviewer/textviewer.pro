@@ -81,12 +81,20 @@ INCLUDEPATH += \
 HEADERS += \
 	src/ctextviewerplugin.h \
 	src/ctextviewerwindow.h \
-	src/cfinddialog.h
+	src/cfinddialog.h \
+	src/clargetextview.h \
+	src/ctextlineindex.h \
+	src/ctextsearcher.h \
+	src/csampledencodingdetector.h
 
 SOURCES += \
 	src/ctextviewerplugin.cpp \
 	src/ctextviewerwindow.cpp \
-	src/cfinddialog.cpp
+	src/cfinddialog.cpp \
+	src/clargetextview.cpp \
+	src/ctextlineindex.cpp \
+	src/ctextsearcher.cpp \
+	src/csampledencodingdetector.cpp
 
 FORMS += \
 	src/ctextviewerwindow.ui \
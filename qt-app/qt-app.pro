@@ -57,6 +57,7 @@ SOURCES += \
 	src/panel/filelistwidget/model/cfilelistmodel.cpp \
 	src/panel/filelistwidget/cfilelistview.cpp \
 	src/panel/filelistwidget/model/cfilelistsortfilterproxymodel.cpp \
+	src/panel/filelistwidget/model/filelistsorting.cpp \
 	src/settings/csettingspageinterface.cpp \
 	src/settings/csettingspageedit.cpp \
 	src/settings/csettingspageother.cpp \
@@ -67,6 +68,7 @@ SOURCES += \
 	src/favoritelocationseditor/cnewfavoritelocationdialog.cpp \
 	src/panel/filelistwidget/cfilelistfilterdialog.cpp \
 	src/filessearchdialog/cfilessearchwindow.cpp \
+	src/filessearchdialog/csearchresultsmodel.cpp \
 	src/progressdialogs/cdeleteprogressdialog.cpp \
 	src/aboutdialog/caboutdialog.cpp \
 	src/progressdialogs/progressdialoghelpers.cpp
@@ -81,6 +83,7 @@ HEADERS += \
 	src/panel/columns.h \
 	src/panel/filelistwidget/cfilelistview.h \
 	src/panel/filelistwidget/model/cfilelistsortfilterproxymodel.h \
+	src/panel/filelistwidget/model/filelistsorting.h \
 	src/settings/csettingspageinterface.h \
 	src/settings/csettingspageedit.h \
 	src/settings/csettingspageother.h \
@@ -91,6 +94,7 @@ HEADERS += \
 	src/favoritelocationseditor/cnewfavoritelocationdialog.h \
 	src/panel/filelistwidget/cfilelistfilterdialog.h \
 	src/filessearchdialog/cfilessearchwindow.h \
+	src/filessearchdialog/csearchresultsmodel.h \
 	src/progressdialogs/cdeleteprogressdialog.h \
 	src/version.h \
 	src/aboutdialog/caboutdialog.h \
@@ -60,8 +60,9 @@ CFilesSearchWindow::CFilesSearchWindow(const std::vector<QString>& targets) :
 	statusBar()->addWidget(_progressLabel, 1);
 	statusBar()->setSizePolicy(QSizePolicy::Ignored, statusBar()->sizePolicy().verticalPolicy());
 
-	connect(ui->resultsList, &QListWidget::itemActivated, [](QListWidgetItem* item){
-		CController::get().activePanel().goToItem(CFileSystemObject(item->data(Qt::UserRole).toString()));
+	ui->resultsList->setModel(&_resultsModel);
+	connect(ui->resultsList, &QListView::activated, [this](const QModelIndex& index){
+		CController::get().activePanel().goToItem(CFileSystemObject(_resultsModel.path(index)));
 		CMainWindow::get()->activateWindow();
 	});
 
@@ -71,9 +72,6 @@ CFilesSearchWindow::CFilesSearchWindow(const std::vector<QString>& targets) :
 	});
 
 	ui->cbNameCaseSensitive->setVisible(caseSensitiveFilesystem());
-
-	connect(&_resultsListUpdateTimer, &QTimer::timeout, this, &CFilesSearchWindow::addResultsToUi);
-	_resultsListUpdateTimer.start(100);
 }
 
 CFilesSearchWindow::~CFilesSearchWindow()
@@ -88,9 +86,10 @@ void CFilesSearchWindow::itemScanned(const QString& currentItem)
 	_progressLabel->setText(currentItem);
 }
 
-void CFilesSearchWindow::matchFound(const QString& path)
+void CFilesSearchWindow::matchesFound(const std::vector<QString>& paths)
 {
-	_matches.push_back(path);
+	_resultsModel.appendPaths(paths);
+	ui->resultsList->scrollToBottom();
 }
 
 void CFilesSearchWindow::searchFinished(CFileSearchEngine::SearchStatus status, uint32_t speed)
@@ -101,8 +100,8 @@ void CFilesSearchWindow::searchFinished(CFileSearchEngine::SearchStatus status,
 		message = message % ", " % tr("search speed: %1 items/sec").arg(speed);
 	_progressLabel->setText(message);
 	ui->resultsList->setFocus();
-	if (ui->resultsList->count() > 0)
-		ui->resultsList->item(0)->setSelected(true);
+	if (_resultsModel.rowCount() > 0)
+		ui->resultsList->setCurrentIndex(_resultsModel.index(0));
 }
 
 void CFilesSearchWindow::search()
@@ -118,28 +117,6 @@ void CFilesSearchWindow::search()
 
 	_engine.search(what, ui->cbNameCaseSensitive->isChecked(), ui->searchRoot->currentText().split("; "), withText, ui->cbContentsCaseSensitive->isChecked());
 	ui->btnSearch->setText("Stop");
-	ui->resultsList->clear();
+	_resultsModel.clear();
 	setWindowTitle('\"' % what % "\" " % tr("search results"));
 }
-
-void CFilesSearchWindow::addResultsToUi()
-{
-	if (_matches.empty())
-		return;
-
-	ui->resultsList->setUpdatesEnabled(false);
-	for (const QString& path: _matches)
-	{
-		const bool isDir = QFileInfo(path).isDir();
-
-		QListWidgetItem* item = new QListWidgetItem;
-		const QString nativePath = toNativeSeparators(path);
-		item->setText(isDir ? ('[' % nativePath % ']') : nativePath);
-		item->setData(Qt::UserRole, path);
-		ui->resultsList->addItem(item);
-	}
-
-	ui->resultsList->scrollToBottom();
-	ui->resultsList->setUpdatesEnabled(true);
-	_matches.clear();
-}
@@ -2,10 +2,10 @@
 
 #include "compiler/compiler_warnings_control.h"
 #include "filesearchengine/cfilesearchengine.h"
+#include "csearchresultsmodel.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QMainWindow>
-#include <QTimer>
 RESTORE_COMPILER_WARNINGS
 
 namespace Ui {
@@ -21,20 +21,17 @@ public:
 	~CFilesSearchWindow();
 
 	void itemScanned(const QString& currentItem) override;
-	void matchFound(const QString& path) override;
+	void matchesFound(const std::vector<QString>& paths) override;
 	void searchFinished(CFileSearchEngine::SearchStatus status, uint32_t speed) override;
 
 private:
 	void search();
 
-	void addResultsToUi();
-
 private:
 	Ui::CFilesSearchWindow *ui;
 	CFileSearchEngine& _engine;
 
 	QLabel* _progressLabel;
-	QTimer _resultsListUpdateTimer;
-	std::vector<QString> _matches;
+	CSearchResultsModel _resultsModel;
 };
 
@@ -0,0 +1,54 @@
+#include "csearchresultsmodel.h"
+#include "filesystemhelperfunctions.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QStringBuilder>
+RESTORE_COMPILER_WARNINGS
+
+CSearchResultsModel::CSearchResultsModel(QObject* parent) : QAbstractListModel(parent)
+{
+}
+
+void CSearchResultsModel::appendPaths(const std::vector<QString>& paths)
+{
+	if (paths.empty())
+		return;
+
+	beginInsertRows(QModelIndex(), (int)_paths.size(), (int)(_paths.size() + paths.size()) - 1);
+	_paths.insert(_paths.end(), paths.begin(), paths.end());
+	endInsertRows();
+}
+
+void CSearchResultsModel::clear()
+{
+	beginResetModel();
+	_paths.clear();
+	endResetModel();
+}
+
+QString CSearchResultsModel::path(const QModelIndex& index) const
+{
+	return index.isValid() && (size_t)index.row() < _paths.size() ? _paths[(size_t)index.row()] : QString();
+}
+
+int CSearchResultsModel::rowCount(const QModelIndex& parent) const
+{
+	return parent.isValid() ? 0 : (int)_paths.size();
+}
+
+QVariant CSearchResultsModel::data(const QModelIndex& index, int role) const
+{
+	if (!index.isValid() || (size_t)index.row() >= _paths.size())
+		return QVariant();
+
+	const QString& path = _paths[(size_t)index.row()];
+	if (role == Qt::DisplayRole)
+	{
+		const QString nativePath = toNativeSeparators(path);
+		return path.endsWith('/') ? QString('[' % nativePath % ']') : nativePath;
+	}
+	else if (role == Qt::UserRole)
+		return path;
+
+	return QVariant();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "compiler/compiler_warnings_control.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QAbstractListModel>
+RESTORE_COMPILER_WARNINGS
+
+#include <vector>
+
+// The search results: only the paths are stored, the display text is produced for the rows that are actually shown
+class CSearchResultsModel : public QAbstractListModel
+{
+public:
+	explicit CSearchResultsModel(QObject* parent = nullptr);
+
+	// Appends the batch as a single insertion
+	void appendPaths(const std::vector<QString>& paths);
+	void clear();
+
+	// Folders end with a slash
+	QString path(const QModelIndex& index) const;
+
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+	std::vector<QString> _paths;
+};
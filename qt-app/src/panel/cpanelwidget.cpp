@@ -17,7 +17,6 @@
 
 DISABLE_COMPILER_WARNINGS
 #include <QClipboard>
-#include <QDateTime>
 #include <QInputDialog>
 #include <QMenu>
 #include <QMessageBox>
@@ -27,10 +26,8 @@ DISABLE_COMPILER_WARNINGS
 RESTORE_COMPILER_WARNINGS
 
 #include <assert.h>
-#include <iostream>
 #include <time.h>
 #include <set>
-#include <tuple>
 
 CPanelWidget::CPanelWidget(QWidget *parent /* = 0 */) :
 	QWidget(parent),
@@ -162,7 +159,7 @@ void CPanelWidget::setPanelPosition(Panel p)
 }
 
 // Returns the list of items added to the view
-void CPanelWidget::fillFromList(const std::map<qulonglong, CFileSystemObject>& items, FileListRefreshCause operation)
+void CPanelWidget::fillFromList(const FileListSnapshot& items, FileListRefreshCause operation)
 {
 // 	time_t start = clock();
 // 	const auto globalStart = start;
@@ -173,78 +170,7 @@ void CPanelWidget::fillFromList(const std::map<qulonglong, CFileSystemObject>& i
 	const QModelIndex previousCurrentIndex = _selectionModel->currentIndex();
 
 	ui->_list->saveHeaderState();
-	_sortModel->setSourceModel(nullptr);
-	_model->clear();
-
-	_model->setColumnCount(NumberOfColumns);
-	_model->setHorizontalHeaderLabels(QStringList() << tr("Name") << tr("Ext") << tr("Size") << tr("Date"));
-
-	int itemRow = 0;
-
-	// TODO: replace with a struct
-	std::vector<std::tuple<int, FileListViewColumns, QStandardItem*>> qTreeViewItems;
-	qTreeViewItems.reserve(items.size() * NumberOfColumns);
-
-	for (const auto& item: items)
-	{
-		const CFileSystemObject& object = item.second;
-		const auto& props = object.properties();
-
-		std::cout << object.fullAbsolutePath().toLatin1().data();
-
-		QStandardItem * fileNameItem = new QStandardItem();
-		fileNameItem->setEditable(false);
-		if (props.type == Directory)
-			fileNameItem->setData(QString("[" % (object.isCdUp() ? QLatin1String("..") : props.fullName) % "]"), Qt::DisplayRole);
-		else if (props.completeBaseName.isEmpty() && props.type == File) // File without a name, displaying extension in the name field and adding point to extension
-			fileNameItem->setData(QString('.') + props.extension, Qt::DisplayRole);
-		else
-			fileNameItem->setData(props.completeBaseName, Qt::DisplayRole);
-		fileNameItem->setIcon(object.icon());
-		fileNameItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, NameColumn, fileNameItem);
-
-		QStandardItem * fileExtItem = new QStandardItem();
-		fileExtItem->setEditable(false);
-		if (!object.isCdUp() && !props.completeBaseName.isEmpty() && !props.extension.isEmpty())
-			fileExtItem->setData(props.extension, Qt::DisplayRole);
-		fileExtItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, ExtColumn, fileExtItem);
-
-		QStandardItem * sizeItem = new QStandardItem();
-		sizeItem->setEditable(false);
-		if (!object.isCdUp() && (props.type != Directory || props.size > 0))
-			sizeItem->setData(fileSizeToString(props.size), Qt::DisplayRole);
-		sizeItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, SizeColumn, sizeItem);
-
-		QStandardItem * dateItem = new QStandardItem();
-		dateItem->setEditable(false);
-		if (!object.isCdUp())
-		{
-			QDateTime modificationDate;
-			modificationDate.setTime_t((uint) props.modificationDate);
-			modificationDate = modificationDate.toLocalTime();
-			dateItem->setData(modificationDate.toString("dd.MM.yyyy hh:mm"), Qt::DisplayRole);
-		}
-		dateItem->setData(props.hash, Qt::UserRole); // Unique identifier for this object;
-		qTreeViewItems.emplace_back(itemRow, DateColumn, dateItem);
-
-		++itemRow;
-	}
-
-	//qInfo () << __FUNCTION__ << "Creating" << items.size() << "items took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
-
-	//start = clock();
-	for (const auto& qTreeViewItem: qTreeViewItems)
-		_model->setItem(std::get<0>(qTreeViewItem), std::get<1>(qTreeViewItem), std::get<2>(qTreeViewItem));
-
-	//qInfo () << __FUNCTION__ << "Setting" << items.size() << "items to the model took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
-
-	//start = clock();
-	_sortModel->setSourceModel(_model);
-	//qInfo () << __FUNCTION__ << "Setting the source model to sort model took" << (clock() - start) * 1000 / CLOCKS_PER_SEC << "ms";
-
+	_model->setItems(items);
 	ui->_list->restoreHeaderState();
 
 	auto indexUnderCursor = _sortModel->index(0, 0);
@@ -254,7 +180,7 @@ void CPanelWidget::fillFromList(const std::map<qulonglong, CFileSystemObject>& i
 	{
 		// Setting the folder we've just stepped out of as current
 		qulonglong targetFolderHash = 0;
-		for (auto& item: items)
+		for (auto& item: *items)
 		{
 			if (item.second.fullAbsolutePath() == previousFolder)
 			{
@@ -285,6 +211,14 @@ void CPanelWidget::fillFromList(const std::map<qulonglong, CFileSystemObject>& i
 	//qInfo () << __FUNCTION__ << items.size() << "items," << (clock() - globalStart) * 1000 / CLOCKS_PER_SEC << "ms";
 }
 
+void CPanelWidget::applyDelta(const CPanel& panel, const FileListDelta& delta)
+{
+	_model->applyDelta(panel.list(), delta);
+
+	// Sizes of the selected items may have changed
+	selectionChanged(QItemSelection(), QItemSelection());
+}
+
 void CPanelWidget::fillFromPanel(const CPanel &panel, FileListRefreshCause operation)
 {
 	const auto itemList = panel.list();
@@ -301,11 +235,11 @@ void CPanelWidget::fillFromPanel(const CPanel &panel, FileListRefreshCause opera
 	{
 		CTimeElapsed timer(true);
 		QItemSelection selection;
-		for (int row = 0; row < _sortModel->rowCount(); ++row)
+		for (const qulonglong hash: selectedItemsHashes)
 		{
-			const qulonglong hash = hashByItemRow(row);
-			if (selectedItemsHashes.count(hash) != 0)
-				selection.select(_sortModel->index(row, 0), _sortModel->index(row, 0));
+			const QModelIndex index = indexByHash(hash);
+			if (index.isValid())
+				selection.select(index, index);
 		}
 
 		timer.start();
@@ -677,7 +611,7 @@ void CPanelWidget::updateInfoLabel(const std::vector<qulonglong>& selection)
 	ui->_infoLabel->clear();
 
 	uint64_t numFilesSelected = 0, numFoldersSelected = 0, totalSize = 0, sizeSelected = 0, totalNumFolders = 0, totalNumFiles = 0;
-	for (const auto& item: _controller->panel(_panelPosition).list())
+	for (const auto& item: *_controller->panel(_panelPosition).list())
 	{
 		const CFileSystemObject& object = item.second;
 		if (object.isFile())
@@ -706,8 +640,7 @@ void CPanelWidget::updateInfoLabel(const std::vector<qulonglong>& selection)
 bool CPanelWidget::fileListReturnPressOrDoubleClickPerformed(const QModelIndex& item)
 {
 	assert_r(item.isValid());
-	QModelIndex source = _sortModel->mapToSource(item);
-	const qulonglong hash = _model->item(source.row(), source.column())->data(Qt::UserRole).toULongLong();
+	const qulonglong hash = _model->itemHash(_sortModel->mapToSource(item));
 	emit itemActivated(hash, this);
 	return true; // Consuming the event
 }
@@ -770,11 +703,8 @@ qulonglong CPanelWidget::hashByItemIndex(const QModelIndex &index) const
 {
 	if (!index.isValid())
 		return 0;
-	QStandardItem * item = _model->item(_sortModel->mapToSource(index).row(), 0);
-	assert_r(item);
-	bool ok = false;
-	const qulonglong hash = item->data(Qt::UserRole).toULongLong(&ok);
-	assert_r(ok);
+	const qulonglong hash = _model->itemHash(_sortModel->mapToSource(index));
+	assert_r(hash != 0);
 	return hash;
 }
 
@@ -788,11 +718,9 @@ QModelIndex CPanelWidget::indexByHash(const qulonglong hash, bool logFailures) c
 	if (hash == 0)
 		return QModelIndex();
 
-	for(int row = 0; row < _sortModel->rowCount(); ++row)
-	{
-		if (hashByItemRow(row) == hash)
-			return _sortModel->index(row, 0);
-	}
+	const QModelIndex index = _sortModel->mapFromSource(_model->indexByHash(hash));
+	if (index.isValid())
+		return index;
 
 	if (logFailures)
 		qInfo() << "Failed to find hash" << hash << "in" << currentDir();
@@ -844,6 +772,19 @@ void CPanelWidget::panelContentsChanged(Panel p , FileListRefreshCause operation
 		fillFromPanel(_controller->panel(_panelPosition), operation);
 }
 
+void CPanelWidget::panelContentsChangedIncrementally(Panel p, const FileListDelta& delta)
+{
+	if (p != _panelPosition)
+		return;
+
+	const CPanel& panel = _controller->panel(_panelPosition);
+	// The changes only make sense relative to the folder the view is showing
+	if (_directoryCurrentlyBeingDisplayed != panel.currentDirPathPosix())
+		fillFromPanel(panel, refreshCauseOther);
+	else
+		applyDelta(panel, delta);
+}
+
 void CPanelWidget::itemDiscoveryInProgress(Panel p, qulonglong /*itemHash*/, size_t /*progress*/, const QString& /*currentDir*/)
 {
 	if (p != _panelPosition)
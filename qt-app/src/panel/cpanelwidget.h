@@ -17,7 +17,6 @@ class CPanelWidget;
 
 class QItemSelectionModel;
 class QSortFilterProxyModel;
-class QStandardItem;
 
 class CFileListModel;
 class CFileListSortFilterProxyModel;
@@ -48,11 +47,12 @@ public:
 	void setPanelPosition(Panel p);
 
 	// Returns the list of items added to the view
-	void fillFromList(const std::map<qulonglong, CFileSystemObject>& items, FileListRefreshCause operation);
+	void fillFromList(const FileListSnapshot& items, FileListRefreshCause operation);
 	void fillFromPanel(const CPanel& panel, FileListRefreshCause operation);
 
 	// CPanel observers
 	void panelContentsChanged(Panel p, FileListRefreshCause operation) override;
+	void panelContentsChangedIncrementally(Panel p, const FileListDelta& delta) override;
 	void itemDiscoveryInProgress(Panel p, qulonglong itemHash, size_t progress, const QString& currentDir) override;
 
 	CFileListView * fileListView() const;
@@ -98,6 +98,8 @@ private slots:
 private:
 	void fillHistory();
 	void updateInfoLabel(const std::vector<qulonglong>& selection);
+	// Inserts, updates and removes only the rows listed in the delta, preserving the selection and the cursor
+	void applyDelta(const CPanel& panel, const FileListDelta& delta);
 
 // Callbacks
 	bool fileListReturnPressOrDoubleClickPerformed(const QModelIndex& item) override;
@@ -1,22 +1,33 @@
 #include "cfilelistmodel.h"
 #include "shell/cshell.h"
 #include "ccontroller.h"
+#include "filesystemhelperfunctions.h"
 #include "../../../cmainwindow.h"
 #include "../../columns.h"
 
 DISABLE_COMPILER_WARNINGS
+#include <QDateTime>
 #include <QMimeData>
 #include <QUrl>
 RESTORE_COMPILER_WARNINGS
 
+#include <algorithm>
+#include <functional>
 #include <set>
 
 CFileListModel::CFileListModel(QTreeView * treeView, QObject *parent) :
-	QStandardItemModel(0, NumberOfColumns, parent),
+	QAbstractTableModel(parent),
 	_controller(CController::get()),
 	_tree(treeView),
-	_panel(UnknownPanel)
+	_panel(UnknownPanel),
+	_items(std::make_shared<const std::map<qulonglong, CFileSystemObject>>())
 {
+	CIconProvider::addListener(this);
+}
+
+CFileListModel::~CFileListModel()
+{
+	CIconProvider::removeListener(this);
 }
 
 // Sets the position (left or right) of a panel that this model represents
@@ -36,26 +47,213 @@ QTreeView *CFileListModel::treeView() const
 	return _tree;
 }
 
+void CFileListModel::setItems(const FileListSnapshot& items)
+{
+	assert_and_return_r(items, );
+
+	beginResetModel();
+
+	_items = items;
+	_itemsAwaitingIcons.clear();
+	_rowHashes.clear();
+	_rowHashes.reserve(_items->size());
+	std::vector<const CFileSystemObject*> rowItems;
+	rowItems.reserve(_items->size());
+	for (const auto& item: *_items)
+	{
+		_rowHashes.push_back(item.first);
+		rowItems.push_back(&item.second);
+	}
+
+	_sortKeys = FileListSorting::buildKeys(rowItems);
+	rebuildRowIndex();
+
+	endResetModel();
+}
+
+void CFileListModel::applyDelta(const FileListSnapshot& items, const FileListDelta& delta)
+{
+	assert_and_return_r(items, );
+
+	std::vector<int> rowsToRemove;
+	for (const qulonglong hash: delta.removed)
+	{
+		const auto row = _rowByHash.find(hash);
+		if (row != _rowByHash.end() && items->count(hash) == 0)
+			rowsToRemove.push_back(row->second);
+	}
+
+	// The rows being removed are still displayed with the old snapshot until they're gone
+	if (!rowsToRemove.empty())
+	{
+		// Removing from the bottom up so that the remaining row numbers stay valid, adjacent rows in one go
+		std::sort(rowsToRemove.begin(), rowsToRemove.end(), std::greater<int>());
+		rowsToRemove.erase(std::unique(rowsToRemove.begin(), rowsToRemove.end()), rowsToRemove.end());
+		for (size_t i = 0; i < rowsToRemove.size();)
+		{
+			size_t rangeEnd = i + 1;
+			while (rangeEnd < rowsToRemove.size() && rowsToRemove[rangeEnd] == rowsToRemove[rangeEnd - 1] - 1)
+				++rangeEnd;
+
+			const int firstRow = rowsToRemove[rangeEnd - 1], lastRow = rowsToRemove[i];
+			beginRemoveRows(QModelIndex(), firstRow, lastRow);
+			_rowHashes.erase(_rowHashes.begin() + firstRow, _rowHashes.begin() + lastRow + 1);
+			_sortKeys.erase(_sortKeys.begin() + firstRow, _sortKeys.begin() + lastRow + 1);
+			endRemoveRows();
+
+			i = rangeEnd;
+		}
+
+		rebuildRowIndex();
+	}
+
+	_items = items;
+
+	// An item reported as inserted may already be listed, e. g. if it has been removed and created again
+	std::vector<int> updatedRows;
+	std::vector<const CFileSystemObject*> updatedItems, newItems;
+	for (const auto* hashes: {&delta.updated, &delta.inserted})
+	{
+		for (const qulonglong hash: *hashes)
+		{
+			const auto item = _items->find(hash);
+			if (item == _items->end())
+				continue; // Has been removed again by now
+
+			const auto row = _rowByHash.find(hash);
+			if (row != _rowByHash.end())
+			{
+				updatedRows.push_back(row->second);
+				updatedItems.push_back(&item->second);
+			}
+			else if (std::find(newItems.cbegin(), newItems.cend(), &item->second) == newItems.cend())
+				newItems.push_back(&item->second);
+		}
+	}
+
+	// The sort keys must be up to date by the time the proxy model gets the notification
+	const auto updatedKeys = FileListSorting::buildKeys(updatedItems);
+	for (size_t i = 0; i < updatedRows.size(); ++i)
+	{
+		_sortKeys[(size_t)updatedRows[i]] = updatedKeys[i];
+		emit dataChanged(index(updatedRows[i], 0), index(updatedRows[i], NumberOfColumns - 1));
+	}
+
+	if (!newItems.empty())
+	{
+		auto newKeys = FileListSorting::buildKeys(newItems);
+
+		const int firstNewRow = (int)_rowHashes.size();
+		beginInsertRows(QModelIndex(), firstNewRow, firstNewRow + (int)newItems.size() - 1);
+		for (size_t i = 0; i < newItems.size(); ++i)
+		{
+			_rowByHash[newItems[i]->hash()] = (int)_rowHashes.size();
+			_rowHashes.push_back(newItems[i]->hash());
+			_sortKeys.push_back(std::move(newKeys[i]));
+		}
+		endInsertRows();
+	}
+}
+
+int CFileListModel::rowCount(const QModelIndex & parent) const
+{
+	return parent.isValid() ? 0 : (int)_rowHashes.size();
+}
+
+int CFileListModel::columnCount(const QModelIndex & parent) const
+{
+	return parent.isValid() ? 0 : NumberOfColumns;
+}
+
+QVariant CFileListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QAbstractTableModel::headerData(section, orientation, role);
+
+	switch (section)
+	{
+	case NameColumn:
+		return tr("Name");
+	case ExtColumn:
+		return tr("Ext");
+	case SizeColumn:
+		return tr("Size");
+	case DateColumn:
+		return tr("Date");
+	default:
+		return QVariant();
+	}
+}
+
 QVariant CFileListModel::data(const QModelIndex & index, int role /*= Qt::DisplayRole*/) const
 {
-	if (role == Qt::ToolTipRole)
+	if (!index.isValid())
+		return role == Qt::ToolTipRole ? QVariant(QString()) : QVariant();
+
+	const CFileSystemObject* item = itemByRow(index.row());
+	if (!item)
+		return QVariant();
+
+	const auto& props = item->properties();
+	if (role == Qt::DisplayRole)
+	{
+		switch (index.column())
+		{
+		case NameColumn:
+			if (props.type == Directory)
+				return QString("[" % (item->isCdUp() ? QLatin1String("..") : props.fullName) % "]");
+			else if (props.completeBaseName.isEmpty() && props.type == File) // File without a name, displaying extension in the name field and adding point to extension
+				return QString(QString('.') + props.extension);
+			else
+				return props.completeBaseName;
+		case ExtColumn:
+			if (!item->isCdUp() && !props.completeBaseName.isEmpty() && !props.extension.isEmpty())
+				return props.extension;
+			break;
+		case SizeColumn:
+			if (!item->isCdUp() && (props.type != Directory || props.size > 0))
+				return fileSizeToString(props.size);
+			break;
+		case DateColumn:
+			if (!item->isCdUp())
+			{
+				QDateTime modificationDate;
+				modificationDate.setTime_t((uint) props.modificationDate);
+				return modificationDate.toLocalTime().toString("dd.MM.yyyy hh:mm");
+			}
+			break;
+		default:
+			break;
+		}
+
+		return QVariant();
+	}
+	else if (role == Qt::DecorationRole)
 	{
-		if (!index.isValid())
-			return QString();
+		if (index.column() != NameColumn)
+			return QVariant();
+
+		bool placeholder = false;
+		const QIcon& icon = CIconProvider::iconForFilesystemObjectAsync(*item, &placeholder);
+		if (placeholder)
+			_itemsAwaitingIcons.insert(_rowHashes[(size_t)index.row()]);
 
-		const CFileSystemObject item = _controller.itemByHash(_panel, itemHash(index));
-		return QString(item.fullName() % "\n\n" % QString::fromStdWString(CShell::toolTip(item.fullAbsolutePath().toStdWString())));
+		return icon;
+	}
+	else if (role == Qt::ToolTipRole)
+	{
+		return QString(item->fullName() % "\n\n" % QString::fromStdWString(CShell::toolTip(item->fullAbsolutePath().toStdWString())));
 	}
-	else if (role == Qt::EditRole)
+	else if (role == Qt::EditRole || role == FullNameRole)
 	{
-		return _controller.itemByHash(_panel, itemHash(index)).fullName();
+		return item->fullName();
 	}
-	else if (role == FullNameRole)
+	else if (role == Qt::UserRole)
 	{
-		return _controller.itemByHash(_panel, itemHash(index)).fullName();
+		return props.hash; // Unique identifier for this object
 	}
 	else
-		return QStandardItemModel::data(index, role);
+		return QVariant();
 }
 
 bool CFileListModel::setData(const QModelIndex & index, const QVariant & value, int role)
@@ -64,24 +262,23 @@ bool CFileListModel::setData(const QModelIndex & index, const QVariant & value,
 	{
 		const qulonglong hash = itemHash(index);
 		emit itemEdited(hash, value.toString());
-		return false;
 	}
-	else
-		return QStandardItemModel::setData(index, value, role);
+
+	// The list only changes when the panel says so
+	return false;
 }
 
 Qt::ItemFlags CFileListModel::flags(const QModelIndex & idx) const
 {
-	const Qt::ItemFlags flags = QStandardItemModel::flags(idx);
 	if (!idx.isValid())
-		return flags;
+		return Qt::ItemIsDropEnabled;
 
-	const qulonglong hash = itemHash(idx);
-	const CFileSystemObject item = _controller.itemByHash(_panel, hash);
+	const Qt::ItemFlags flags = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsDragEnabled | Qt::ItemIsDropEnabled;
+	const CFileSystemObject* item = itemByRow(idx.row());
 
-	if (!item.exists())
+	if (!item || !item->exists())
 		return flags;
-	else if (item.isCdUp())
+	else if (item->isCdUp())
 		return flags & ~Qt::ItemIsSelectable;
 	else
 		return flags | Qt::ItemIsEditable;
@@ -149,12 +346,65 @@ QMimeData *CFileListModel::mimeData(const QModelIndexList & indexes) const
 
 qulonglong CFileListModel::itemHash(const QModelIndex & index) const
 {
-	QStandardItem * itm = item(index.row(), 0);
-	if (!itm)
+	if (!index.isValid() || index.row() >= (int)_rowHashes.size())
 		return 0;
 
-	bool ok = false;
-	const qulonglong hash = itm->data(Qt::UserRole).toULongLong(&ok);
-	assert_and_return_r(ok, 0);
-	return hash;
+	return _rowHashes[(size_t)index.row()];
+}
+
+QModelIndex CFileListModel::indexByHash(qulonglong hash, int column) const
+{
+	const auto row = _rowByHash.find(hash);
+	return row != _rowByHash.end() ? index(row->second, column) : QModelIndex();
+}
+
+const std::vector<FileListSortKey>& CFileListModel::sortKeys() const
+{
+	return _sortKeys;
+}
+
+void CFileListModel::iconsResolved()
+{
+	std::vector<int> rows;
+	for (auto hash = _itemsAwaitingIcons.begin(); hash != _itemsAwaitingIcons.end();)
+	{
+		const auto row = _rowByHash.find(*hash);
+		const CFileSystemObject* item = row != _rowByHash.end() ? itemByRow(row->second) : nullptr;
+		if (item && !CIconProvider::iconResolved(*item))
+		{
+			++hash;
+			continue;
+		}
+
+		if (item)
+			rows.push_back(row->second);
+		hash = _itemsAwaitingIcons.erase(hash);
+	}
+
+	// One signal per run of consecutive rows
+	std::sort(rows.begin(), rows.end());
+	for (size_t first = 0, last = 0; first < rows.size(); first = ++last)
+	{
+		while (last + 1 < rows.size() && rows[last + 1] == rows[last] + 1)
+			++last;
+
+		emit dataChanged(index(rows[first], NameColumn), index(rows[last], NameColumn), QVector<int>{Qt::DecorationRole});
+	}
+}
+
+const CFileSystemObject* CFileListModel::itemByRow(int row) const
+{
+	if (row < 0 || row >= (int)_rowHashes.size())
+		return nullptr;
+
+	const auto item = _items->find(_rowHashes[(size_t)row]);
+	return item != _items->end() ? &item->second : nullptr;
+}
+
+void CFileListModel::rebuildRowIndex()
+{
+	_rowByHash.clear();
+	_rowByHash.reserve(_rowHashes.size());
+	for (size_t row = 0; row < _rowHashes.size(); ++row)
+		_rowByHash[_rowHashes[row]] = (int)row;
 }
@@ -2,28 +2,45 @@
 #define CFILELISTMODEL_H
 
 #include "cpanel.h"
+#include "filelistsorting.h"
+#include "iconprovider/ciconprovider.h"
 
 DISABLE_COMPILER_WARNINGS
-#include <QStandardItemModel>
+#include <QAbstractTableModel>
 RESTORE_COMPILER_WARNINGS
 
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 enum Role {
 	FullNameRole = Qt::UserRole+1
 };
 
 class CController;
 class QTreeView;
-class CFileListModel : public QStandardItemModel
+
+// Presents a snapshot of the panel's items without copying them. The display strings and icons are only produced for the rows that are actually shown.
+class CFileListModel : public QAbstractTableModel, private CIconProvider::IconsResolvedListener
 {
 	Q_OBJECT
 public:
 	explicit CFileListModel(QTreeView * treeview, QObject *parent = 0);
+	~CFileListModel() override;
 	// Sets the position (left or right) of a panel that this model represents
 	void setPanelPosition(Panel p);
 	Panel panelPosition() const;
 
 	QTreeView * treeView() const;
 
+	// Replaces all the rows
+	void setItems(const FileListSnapshot& items);
+	// Only inserts, removes and updates the rows listed in the delta. 'items' is the snapshot the delta has been applied to.
+	void applyDelta(const FileListSnapshot& items, const FileListDelta& delta);
+
+	int rowCount(const QModelIndex & parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex & parent = QModelIndex()) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 	QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
 	bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 	Qt::ItemFlags flags(const QModelIndex & index) const override;
@@ -35,14 +52,31 @@ public:
 	QMimeData* mimeData(const QModelIndexList &indexes) const override;
 
 	qulonglong itemHash(const QModelIndex& index) const;
+	// Returns an invalid index if there's no such item
+	QModelIndex indexByHash(qulonglong hash, int column = 0) const;
+	// The keys are kept up to date with the rows, one per row
+	const std::vector<FileListSortKey>& sortKeys() const;
 
 signals:
 	void itemEdited(qulonglong itemHash, QString newName);
 
+private:
+	// The rows are shown with placeholder icons until the actual ones are resolved. Only the rows whose icons have arrived are updated.
+	void iconsResolved() override;
+
+	const CFileSystemObject* itemByRow(int row) const;
+	void rebuildRowIndex();
+
 private:
 	CController & _controller;
 	QTreeView   * _tree;
 	Panel         _panel;
+
+	FileListSnapshot                        _items;
+	std::vector<qulonglong>                 _rowHashes; // The item hash for every row, in the order of rows
+	std::vector<FileListSortKey>            _sortKeys;  // In the order of rows
+	std::unordered_map<qulonglong, int>     _rowByHash;
+	mutable std::unordered_set<qulonglong>  _itemsAwaitingIcons; // Shown with a placeholder icon
 };
 
 #endif // CFILELISTMODEL_H
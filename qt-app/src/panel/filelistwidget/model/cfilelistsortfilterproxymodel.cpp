@@ -1,17 +1,15 @@
 #include "cfilelistsortfilterproxymodel.h"
-#include "ccontroller.h"
-#include "../../columns.h"
+#include "cfilelistmodel.h"
+#include "filelistsorting.h"
+#include "assert/advanced_assert.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QDebug>
-#include <QStandardItemModel>
 RESTORE_COMPILER_WARNINGS
 
 CFileListSortFilterProxyModel::CFileListSortFilterProxyModel(QObject *parent) :
 	QSortFilterProxyModel(parent),
-	_controller(CController::get()),
-	_panel(UnknownPanel),
-	_sorter(CNaturalSorting(nsaQCollator, SortingOptions()))
+	_panel(UnknownPanel)
 {
 }
 
@@ -22,9 +20,45 @@ void CFileListSortFilterProxyModel::setPanelPosition(Panel p)
 	_panel = p;
 }
 
-void CFileListSortFilterProxyModel::setSortingOptions(SortingOptions options)
+void CFileListSortFilterProxyModel::setSourceModel(QAbstractItemModel * sourceModel)
 {
-	_sorter.setSortingOptions(options);
+	for (const auto& connection: _sourceModelConnections)
+		disconnect(connection);
+	_sourceModelConnections.clear();
+
+	_fileListModel = dynamic_cast<const CFileListModel*>(sourceModel);
+	assert_r(_fileListModel || !sourceModel);
+	_sortedPositions.clear();
+
+	// Connecting before QSortFilterProxyModel does so that the positions are up to date by the time it re-sorts the rows
+	if (_fileListModel)
+	{
+		_sourceModelConnections.push_back(connect(_fileListModel, &QAbstractItemModel::modelReset, this, [this]() {
+			calculateSortedPositions(sortColumn(), sortOrder());
+		}));
+
+		_sourceModelConnections.push_back(connect(_fileListModel, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex&, int first, int last) {
+			if (!_sortedPositions.empty() && (size_t)first <= _sortedPositions.size())
+				_sortedPositions.insert(_sortedPositions.begin() + first, (size_t)(last - first + 1), -1);
+		}));
+
+		_sourceModelConnections.push_back(connect(_fileListModel, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex&, int first, int last) {
+			// The relative order of the remaining rows doesn't change
+			if ((size_t)last < _sortedPositions.size())
+				_sortedPositions.erase(_sortedPositions.begin() + first, _sortedPositions.begin() + last + 1);
+		}));
+
+		_sourceModelConnections.push_back(connect(_fileListModel, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles) {
+			// E. g. the icons, which have nothing to do with the sorting. No roles means all of them.
+			if (!roles.isEmpty() && !roles.contains(Qt::DisplayRole) && !roles.contains(Qt::EditRole) && !roles.contains(sortRole()))
+				return;
+
+			for (int row = topLeft.row(); row <= bottomRight.row() && (size_t)row < _sortedPositions.size(); ++row)
+				_sortedPositions[(size_t)row] = -1;
+		}));
+	}
+
+	QSortFilterProxyModel::setSourceModel(sourceModel);
 }
 
 bool CFileListSortFilterProxyModel::canDropMimeData(const QMimeData * data, Qt::DropAction action, int row, int column, const QModelIndex & parent) const
@@ -35,6 +69,7 @@ bool CFileListSortFilterProxyModel::canDropMimeData(const QMimeData * data, Qt::
 
 void CFileListSortFilterProxyModel::sort(int column, Qt::SortOrder order)
 {
+	calculateSortedPositions(column, order);
 	QSortFilterProxyModel::sort(column, order);
 	emit sorted();
 }
@@ -43,82 +78,31 @@ bool CFileListSortFilterProxyModel::lessThan(const QModelIndex &left, const QMod
 {
 	assert_r(left.column() == right.column());
 	assert_r(left.isValid() && right.isValid());
-	const int sortColumn = left.column();
-
-	QStandardItemModel * srcModel = dynamic_cast<QStandardItemModel*>(sourceModel());
-	QStandardItem * l = srcModel->item(left.row(), left.column());
-	QStandardItem * r = srcModel->item(right.row(), right.column());
-
-	if (!l && r)
-		return true;
-	else if (!r && l)
-		return false;
-	else if (!l && !r)
-		return false;
-
-	const qulonglong leftHash = l->data(Qt::UserRole).toULongLong();
-	const qulonglong rightHash = r->data(Qt::UserRole).toULongLong();
-
-	const CFileSystemObject leftItem = _controller.itemByHash(_panel, leftHash), rightItem = _controller.itemByHash(_panel, rightHash);
-
-	const bool descendingOrder = sortOrder() == Qt::DescendingOrder;
-	// Folders always before files, no matter the sorting column and direction
-	if (leftItem.isDir() && !rightItem.isDir())
-		return !descendingOrder;  // always keep directory on top
-	else if (!leftItem.isDir() && rightItem.isDir())
-		return descendingOrder;   // always keep directory on top
-
-	// [..] is always on top
-	if (leftItem.isCdUp())
-		return !descendingOrder;
-	else if (rightItem.isCdUp())
-		return descendingOrder;
-
-	switch (sortColumn)
+	assert_and_return_r(_fileListModel, false);
+
+	const size_t leftRow = (size_t)left.row(), rightRow = (size_t)right.row();
+	const auto& keys = _fileListModel->sortKeys();
+	assert_and_return_r(leftRow < keys.size() && rightRow < keys.size(), false);
+
+	if (_sortedPositionsColumn == left.column() && _sortedPositionsOrder == sortOrder() && leftRow < _sortedPositions.size() && rightRow < _sortedPositions.size())
 	{
-	case NameColumn:
-		// File name and extension sort is case-insensitive
-		return _sorter.lessThan(leftItem.fullName(), rightItem.fullName());
-		break;
-	case ExtColumn:
-		if (leftItem.isDir() && rightItem.isDir()) // Sorting directories by name, files - by extension
-			return _sorter.lessThan(leftItem.name(), rightItem.name());
-		else if (!leftItem.isDir() && !rightItem.isDir() && leftItem.extension().isEmpty() && rightItem.extension().isEmpty())
-			return _sorter.lessThan(leftItem.name(), rightItem.name());
-		else
-		{
-			QString leftExt = leftItem.extension(), rightExt = rightItem.extension();
-			QString leftName = leftItem.name(), rightName = rightItem.name();
-			if (rightName.isEmpty())
-			{
-				rightName = rightExt;
-				rightExt.clear();
-			}
-
-			if (leftName.isEmpty())
-			{
-				leftName = leftExt;
-				leftExt.clear();
-			}
-
-			if (_sorter.lessThan(leftExt, rightExt))
-				return true;
-			else if (_sorter.lessThan(rightExt, leftExt)) // check if extensions are the same
-				return false;
-			else // if they are - compare by names
-				return _sorter.lessThan(leftName, rightName);
-		}
-		break;
-	case SizeColumn:
-		return leftItem.size() < rightItem.size();
-		break;
-	case DateColumn:
-		return leftItem.properties().modificationDate < rightItem.properties().modificationDate;
-		break;
-	default:
-		break;
+		const int leftPosition = _sortedPositions[leftRow], rightPosition = _sortedPositions[rightRow];
+		if (leftPosition >= 0 && rightPosition >= 0)
+			return leftPosition < rightPosition;
 	}
 
-	assert_unconditional_r("Unhandled code path");
-	return false;
+	// A row that has been added or changed since the list was sorted
+	return FileListSorting::lessThan(keys[leftRow], keys[rightRow], left.column(), sortOrder() == Qt::DescendingOrder);
+}
+
+void CFileListSortFilterProxyModel::calculateSortedPositions(int column, Qt::SortOrder order)
+{
+	_sortedPositions.clear();
+	_sortedPositionsColumn = column;
+	_sortedPositionsOrder = order;
+
+	if (!_fileListModel || column < 0)
+		return;
+
+	_sortedPositions = FileListSorting::sortedPositions(_fileListModel->sortKeys(), column, order == Qt::DescendingOrder);
 }
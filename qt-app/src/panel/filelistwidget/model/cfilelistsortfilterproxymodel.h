@@ -1,14 +1,17 @@
 #pragma once
 
 #include "cpanel.h"
-#include "utils/naturalsorting/cnaturalsorting.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QSortFilterProxyModel>
 RESTORE_COMPILER_WARNINGS
 
-class CController;
+#include <vector>
 
+class CFileListModel;
+
+// Sorts by the keys CFileListModel precomputes for every row. The whole list is sorted on multiple threads up front,
+// so that QSortFilterProxyModel itself only has to compare the resulting positions.
 class CFileListSortFilterProxyModel : public QSortFilterProxyModel
 {
 	Q_OBJECT
@@ -18,7 +21,8 @@ public:
 	// Sets the position (left or right) of a panel that this model represents
 	void setPanelPosition(Panel p);
 
-	void setSortingOptions(SortingOptions options);
+	// Only CFileListModel is supported
+	void setSourceModel(QAbstractItemModel * sourceModel) override;
 
 // Drag and drop
 	bool canDropMimeData(const QMimeData * data, Qt::DropAction action, int row, int column, const QModelIndex & parent) const override;
@@ -32,8 +36,16 @@ protected:
 	bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
 
 private:
-	CController   & _controller;
-	Panel           _panel;
-	CNaturalSorting _sorter;
+	void calculateSortedPositions(int column, Qt::SortOrder order);
+
+private:
+	Panel                                _panel;
+	const CFileListModel               * _fileListModel = nullptr;
+	std::vector<QMetaObject::Connection> _sourceModelConnections;
+
+	// The position of every source row in the sorted list, or -1 for the rows added or changed since. Indexed by source row.
+	std::vector<int>                     _sortedPositions;
+	int                                  _sortedPositionsColumn = -1;
+	Qt::SortOrder                        _sortedPositionsOrder = Qt::AscendingOrder;
 };
 
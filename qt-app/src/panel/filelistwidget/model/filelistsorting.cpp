@@ -0,0 +1,171 @@
+#include "filelistsorting.h"
+#include "../../columns.h"
+#include "assert/advanced_assert.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCollator>
+RESTORE_COMPILER_WARNINGS
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+// Splits [0, count) into contiguous ranges and calls func(begin, end) for each range on its own thread. Small jobs are done on the calling thread.
+static void forEachRangeInParallel(size_t count, size_t minItemsPerThread, const std::function<void (size_t /*rangeIndex*/, size_t /*begin*/, size_t /*end*/)>& func)
+{
+	const size_t numThreads = std::max((size_t)1, std::min((size_t)std::thread::hardware_concurrency(), count / std::max(minItemsPerThread, (size_t)1)));
+	if (numThreads <= 1)
+	{
+		func(0, 0, count);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; ++i)
+		threads.emplace_back(func, i, count * i / numThreads, count * (i + 1) / numThreads);
+
+	for (auto& thread: threads)
+		thread.join();
+}
+
+static FileListSortKey buildKey(const CFileSystemObject& item, const QCollator& collator)
+{
+	const QString name = item.name(), extension = item.extension();
+	const QCollatorSortKey nameKey = collator.sortKey(name);
+
+	FileListSortKey key {
+		collator.sortKey(item.fullName()),
+		nameKey,
+		name.isEmpty() ? collator.sortKey(extension) : nameKey,
+		collator.sortKey(name.isEmpty() ? QString() : extension),
+		item.size(),
+		item.properties().modificationDate,
+		item.isDir(),
+		item.isCdUp(),
+		!extension.isEmpty()
+	};
+
+	return key;
+}
+
+std::vector<FileListSortKey> FileListSorting::buildKeys(const std::vector<const CFileSystemObject*>& items)
+{
+	// QCollator lazily initializes itself in its const methods, so every thread needs its own instance
+	std::vector<std::vector<FileListSortKey>> keysForRange(std::max(std::thread::hardware_concurrency(), 1u));
+	forEachRangeInParallel(items.size(), 2000, [&items, &keysForRange](size_t rangeIndex, size_t begin, size_t end) {
+		QCollator collator;
+		collator.setNumericMode(true);
+		collator.setCaseSensitivity(Qt::CaseInsensitive);
+
+		auto& keys = keysForRange[rangeIndex];
+		keys.reserve(end - begin);
+		for (size_t i = begin; i < end; ++i)
+			keys.push_back(buildKey(*items[i], collator));
+	});
+
+	std::vector<FileListSortKey> keys = std::move(keysForRange.front());
+	keys.reserve(items.size());
+	for (auto range = keysForRange.begin() + 1; range != keysForRange.end(); ++range)
+		std::move(range->begin(), range->end(), std::back_inserter(keys));
+
+	assert_r(keys.size() == items.size());
+	return keys;
+}
+
+bool FileListSorting::lessThan(const FileListSortKey& l, const FileListSortKey& r, int column, bool descendingOrder)
+{
+	// Folders always before files, no matter the sorting column and direction
+	if (l.isDir && !r.isDir)
+		return !descendingOrder;  // always keep directory on top
+	else if (!l.isDir && r.isDir)
+		return descendingOrder;   // always keep directory on top
+
+	// [..] is always on top
+	if (l.isCdUp)
+		return !descendingOrder;
+	else if (r.isCdUp)
+		return descendingOrder;
+
+	switch (column)
+	{
+	case NameColumn:
+		// File name and extension sort is case-insensitive
+		return l.fullName.compare(r.fullName) < 0;
+	case ExtColumn:
+		if (l.isDir && r.isDir) // Sorting directories by name, files - by extension
+			return l.name.compare(r.name) < 0;
+		else if (!l.isDir && !r.isDir && !l.hasExtension && !r.hasExtension)
+			return l.name.compare(r.name) < 0;
+		else
+		{
+			const int extensionComparison = l.extensionForExtensionSorting.compare(r.extensionForExtensionSorting);
+			if (extensionComparison != 0)
+				return extensionComparison < 0;
+			else // if the extensions are the same - compare by names
+				return l.nameForExtensionSorting.compare(r.nameForExtensionSorting) < 0;
+		}
+	case SizeColumn:
+		return l.size < r.size;
+	case DateColumn:
+		return l.modificationDate < r.modificationDate;
+	default:
+		break;
+	}
+
+	assert_unconditional_r("Unhandled code path");
+	return false;
+}
+
+std::vector<int> FileListSorting::sortedPositions(const std::vector<FileListSortKey>& keys, int column, bool descendingOrder)
+{
+	std::vector<int> order(keys.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	const auto less = [&keys, column, descendingOrder](int l, int r) {
+		return lessThan(keys[(size_t)l], keys[(size_t)r], column, descendingOrder);
+	};
+
+	// Every thread sorts its own range, then the neighboring ranges are merged pairwise
+	std::vector<size_t> rangeBoundaries(1, 0);
+	std::mutex boundariesMutex;
+	forEachRangeInParallel(order.size(), 5000, [&](size_t /*rangeIndex*/, size_t begin, size_t end) {
+		std::stable_sort(order.begin() + (ptrdiff_t)begin, order.begin() + (ptrdiff_t)end, less);
+
+		std::lock_guard<std::mutex> lock(boundariesMutex);
+		rangeBoundaries.push_back(end);
+	});
+
+	std::sort(rangeBoundaries.begin(), rangeBoundaries.end());
+	while (rangeBoundaries.size() > 2)
+	{
+		std::vector<size_t> mergedBoundaries(1, 0);
+		std::vector<std::thread> mergeThreads;
+		for (size_t i = 0; i + 2 < rangeBoundaries.size(); i += 2)
+		{
+			const auto first = order.begin() + (ptrdiff_t)rangeBoundaries[i], middle = order.begin() + (ptrdiff_t)rangeBoundaries[i + 1], last = order.begin() + (ptrdiff_t)rangeBoundaries[i + 2];
+			mergeThreads.emplace_back([first, middle, last, &less]() {
+				std::inplace_merge(first, middle, last, less);
+			});
+			mergedBoundaries.push_back(rangeBoundaries[i + 2]);
+		}
+
+		for (auto& thread: mergeThreads)
+			thread.join();
+
+		// An odd range out is merged on the next pass
+		if (mergedBoundaries.back() != rangeBoundaries.back())
+			mergedBoundaries.push_back(rangeBoundaries.back());
+
+		rangeBoundaries = std::move(mergedBoundaries);
+	}
+
+	std::vector<int> positions(keys.size());
+	for (size_t position = 0; position < order.size(); ++position)
+		positions[(size_t)order[position]] = (int)position;
+
+	return positions;
+}
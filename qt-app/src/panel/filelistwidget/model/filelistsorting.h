@@ -0,0 +1,40 @@
+#pragma once
+
+#include "cfilesystemobject.h"
+
+DISABLE_COMPILER_WARNINGS
+#include <QCollatorSortKey>
+RESTORE_COMPILER_WARNINGS
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+// Everything the file list is sorted by, extracted from a CFileSystemObject once per listing.
+// The names are pre-transformed by QCollator (natural, case-insensitive), so comparing them doesn't involve the collator any more.
+struct FileListSortKey
+{
+	QCollatorSortKey fullName;
+	QCollatorSortKey name;
+	// For the extension column: a file without a name (e. g. ".gitignore") is sorted by its extension as if it were the name
+	QCollatorSortKey nameForExtensionSorting;
+	QCollatorSortKey extensionForExtensionSorting;
+	uint64_t size;
+	time_t modificationDate;
+	bool isDir;
+	bool isCdUp;
+	bool hasExtension;
+};
+
+namespace FileListSorting {
+
+// Builds the keys in the same order as the items, on multiple threads if there are many
+std::vector<FileListSortKey> buildKeys(const std::vector<const CFileSystemObject*>& items);
+
+// The order of the file list: folders before files and [..] on top regardless of the direction, then by the column
+bool lessThan(const FileListSortKey& l, const FileListSortKey& r, int column, bool descendingOrder);
+
+// Sorts the keys on multiple threads and returns the position of every key in the sorted order. Equal keys keep their relative order.
+std::vector<int> sortedPositions(const std::vector<FileListSortKey>& keys, int column, bool descendingOrder);
+
+}
@@ -4,6 +4,8 @@
 #include "cpromptdialog.h"
 #include "filesystemhelperfunctions.h"
 #include "progressdialoghelpers.h"
+#include "settings/csettings.h"
+#include "settings.h"
 
 DISABLE_COMPILER_WARNINGS
 #include <QCloseEvent>
@@ -17,7 +19,9 @@ CCopyMoveDialog::CCopyMoveDialog(Operation operation, const std::vector<CFileSys
 	_mainWindow(mainWindow),
 	_op(operation),
 	_titleTemplate(_op == operationCopy ? tr("%1% Copying %2/s, %3 remaining") : tr("%1% Moving %2/s, %3 remaining")),
-	_labelTemplate(_op == operationCopy ? tr("Copying files... %2/s, %3 remaining") : tr("Moving files... %2/s, %3 remaining"))
+	_labelTemplate(_op == operationCopy ? tr("Copying files... %2/s, %3 remaining") : tr("Moving files... %2/s, %3 remaining")),
+	_estimatingTitleTemplate(_op == operationCopy ? tr("Copying %1/s, estimating...") : tr("Moving %1/s, estimating...")),
+	_estimatingLabelTemplate(_op == operationCopy ? tr("Copying files... %1/s, estimating the total size") : tr("Moving files... %1/s, estimating the total size"))
 {
 	ui->setupUi(this);
 	ui->_overallProgress->linkToWidgetstaskbarButton(this);
@@ -46,7 +50,9 @@ CCopyMoveDialog::CCopyMoveDialog(Operation operation, const std::vector<CFileSys
 	_eventsProcessTimer.start();
 	connect(&_eventsProcessTimer, &QTimer::timeout, this, &CCopyMoveDialog::processEvents);
 
+	CSettings s;
 	_performer->setWatcher(this);
+	_performer->setParallelCopying(s.value(KEY_OPERATIONS_PARALLEL_COPY_WORKERS, 4).toUInt(), s.value(KEY_OPERATIONS_PARALLEL_COPY_WORKERS_PER_DEVICE, 4).toUInt());
 	_performer->start();
 }
 
@@ -58,14 +64,25 @@ CCopyMoveDialog::~CCopyMoveDialog()
 	delete ui;
 }
 
-void CCopyMoveDialog::onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed, uint32_t secondsRemaining)
+void CCopyMoveDialog::onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed, uint32_t secondsRemaining, bool totalsEstimated)
 {
-	ui->_overallProgress->setValue((int)(totalPercentage + 0.5f));
-	ui->_overallProgressText->setText(QString::number(totalPercentage, 'f', 1).append('%'));
-
 	ui->_fileProgress->setValue((int)(filePercentage + 0.5f));
 	ui->_fileProgressText->setText(QString::number(filePercentage, 'f', 1).append('%'));
 
+	// The source tree is still being enumerated, the overall percentage and the time remaining are meaningless
+	if (totalsEstimated)
+	{
+		ui->_overallProgress->setValue(0);
+		ui->_overallProgressText->setText("...");
+
+		ui->_lblOperationName->setText(_estimatingLabelTemplate.arg(fileSizeToString(speed)));
+		ui->_lblNumFiles->setText(QString("%1/%2+").arg(numFilesProcessed).arg(totalNumFiles));
+		setWindowTitle(_estimatingTitleTemplate.arg(fileSizeToString(speed)));
+		return;
+	}
+
+	ui->_overallProgress->setValue((int)(totalPercentage + 0.5f));
+	ui->_overallProgressText->setText(QString::number(totalPercentage, 'f', 1).append('%'));
 
 	ui->_lblOperationName->setText(_labelTemplate.arg(fileSizeToString(speed)).arg(secondsToTimeIntervalString(secondsRemaining)));
 	ui->_lblNumFiles->setText(QString("%1/%2").arg(numFilesProcessed).arg(totalNumFiles));
@@ -23,7 +23,7 @@ public:
 	~CCopyMoveDialog();
 
 // Callbacks
-	void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining) override;
+	void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining, bool totalsEstimated) override;
 	void onProcessHalted(HaltReason, CFileSystemObject source, CFileSystemObject dest, QString errorMessage) override; // User decision required (file exists, file is read-only etc.)
 	void onProcessFinished(QString message = QString()) override; // Done or canceled
 	void onCurrentFileChanged(QString file) override; // Starting to process a new file
@@ -54,6 +54,8 @@ private:
 	QTimer                _eventsProcessTimer;
 	const QString         _titleTemplate;
 	const QString         _labelTemplate;
+	const QString         _estimatingTitleTemplate;
+	const QString         _estimatingLabelTemplate;
 };
 
 #endif // CCOPYMOVEDIALOG_H
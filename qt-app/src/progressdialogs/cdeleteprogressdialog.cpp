@@ -43,7 +43,7 @@ CDeleteProgressDialog::~CDeleteProgressDialog()
 	delete ui;
 }
 
-void CDeleteProgressDialog::onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float /*filePercentage*/, uint64_t speed, uint32_t secondsRemaining)
+void CDeleteProgressDialog::onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float /*filePercentage*/, uint64_t speed, uint32_t secondsRemaining, bool /*totalsEstimated*/)
 {
 	ui->_progress->setValue((int)(totalPercentage + 0.5f));
 	ui->_lblOperationNameAndSpeed->setText(tr("Deleting item %1 of %2, %3 items / second, %4 remaining").arg(numFilesProcessed).arg(totalNumFiles).arg(speed).arg(secondsToTimeIntervalString(secondsRemaining)));
@@ -24,7 +24,7 @@ public:
 	~CDeleteProgressDialog();
 
 // Callbacks
-	void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining) override;
+	void onProgressChanged(float totalPercentage, size_t numFilesProcessed, size_t totalNumFiles, float filePercentage, uint64_t speed /* B/s*/, uint32_t secondsRemaining, bool totalsEstimated) override;
 	void onProcessHalted(HaltReason, CFileSystemObject source, CFileSystemObject dest, QString errorMessage) override; // User decision required (file exists, file is read-only etc.)
 	void onProcessFinished(QString message = QString()) override; // Done or canceled
 	void onCurrentFileChanged(QString file) override; // Starting to process a new file
@@ -10,6 +10,8 @@ CSettingsPageOperations::CSettingsPageOperations(QWidget *parent) :
 	ui->setupUi(this);
 	CSettings s;
 	ui->_cbPromptForCopyOrMove->setChecked(s.value(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, true).toBool());
+	ui->_sbParallelCopyWorkers->setValue(s.value(KEY_OPERATIONS_PARALLEL_COPY_WORKERS, 4).toInt());
+	ui->_sbParallelCopyWorkersPerDevice->setValue(s.value(KEY_OPERATIONS_PARALLEL_COPY_WORKERS_PER_DEVICE, 4).toInt());
 }
 
 CSettingsPageOperations::~CSettingsPageOperations()
@@ -21,4 +23,6 @@ void CSettingsPageOperations::acceptSettings()
 {
 	CSettings s;
 	s.setValue(KEY_OPERATIONS_ASK_FOR_COPY_MOVE_CONFIRMATION, ui->_cbPromptForCopyOrMove->isChecked());
+	s.setValue(KEY_OPERATIONS_PARALLEL_COPY_WORKERS, ui->_sbParallelCopyWorkers->value());
+	s.setValue(KEY_OPERATIONS_PARALLEL_COPY_WORKERS_PER_DEVICE, ui->_sbParallelCopyWorkersPerDevice->value());
 }
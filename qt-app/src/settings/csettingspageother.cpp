@@ -15,6 +15,8 @@ CSettingsPageOther::CSettingsPageOther(QWidget *parent) :
 	CSettings s;
 	ui->_shellCommandName->setText(s.value(KEY_OTHER_SHELL_COMMAND_NAME, CShell::shellExecutable()).toString());
 	ui->_cbCheckForUpdatesAutomatically->setChecked(s.value(KEY_OTHER_CHECK_FOR_UPDATES_AUTOMATICALLY, true).toBool());
+	ui->_fileNameIndexLocations->setText(s.value(KEY_OTHER_FILE_NAME_INDEX_LOCATIONS).toStringList().join(";"));
+	ui->_contentsIndexLocations->setText(s.value(KEY_OTHER_CONTENTS_INDEX_LOCATIONS).toStringList().join(";"));
 }
 
 CSettingsPageOther::~CSettingsPageOther()
@@ -27,4 +29,6 @@ void CSettingsPageOther::acceptSettings()
 	CSettings s;
 	s.setValue(KEY_OTHER_SHELL_COMMAND_NAME, ui->_shellCommandName->text());
 	s.setValue(KEY_OTHER_CHECK_FOR_UPDATES_AUTOMATICALLY, ui->_cbCheckForUpdatesAutomatically->isChecked());
+	s.setValue(KEY_OTHER_FILE_NAME_INDEX_LOCATIONS, ui->_fileNameIndexLocations->text().split(';', QString::SkipEmptyParts));
+	s.setValue(KEY_OTHER_CONTENTS_INDEX_LOCATIONS, ui->_contentsIndexLocations->text().split(';', QString::SkipEmptyParts));
 }